@@ -0,0 +1,389 @@
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+
+// Qt Header
+#include <QtGui/QtGui>
+
+// Application header
+#include "Gesture.h"
+#include "HandControl.h"
+#include "Session.h"
+#include "Simulator.h"
+#include "UserMap.h"
+#pragma endregion
+
+#pragma region Allocation counter
+static boost::atomic<uint64_t> s_uAllocations( 0 );
+
+void* operator new( size_t uSize )
+{
+	s_uAllocations.fetch_add( 1, boost::memory_order_relaxed );
+	if( void* p = std::malloc( uSize ? uSize : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[]( size_t uSize )
+{
+	return operator new( uSize );
+}
+
+void operator delete( void* p ) throw()
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p ) throw()
+{
+	std::free( p );
+}
+#pragma endregion
+
+/**
+ * Stages measured for each frame
+ */
+enum EStage
+{
+	ST_UPDATE,		/**< QONI_UserMap::Update(): select user and colorize; the skeleton is left to engine */
+	ST_HAND,		/**< CGestureEngine::ProcessUsers(): skeleton, hand selection and hand control with view */
+	ST_BUTTON,		/**< CTimerButton::CheckInSide() */
+	ST_SKELETON,	/**< QONI_Skeleton::SetSkeleton(), also done by engine so not in end-to-end */
+	ST_PAINT,		/**< QONI_Skeleton::paint() into an image, done by view so not in end-to-end */
+	ST_END_TO_END,	/**< Update, hand and button */
+	ST_COUNT,
+};
+static const char* s_aStageName[ST_COUNT] = { "update", "hand", "button", "skeleton", "paint", "end_to_end" };
+
+/**
+ * Durations and allocations of one stage for all frames
+ */
+struct SStageRecord
+{
+	std::vector<double>		aMicroseconds;
+	std::vector<uint32_t>	aAllocations;
+};
+
+struct SStageSummary
+{
+	double	dMean;
+	double	dP50;
+	double	dP90;
+	double	dP99;
+	double	dP999;
+	double	dMax;
+	double	dAllocations;	/**< mean per frame */
+};
+
+static SStageSummary Summarize( const SStageRecord& rRecord )
+{
+	SStageSummary mSummary = {};
+	std::vector<double> aSorted = rRecord.aMicroseconds;
+	if( aSorted.empty() )
+		return mSummary;
+
+	std::sort( aSorted.begin(), aSorted.end() );
+	auto funcPercentile = [&aSorted]( double p ){
+		return aSorted[std::min( size_t( p * aSorted.size() ), aSorted.size() - 1 )];
+	};
+
+	double dSum = 0, dAllocations = 0;
+	for( size_t i = 0; i < aSorted.size(); ++ i )
+	{
+		dSum			+= aSorted[i];
+		dAllocations	+= rRecord.aAllocations[i];
+	}
+	mSummary.dMean			= dSum / aSorted.size();
+	mSummary.dP50			= funcPercentile( 0.5 );
+	mSummary.dP90			= funcPercentile( 0.9 );
+	mSummary.dP99			= funcPercentile( 0.99 );
+	mSummary.dP999			= funcPercentile( 0.999 );
+	mSummary.dMax			= aSorted.back();
+	mSummary.dAllocations	= dAllocations / aSorted.size();
+	return mSummary;
+}
+
+static void PrintUsage()
+{
+	std::cout << "NIBenchmark [--simulate | --replay file] [--frames n] [--warmup n]\n"
+				 "            [--users n] [--noise mm] [--lowconf p] [--resolution w/h]\n"
+				 "            [--colormap name] [--kernel name] [--threads n] [--incremental 0/1]\n"
+				 "            [--slots n] [--slotthreads n]\n"
+				 "            [--json file] [--trace file]" << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+	#pragma region Options
+	// no window, but Qt graphics items and images are used
+	QApplication qApp( argc, argv, false );
+
+	SSimulatorConfig mSimConfig;
+	std::string	sReplayFile, sJsonFile, sTraceFile;
+	int			iFrames = 3000, iWarmup = 100;
+	QString		sColorMap = "direct", sKernel = "auto";
+	unsigned int uThreads = 1, uSlots = 1, uSlotThreads = 1;
+	bool		bIncremental = true;
+
+	QStringList aArgs = qApp.arguments();
+	for( int i = 1; i < aArgs.size(); ++ i )
+	{
+		bool bValue = ( i + 1 < aArgs.size() );
+		if( aArgs[i] == "--simulate" )
+			sReplayFile.clear();
+		else if( aArgs[i] == "--replay" && bValue )
+			sReplayFile = aArgs[++i].toLocal8Bit().constData();
+		else if( aArgs[i] == "--frames" && bValue )
+			iFrames = aArgs[++i].toInt();
+		else if( aArgs[i] == "--warmup" && bValue )
+			iWarmup = aArgs[++i].toInt();
+		else if( aArgs[i] == "--users" && bValue )
+			mSimConfig.iUsers = aArgs[++i].toInt();
+		else if( aArgs[i] == "--noise" && bValue )
+			mSimConfig.fJointNoise = aArgs[++i].toFloat();
+		else if( aArgs[i] == "--lowconf" && bValue )
+			mSimConfig.fLowConfidence = aArgs[++i].toFloat();
+		else if( aArgs[i] == "--resolution" && bValue )
+		{
+			QStringList aSize = aArgs[++i].split('/');
+			if( aSize.length() == 2 )
+			{
+				mSimConfig.iWidth	= aSize[0].toInt();
+				mSimConfig.iHeight	= aSize[1].toInt();
+			}
+		}
+		else if( aArgs[i] == "--colormap" && bValue )
+			sColorMap = aArgs[++i];
+		else if( aArgs[i] == "--kernel" && bValue )
+			sKernel = aArgs[++i];
+		else if( aArgs[i] == "--threads" && bValue )
+			uThreads = aArgs[++i].toUInt();
+		else if( aArgs[i] == "--slots" && bValue )
+			uSlots = aArgs[++i].toUInt();
+		else if( aArgs[i] == "--slotthreads" && bValue )
+			uSlotThreads = aArgs[++i].toUInt();
+		else if( aArgs[i] == "--incremental" && bValue )
+			bIncremental = aArgs[++i].toInt() != 0;
+		else if( aArgs[i] == "--json" && bValue )
+			sJsonFile = aArgs[++i].toLocal8Bit().constData();
+		else if( aArgs[i] == "--trace" && bValue )
+			sTraceFile = aArgs[++i].toLocal8Bit().constData();
+		else
+		{
+			PrintUsage();
+			return -1;
+		}
+	}
+	iFrames = std::max( iFrames, 1 );
+	iWarmup = std::max( iWarmup, 0 );
+	#pragma endregion
+
+	#pragma region Frame source
+	CSimulatedSource	mSimulator;
+	CSessionPlayer		mPlayer;
+	if( sReplayFile.empty() )
+	{
+		mSimConfig.uBuffers = 2;
+		mSimulator.Open( mSimConfig );
+	}
+	else if( !mPlayer.Open( sReplayFile ) || mPlayer.GetFrameCount() == 0 )
+	{
+		std::cerr << "Can't replay " << sReplayFile << std::endl;
+		return -1;
+	}
+	#pragma endregion
+
+	#pragma region Stages
+	// same layout as QNIControl
+	QRectF qRect( 0, 0, 640, 480 );
+	nite::UserTracker mTracker;
+	QONI_UserMap mUserMap( mTracker );
+	mUserMap.SetColorizeKernel( sKernel );
+	mUserMap.SetColorizeThreads( uThreads );
+	mUserMap.SetColorMap( sColorMap );
+	mUserMap.SetIncremental( bIncremental );
+	mUserMap.SetSize( qRect.width(), qRect.height() );
+	mUserMap.SetRenderTarget( true, int( qRect.width() ) );
+	mUserMap.SetProcessSkeleton( false );
+
+	unsigned int uKeys = 0;
+	QHandControl mHandControl;
+	mHandControl.SetRect( qRect );
+	CGestureEngine mEngine;
+	mEngine.SetMaxUsers( uSlots );
+	mEngine.SetUserThreads( uSlotThreads );
+	mEngine.SetViewSize( int( qRect.width() ), int( qRect.height() ) );
+	mEngine.m_funcSendKey = [&uKeys]( unsigned short ){ ++ uKeys; };
+	mEngine.SetView( 0, &mHandControl );
+
+	QONI_Skeleton mSkeleton;
+	mSkeleton.SetViewSize( int( qRect.width() ), int( qRect.height() ) );
+	QImage qPaintTarget( int( qRect.width() ), int( qRect.height() ), QImage::Format_ARGB32_Premultiplied );
+	qPaintTarget.fill( 0 );
+	QPainter qPainter( &qPaintTarget );
+
+	CTimerButton mButton;
+	mButton.m_Pos = qRect.center();
+	#pragma endregion
+
+	#pragma region Run
+	typedef boost::chrono::steady_clock TClock;
+	std::array<SStageRecord,ST_COUNT> aRecords;
+	for( int s = 0; s < ST_COUNT; ++ s )
+	{
+		aRecords[s].aMicroseconds.reserve( iFrames );
+		aRecords[s].aAllocations.reserve( iFrames );
+	}
+
+	auto funcRecord = [&aRecords]( EStage eStage, TClock::time_point tpBegin, TClock::time_point tpEnd, uint64_t uAllocBegin, uint64_t uAllocEnd ){
+		aRecords[eStage].aMicroseconds.push_back( boost::chrono::duration<double,boost::micro>( tpEnd - tpBegin ).count() );
+		aRecords[eStage].aAllocations.push_back( uint32_t( uAllocEnd - uAllocBegin ) );
+	};
+
+	CUserFrame mFrame;
+	int iActiveFrames = 0;
+	TClock::time_point tpStart;
+	for( int i = -iWarmup; i < iFrames; ++ i )
+	{
+		if( i == 0 )
+		{
+			// markers of a frame in one thread: up to 10 of user map, selection and painting,
+			// and 3 of each user slot (TransformPose, SelectHand, HandControl)
+			if( !sTraceFile.empty() )
+				Trace::Start( iFrames * ( 10 + 3 * uSlots ) );
+			tpStart = TClock::now();
+		}
+		NIC_TRACE_SCOPE( "Frame" );
+
+		if( mSimulator.IsOpen() )
+			mSimulator.GenerateFrame( mFrame );
+		else
+			mPlayer.GetFrame( ( i + iWarmup ) % mPlayer.GetFrameCount(), mFrame );
+
+		// time and allocation count at the boundaries of stages
+		TClock::time_point	tpUpdate, tpUpdateEnd, tpHand, tpHandEnd, tpButtonEnd, tpSkeleton, tpSkeletonEnd, tpPaintEnd;
+		uint64_t			uUpdate, uUpdateEnd, uHand, uHandEnd, uButtonEnd, uSkeleton, uSkeletonEnd, uPaintEnd;
+
+		uUpdate		= s_uAllocations.load( boost::memory_order_relaxed );
+		tpUpdate	= TClock::now();
+		bool bActive = mUserMap.Update( mFrame );
+		tpUpdateEnd	= TClock::now();
+		uUpdateEnd	= s_uAllocations.load( boost::memory_order_relaxed );
+
+		uHand		= s_uAllocations.load( boost::memory_order_relaxed );
+		tpHand		= TClock::now();
+		mEngine.ProcessUsers( mFrame, mUserMap.GetTrackedUsers() );
+		tpHandEnd	= TClock::now();
+		uHandEnd	= s_uAllocations.load( boost::memory_order_relaxed );
+
+		mButton.CheckInSide( mEngine.GetHandControl().GetHandPos(), 0, mEngine.m_Clock.Now() );
+		tpButtonEnd	= TClock::now();
+		uButtonEnd	= s_uAllocations.load( boost::memory_order_relaxed );
+
+		// skeleton of active user, measured alone
+		const nite::UserData* pUser = ( bActive ? mUserMap.SelectActiveUser( mFrame ) : NULL );
+		uSkeleton	= s_uAllocations.load( boost::memory_order_relaxed );
+		tpSkeleton	= TClock::now();
+		if( pUser != NULL )
+			mSkeleton.SetSkeleton( pUser->getSkeleton() );
+		tpSkeletonEnd	= TClock::now();
+		uSkeletonEnd	= s_uAllocations.load( boost::memory_order_relaxed );
+
+		if( pUser != NULL )
+			mSkeleton.paint( &qPainter, NULL, NULL );
+		tpPaintEnd	= TClock::now();
+		uPaintEnd	= s_uAllocations.load( boost::memory_order_relaxed );
+
+		if( i < 0 )
+			continue;
+
+		iActiveFrames += bActive ? 1 : 0;
+		funcRecord( ST_UPDATE, tpUpdate, tpUpdateEnd, uUpdate, uUpdateEnd );
+		funcRecord( ST_HAND, tpHand, tpHandEnd, uHand, uHandEnd );
+		funcRecord( ST_BUTTON, tpHandEnd, tpButtonEnd, uHandEnd, uButtonEnd );
+		funcRecord( ST_SKELETON, tpSkeleton, tpSkeletonEnd, uSkeleton, uSkeletonEnd );
+		funcRecord( ST_PAINT, tpSkeletonEnd, tpPaintEnd, uSkeletonEnd, uPaintEnd );
+		funcRecord( ST_END_TO_END, tpUpdate, tpButtonEnd, uUpdate, uButtonEnd );
+	}
+	double dSeconds = boost::chrono::duration<double>( TClock::now() - tpStart ).count();
+	if( Trace::IsEnabled() )
+	{
+		Trace::Stop();
+		Trace::WriteJson( sTraceFile );
+	}
+	#pragma endregion
+
+	#pragma region Report
+	std::array<SStageSummary,ST_COUNT> aSummary;
+	for( int s = 0; s < ST_COUNT; ++ s )
+		aSummary[s] = Summarize( aRecords[s] );
+
+	double dFps = iFrames / dSeconds;
+	std::cout << ( mSimulator.IsOpen() ? "simulate" : sReplayFile ) << ", " << iFrames << " frames, "
+			  << iActiveFrames << " with active user, " << uKeys << " keys sent" << std::endl;
+	std::cout << "frames/sec: " << dFps << ", allocations/frame: " << aSummary[ST_END_TO_END].dAllocations << std::endl;
+	std::cout << std::left << std::setw( 12 ) << "stage (us)" << std::right << std::fixed << std::setprecision( 2 )
+			  << std::setw( 10 ) << "mean" << std::setw( 10 ) << "p50" << std::setw( 10 ) << "p90"
+			  << std::setw( 10 ) << "p99" << std::setw( 10 ) << "p99.9" << std::setw( 10 ) << "max"
+			  << std::setw( 10 ) << "allocs" << std::endl;
+	for( int s = 0; s < ST_COUNT; ++ s )
+	{
+		const SStageSummary& r = aSummary[s];
+		std::cout << std::left << std::setw( 12 ) << s_aStageName[s] << std::right
+				  << std::setw( 10 ) << r.dMean << std::setw( 10 ) << r.dP50 << std::setw( 10 ) << r.dP90
+				  << std::setw( 10 ) << r.dP99 << std::setw( 10 ) << r.dP999 << std::setw( 10 ) << r.dMax
+				  << std::setw( 10 ) << r.dAllocations << std::endl;
+	}
+
+	if( !sJsonFile.empty() )
+	{
+		std::ofstream fsJson( sJsonFile.c_str() );
+		if( !fsJson.is_open() )
+		{
+			std::cerr << "Can't write " << sJsonFile << std::endl;
+			return -1;
+		}
+
+		int iWidth = mSimulator.IsOpen() ? mSimulator.GetWidth() : mPlayer.GetWidth(),
+			iHeight = mSimulator.IsOpen() ? mSimulator.GetHeight() : mPlayer.GetHeight();
+		fsJson << std::setprecision( 3 ) << std::fixed;
+		fsJson << "{\n  \"source\": \"" << ( mSimulator.IsOpen() ? "simulate" : "replay" ) << "\",\n"
+			   << "  \"frames\": " << iFrames << ",\n"
+			   << "  \"width\": " << iWidth << ",\n"
+			   << "  \"height\": " << iHeight << ",\n"
+			   << "  \"users\": " << ( mSimulator.IsOpen() ? mSimConfig.iUsers : -1 ) << ",\n"
+			   << "  \"colormap\": \"" << sColorMap.toStdString() << "\",\n"
+			   << "  \"kernel\": \"" << CDepthColorizer::GetKernelName( mUserMap.GetColorizeKernel() ) << "\",\n"
+			   << "  \"threads\": " << uThreads << ",\n"
+			   << "  \"slots\": " << uSlots << ",\n"
+			   << "  \"slot_threads\": " << uSlotThreads << ",\n"
+			   << "  \"active_frames\": " << iActiveFrames << ",\n"
+			   << "  \"fps\": " << dFps << ",\n"
+			   << "  \"allocations_per_frame\": " << aSummary[ST_END_TO_END].dAllocations << ",\n"
+			   << "  \"stages_us\": {\n";
+		for( int s = 0; s < ST_COUNT; ++ s )
+		{
+			const SStageSummary& r = aSummary[s];
+			fsJson << "    \"" << s_aStageName[s] << "\": { \"mean\": " << r.dMean << ", \"p50\": " << r.dP50
+				   << ", \"p90\": " << r.dP90 << ", \"p99\": " << r.dP99 << ", \"p999\": " << r.dP999
+				   << ", \"max\": " << r.dMax << ", \"allocations\": " << r.dAllocations << " }"
+				   << ( s + 1 < ST_COUNT ? ",\n" : "\n" );
+		}
+		fsJson << "  }\n}\n";
+	}
+	#pragma endregion
+	return 0;
+}
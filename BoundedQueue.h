@@ -0,0 +1,107 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <deque>
+
+// Boost Header
+#include <boost/thread.hpp>
+#pragma endregion
+
+/**
+ * Bounded blocking queue between threads.
+ * When full, the oldest element is dropped so the producer never waits.
+ */
+template<typename _T>
+class TBoundedQueue
+{
+public:
+	TBoundedQueue( size_t uCapacity = 2 ) : m_uCapacity( uCapacity ), m_bStop( false ), m_uDropped( 0 )
+	{
+	}
+
+	/**
+	 * Push an element, return false if the oldest element is dropped; it is moved to pDropped if given
+	 */
+	bool Push( const _T& rValue, _T* pDropped = NULL )
+	{
+		bool bDrop = false;
+		{
+			boost::lock_guard<boost::mutex> lock( m_Mutex );
+			if( m_qData.size() >= m_uCapacity )
+			{
+				if( pDropped )
+					*pDropped = m_qData.front();
+				m_qData.pop_front();
+				++ m_uDropped;
+				bDrop = true;
+			}
+			m_qData.push_back( rValue );
+		}
+		m_cvData.notify_one();
+		return !bDrop;
+	}
+
+	/**
+	 * Wait for an element, return false if the queue is stopped
+	 */
+	bool Pop( _T& rValue )
+	{
+		boost::unique_lock<boost::mutex> lock( m_Mutex );
+		while( m_qData.empty() && !m_bStop )
+			m_cvData.wait( lock );
+
+		if( m_bStop )
+			return false;
+
+		rValue = m_qData.front();
+		m_qData.pop_front();
+		return true;
+	}
+
+	/**
+	 * Get an element without waiting
+	 */
+	bool TryPop( _T& rValue )
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		if( m_qData.empty() )
+			return false;
+
+		rValue = m_qData.front();
+		m_qData.pop_front();
+		return true;
+	}
+
+	/**
+	 * Wake up all waiting consumers and reject further Pop()
+	 */
+	void Stop()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock( m_Mutex );
+			m_bStop = true;
+		}
+		m_cvData.notify_all();
+	}
+
+	void Reset()
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_qData.clear();
+		m_bStop = false;
+	}
+
+	unsigned int GetDropped()
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		return m_uDropped;
+	}
+
+private:
+	size_t						m_uCapacity;
+	bool						m_bStop;
+	unsigned int				m_uDropped;
+	std::deque<_T>				m_qData;
+	boost::mutex				m_Mutex;
+	boost::condition_variable	m_cvData;
+};
@@ -0,0 +1,320 @@
+#include "ButtonLayout.h"
+
+// STL Header
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#pragma region CButtonGrid
+void CButtonGrid::Add( int iIndex, const QRectF& rBounds )
+{
+	SItem mItem;
+	mItem.iIndex	= iIndex;
+	mItem.mBounds	= rBounds;
+	m_aItems.push_back( mItem );
+}
+
+void CButtonGrid::Build()
+{
+	m_Bounds	= QRectF();
+	m_fCellSize	= 1;
+	for( auto itItem = m_aItems.begin(); itItem != m_aItems.end(); ++ itItem )
+	{
+		m_Bounds	= m_Bounds.isNull() ? itItem->mBounds : m_Bounds.united( itItem->mBounds );
+		m_fCellSize	= std::max( m_fCellSize, float( std::max( itItem->mBounds.width(), itItem->mBounds.height() ) ) );
+	}
+
+	// at most 64 x 64 cells even if buttons are far apart
+	m_fCellSize	= std::max( m_fCellSize, float( std::max( m_Bounds.width(), m_Bounds.height() ) ) / 64 );
+	m_iColumns	= std::max( 1, int( std::ceil( m_Bounds.width() / m_fCellSize ) ) );
+	m_iRows		= std::max( 1, int( std::ceil( m_Bounds.height() / m_fCellSize ) ) );
+
+	// count the buttons of each cell, then fill them in place
+	int iCells = m_iColumns * m_iRows;
+	m_aCellStart.assign( iCells + 1, 0 );
+	for( int iPass = 0; iPass < 2; ++ iPass )
+	{
+		std::vector<int> aFill( m_aCellStart.begin(), m_aCellStart.end() - 1 );
+		for( auto itItem = m_aItems.begin(); itItem != m_aItems.end(); ++ itItem )
+		{
+			const QRectF& rRect = itItem->mBounds;
+			int	iX0 = std::min( int( ( rRect.left() - m_Bounds.left() ) / m_fCellSize ), m_iColumns - 1 ),
+				iX1 = std::min( int( ( rRect.right() - m_Bounds.left() ) / m_fCellSize ), m_iColumns - 1 ),
+				iY0 = std::min( int( ( rRect.top() - m_Bounds.top() ) / m_fCellSize ), m_iRows - 1 ),
+				iY1 = std::min( int( ( rRect.bottom() - m_Bounds.top() ) / m_fCellSize ), m_iRows - 1 );
+			for( int y = iY0; y <= iY1; ++ y )
+			{
+				for( int x = iX0; x <= iX1; ++ x )
+				{
+					int iCell = y * m_iColumns + x;
+					if( iPass == 0 )
+						++ m_aCellStart[iCell + 1];
+					else
+						m_aCellItems[aFill[iCell] ++] = itItem->iIndex;
+				}
+			}
+		}
+
+		if( iPass == 0 )
+		{
+			for( int i = 0; i < iCells; ++ i )
+				m_aCellStart[i + 1] += m_aCellStart[i];
+			m_aCellItems.resize( m_aCellStart.back() );
+		}
+	}
+}
+
+void CButtonGrid::Query( const QPointF& rPt, const int*& pFirst, const int*& pLast ) const
+{
+	pFirst = pLast = NULL;
+	if( m_aCellItems.empty() || !m_Bounds.contains( rPt ) )
+		return;
+
+	int	x = std::min( int( ( rPt.x() - m_Bounds.left() ) / m_fCellSize ), m_iColumns - 1 ),
+		y = std::min( int( ( rPt.y() - m_Bounds.top() ) / m_fCellSize ), m_iRows - 1 );
+	int iCell = y * m_iColumns + x;
+	pFirst	= m_aCellItems.data() + m_aCellStart[iCell];
+	pLast	= m_aCellItems.data() + m_aCellStart[iCell + 1];
+}
+#pragma endregion
+
+#pragma region CButtonLayout
+/**
+ * Virtual-key codes of Windows by name
+ */
+static const struct
+{
+	const char*		szName;
+	unsigned short	uKey;
+} s_aKeyName[] = {
+	{ "BACK",		0x08 },
+	{ "TAB",		0x09 },
+	{ "RETURN",		0x0D },
+	{ "ESCAPE",		0x1B },
+	{ "SPACE",		0x20 },
+	{ "PRIOR",		0x21 },
+	{ "NEXT",		0x22 },
+	{ "END",		0x23 },
+	{ "HOME",		0x24 },
+	{ "LEFT",		0x25 },
+	{ "UP",			0x26 },
+	{ "RIGHT",		0x27 },
+	{ "DOWN",		0x28 },
+	{ "F5",			0x74 },
+	{ "VOLUME_MUTE",		0xAD },
+	{ "VOLUME_DOWN",		0xAE },
+	{ "VOLUME_UP",			0xAF },
+	{ "MEDIA_NEXT_TRACK",	0xB0 },
+	{ "MEDIA_PREV_TRACK",	0xB1 },
+	{ "MEDIA_PLAY_PAUSE",	0xB3 },
+};
+
+/**
+ * Parse "x/y"
+ */
+static QPointF ParsePoint( const QString& sValue )
+{
+	QStringList aValue = sValue.split( '/' );
+	if( aValue.size() != 2 )
+		return QPointF();
+	return QPointF( aValue[0].toFloat(), aValue[1].toFloat() );
+}
+
+CButtonLayout CButtonLayout::Default()
+{
+	CButtonLayout mLayout;
+	mLayout.m_aPages.resize( 1 );
+	SPage& rPage = mLayout.m_aPages[0];
+	rPage.sName = "main";
+
+	SButton mButton;
+	mButton.fSize	= 70;
+	mButton.eShape	= BSH_CIRCLE;
+	mButton.bDepth	= false;
+	mButton.iTime	= 0;
+	mButton.eAction	= BA_KEY;
+	mButton.iPage	= 0;
+
+	mButton.sName	= "next";
+	mButton.mPos	= QPointF( 80, 0 );
+	mButton.uKey	= 0x22;
+	rPage.aButtons.push_back( mButton );
+
+	mButton.sName	= "previous";
+	mButton.mPos	= QPointF( -80, 0 );
+	mButton.uKey	= 0x21;
+	rPage.aButtons.push_back( mButton );
+	return mLayout;
+}
+
+bool CButtonLayout::Load( const QString& sFile )
+{
+	if( !QFile::exists( sFile ) )
+	{
+		std::cerr << "Can't open button layout " << sFile.toLocal8Bit().constData() << std::endl;
+		return false;
+	}
+
+	QSettings qFile( sFile, QSettings::IniFormat );
+	QStringList aPages = qFile.value( "Layout/Pages" ).toStringList();
+	if( aPages.isEmpty() )
+	{
+		std::cerr << "No [Layout] Pages in button layout " << sFile.toLocal8Bit().constData() << std::endl;
+		return false;
+	}
+
+	// names first, so the buttons can go to any page
+	CButtonLayout mLayout;
+	mLayout.m_aPages.resize( aPages.size() );
+	for( int i = 0; i < aPages.size(); ++ i )
+		mLayout.m_aPages[i].sName = aPages[i].trimmed();
+
+	for( int i = 0; i < aPages.size(); ++ i )
+	{
+		qFile.beginGroup( mLayout.m_aPages[i].sName );
+		bool bOK = mLayout.LoadPage( qFile, i );
+		qFile.endGroup();
+		if( !bOK )
+		{
+			std::cerr << "in button layout " << sFile.toLocal8Bit().constData() << std::endl;
+			return false;
+		}
+	}
+
+	*this = mLayout;
+	return true;
+}
+
+bool CButtonLayout::LoadPage( QSettings& rFile, int iPage )
+{
+	SPage& rPage = m_aPages[iPage];
+
+	// the defaults of buttons in page
+	QString	sArrange	= rFile.value( "Arrange", "free" ).toString().toLower();
+	QPointF	ptCenter	= ParsePoint( rFile.value( "Center", "0/0" ).toString() );
+	float	fSize		= rFile.value( "Size", 70 ).toFloat();
+	QString	sShape		= rFile.value( "Shape", "circle" ).toString().toLower();
+	QString	sPress		= rFile.value( "Press", "timer" ).toString().toLower();
+	int		iTime		= rFile.value( "Time", 0 ).toInt();
+
+	// radial: on a circle around the center, from Angle (degree, counter-clockwise from right)
+	float	fRadius		= rFile.value( "Radius", 120 ).toFloat(),
+			fAngle		= rFile.value( "Angle", 90 ).toFloat(),
+			fStep		= rFile.value( "Step", 0 ).toFloat();
+
+	// grid: rows of Columns buttons, centered
+	int		iColumns	= std::max( rFile.value( "Columns", 3 ).toInt(), 1 );
+	float	fSpacing	= rFile.value( "Spacing", fSize + 20 ).toFloat();
+
+	int iCount = rFile.beginReadArray( "Buttons" );
+	if( iCount == 0 )
+	{
+		std::cerr << "Page " << rPage.sName.toLocal8Bit().constData() << " has no buttons" << std::endl;
+		rFile.endArray();
+		return false;
+	}
+	if( fStep == 0 )
+		fStep = 360.0f / iCount;
+	int iRows = ( iCount + iColumns - 1 ) / iColumns;
+
+	bool bOK = true;
+	for( int i = 0; i < iCount && bOK; ++ i )
+	{
+		rFile.setArrayIndex( i );
+
+		SButton mButton;
+		mButton.sLabel	= rFile.value( "Label", "" ).toString();
+		mButton.fSize	= rFile.value( "Size", fSize ).toFloat();
+		mButton.eShape	= ( rFile.value( "Shape", sShape ).toString().toLower() == "rect" ? BSH_RECT : BSH_CIRCLE );
+		mButton.bDepth	= ( rFile.value( "Press", sPress ).toString().toLower() == "depth" );
+		mButton.iTime	= rFile.value( "Time", iTime ).toInt();
+
+		QString sAction = rFile.value( "Action", "" ).toString();
+		bOK = ParseAction( sAction, mButton );
+		mButton.sName	= rFile.value( "Name", mButton.sLabel.isEmpty() ? sAction : mButton.sLabel ).toString();
+
+		if( sArrange == "radial" )
+		{
+			float fRad = ( fAngle + fStep * i ) * 3.14159265f / 180;
+			mButton.mPos = ptCenter + QPointF( fRadius * std::cos( fRad ), -fRadius * std::sin( fRad ) );
+		}
+		else if( sArrange == "grid" )
+		{
+			mButton.mPos = ptCenter + QPointF( ( i % iColumns - ( iColumns - 1 ) / 2.0f ) * fSpacing,
+											   ( i / iColumns - ( iRows - 1 ) / 2.0f ) * fSpacing );
+		}
+		else
+		{
+			mButton.mPos = ParsePoint( rFile.value( "Pos", "0/0" ).toString() );
+		}
+		rPage.aButtons.push_back( mButton );
+	}
+	rFile.endArray();
+
+	if( !bOK )
+		std::cerr << "Wrong action of page " << rPage.sName.toLocal8Bit().constData() << std::endl;
+	return bOK;
+}
+
+bool CButtonLayout::ParseAction( const QString& sAction, SButton& rButton ) const
+{
+	QStringList aWord = sAction.trimmed().split( ' ', QString::SkipEmptyParts );
+	if( aWord.isEmpty() )
+		return false;
+
+	QString sType = aWord[0].toLower();
+	rButton.uKey	= 0;
+	rButton.iPage	= 0;
+	if( sType == "back" && aWord.size() == 1 )
+	{
+		rButton.eAction = BA_BACK;
+		return true;
+	}
+	if( aWord.size() != 2 )
+		return false;
+
+	if( sType == "page" )
+	{
+		rButton.eAction = BA_PAGE;
+		for( size_t i = 0; i < m_aPages.size(); ++ i )
+		{
+			if( m_aPages[i].sName == aWord[1] )
+			{
+				rButton.iPage = int( i );
+				return true;
+			}
+		}
+		return false;
+	}
+
+	if( sType == "key" )
+	{
+		// a name, a letter or digit, or a virtual key code like 0x22
+		rButton.eAction = BA_KEY;
+		QString sKey = aWord[1].toUpper();
+		for( size_t i = 0; i < sizeof( s_aKeyName ) / sizeof( s_aKeyName[0] ); ++ i )
+		{
+			if( sKey == s_aKeyName[i].szName )
+			{
+				rButton.uKey = s_aKeyName[i].uKey;
+				return true;
+			}
+		}
+
+		if( sKey.size() == 1 && sKey[0].isLetterOrNumber() )
+		{
+			rButton.uKey = sKey[0].unicode();
+			return true;
+		}
+
+		if( sKey.startsWith( "0X" ) )
+		{
+			bool bNumber = false;
+			rButton.uKey = sKey.mid( 2 ).toUShort( &bNumber, 16 );
+			if( bNumber && rButton.uKey != 0 )
+				return true;
+		}
+	}
+	return false;
+}
+#pragma endregion
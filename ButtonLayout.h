@@ -0,0 +1,116 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <vector>
+
+// Qt Header
+#include <QtCore/QSettings>
+#include <QtGui/QtGui>
+#pragma endregion
+
+/**
+ * Shape of a button for hit test, m_fSize is the diameter or the side
+ */
+enum EButtonShape
+{
+	BSH_RECT,
+	BSH_CIRCLE,
+};
+
+/**
+ * Uniform grid over the buttons of a page, to find the buttons which may contain a point
+ * without testing all of them. The cell size is the largest button, so a button covers at
+ * most 2 x 2 cells and a cell has only a few buttons.
+ */
+class CButtonGrid
+{
+public:
+	CButtonGrid() : m_fCellSize( 1 ), m_iColumns( 0 ), m_iRows( 0 ) {}
+
+	/**
+	 * Add the bounds of button iIndex, call Build() after all buttons are added
+	 */
+	void Add( int iIndex, const QRectF& rBounds );
+
+	void Build();
+
+	/**
+	 * Buttons whose bounds cover the cell of rPt, as [first, last); empty if out of all buttons
+	 */
+	void Query( const QPointF& rPt, const int*& pFirst, const int*& pLast ) const;
+
+private:
+	struct SItem
+	{
+		int		iIndex;
+		QRectF	mBounds;
+	};
+
+	std::vector<SItem>	m_aItems;
+	QRectF				m_Bounds;
+	float				m_fCellSize;
+	int					m_iColumns;
+	int					m_iRows;
+	std::vector<int>	m_aCellStart;		/**< Begin of each cell in m_aCellItems, and the end */
+	std::vector<int>	m_aCellItems;
+};
+
+/**
+ * Pages of buttons shown by the hand control, loaded from a layout file.
+ * The first page is shown when the hand is fixed. Positions are relative to the fixed hand.
+ */
+class CButtonLayout
+{
+public:
+	enum EAction
+	{
+		BA_KEY,			/**< Send uKey */
+		BA_PAGE,		/**< Show page iPage */
+		BA_BACK,		/**< Show the page before */
+	};
+
+	struct SButton
+	{
+		QString			sLabel;			/**< Drawn on the button, can be empty */
+		QString			sName;			/**< Printed and used as flight record name */
+		QPointF			mPos;
+		float			fSize;
+		EButtonShape	eShape;
+		bool			bDepth;			/**< Pressed by pushing forward, or by staying */
+		int				iTime;			/**< Time to press (ms), 0 for the InvokeTime of hand control */
+		EAction			eAction;
+		unsigned short	uKey;
+		int				iPage;
+	};
+
+	struct SPage
+	{
+		QString					sName;
+		std::vector<SButton>	aButtons;
+	};
+
+public:
+	std::vector<SPage>	m_aPages;
+
+public:
+	/**
+	 * The two buttons of previous and next page, for presentation
+	 */
+	static CButtonLayout Default();
+
+	/**
+	 * Load an INI layout file, keep the layout and return false if it has an error
+	 */
+	bool Load( const QString& sFile );
+
+private:
+	/**
+	 * Load the buttons of page iPage from the current group of rFile
+	 */
+	bool LoadPage( QSettings& rFile, int iPage );
+
+	/**
+	 * Parse "key NAME", "page NAME" or "back"
+	 */
+	bool ParseAction( const QString& sAction, SButton& rButton ) const;
+};
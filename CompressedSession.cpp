@@ -0,0 +1,613 @@
+#include "CompressedSession.h"
+
+// STL Header
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace CompressedSession;
+
+static const char s_aMagic[8] = { 'Q', 'O', 'N', 'I', 'S', 'E', 'Z', '1' };
+
+#pragma region Codec
+namespace
+{
+	enum
+	{
+		RICE_BLOCK		= 16,	/**< pixels share one Rice parameter */
+		RICE_ESCAPE		= 24,	/**< unary prefix length to store raw 16 bits */
+	};
+
+	/**
+	 * LSB-first bit stream writer
+	 */
+	class CBitWriter
+	{
+	public:
+		CBitWriter( std::vector<uint8_t>& rOut ) : m_rOut( rOut ), m_uBits( 0 ), m_iCount( 0 )
+		{
+		}
+
+		/**
+		 * Write the low iBits bits of uValue, iBits <= 32
+		 */
+		void Put( uint32_t uValue, int iBits )
+		{
+			m_uBits |= uint64_t( uValue ) << m_iCount;
+			m_iCount += iBits;
+			while( m_iCount >= 8 )
+			{
+				m_rOut.push_back( uint8_t( m_uBits ) );
+				m_uBits >>= 8;
+				m_iCount -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if( m_iCount > 0 )
+				m_rOut.push_back( uint8_t( m_uBits ) );
+			m_uBits		= 0;
+			m_iCount	= 0;
+		}
+
+	private:
+		std::vector<uint8_t>&	m_rOut;
+		uint64_t				m_uBits;
+		int						m_iCount;
+	};
+
+	/**
+	 * LSB-first bit stream reader, read 0 after end of data
+	 */
+	class CBitReader
+	{
+	public:
+		CBitReader( const uint8_t* pData, size_t uSize ) : m_pData( pData ), m_pEnd( pData + uSize ), m_uBits( 0 ), m_iCount( 0 )
+		{
+		}
+
+		uint32_t Get( int iBits )
+		{
+			while( m_iCount < iBits )
+			{
+				uint64_t uByte = ( m_pData < m_pEnd ? *m_pData++ : 0 );
+				m_uBits |= uByte << m_iCount;
+				m_iCount += 8;
+			}
+			uint32_t uValue = uint32_t( m_uBits & ( ( uint64_t( 1 ) << iBits ) - 1 ) );
+			m_uBits >>= iBits;
+			m_iCount -= iBits;
+			return uValue;
+		}
+
+		/**
+		 * Count 1 bits until a 0 bit, at most iLimit
+		 */
+		int GetUnary( int iLimit )
+		{
+			int q = 0;
+			while( q < iLimit && Get( 1 ) )
+				++ q;
+			return q;
+		}
+
+	private:
+		const uint8_t*	m_pData;
+		const uint8_t*	m_pEnd;
+		uint64_t		m_uBits;
+		int				m_iCount;
+	};
+
+	inline uint16_t ZigZag( uint16_t uDelta )
+	{
+		int16_t iDelta = int16_t( uDelta );
+		return uint16_t( ( iDelta << 1 ) ^ ( iDelta >> 15 ) );
+	}
+
+	inline uint16_t UnZigZag( uint16_t uValue )
+	{
+		return uint16_t( ( uValue >> 1 ) ^ ( 0 - ( uValue & 1 ) ) );
+	}
+
+	void PutVarint( std::vector<uint8_t>& rOut, uint32_t uValue )
+	{
+		while( uValue >= 0x80 )
+		{
+			rOut.push_back( uint8_t( uValue | 0x80 ) );
+			uValue >>= 7;
+		}
+		rOut.push_back( uint8_t( uValue ) );
+	}
+
+	bool GetVarint( const uint8_t*& rpData, const uint8_t* pEnd, uint32_t& rValue )
+	{
+		rValue = 0;
+		for( int iShift = 0; iShift < 35 && rpData < pEnd; iShift += 7 )
+		{
+			uint8_t uByte = *rpData++;
+			rValue |= uint32_t( uByte & 0x7f ) << iShift;
+			if( !( uByte & 0x80 ) )
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Predict each pixel from previous frame, or from the left (upper for first column)
+	 * pixel in key frame, and Rice code the residuals.
+	 */
+	void EncodeDepth( const uint16_t* pDepth, const uint16_t* pPrev, int w, int h, std::vector<uint8_t>& rOut )
+	{
+		rOut.clear();
+		CBitWriter mWriter( rOut );
+
+		int iPixels = w * h;
+		std::array<uint16_t,RICE_BLOCK> aResidual;
+		for( int iBlock = 0; iBlock < iPixels; iBlock += RICE_BLOCK )
+		{
+			int iCount = std::min<int>( RICE_BLOCK, iPixels - iBlock );
+			uint32_t uSum = 0;
+			for( int i = 0; i < iCount; ++ i )
+			{
+				int iIdx = iBlock + i;
+				uint16_t uPredict;
+				if( pPrev != NULL )
+					uPredict = pPrev[iIdx];
+				else if( iIdx % w != 0 )
+					uPredict = pDepth[iIdx - 1];
+				else
+					uPredict = ( iIdx >= w ? pDepth[iIdx - w] : 0 );
+
+				aResidual[i] = ZigZag( uint16_t( pDepth[iIdx] - uPredict ) );
+				uSum += aResidual[i];
+			}
+
+			// 2^k is about the mean of residuals
+			int k = 0;
+			while( k < 15 && ( uint32_t( iCount ) << k ) < uSum )
+				++ k;
+			mWriter.Put( k, 4 );
+
+			for( int i = 0; i < iCount; ++ i )
+			{
+				uint32_t q = aResidual[i] >> k;
+				if( q < RICE_ESCAPE )
+				{
+					mWriter.Put( ( 1u << q ) - 1, q + 1 );
+					mWriter.Put( aResidual[i] & ( ( 1u << k ) - 1 ), k );
+				}
+				else
+				{
+					mWriter.Put( ( 1u << RICE_ESCAPE ) - 1, RICE_ESCAPE );
+					mWriter.Put( aResidual[i], 16 );
+				}
+			}
+		}
+		mWriter.Flush();
+	}
+
+	void DecodeDepth( const uint8_t* pCode, size_t uSize, const uint16_t* pPrev, int w, int h, uint16_t* pDepth )
+	{
+		CBitReader mReader( pCode, uSize );
+
+		int iPixels = w * h;
+		for( int iBlock = 0; iBlock < iPixels; iBlock += RICE_BLOCK )
+		{
+			int iCount = std::min<int>( RICE_BLOCK, iPixels - iBlock );
+			int k = mReader.Get( 4 );
+			for( int i = 0; i < iCount; ++ i )
+			{
+				uint16_t uResidual;
+				int q = mReader.GetUnary( RICE_ESCAPE );
+				if( q < RICE_ESCAPE )
+					uResidual = uint16_t( ( q << k ) | mReader.Get( k ) );
+				else
+					uResidual = uint16_t( mReader.Get( 16 ) );
+
+				int iIdx = iBlock + i;
+				uint16_t uPredict;
+				if( pPrev != NULL )
+					uPredict = pPrev[iIdx];
+				else if( iIdx % w != 0 )
+					uPredict = pDepth[iIdx - 1];
+				else
+					uPredict = ( iIdx >= w ? pDepth[iIdx - w] : 0 );
+
+				pDepth[iIdx] = uint16_t( uPredict + UnZigZag( uResidual ) );
+			}
+		}
+	}
+
+	/**
+	 * Runs of (value, length) in each row, as varints
+	 */
+	void EncodeUserMap( const nite::UserId* pUserMap, int w, int h, std::vector<uint8_t>& rOut )
+	{
+		rOut.clear();
+		for( int y = 0; y < h; ++ y )
+		{
+			const nite::UserId* pRow = pUserMap + w * y;
+			int x = 0;
+			while( x < w )
+			{
+				int iStart = x;
+				while( x < w && pRow[x] == pRow[iStart] )
+					++ x;
+				PutVarint( rOut, ZigZag( uint16_t( pRow[iStart] ) ) );
+				PutVarint( rOut, x - iStart );
+			}
+		}
+	}
+
+	bool DecodeUserMap( const uint8_t* pCode, size_t uSize, int w, int h, nite::UserId* pUserMap )
+	{
+		const uint8_t* pEnd = pCode + uSize;
+		for( int y = 0; y < h; ++ y )
+		{
+			nite::UserId* pRow = pUserMap + w * y;
+			int x = 0;
+			while( x < w )
+			{
+				uint32_t uValue, uLength;
+				if( !GetVarint( pCode, pEnd, uValue ) || !GetVarint( pCode, pEnd, uLength ) || uLength > uint32_t( w - x ) )
+					return false;
+				std::fill_n( pRow + x, uLength, nite::UserId( UnZigZag( uint16_t( uValue ) ) ) );
+				x += uLength;
+			}
+		}
+		return true;
+	}
+
+	inline void PutInt16( std::vector<uint8_t>& rOut, float fValue )
+	{
+		int iValue = int( std::floor( std::min( std::max( fValue, -32768.0f ), 32767.0f ) + 0.5f ) );
+		rOut.push_back( uint8_t( iValue ) );
+		rOut.push_back( uint8_t( iValue >> 8 ) );
+	}
+
+	inline float GetInt16( const uint8_t*& rpData )
+	{
+		int16_t iValue = int16_t( rpData[0] | ( rpData[1] << 8 ) );
+		rpData += 2;
+		return iValue;
+	}
+
+	inline void PutUnit8( std::vector<uint8_t>& rOut, float fValue )
+	{
+		rOut.push_back( uint8_t( std::min( std::max( fValue, 0.0f ), 1.0f ) * 255 + 0.5f ) );
+	}
+
+	inline float GetUnit8( const uint8_t*& rpData )
+	{
+		return *rpData++ / 255.0f;
+	}
+
+	inline void PutPoint( std::vector<uint8_t>& rOut, const NitePoint3f& rPoint )
+	{
+		PutInt16( rOut, rPoint.x );
+		PutInt16( rOut, rPoint.y );
+		PutInt16( rOut, rPoint.z );
+	}
+
+	inline void GetPoint( const uint8_t*& rpData, NitePoint3f& rPoint )
+	{
+		rPoint.x = GetInt16( rpData );
+		rPoint.y = GetInt16( rpData );
+		rPoint.z = GetInt16( rpData );
+	}
+
+	enum
+	{
+		PACKED_JOINT_SIZE	= 6 + 1 + 8 + 1,
+		PACKED_USER_SIZE	= 2 + 1 + 1 + 6 + 12 + NITE_JOINT_COUNT * PACKED_JOINT_SIZE,
+	};
+
+	/**
+	 * Quantize users: positions in mm, bounding box in pixels
+	 */
+	void PackUsers( const CUserFrame& rFrame, std::vector<uint8_t>& rOut )
+	{
+		rOut.clear();
+		for( int i = 0; i < rFrame.getUserCount(); ++ i )
+		{
+			const NiteUserData& rUser = reinterpret_cast<const NiteUserData&>( rFrame.getUser( i ) );
+			PutInt16( rOut, rUser.id );
+			rOut.push_back( uint8_t( rUser.state ) );
+			rOut.push_back( uint8_t( rUser.skeleton.state ) );
+			PutPoint( rOut, rUser.centerOfMass );
+			PutPoint( rOut, rUser.boundingBox.min );
+			PutPoint( rOut, rUser.boundingBox.max );
+			for( int j = 0; j < NITE_JOINT_COUNT; ++ j )
+			{
+				const NiteSkeletonJoint& rJoint = rUser.skeleton.joints[j];
+				PutPoint( rOut, rJoint.position );
+				PutUnit8( rOut, rJoint.positionConfidence );
+				PutInt16( rOut, rJoint.orientation.x * 32767 );
+				PutInt16( rOut, rJoint.orientation.y * 32767 );
+				PutInt16( rOut, rJoint.orientation.z * 32767 );
+				PutInt16( rOut, rJoint.orientation.w * 32767 );
+				PutUnit8( rOut, rJoint.orientationConfidence );
+			}
+		}
+	}
+
+	void UnpackUsers( const uint8_t* pData, int iCount, std::vector<NiteUserData>& rUsers )
+	{
+		rUsers.assign( iCount, NiteUserData() );
+		for( int i = 0; i < iCount; ++ i )
+		{
+			NiteUserData& rUser = rUsers[i];
+			rUser.id				= NiteUserId( GetInt16( pData ) );
+			rUser.state				= *pData++;
+			rUser.skeleton.state	= NiteSkeletonState( *pData++ );
+			GetPoint( pData, rUser.centerOfMass );
+			GetPoint( pData, rUser.boundingBox.min );
+			GetPoint( pData, rUser.boundingBox.max );
+			for( int j = 0; j < NITE_JOINT_COUNT; ++ j )
+			{
+				NiteSkeletonJoint& rJoint = rUser.skeleton.joints[j];
+				rJoint.jointType				= NiteJointType( j );
+				GetPoint( pData, rJoint.position );
+				rJoint.positionConfidence		= GetUnit8( pData );
+				rJoint.orientation.x			= GetInt16( pData ) / 32767;
+				rJoint.orientation.y			= GetInt16( pData ) / 32767;
+				rJoint.orientation.z			= GetInt16( pData ) / 32767;
+				rJoint.orientation.w			= GetInt16( pData ) / 32767;
+				rJoint.orientationConfidence	= GetUnit8( pData );
+			}
+		}
+	}
+}
+#pragma endregion
+
+#pragma region CCompressedRecorder
+CCompressedRecorder::CCompressedRecorder( unsigned int uQueueSize ) :
+	m_bOpen( false ), m_qFrames( uQueueSize ), m_aSlots( uQueueSize + 2 ), m_uFrames( 0 ), m_uRawBytes( 0 ), m_uWrittenBytes( 0 ), m_uEncodeMicroseconds( 0 )
+{
+	m_aFreeSlots.reserve( m_aSlots.size() );
+	m_uKeyFrameInterval	= 300;
+	m_uSinceKeyFrame	= 0;
+}
+
+CCompressedRecorder::~CCompressedRecorder()
+{
+	Close();
+}
+
+bool CCompressedRecorder::Open( const std::string& sFilename )
+{
+	Close();
+
+	m_fsFile.open( sFilename.c_str(), std::ios::binary | std::ios::trunc );
+	if( !m_fsFile.is_open() )
+	{
+		std::cerr << "Can't create session file " << sFilename << std::endl;
+		return false;
+	}
+
+	// frame count is written when closed
+	SCompressedHeader mHeader = {};
+	m_fsFile.write( reinterpret_cast<const char*>( &mHeader ), sizeof( mHeader ) );
+
+	m_aPrevDepth.clear();
+	m_uSinceKeyFrame	= 0;
+	m_tpOpen			= boost::chrono::steady_clock::now();
+	m_uFrames.store( 0 );
+	m_uRawBytes.store( 0 );
+	m_uWrittenBytes.store( sizeof( mHeader ) );
+	m_uEncodeMicroseconds.store( 0 );
+
+	m_qFrames.Reset();
+	m_aFreeSlots.clear();
+	for( int i = int( m_aSlots.size() ) - 1; i >= 0; -- i )
+		m_aFreeSlots.push_back( i );
+	m_bOpen.store( true );
+	m_tWrite	= boost::thread( [this](){ WriteLoop(); } );
+	return true;
+}
+
+void CCompressedRecorder::Close()
+{
+	if( !m_bOpen.exchange( false ) )
+		return;
+
+	// an invalid frame tells write thread to finish
+	SQueuedFrame mEnd;
+	mEnd.iSlot = -1;
+	m_qFrames.Push( mEnd );
+	m_tWrite.join();
+
+	SCompressedHeader mHeader = {};
+	std::memcpy( mHeader.aMagic, s_aMagic, sizeof( s_aMagic ) );
+	mHeader.uVersion	= FILE_VERSION;
+	mHeader.uFrameCount	= m_uFrames.load();
+	m_fsFile.seekp( 0 );
+	m_fsFile.write( reinterpret_cast<const char*>( &mHeader ), sizeof( mHeader ) );
+	m_fsFile.close();
+}
+
+bool CCompressedRecorder::Write( const CUserFrame& rFrame )
+{
+	if( !IsOpen() || !rFrame.isValid() )
+		return false;
+
+	// NiTE frames are kept by reference, the others are copied into a free slot
+	SQueuedFrame mQueued;
+	mQueued.iSlot = -1;
+	if( rFrame.isLive() )
+	{
+		mQueued.mFrame = rFrame;
+	}
+	else
+	{
+		{
+			boost::lock_guard<boost::mutex> lock( m_mtxSlots );
+			mQueued.iSlot = m_aFreeSlots.back();
+			m_aFreeSlots.pop_back();
+		}
+
+		// the slot keeps its capacity, so only the first frame allocates
+		SFrameSlot& rSlot = m_aSlots[mQueued.iSlot];
+		int w = rFrame.getWidth(), h = rFrame.getHeight(), iUsers = rFrame.getUserCount();
+		size_t uPixels = size_t( w ) * h;
+		rSlot.aDepth.assign( rFrame.getDepth(), rFrame.getDepth() + uPixels );
+		rSlot.aUserMap.assign( rFrame.getUserMap(), rFrame.getUserMap() + uPixels );
+		if( iUsers > 0 )
+		{
+			// nite::UserData is a wrapper of NiteUserData without other members
+			const NiteUserData* pUsers = reinterpret_cast<const NiteUserData*>( &rFrame.getUser( 0 ) );
+			rSlot.aUsers.assign( pUsers, pUsers + iUsers );
+		}
+		else
+			rSlot.aUsers.clear();
+		mQueued.mFrame.SetData( &rSlot.aDepth[0], &rSlot.aUserMap[0], w, h, iUsers > 0 ? &rSlot.aUsers[0] : NULL, iUsers,
+								rFrame.getTimestamp(), rFrame.getFrameIndex() );
+	}
+
+	SQueuedFrame mDropped;
+	if( m_qFrames.Push( mQueued, &mDropped ) )
+		return true;
+	ReleaseSlot( mDropped.iSlot );
+	return false;
+}
+
+double CCompressedRecorder::GetCompressionRatio() const
+{
+	uint64_t uWritten = m_uWrittenBytes.load( boost::memory_order_relaxed );
+	return uWritten > 0 ? double( m_uRawBytes.load( boost::memory_order_relaxed ) ) / uWritten : 0;
+}
+
+double CCompressedRecorder::GetThroughput() const
+{
+	double dSeconds = boost::chrono::duration<double>( boost::chrono::steady_clock::now() - m_tpOpen ).count();
+	return dSeconds > 0 ? m_uWrittenBytes.load( boost::memory_order_relaxed ) / dSeconds : 0;
+}
+
+void CCompressedRecorder::PrintStatistics() const
+{
+	unsigned int uFrames = GetFrameCount();
+	std::cout << "Recorded frames: " << uFrames
+			  << ", dropped: " << GetDroppedFrames()
+			  << ", " << ( m_uWrittenBytes.load() >> 20 ) << " MB"
+			  << ", compression ratio " << GetCompressionRatio()
+			  << ", write " << GetThroughput() / ( 1 << 20 ) << " MB/s"
+			  << ", encode " << ( uFrames > 0 ? m_uEncodeMicroseconds.load() / uFrames : 0 ) << " us/frame" << std::endl;
+}
+
+void CCompressedRecorder::WriteLoop()
+{
+	SQueuedFrame mQueued;
+	while( m_qFrames.Pop( mQueued ) && mQueued.mFrame.isValid() )
+	{
+		WriteFrame( mQueued.mFrame );
+		mQueued.mFrame.release();
+		ReleaseSlot( mQueued.iSlot );
+	}
+}
+
+void CCompressedRecorder::ReleaseSlot( int iSlot )
+{
+	if( iSlot < 0 )
+		return;
+
+	boost::lock_guard<boost::mutex> lock( m_mtxSlots );
+	m_aFreeSlots.push_back( iSlot );
+}
+
+void CCompressedRecorder::WriteFrame( const CUserFrame& rFrame )
+{
+	boost::chrono::steady_clock::time_point tpStart = boost::chrono::steady_clock::now();
+
+	int w = rFrame.getWidth(), h = rFrame.getHeight();
+	size_t uPixels = size_t( w ) * h;
+
+	// key frame on size change and by interval, so the file can be recovered after damage
+	bool bKeyFrame = ( m_aPrevDepth.size() != uPixels || m_uSinceKeyFrame >= m_uKeyFrameInterval );
+	EncodeDepth( rFrame.getDepth(), bKeyFrame ? NULL : &m_aPrevDepth[0], w, h, m_aDepthCode );
+	EncodeUserMap( rFrame.getUserMap(), w, h, m_aUserMapCode );
+	PackUsers( rFrame, m_aUserCode );
+	m_aPrevDepth.assign( rFrame.getDepth(), rFrame.getDepth() + uPixels );
+	m_uSinceKeyFrame = ( bKeyFrame ? 1 : m_uSinceKeyFrame + 1 );
+
+	SCompressedFrame mRecord = {};
+	mRecord.uTimestamp		= rFrame.getTimestamp();
+	mRecord.iFrameIndex		= rFrame.getFrameIndex();
+	mRecord.uWidth			= uint16_t( w );
+	mRecord.uHeight			= uint16_t( h );
+	mRecord.uUserCount		= uint16_t( rFrame.getUserCount() );
+	mRecord.uFlags			= ( bKeyFrame ? FLAG_KEY_FRAME : 0 );
+	mRecord.uDepthBytes		= uint32_t( m_aDepthCode.size() );
+	mRecord.uUserMapBytes	= uint32_t( m_aUserMapCode.size() );
+
+	boost::chrono::steady_clock::time_point tpEncoded = boost::chrono::steady_clock::now();
+
+	m_fsFile.write( reinterpret_cast<const char*>( &mRecord ), sizeof( mRecord ) );
+	m_fsFile.write( reinterpret_cast<const char*>( &m_aDepthCode[0] ), m_aDepthCode.size() );
+	m_fsFile.write( reinterpret_cast<const char*>( &m_aUserMapCode[0] ), m_aUserMapCode.size() );
+	if( !m_aUserCode.empty() )
+		m_fsFile.write( reinterpret_cast<const char*>( &m_aUserCode[0] ), m_aUserCode.size() );
+
+	m_uFrames.fetch_add( 1, boost::memory_order_relaxed );
+	m_uRawBytes.fetch_add( sizeof( Session::SFrameRecord ) + uPixels * ( sizeof( openni::DepthPixel ) + sizeof( nite::UserId ) ) + rFrame.getUserCount() * sizeof( NiteUserData ), boost::memory_order_relaxed );
+	m_uWrittenBytes.fetch_add( sizeof( mRecord ) + m_aDepthCode.size() + m_aUserMapCode.size() + m_aUserCode.size(), boost::memory_order_relaxed );
+	m_uEncodeMicroseconds.fetch_add( boost::chrono::duration_cast<boost::chrono::microseconds>( tpEncoded - tpStart ).count(), boost::memory_order_relaxed );
+}
+#pragma endregion
+
+bool UnpackSession( const std::string& sCompressedFile, const std::string& sSessionFile )
+{
+	std::ifstream fsInput( sCompressedFile.c_str(), std::ios::binary );
+	SCompressedHeader mHeader;
+	if( !fsInput.read( reinterpret_cast<char*>( &mHeader ), sizeof( mHeader ) )
+		|| std::memcmp( mHeader.aMagic, s_aMagic, sizeof( s_aMagic ) ) != 0 || mHeader.uVersion != FILE_VERSION )
+	{
+		std::cerr << "Not a compressed session file, or it is not closed: " << sCompressedFile << std::endl;
+		return false;
+	}
+
+	CSessionRecorder mRecorder;
+	if( !mRecorder.Open( sSessionFile ) )
+		return false;
+
+	std::vector<uint8_t>		aCode;
+	std::vector<uint16_t>		aDepth, aPrevDepth;
+	std::vector<nite::UserId>	aUserMap;
+	std::vector<NiteUserData>	aUsers;
+	for( uint32_t f = 0; f < mHeader.uFrameCount; ++ f )
+	{
+		SCompressedFrame mRecord;
+		if( !fsInput.read( reinterpret_cast<char*>( &mRecord ), sizeof( mRecord ) ) )
+			break;
+
+		size_t uPixels = size_t( mRecord.uWidth ) * mRecord.uHeight,
+			   uUserBytes = mRecord.uUserCount * size_t( PACKED_USER_SIZE );
+		bool bKeyFrame = ( mRecord.uFlags & FLAG_KEY_FRAME ) != 0;
+		if( !bKeyFrame && aPrevDepth.size() != uPixels )
+			break;
+
+		aCode.resize( mRecord.uDepthBytes + mRecord.uUserMapBytes + uUserBytes );
+		if( aCode.empty() || !fsInput.read( reinterpret_cast<char*>( &aCode[0] ), aCode.size() ) )
+			break;
+
+		aDepth.resize( uPixels );
+		aUserMap.resize( uPixels );
+		DecodeDepth( &aCode[0], mRecord.uDepthBytes, bKeyFrame ? NULL : &aPrevDepth[0], mRecord.uWidth, mRecord.uHeight, &aDepth[0] );
+		if( !DecodeUserMap( &aCode[mRecord.uDepthBytes], mRecord.uUserMapBytes, mRecord.uWidth, mRecord.uHeight, &aUserMap[0] ) )
+			break;
+		UnpackUsers( &aCode[mRecord.uDepthBytes + mRecord.uUserMapBytes], mRecord.uUserCount, aUsers );
+
+		CUserFrame mFrame;
+		mFrame.SetData( &aDepth[0], &aUserMap[0], mRecord.uWidth, mRecord.uHeight,
+						aUsers.empty() ? NULL : &aUsers[0], mRecord.uUserCount, mRecord.uTimestamp, mRecord.iFrameIndex );
+		mRecorder.Write( mFrame );
+		aPrevDepth.swap( aDepth );
+	}
+
+	bool bComplete = ( mRecorder.GetFrameCount() == mHeader.uFrameCount );
+	if( !bComplete )
+		std::cerr << "Compressed session is damaged after frame " << mRecorder.GetFrameCount() << std::endl;
+	mRecorder.Close();
+	return bComplete;
+}
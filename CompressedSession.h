@@ -0,0 +1,185 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+
+// Application header
+#include "BoundedQueue.h"
+#include "Session.h"
+#include "UserFrame.h"
+#pragma endregion
+
+/**
+ * Compressed session file, written sequentially:
+ *
+ *   SCompressedHeader
+ *   frame 0: SCompressedFrame, depth code, user map code, packed users
+ *   frame 1: ...
+ *
+ * Depth is predicted from the previous frame (from the left pixel in key frames), and the
+ * residuals are Rice coded in blocks of 16 pixels. The user map is run-length encoded per
+ * row. Joints are quantized to 1 mm, quaternions to 1/32767 and confidences to 1/255;
+ * pose detection data is not kept.
+ *
+ * The file can't be replayed directly, UnpackSession() convert it to a normal session file.
+ */
+namespace CompressedSession
+{
+	struct SCompressedHeader
+	{
+		char		aMagic[8];		/**< "QONISEZ1" */
+		uint32_t	uVersion;
+		uint32_t	uFrameCount;
+	};
+
+	struct SCompressedFrame
+	{
+		uint64_t	uTimestamp;
+		int32_t		iFrameIndex;
+		uint16_t	uWidth;
+		uint16_t	uHeight;
+		uint16_t	uUserCount;
+		uint16_t	uFlags;
+		uint32_t	uDepthBytes;
+		uint32_t	uUserMapBytes;
+	};
+
+	enum
+	{
+		FILE_VERSION	= 1,
+		FLAG_KEY_FRAME	= 0x1,
+	};
+}
+
+/**
+ * Session recorder for long captures.
+ *
+ * Write() only put the frame into a bounded queue, so the frame thread never waits; when
+ * the recorder can't keep up, the oldest frames in queue are dropped. A background thread
+ * compresses and writes the frames sequentially.
+ * Frames of session player and simulator are copied into preallocated slots, because the
+ * source reuses their storage before the write thread reaches them.
+ */
+class CCompressedRecorder : public CSessionWriter
+{
+public:
+	/**
+	 * uQueueSize is the number of frames can wait for compression
+	 */
+	CCompressedRecorder( unsigned int uQueueSize = 8 );
+	~CCompressedRecorder();
+
+	bool Open( const std::string& sFilename );
+
+	/**
+	 * Compress the frames in queue, then close the file
+	 */
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_bOpen.load( boost::memory_order_relaxed );
+	}
+
+	bool Write( const CUserFrame& rFrame );
+
+	unsigned int GetFrameCount() const
+	{
+		return m_uFrames.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * Frames dropped because the queue is full
+	 */
+	unsigned int GetDroppedFrames() const
+	{
+		return m_qFrames.GetDropped();
+	}
+
+	/**
+	 * Size of frames before compression / size written
+	 */
+	double GetCompressionRatio() const;
+
+	/**
+	 * Bytes written per second since open
+	 */
+	double GetThroughput() const;
+
+	void PrintStatistics() const;
+
+	/**
+	 * Number of frames between key frames
+	 */
+	void SetKeyFrameInterval( unsigned int uInterval )
+	{
+		m_uKeyFrameInterval = uInterval;
+	}
+
+private:
+	/**
+	 * Storage of a frame which is not read from user tracker
+	 */
+	struct SFrameSlot
+	{
+		std::vector<openni::DepthPixel>	aDepth;
+		std::vector<nite::UserId>		aUserMap;
+		std::vector<NiteUserData>		aUsers;
+	};
+
+	struct SQueuedFrame
+	{
+		CUserFrame	mFrame;
+		int			iSlot;		/**< Index of m_aSlots holding the data, -1 for a NiTE frame */
+	};
+
+private:
+	void WriteLoop();
+
+	void WriteFrame( const CUserFrame& rFrame );
+
+	/**
+	 * Return the slot of a written or dropped frame, nothing if iSlot is -1
+	 */
+	void ReleaseSlot( int iSlot );
+
+private:
+	std::ofstream						m_fsFile;
+	boost::atomic<bool>					m_bOpen;
+	mutable TBoundedQueue<SQueuedFrame>	m_qFrames;
+	boost::thread						m_tWrite;
+	unsigned int						m_uKeyFrameInterval;
+
+	// one slot for each frame in queue, the one being written and the one being copied
+	std::vector<SFrameSlot>				m_aSlots;
+	std::vector<int>					m_aFreeSlots;
+	boost::mutex						m_mtxSlots;
+
+	// state of encoder, only used by write thread
+	std::vector<uint16_t>				m_aPrevDepth;
+	std::vector<uint8_t>				m_aDepthCode;
+	std::vector<uint8_t>				m_aUserMapCode;
+	std::vector<uint8_t>				m_aUserCode;
+	unsigned int						m_uSinceKeyFrame;
+
+	// statistics
+	boost::chrono::steady_clock::time_point	m_tpOpen;
+	boost::atomic<unsigned int>			m_uFrames;
+	boost::atomic<uint64_t>				m_uRawBytes;
+	boost::atomic<uint64_t>				m_uWrittenBytes;
+	boost::atomic<uint64_t>				m_uEncodeMicroseconds;
+};
+
+/**
+ * Decode a compressed session into a session file which can be replayed
+ */
+bool UnpackSession( const std::string& sCompressedFile, const std::string& sSessionFile );
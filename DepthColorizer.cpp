@@ -0,0 +1,543 @@
+#include "DepthColorizer.h"
+
+// STL Header
+#include <algorithm>
+#include <cmath>
+
+#pragma region Instruction set support
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define NIC_SSE2
+	#include <emmintrin.h>
+
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#if _MSC_VER >= 1700
+			#define NIC_AVX2
+			#define NIC_TARGET_AVX2
+			#include <immintrin.h>
+		#endif
+	#elif defined(__GNUC__)
+		#include <cpuid.h>
+		#define NIC_AVX2
+		#define NIC_TARGET_AVX2 __attribute__((target("avx2")))
+		#include <immintrin.h>
+	#endif
+#endif
+#pragma endregion
+
+#pragma region Scalar kernel
+/**
+ * Premultiply a channel in the same way as Qt (PREMUL in qdrawhelper_p.h)
+ */
+inline uint32_t Premultiply( uint32_t uColor, uint32_t uAlpha )
+{
+	uint32_t t = uColor * uAlpha;
+	return ( t + ( t >> 8 ) + 0x80 ) >> 8;
+}
+
+/**
+ * Keep the same float operation order as the original code, so SIMD kernels can match it
+ */
+template<bool bPremultiplied>
+inline uint32_t UserColor( uint16_t uDepth )
+{
+	uint32_t uColor = CDepthColorizer::GetUserValue( uDepth );
+	if( bPremultiplied )
+		uColor = Premultiply( uColor, 128 );
+	return 0x80000000 | ( uColor << 16 );
+}
+
+template<bool bPremultiplied>
+inline uint32_t DepthColor( uint16_t uDepth )
+{
+	float fValue = 255.0f * ( 1.0f - float( int( uDepth ) - 1000 ) / 5000.0f );
+	uint32_t uColor = int( fValue ) & 0xff;
+	if( bPremultiplied )
+		return ( uColor << 24 ) | ( Premultiply( uColor, uColor ) * 0x010101 );
+	return uColor * 0x01010101;
+}
+
+template<bool bPremultiplied>
+static void UserRowScalar( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, uint32_t* pOut, int w )
+{
+	for( int x = 0; x < w; ++ x )
+		pOut[x] = ( pUserMap[x] == uID ? UserColor<bPremultiplied>( pDepth[x] ) : 0 );
+}
+
+template<bool bPremultiplied>
+static void DepthRowScalar( const uint16_t* pDepth, uint32_t* pOut, int w )
+{
+	for( int x = 0; x < w; ++ x )
+		pOut[x] = DepthColor<bPremultiplied>( pDepth[x] );
+}
+#pragma endregion
+
+#pragma region SSE2 kernel
+#ifdef NIC_SSE2
+/**
+ * Premultiply 4 channel values by alpha, both should be less than 256
+ */
+inline __m128i PremultiplySSE2( __m128i iColor, __m128i iAlpha )
+{
+	__m128i t = _mm_mullo_epi16( iColor, iAlpha );
+	return _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( t, _mm_srli_epi32( t, 8 ) ), _mm_set1_epi32( 0x80 ) ), 8 );
+}
+
+template<bool bPremultiplied>
+static void UserRowSSE2( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, uint32_t* pOut, int w )
+{
+	const __m128i	iZero	= _mm_setzero_si128();
+	const __m128i	iID		= _mm_set1_epi16( uID );
+	const __m128i	iMask	= _mm_set1_epi32( 0xff );
+	const __m128i	iAlpha	= _mm_set1_epi32( int( 0x80000000 ) );
+	const __m128i	iHalf	= _mm_set1_epi32( 128 );
+	const __m128	fOne	= _mm_set1_ps( 1.0f );
+	const __m128	fRange	= _mm_set1_ps( 3000.0f );
+	const __m128	fScale	= _mm_set1_ps( 128.0f );
+	const __m128	fShift	= _mm_set1_ps( 127.0f );
+
+	int x = 0;
+	for( ; x + 8 <= w; x += 8 )
+	{
+		__m128i iDepth	= _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDepth + x ) );
+		__m128i iUser	= _mm_cmpeq_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pUserMap + x ) ), iID );
+
+		__m128i aDepth[2] = { _mm_unpacklo_epi16( iDepth, iZero ), _mm_unpackhi_epi16( iDepth, iZero ) };
+		__m128i aUser[2] = { _mm_unpacklo_epi16( iUser, iUser ), _mm_unpackhi_epi16( iUser, iUser ) };
+		for( int i = 0; i < 2; ++ i )
+		{
+			__m128 fValue = _mm_div_ps( _mm_cvtepi32_ps( aDepth[i] ), fRange );
+			fValue = _mm_add_ps( _mm_mul_ps( fScale, _mm_sub_ps( fOne, fValue ) ), fShift );
+
+			__m128i iColor = _mm_and_si128( _mm_cvttps_epi32( fValue ), iMask );
+			if( bPremultiplied )
+				iColor = PremultiplySSE2( iColor, iHalf );
+			iColor = _mm_or_si128( _mm_slli_epi32( iColor, 16 ), iAlpha );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pOut + x + 4 * i ), _mm_and_si128( iColor, aUser[i] ) );
+		}
+	}
+	UserRowScalar<bPremultiplied>( pDepth + x, pUserMap + x, uID, pOut + x, w - x );
+}
+
+template<bool bPremultiplied>
+static void DepthRowSSE2( const uint16_t* pDepth, uint32_t* pOut, int w )
+{
+	const __m128i	iZero	= _mm_setzero_si128();
+	const __m128i	iMask	= _mm_set1_epi32( 0xff );
+	const __m128i	iNear	= _mm_set1_epi32( 1000 );
+	const __m128	fOne	= _mm_set1_ps( 1.0f );
+	const __m128	fRange	= _mm_set1_ps( 5000.0f );
+	const __m128	fScale	= _mm_set1_ps( 255.0f );
+
+	int x = 0;
+	for( ; x + 8 <= w; x += 8 )
+	{
+		__m128i iDepth = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDepth + x ) );
+
+		__m128i aDepth[2] = { _mm_unpacklo_epi16( iDepth, iZero ), _mm_unpackhi_epi16( iDepth, iZero ) };
+		for( int i = 0; i < 2; ++ i )
+		{
+			__m128 fValue = _mm_div_ps( _mm_cvtepi32_ps( _mm_sub_epi32( aDepth[i], iNear ) ), fRange );
+			fValue = _mm_mul_ps( fScale, _mm_sub_ps( fOne, fValue ) );
+
+			__m128i iAlpha = _mm_and_si128( _mm_cvttps_epi32( fValue ), iMask );
+			__m128i iColor = ( bPremultiplied ? PremultiplySSE2( iAlpha, iAlpha ) : iAlpha );
+			iColor = _mm_or_si128( iColor, _mm_slli_epi32( iColor, 8 ) );
+			iColor = _mm_or_si128( iColor, _mm_slli_epi32( iColor, 8 ) );
+			iColor = _mm_or_si128( iColor, _mm_slli_epi32( iAlpha, 24 ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pOut + x + 4 * i ), iColor );
+		}
+	}
+	DepthRowScalar<bPremultiplied>( pDepth + x, pOut + x, w - x );
+}
+#endif
+#pragma endregion
+
+#pragma region AVX2 kernel
+#ifdef NIC_AVX2
+NIC_TARGET_AVX2 inline __m256i PremultiplyAVX2( __m256i iColor, __m256i iAlpha )
+{
+	__m256i t = _mm256_mullo_epi16( iColor, iAlpha );
+	return _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( t, _mm256_srli_epi32( t, 8 ) ), _mm256_set1_epi32( 0x80 ) ), 8 );
+}
+
+template<bool bPremultiplied>
+NIC_TARGET_AVX2 static void UserRowAVX2( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, uint32_t* pOut, int w )
+{
+	const __m128i	iID		= _mm_set1_epi16( uID );
+	const __m256i	iMask	= _mm256_set1_epi32( 0xff );
+	const __m256i	iAlpha	= _mm256_set1_epi32( int( 0x80000000 ) );
+	const __m256i	iHalf	= _mm256_set1_epi32( 128 );
+	const __m256	fOne	= _mm256_set1_ps( 1.0f );
+	const __m256	fRange	= _mm256_set1_ps( 3000.0f );
+	const __m256	fScale	= _mm256_set1_ps( 128.0f );
+	const __m256	fShift	= _mm256_set1_ps( 127.0f );
+
+	int x = 0;
+	for( ; x + 8 <= w; x += 8 )
+	{
+		__m256i iDepth	= _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDepth + x ) ) );
+		__m256i iUser	= _mm256_cvtepi16_epi32( _mm_cmpeq_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pUserMap + x ) ), iID ) );
+
+		__m256 fValue = _mm256_div_ps( _mm256_cvtepi32_ps( iDepth ), fRange );
+		fValue = _mm256_add_ps( _mm256_mul_ps( fScale, _mm256_sub_ps( fOne, fValue ) ), fShift );
+
+		__m256i iColor = _mm256_and_si256( _mm256_cvttps_epi32( fValue ), iMask );
+		if( bPremultiplied )
+			iColor = PremultiplyAVX2( iColor, iHalf );
+		iColor = _mm256_or_si256( _mm256_slli_epi32( iColor, 16 ), iAlpha );
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( pOut + x ), _mm256_and_si256( iColor, iUser ) );
+	}
+	UserRowScalar<bPremultiplied>( pDepth + x, pUserMap + x, uID, pOut + x, w - x );
+}
+
+template<bool bPremultiplied>
+NIC_TARGET_AVX2 static void DepthRowAVX2( const uint16_t* pDepth, uint32_t* pOut, int w )
+{
+	const __m256i	iMask	= _mm256_set1_epi32( 0xff );
+	const __m256i	iNear	= _mm256_set1_epi32( 1000 );
+	const __m256i	iGray	= _mm256_set1_epi32( 0x010101 );
+	const __m256	fOne	= _mm256_set1_ps( 1.0f );
+	const __m256	fRange	= _mm256_set1_ps( 5000.0f );
+	const __m256	fScale	= _mm256_set1_ps( 255.0f );
+
+	int x = 0;
+	for( ; x + 8 <= w; x += 8 )
+	{
+		__m256i iDepth = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDepth + x ) ) );
+
+		__m256 fValue = _mm256_div_ps( _mm256_cvtepi32_ps( _mm256_sub_epi32( iDepth, iNear ) ), fRange );
+		fValue = _mm256_mul_ps( fScale, _mm256_sub_ps( fOne, fValue ) );
+
+		__m256i iAlpha = _mm256_and_si256( _mm256_cvttps_epi32( fValue ), iMask );
+		__m256i iColor = ( bPremultiplied ? PremultiplyAVX2( iAlpha, iAlpha ) : iAlpha );
+		iColor = _mm256_or_si256( _mm256_mullo_epi32( iColor, iGray ), _mm256_slli_epi32( iAlpha, 24 ) );
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( pOut + x ), iColor );
+	}
+	DepthRowScalar<bPremultiplied>( pDepth + x, pOut + x, w - x );
+}
+#endif
+#pragma endregion
+
+#pragma region CPU detection
+static void CPUID( int aInfo[4], int iLeaf )
+{
+#if defined(_MSC_VER)
+	__cpuidex( aInfo, iLeaf, 0 );
+#elif defined(__GNUC__) && defined(NIC_SSE2)
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count( iLeaf, 0, a, b, c, d );
+	aInfo[0] = a;	aInfo[1] = b;	aInfo[2] = c;	aInfo[3] = d;
+#else
+	aInfo[0] = aInfo[1] = aInfo[2] = aInfo[3] = 0;
+#endif
+}
+
+#ifdef NIC_AVX2
+static bool OSSupportAVX()
+{
+#if defined(_MSC_VER)
+	return ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+#else
+	unsigned int a, d;
+	__asm__ __volatile__( "xgetbv" : "=a"(a), "=d"(d) : "c"(0) );
+	return ( a & 0x6 ) == 0x6;
+#endif
+}
+#endif
+#pragma endregion
+
+CDepthColorizer::CDepthColorizer()
+{
+	m_bPremultiplied = false;
+	SetKernel( DetectKernel() );
+}
+
+CDepthColorizer::EKernel CDepthColorizer::DetectKernel()
+{
+#ifdef NIC_SSE2
+	int aInfo[4];
+	CPUID( aInfo, 0 );
+	int iMaxLeaf = aInfo[0];
+
+	CPUID( aInfo, 1 );
+	bool bSSE2		= ( aInfo[3] & ( 1 << 26 ) ) != 0;
+	bool bOSXSAVE	= ( aInfo[2] & ( 1 << 27 ) ) != 0;
+
+	#ifdef NIC_AVX2
+	if( iMaxLeaf >= 7 && bOSXSAVE && OSSupportAVX() )
+	{
+		CPUID( aInfo, 7 );
+		if( aInfo[1] & ( 1 << 5 ) )
+			return CK_AVX2;
+	}
+	#endif
+
+	if( bSSE2 )
+		return CK_SSE2;
+#endif
+	return CK_SCALAR;
+}
+
+void CDepthColorizer::SetKernel( EKernel eKernel )
+{
+	EKernel eSupport = DetectKernel();
+	if( eKernel > eSupport )
+		eKernel = eSupport;
+
+	m_eKernel		= eKernel;
+	m_funcUserRow	= m_bPremultiplied ? UserRowScalar<true> : UserRowScalar<false>;
+	m_funcDepthRow	= m_bPremultiplied ? DepthRowScalar<true> : DepthRowScalar<false>;
+	switch( m_eKernel )
+	{
+#ifdef NIC_AVX2
+	case CK_AVX2:
+		m_funcUserRow	= m_bPremultiplied ? UserRowAVX2<true> : UserRowAVX2<false>;
+		m_funcDepthRow	= m_bPremultiplied ? DepthRowAVX2<true> : DepthRowAVX2<false>;
+		break;
+#endif
+
+#ifdef NIC_SSE2
+	case CK_SSE2:
+		m_funcUserRow	= m_bPremultiplied ? UserRowSSE2<true> : UserRowSSE2<false>;
+		m_funcDepthRow	= m_bPremultiplied ? DepthRowSSE2<true> : DepthRowSSE2<false>;
+		break;
+#endif
+
+	default:
+		m_eKernel = CK_SCALAR;
+		break;
+	}
+}
+
+void CDepthColorizer::SetPremultiplied( bool bPremultiplied )
+{
+	m_bPremultiplied = bPremultiplied;
+	SetKernel( m_eKernel );
+}
+
+void CDepthColorizer::SetKernel( const std::string& sName )
+{
+	if( sName == "scalar" )
+		SetKernel( CK_SCALAR );
+	else if( sName == "sse2" )
+		SetKernel( CK_SSE2 );
+	else if( sName == "avx2" )
+		SetKernel( CK_AVX2 );
+	else
+		SetKernel( DetectKernel() );
+}
+
+const char* CDepthColorizer::GetKernelName( EKernel eKernel )
+{
+	switch( eKernel )
+	{
+	case CK_AVX2:
+		return "avx2";
+
+	case CK_SSE2:
+		return "sse2";
+
+	default:
+		return "scalar";
+	}
+}
+
+void CDepthColorizer::DrawUserMap( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h, unsigned char* pDst, int iStride ) const
+{
+	for( int y = 0; y < h; ++ y )
+		m_funcUserRow( pDepth + w * y, pUserMap + w * y, uID, reinterpret_cast<uint32_t*>( pDst + iStride * y ), w );
+}
+
+void CDepthColorizer::DrawDepthMap( const uint16_t* pDepth, int w, int h, unsigned char* pDst, int iStride ) const
+{
+	for( int y = 0; y < h; ++ y )
+		m_funcDepthRow( pDepth + w * y, reinterpret_cast<uint32_t*>( pDst + iStride * y ), w );
+}
+
+#pragma region Colormap
+static float Clamp01( float fValue )
+{
+	return std::min( std::max( fValue, 0.0f ), 1.0f );
+}
+
+/**
+ * Get color of colormap, t is 0 at near and 1 at far
+ */
+static void ColorMapRGB( CDepthColorLUT::EColorMap eColorMap, float t, float& r, float& g, float& b )
+{
+	float u = 1.0f - t;
+	switch( eColorMap )
+	{
+	case CDepthColorLUT::CM_RED:
+		r = 1.0f - 0.5f * t;
+		g = b = 0.0f;
+		break;
+
+	case CDepthColorLUT::CM_JET:
+		r = Clamp01( 1.5f - std::fabs( 4 * u - 3 ) );
+		g = Clamp01( 1.5f - std::fabs( 4 * u - 2 ) );
+		b = Clamp01( 1.5f - std::fabs( 4 * u - 1 ) );
+		break;
+
+	case CDepthColorLUT::CM_HOT:
+		r = Clamp01( 3 * u );
+		g = Clamp01( 3 * u - 1 );
+		b = Clamp01( 3 * u - 2 );
+		break;
+
+	default:
+		r = g = b = u;
+		break;
+	}
+}
+
+static uint32_t ARGB( float a, float r, float g, float b )
+{
+	return	( uint32_t( a * 255 + 0.5f ) << 24 ) | ( uint32_t( r * 255 + 0.5f ) << 16 ) |
+			( uint32_t( g * 255 + 0.5f ) << 8 ) | uint32_t( b * 255 + 0.5f );
+}
+#pragma endregion
+
+CDepthColorLUT::CDepthColorLUT()
+{
+	m_eColorMap		= CM_RED;
+	m_uNear			= 1000;
+	m_uFar			= 6000;
+	m_bAutoRange	= false;
+	m_uVersion		= 0;
+	m_aIndex.resize( 65536 );
+	m_aHistogram.fill( 0 );
+
+	BuildTable();
+	BuildPalette();
+}
+
+bool CDepthColorLUT::ParseColorMap( const std::string& sName, EColorMap& eColorMap )
+{
+	if( sName == "gray" )
+		eColorMap = CM_GRAY;
+	else if( sName == "red" )
+		eColorMap = CM_RED;
+	else if( sName == "jet" )
+		eColorMap = CM_JET;
+	else if( sName == "hot" )
+		eColorMap = CM_HOT;
+	else
+		return false;
+	return true;
+}
+
+void CDepthColorLUT::SetColorMap( EColorMap eColorMap )
+{
+	m_eColorMap = eColorMap;
+	BuildPalette();
+}
+
+void CDepthColorLUT::SetRange( uint16_t uNear, uint16_t uFar )
+{
+	m_uNear	= uNear;
+	m_uFar	= std::max<uint16_t>( uFar, uNear + 1 );
+	BuildTable();
+}
+
+void CDepthColorLUT::UpdateHistogram( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h )
+{
+	// the histogram is only used to fit the range
+	if( !m_bAutoRange )
+		return;
+
+	// decay old samples, so the histogram follows the scene
+	for( size_t i = 0; i < m_aHistogram.size(); ++ i )
+		m_aHistogram[i] -= m_aHistogram[i] >> 2;
+
+	for( int y = 0; y < h; y += SAMPLE_STEP )
+	{
+		for( int x = 0; x < w; x += SAMPLE_STEP )
+		{
+			int iIdx = x + w * y;
+			if( pDepth[iIdx] == 0 || ( uID != 0 && pUserMap[iIdx] != uID ) )
+				continue;
+
+			m_aHistogram[ std::min<int>( pDepth[iIdx] >> HISTOGRAM_SHIFT, HISTOGRAM_BINS - 1 ) ] += 16;
+		}
+	}
+
+	// use 2% and 98% percentile as range
+	uint32_t uTotal = 0;
+	for( size_t i = 0; i < m_aHistogram.size(); ++ i )
+		uTotal += m_aHistogram[i];
+	if( uTotal == 0 )
+		return;
+
+	uint32_t uLow = uTotal / 50, uHigh = uTotal - uTotal / 50, uSum = 0;
+	int iNearBin = -1, iFarBin = HISTOGRAM_BINS - 1;
+	for( int i = 0; i < HISTOGRAM_BINS; ++ i )
+	{
+		uSum += m_aHistogram[i];
+		if( iNearBin < 0 && uSum > uLow )
+			iNearBin = i;
+		if( uSum >= uHigh )
+		{
+			iFarBin = i;
+			break;
+		}
+	}
+
+	// rebuild table only if the range move more than 2 bins
+	int iNear = iNearBin << HISTOGRAM_SHIFT, iFar = ( iFarBin + 1 ) << HISTOGRAM_SHIFT;
+	const int iHysteresis = 2 << HISTOGRAM_SHIFT;
+	if( std::abs( iNear - m_uNear ) >= iHysteresis || std::abs( iFar - m_uFar ) >= iHysteresis )
+		SetRange( uint16_t( iNear ), uint16_t( std::min( iFar, 65535 ) ) );
+}
+
+void CDepthColorLUT::DrawUserMap( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h, unsigned char* pDst, int iStride ) const
+{
+	const uint8_t* pIndex = &m_aIndex[0];
+	for( int y = 0; y < h; ++ y )
+	{
+		const uint16_t*	pD = pDepth + w * y;
+		const int16_t*	pU = pUserMap + w * y;
+		unsigned char*	pOut = pDst + iStride * y;
+		for( int x = 0; x < w; ++ x )
+			pOut[x] = ( pU[x] == uID ? pIndex[pD[x]] : 0 );
+	}
+}
+
+void CDepthColorLUT::DrawDepthMap( const uint16_t* pDepth, int w, int h, unsigned char* pDst, int iStride ) const
+{
+	const uint8_t* pIndex = &m_aIndex[0];
+	for( int y = 0; y < h; ++ y )
+	{
+		const uint16_t*	pD = pDepth + w * y;
+		unsigned char*	pOut = pDst + iStride * y;
+		for( int x = 0; x < w; ++ x )
+			pOut[x] = pIndex[pD[x]];
+	}
+}
+
+void CDepthColorLUT::BuildTable()
+{
+	++ m_uVersion;
+	float fScale = 254.0f / ( m_uFar - m_uNear );
+	m_aIndex[0] = 0;
+	for( int d = 1; d < 65536; ++ d )
+	{
+		float t = std::min( std::max( float( d - m_uNear ) * fScale, 0.0f ), 254.0f );
+		m_aIndex[d] = uint8_t( 1 + int( t + 0.5f ) );
+	}
+}
+
+void CDepthColorLUT::BuildPalette()
+{
+	++ m_uVersion;
+	m_aUserPalette[0]	= 0;
+	m_aDepthPalette[0]	= 0;
+	for( int i = 1; i < 256; ++ i )
+	{
+		float t = ( i - 1 ) / 254.0f, r, g, b;
+		ColorMapRGB( m_eColorMap, t, r, g, b );
+		m_aUserPalette[i]	= ARGB( 0.5f, r, g, b );
+		m_aDepthPalette[i]	= ARGB( 1.0f - t, r, g, b );
+	}
+}
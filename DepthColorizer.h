@@ -0,0 +1,211 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <array>
+#include <string>
+#include <vector>
+#pragma endregion
+
+/**
+ * Colorize depth map and user map into 32-bit ARGB scanlines.
+ *
+ * There are scalar, SSE2 and AVX2 kernels, the best one supported by CPU is selected at
+ * runtime. All kernels give exactly the same result as the original per-pixel code:
+ *   user pixel:	qRgba( 128 * ( 1 - d / 3000 ) + 127, 0, 0, 128 ), others transparent
+ *   no user:		gray and alpha = 255 * ( 1 - ( d - 1000 ) / 5000 )
+ * The output can also be premultiplied, which is the same as converting the result to
+ * QImage::Format_ARGB32_Premultiplied.
+ */
+class CDepthColorizer
+{
+public:
+	enum EKernel
+	{
+		CK_SCALAR,
+		CK_SSE2,
+		CK_AVX2,
+	};
+
+public:
+	CDepthColorizer();
+
+	/**
+	 * The best kernel supported by this CPU
+	 */
+	static EKernel DetectKernel();
+
+	/**
+	 * Select kernel, fall back to supported one if CPU can't run it.
+	 */
+	void SetKernel( EKernel eKernel );
+
+	/**
+	 * Select kernel by name: "auto", "scalar", "sse2" or "avx2"
+	 */
+	void SetKernel( const std::string& sName );
+
+	EKernel GetKernel() const
+	{
+		return m_eKernel;
+	}
+
+	static const char* GetKernelName( EKernel eKernel );
+
+	/**
+	 * Output premultiplied ARGB or not
+	 */
+	void SetPremultiplied( bool bPremultiplied );
+
+	bool IsPremultiplied() const
+	{
+		return m_bPremultiplied;
+	}
+
+	/**
+	 * Red channel of a user pixel before premultiplied; pixels of the same value are drawn the same
+	 */
+	static uint32_t GetUserValue( uint16_t uDepth )
+	{
+		return uint32_t( int( 128.0f * ( 1.0f - float( uDepth ) / 3000.0f ) + 127.0f ) ) & 0xff;
+	}
+
+	/**
+	 * Draw the pixels of user uID, other pixels are transparent
+	 */
+	void DrawUserMap( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h, unsigned char* pDst, int iStride ) const;
+
+	/**
+	 * Draw depth map as gray image
+	 */
+	void DrawDepthMap( const uint16_t* pDepth, int w, int h, unsigned char* pDst, int iStride ) const;
+
+public:
+	typedef void (*TUserRowFunc)( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, uint32_t* pOut, int w );
+	typedef void (*TDepthRowFunc)( const uint16_t* pDepth, uint32_t* pOut, int w );
+
+private:
+	EKernel			m_eKernel;
+	bool			m_bPremultiplied;
+	TUserRowFunc	m_funcUserRow;
+	TDepthRowFunc	m_funcDepthRow;
+};
+
+/**
+ * Depth to palette index lookup table, to draw the user map as 8-bit indexed image.
+ *
+ * Index 0 is reserved for transparent (no user or no depth), index 1-255 are mapped
+ * linearly from near to far by the selected colormap. The depth range can be fitted
+ * automatically from a histogram of sampled pixels, which is updated every frame.
+ */
+class CDepthColorLUT
+{
+public:
+	enum EColorMap
+	{
+		CM_GRAY,
+		CM_RED,
+		CM_JET,
+		CM_HOT,
+	};
+
+	typedef std::array<uint32_t,256>	TPalette;
+
+public:
+	CDepthColorLUT();
+
+	/**
+	 * Get colormap by name: "gray", "red", "jet" or "hot"
+	 */
+	static bool ParseColorMap( const std::string& sName, EColorMap& eColorMap );
+
+	void SetColorMap( EColorMap eColorMap );
+
+	void SetRange( uint16_t uNear, uint16_t uFar );
+
+	void SetAutoRange( bool bAuto )
+	{
+		m_bAutoRange = bAuto;
+	}
+
+	uint16_t GetNear() const
+	{
+		return m_uNear;
+	}
+
+	uint16_t GetFar() const
+	{
+		return m_uFar;
+	}
+
+	/**
+	 * Add sampled pixels of this frame into histogram and refit the range, nothing if auto range
+	 * is not used. Only the pixels of user uID are sampled if uID is not 0.
+	 */
+	void UpdateHistogram( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h );
+
+	/**
+	 * Palette index of a depth value
+	 */
+	uint8_t GetIndex( uint16_t uDepth ) const
+	{
+		return m_aIndex[uDepth];
+	}
+
+	/**
+	 * Increased whenever the table or palette is rebuilt, so cached results can be invalidated
+	 */
+	uint32_t GetVersion() const
+	{
+		return m_uVersion;
+	}
+
+	/**
+	 * Draw the pixels of user uID as index, other pixels are 0
+	 */
+	void DrawUserMap( const uint16_t* pDepth, const int16_t* pUserMap, int16_t uID, int w, int h, unsigned char* pDst, int iStride ) const;
+
+	/**
+	 * Draw depth map as index
+	 */
+	void DrawDepthMap( const uint16_t* pDepth, int w, int h, unsigned char* pDst, int iStride ) const;
+
+	/**
+	 * The palette to draw user (half transparent)
+	 */
+	const TPalette& GetUserPalette() const
+	{
+		return m_aUserPalette;
+	}
+
+	/**
+	 * The palette to draw depth map (fade out with distance)
+	 */
+	const TPalette& GetDepthPalette() const
+	{
+		return m_aDepthPalette;
+	}
+
+private:
+	void BuildTable();
+
+	void BuildPalette();
+
+private:
+	enum
+	{
+		HISTOGRAM_SHIFT	= 6,	/**< 64mm per bin */
+		HISTOGRAM_BINS	= 256,
+		SAMPLE_STEP		= 4,	/**< sample 1 pixel in 4x4 */
+	};
+
+	EColorMap				m_eColorMap;
+	uint16_t				m_uNear;
+	uint16_t				m_uFar;
+	bool					m_bAutoRange;
+	uint32_t				m_uVersion;
+	std::vector<uint8_t>	m_aIndex;
+	TPalette				m_aUserPalette;
+	TPalette				m_aDepthPalette;
+	std::array<uint32_t,HISTOGRAM_BINS>	m_aHistogram;
+};
@@ -0,0 +1,279 @@
+#include "FlightRecorder.h"
+#include "Gesture.h"
+
+// STL Header
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+
+enum
+{
+	STATUS_CAPACITY	= 256,
+	ARENA_ALIGN		= 64,
+};
+
+static size_t AlignArena( size_t uSize )
+{
+	return ( uSize + ARENA_ALIGN - 1 ) & ~size_t( ARENA_ALIGN - 1 );
+}
+
+template<typename _T>
+static void CarveRing( _T& rRing, uint32_t uCapacity, char*& rpArena )
+{
+	typedef typename std::remove_pointer<decltype( rRing.pData )>::type TRecord;
+	rRing.pData		= reinterpret_cast<TRecord*>( rpArena );
+	rRing.uCapacity	= uCapacity;
+	rRing.uCount	= 0;
+	rpArena += AlignArena( uCapacity * sizeof( TRecord ) );
+}
+
+template<typename _T>
+static void CopyRing( const _T& rFrom, _T& rTo )
+{
+	std::memcpy( rTo.pData, rFrom.pData, rFrom.Size() * sizeof( *rFrom.pData ) );
+	rTo.uCount = rFrom.uCount;
+}
+
+CFlightRecorder::CFlightRecorder( float fSeconds, int iFps, int iUserMapStep, int iWidth, int iHeight )
+{
+	m_iUserMapStep	= std::max( iUserMapStep, 0 );
+	m_uUserMapBytes	= m_iUserMapStep > 0 ? size_t( iWidth / m_iUserMapStep ) * ( iHeight / m_iUserMapStep ) : 0;
+	m_sPath			= ".";
+	m_tpStart		= boost::chrono::steady_clock::now();
+	m_iWindow		= int64_t( fSeconds * 1000000 );
+	m_bDumpRequest	= false;
+	m_bStop			= false;
+	m_bDumping		= false;
+	m_aReason.fill( 0 );
+	m_iDumpTime		= 0;
+	m_uDumpCount	= 0;
+
+	// one arena for both live rings and snapshot
+	uint32_t uFrames = std::max( uint32_t( fSeconds * iFps ), 1u ),
+			 uUserMaps = m_uUserMapBytes > 0 ? uFrames : 1;
+	size_t uBytes =	AlignArena( uFrames * sizeof( SSkeletonRecord ) ) +
+					AlignArena( uFrames * sizeof( SHandRecord ) ) +
+					AlignArena( STATUS_CAPACITY * sizeof( SStatusRecord ) ) +
+					AlignArena( uUserMaps * sizeof( SUserMapRecord ) ) +
+					AlignArena( uUserMaps * m_uUserMapBytes );
+	m_aArena.reset( new char[2 * uBytes + ARENA_ALIGN] );
+
+	char* pArena = m_aArena.get() + ( ARENA_ALIGN - reinterpret_cast<uintptr_t>( m_aArena.get() ) % ARENA_ALIGN ) % ARENA_ALIGN;
+	CarveRing( m_mLive.mSkeleton, uFrames, pArena );
+	CarveRing( m_mLive.mHand, uFrames, pArena );
+	CarveRing( m_mLive.mStatus, STATUS_CAPACITY, pArena );
+	CarveRing( m_mLive.mUserMap, uUserMaps, pArena );
+	m_mLive.pUserMapPixels = reinterpret_cast<uint8_t*>( pArena );
+	pArena += AlignArena( uUserMaps * m_uUserMapBytes );
+
+	CarveRing( m_mSnapshot.mSkeleton, uFrames, pArena );
+	CarveRing( m_mSnapshot.mHand, uFrames, pArena );
+	CarveRing( m_mSnapshot.mStatus, STATUS_CAPACITY, pArena );
+	CarveRing( m_mSnapshot.mUserMap, uUserMaps, pArena );
+	m_mSnapshot.pUserMapPixels = reinterpret_cast<uint8_t*>( pArena );
+
+	m_tDump = boost::thread( [this](){ DumpLoop(); } );
+}
+
+CFlightRecorder::~CFlightRecorder()
+{
+	{
+		boost::lock_guard<boost::mutex> lock( m_mtxDump );
+		m_bStop = true;
+	}
+	m_cvDump.notify_all();
+	m_tDump.join();
+}
+
+int64_t CFlightRecorder::Now() const
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>( boost::chrono::steady_clock::now() - m_tpStart ).count();
+}
+
+void CFlightRecorder::AddSkeleton( const SSkeletonPose& rPose )
+{
+	SSkeletonRecord& rRecord = m_mLive.mSkeleton.Next();
+	rRecord.iTime	= Now();
+	for( int i = 0; i < 15; ++ i )
+	{
+		rRecord.aJoint[i][0] = rPose.mJoints.aX[i];
+		rRecord.aJoint[i][1] = rPose.mJoints.aY[i];
+		rRecord.aJoint[i][2] = rPose.mJoints.aZ[i];
+		rRecord.aJoint[i][3] = rPose.aConfidence[i];
+	}
+	m_mLive.mSkeleton.Commit();
+}
+
+void CFlightRecorder::AddHandPos( const QPointF& rPos2D, const QVector3D& rPos3D )
+{
+	SHandRecord& rRecord = m_mLive.mHand.Next();
+	rRecord.iTime		= Now();
+	rRecord.aPos2D[0]	= float( rPos2D.x() );
+	rRecord.aPos2D[1]	= float( rPos2D.y() );
+	rRecord.aPos3D[0]	= float( rPos3D.x() );
+	rRecord.aPos3D[1]	= float( rPos3D.y() );
+	rRecord.aPos3D[2]	= float( rPos3D.z() );
+	m_mLive.mHand.Commit();
+}
+
+void CFlightRecorder::AddStatus( int iFrom, int iTo )
+{
+	SStatusRecord& rRecord = m_mLive.mStatus.Next();
+	rRecord.iTime	= Now();
+	rRecord.iFrom	= iFrom;
+	rRecord.iTo		= iTo;
+	m_mLive.mStatus.Commit();
+}
+
+void CFlightRecorder::AddUserMap( const CUserFrame& rFrame )
+{
+	if( m_iUserMapStep <= 0 || !rFrame.isValid() )
+		return;
+
+	int iStep = m_iUserMapStep,
+		iWidth = rFrame.getWidth() / iStep,
+		iHeight = rFrame.getHeight() / iStep;
+	if( size_t( iWidth ) * iHeight > m_uUserMapBytes )
+		return;
+
+	boost::lock_guard<boost::mutex> lock( m_mtxUserMap );
+	TRing<SUserMapRecord>& rRing = m_mLive.mUserMap;
+	uint8_t* pPixels = m_mLive.pUserMapPixels + ( rRing.uCount % rRing.uCapacity ) * m_uUserMapBytes;
+
+	SUserMapRecord& rRecord = rRing.Next();
+	rRecord.iTime		= Now();
+	rRecord.iFrameIndex	= rFrame.getFrameIndex();
+	rRecord.uWidth		= uint16_t( iWidth );
+	rRecord.uHeight		= uint16_t( iHeight );
+
+	const nite::UserId* pUserMap = rFrame.getUserMap();
+	for( int y = 0; y < iHeight; ++ y )
+	{
+		const nite::UserId* pRow = pUserMap + size_t( y * iStep ) * rFrame.getWidth();
+		for( int x = 0; x < iWidth; ++ x )
+			*pPixels++ = uint8_t( pRow[x * iStep] );
+	}
+	rRing.Commit();
+}
+
+bool CFlightRecorder::Dump( const char* szReason )
+{
+	// keep the first dump if triggered again while writing
+	if( m_bDumping.exchange( true ) )
+		return false;
+
+	CopyRings( m_mLive, m_mSnapshot );
+	{
+		boost::lock_guard<boost::mutex> lock( m_mtxDump );
+		std::strncpy( m_aReason.data(), szReason, m_aReason.size() - 1 );
+		m_iDumpTime		= Now();
+		m_bDumpRequest = true;
+	}
+	m_cvDump.notify_one();
+	return true;
+}
+
+void CFlightRecorder::CopyRings( const SRings& rFrom, SRings& rTo )
+{
+	CopyRing( rFrom.mSkeleton, rTo.mSkeleton );
+	CopyRing( rFrom.mHand, rTo.mHand );
+	CopyRing( rFrom.mStatus, rTo.mStatus );
+
+	boost::lock_guard<boost::mutex> lock( m_mtxUserMap );
+	CopyRing( rFrom.mUserMap, rTo.mUserMap );
+	std::memcpy( rTo.pUserMapPixels, rFrom.pUserMapPixels, rFrom.mUserMap.Size() * m_uUserMapBytes );
+}
+
+void CFlightRecorder::DumpLoop()
+{
+	boost::unique_lock<boost::mutex> lock( m_mtxDump );
+	while( true )
+	{
+		m_cvDump.wait( lock, [this](){ return m_bDumpRequest || m_bStop; } );
+		if( !m_bDumpRequest )
+			break;
+
+		m_bDumpRequest = false;
+		lock.unlock();
+		WriteDump();
+		m_bDumping = false;
+		lock.lock();
+	}
+}
+
+void CFlightRecorder::WriteDump()
+{
+	// only keep the records in window before the dump
+	int64_t iLast = m_iDumpTime;
+	int64_t iFirst = iLast - m_iWindow;
+
+	char szTime[32];
+	std::time_t tNow = std::time( NULL );
+	std::strftime( szTime, sizeof( szTime ), "%Y%m%d-%H%M%S", std::localtime( &tNow ) );
+	std::ostringstream ssName;
+	ssName << m_sPath << "/flight-" << szTime << "-" << ++m_uDumpCount << "-" << m_aReason.data();
+	std::string sName = ssName.str();
+
+	std::ofstream fsText( ( sName + ".txt" ).c_str() );
+	if( !fsText.is_open() )
+	{
+		std::cerr << "Can't write flight record " << sName << ".txt" << std::endl;
+		return;
+	}
+
+	// times are in milliseconds relative to the dump
+	fsText << "# flight record: " << m_aReason.data() << "\n";
+	fsText << "[Status]\n# time from to\n";
+	for( uint32_t i = 0; i < m_mSnapshot.mStatus.Size(); ++ i )
+	{
+		const SStatusRecord& r = m_mSnapshot.mStatus.At( i );
+		if( r.iTime >= iFirst )
+			fsText << ( r.iTime - iLast ) / 1000.0 << " " << r.iFrom << " " << r.iTo << "\n";
+	}
+
+	fsText << "[Hand]\n# time x y X Y Z\n";
+	for( uint32_t i = 0; i < m_mSnapshot.mHand.Size(); ++ i )
+	{
+		const SHandRecord& r = m_mSnapshot.mHand.At( i );
+		if( r.iTime >= iFirst )
+			fsText << ( r.iTime - iLast ) / 1000.0 << " " << r.aPos2D[0] << " " << r.aPos2D[1] << " "
+				   << r.aPos3D[0] << " " << r.aPos3D[1] << " " << r.aPos3D[2] << "\n";
+	}
+
+	fsText << "[Skeleton]\n# time (x y z confidence) * 15\n";
+	for( uint32_t i = 0; i < m_mSnapshot.mSkeleton.Size(); ++ i )
+	{
+		const SSkeletonRecord& r = m_mSnapshot.mSkeleton.At( i );
+		if( r.iTime < iFirst )
+			continue;
+
+		fsText << ( r.iTime - iLast ) / 1000.0;
+		for( int j = 0; j < 15; ++ j )
+			fsText << " " << r.aJoint[j][0] << " " << r.aJoint[j][1] << " " << r.aJoint[j][2] << " " << r.aJoint[j][3];
+		fsText << "\n";
+	}
+	fsText.close();
+
+	// user maps: SUserMapRecord followed by width * height user ids of each frame
+	const TRing<SUserMapRecord>& rUserMaps = m_mSnapshot.mUserMap;
+	if( m_uUserMapBytes > 0 && rUserMaps.Size() > 0 )
+	{
+		std::ofstream fsUserMap( ( sName + ".usermap" ).c_str(), std::ios::binary );
+		uint32_t uBase = rUserMaps.uCount - rUserMaps.Size();
+		for( uint32_t i = 0; i < rUserMaps.Size(); ++ i )
+		{
+			SUserMapRecord r = rUserMaps.At( i );
+			if( r.iTime < iFirst )
+				continue;
+
+			const uint8_t* pPixels = m_mSnapshot.pUserMapPixels + ( ( uBase + i ) % rUserMaps.uCapacity ) * m_uUserMapBytes;
+			r.iTime -= iLast;
+			fsUserMap.write( reinterpret_cast<const char*>( &r ), sizeof( r ) );
+			fsUserMap.write( reinterpret_cast<const char*>( pPixels ), size_t( r.uWidth ) * r.uHeight );
+		}
+	}
+	std::cout << "Flight record written: " << sName << std::endl;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+
+// Qt Header
+#include <QtGui/QtGui>
+
+// Application header
+#include "UserFrame.h"
+#pragma endregion
+
+struct SSkeletonPose;
+
+/**
+ * Always-on recorder of the last seconds of tracking and hand control.
+ *
+ * All memory is allocated in one arena when constructed, and records are written into
+ * fixed rings, so recording never allocates. Dump() copies the rings into a second arena
+ * and a background thread writes the copy to disk, so the caller doesn't wait for IO.
+ *
+ * Skeletons, hand points and status are recorded by GUI thread; user maps are recorded by
+ * the frame thread. Dump() should be called by GUI thread.
+ */
+class CFlightRecorder
+{
+public:
+	/**
+	 * fSeconds of history at iFps; user maps are kept only if iUserMapStep > 0, sampled every
+	 * iUserMapStep pixels of a iWidth x iHeight frame.
+	 */
+	CFlightRecorder( float fSeconds = 10, int iFps = 30, int iUserMapStep = 0, int iWidth = 640, int iHeight = 480 );
+	~CFlightRecorder();
+
+	/**
+	 * Folder to write dump files
+	 */
+	void SetPath( const std::string& sPath )
+	{
+		m_sPath = sPath;
+	}
+
+	/**
+	 * Joints of the active user
+	 */
+	void AddSkeleton( const SSkeletonPose& rPose );
+
+	void AddHandPos( const QPointF& rPos2D, const QVector3D& rPos3D );
+
+	void AddStatus( int iFrom, int iTo );
+
+	/**
+	 * Keep a downsampled copy of user map, can be called by the frame thread
+	 */
+	void AddUserMap( const CUserFrame& rFrame );
+
+	/**
+	 * Write the history to disk in background, the reason is put in the file name.
+	 * Return false if the previous dump is not finished.
+	 */
+	bool Dump( const char* szReason );
+
+private:
+	struct SSkeletonRecord
+	{
+		int64_t		iTime;
+		float		aJoint[15][4];	/**< x, y, z, confidence */
+	};
+
+	struct SHandRecord
+	{
+		int64_t		iTime;
+		float		aPos2D[2];
+		float		aPos3D[3];
+	};
+
+	struct SStatusRecord
+	{
+		int64_t		iTime;
+		int32_t		iFrom;
+		int32_t		iTo;
+	};
+
+	struct SUserMapRecord
+	{
+		int64_t		iTime;
+		int32_t		iFrameIndex;
+		uint16_t	uWidth;
+		uint16_t	uHeight;
+	};
+
+	/**
+	 * Ring in arena memory, keeps the last uCapacity records
+	 */
+	template<typename _T>
+	struct TRing
+	{
+		_T*			pData;
+		uint32_t	uCapacity;
+		uint32_t	uCount;		/**< total number pushed */
+
+		_T& Next()
+		{
+			return pData[uCount % uCapacity];
+		}
+
+		void Commit()
+		{
+			++ uCount;
+		}
+
+		uint32_t Size() const
+		{
+			return std::min( uCount, uCapacity );
+		}
+
+		/**
+		 * i-th record from the oldest
+		 */
+		const _T& At( uint32_t i ) const
+		{
+			return pData[( uCount - Size() + i ) % uCapacity];
+		}
+	};
+
+	/**
+	 * All rings, in live or snapshot arena
+	 */
+	struct SRings
+	{
+		TRing<SSkeletonRecord>	mSkeleton;
+		TRing<SHandRecord>		mHand;
+		TRing<SStatusRecord>	mStatus;
+		TRing<SUserMapRecord>	mUserMap;
+		uint8_t*				pUserMapPixels;
+	};
+
+	int64_t Now() const;
+
+	void Allocate( SRings& rRings, char*& rpArena );
+
+	void CopyRings( const SRings& rFrom, SRings& rTo );
+
+	void DumpLoop();
+
+	void WriteDump();
+
+private:
+	int							m_iUserMapStep;
+	size_t						m_uUserMapBytes;	/**< bytes of one downsampled user map */
+	std::string					m_sPath;
+	boost::chrono::steady_clock::time_point	m_tpStart;
+	int64_t						m_iWindow;			/**< history length in microseconds */
+
+	std::unique_ptr<char[]>		m_aArena;
+	SRings						m_mLive;
+	SRings						m_mSnapshot;
+	boost::mutex				m_mtxUserMap;		/**< user map ring is written by frame thread */
+
+	boost::thread				m_tDump;
+	boost::mutex				m_mtxDump;
+	boost::condition_variable	m_cvDump;
+	bool						m_bDumpRequest;
+	bool						m_bStop;
+	boost::atomic<bool>			m_bDumping;
+	std::array<char,32>			m_aReason;
+	int64_t						m_iDumpTime;
+	unsigned int				m_uDumpCount;
+};
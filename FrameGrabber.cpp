@@ -0,0 +1,37 @@
+#include "FrameGrabber.h"
+
+const QEvent::Type QONI_FrameListener::FrameEvent = static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+QONI_FrameListener::QONI_FrameListener( QObject* pReceiver ) :
+	m_pReceiver( pReceiver ), m_pMetrics( NULL ), m_bEventPending( false ), m_uReceived( 0 ), m_uDropped( 0 ), m_uProcessed( 0 )
+{
+}
+
+void QONI_FrameListener::PushFrame( const CUserFrame& rFrame )
+{
+	m_Mailbox.Back() = rFrame;
+
+	m_uReceived.fetch_add( 1, boost::memory_order_relaxed );
+	if( m_Mailbox.Publish() )
+	{
+		m_uDropped.fetch_add( 1, boost::memory_order_relaxed );
+		if( m_pMetrics != NULL )
+			m_pMetrics->AddDroppedFrame();
+	}
+
+	// only one event in Qt queue, receiver always fetch the latest frame
+	if( !m_bEventPending.exchange( true, boost::memory_order_acq_rel ) )
+		QCoreApplication::postEvent( m_pReceiver, new QEvent( FrameEvent ) );
+}
+
+bool QONI_FrameListener::FetchFrame( CUserFrame& rFrame )
+{
+	m_bEventPending.store( false, boost::memory_order_release );
+	if( m_Mailbox.Fetch() )
+	{
+		rFrame = m_Mailbox.Front();
+		m_uProcessed.fetch_add( 1, boost::memory_order_relaxed );
+		return true;
+	}
+	return false;
+}
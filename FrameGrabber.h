@@ -0,0 +1,165 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <array>
+#include <functional>
+
+// Boost Header
+#include <boost/atomic.hpp>
+
+// Qt Header
+#include <QtCore/QtCore>
+
+// NiTE Header
+#include <NiTE.h>
+
+// Application header
+#include "Metrics.h"
+#include "UserFrame.h"
+#pragma endregion
+
+/**
+ * Lock-free single-producer / single-consumer mailbox which only keeps the latest value.
+ * It is a triple buffer: the producer never waits for the consumer, and an unread value
+ * is simply replaced by the newer one.
+ */
+template<typename _T>
+class TLatestMailbox
+{
+public:
+	TLatestMailbox() : m_iMiddle( 1 )
+	{
+		m_iBack		= 0;
+		m_iFront	= 2;
+	}
+
+	/**
+	 * The slot owned by producer, write the new value here before Publish()
+	 */
+	_T& Back()
+	{
+		return m_aSlot[m_iBack];
+	}
+
+	/**
+	 * Make the back slot visible to consumer.
+	 * Return true if an unread value is overwritten (dropped).
+	 */
+	bool Publish()
+	{
+		int iOld = m_iMiddle.exchange( m_iBack | FLAG_NEW, boost::memory_order_acq_rel );
+		m_iBack = iOld & INDEX_MASK;
+		return ( iOld & FLAG_NEW ) != 0;
+	}
+
+	/**
+	 * Take the latest published value into the front slot.
+	 * Return false if nothing new since last fetch.
+	 */
+	bool Fetch()
+	{
+		if( !( m_iMiddle.load( boost::memory_order_relaxed ) & FLAG_NEW ) )
+			return false;
+
+		int iOld = m_iMiddle.exchange( m_iFront, boost::memory_order_acq_rel );
+		m_iFront = iOld & INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * The slot owned by consumer, valid after Fetch() return true
+	 */
+	_T& Front()
+	{
+		return m_aSlot[m_iFront];
+	}
+
+private:
+	enum
+	{
+		INDEX_MASK	= 0x3,
+		FLAG_NEW	= 0x4
+	};
+
+	std::array<_T,3>	m_aSlot;
+	int					m_iBack;
+	int					m_iFront;
+	boost::atomic<int>	m_iMiddle;
+};
+
+/**
+ * Read user tracker frames from NiTE as soon as they are ready, and give them to sink.
+ * onNewFrame() is called on the NiTE worker thread.
+ */
+class CLiveFrameSource : public nite::UserTracker::NewFrameListener
+{
+public:
+	std::function<void(const CUserFrame&)>	m_funcSink;
+
+public:
+	/**
+	 * Callback of NiTE, run on NiTE thread
+	 */
+	void onNewFrame( nite::UserTracker& rTracker )
+	{
+		CUserFrame mFrame;
+		if( mFrame.Read( rTracker ) && m_funcSink )
+			m_funcSink( mFrame );
+	}
+};
+
+/**
+ * Pass frames from the source thread to GUI thread.
+ * PushFrame() put the frame into the mailbox, and the receiver object on GUI thread is
+ * notified with FrameEvent.
+ */
+class QONI_FrameListener
+{
+public:
+	static const QEvent::Type FrameEvent;
+
+public:
+	QONI_FrameListener( QObject* pReceiver );
+
+	/**
+	 * Called on the source thread (NiTE or session player)
+	 */
+	void PushFrame( const CUserFrame& rFrame );
+
+	/**
+	 * Get the latest frame, should be called by receiver when FrameEvent arrived.
+	 */
+	bool FetchFrame( CUserFrame& rFrame );
+
+	/**
+	 * Count dropped frames, NULL to disable
+	 */
+	void SetMetrics( CMetrics* pMetrics )
+	{
+		m_pMetrics = pMetrics;
+	}
+
+	unsigned int GetReceivedFrames() const
+	{
+		return m_uReceived.load( boost::memory_order_relaxed );
+	}
+
+	unsigned int GetDroppedFrames() const
+	{
+		return m_uDropped.load( boost::memory_order_relaxed );
+	}
+
+	unsigned int GetProcessedFrames() const
+	{
+		return m_uProcessed.load( boost::memory_order_relaxed );
+	}
+
+private:
+	QObject*									m_pReceiver;
+	CMetrics*									m_pMetrics;
+	TLatestMailbox<CUserFrame>					m_Mailbox;
+	boost::atomic<bool>							m_bEventPending;
+	boost::atomic<unsigned int>					m_uReceived;
+	boost::atomic<unsigned int>					m_uDropped;
+	boost::atomic<unsigned int>					m_uProcessed;
+};
@@ -0,0 +1,223 @@
+#include "FrontEnd.h"
+
+// STL Header
+#include <iostream>
+
+CNIFrontEnd::CNIFrontEnd( QString sINIFile ) :
+	m_qSetting( sINIFile, QSettings::IniFormat ), m_MetricsServer( m_Metrics )
+{
+	m_LiveSource.m_funcSink = [this]( const CUserFrame& rFrame ){ OnFrame( rFrame ); };
+
+	m_bTraceOnStart	= m_qSetting.value( "Trace/Enable", false ).toBool();
+	m_uTraceEvents	= m_qSetting.value( "Trace/Events", 100000 ).toUInt();
+	m_sTraceFile	= m_qSetting.value( "Trace/File", "trace.json" ).toString().toLocal8Bit().constData();
+}
+
+CNIFrontEnd::~CNIFrontEnd()
+{
+	m_niUserTracker.destroy();
+	nite::NiTE::shutdown();
+
+	m_niDepthStream.destroy();
+	m_niDevice.close();
+	openni::OpenNI::shutdown();
+}
+
+bool CNIFrontEnd::InitialNIDevice()
+{
+	int w, h;
+	GetResolution( w, h );
+	return InitialNIDevice( w, h );
+}
+
+bool CNIFrontEnd::InitialNIDevice( int w, int h )
+{
+	#pragma region OpenNI
+	using namespace openni;
+	if( OpenNI::initialize() != STATUS_OK )
+	{
+		ReportError( "OpenNI initialize error", OpenNI::getExtendedError() );
+		return false;
+	}
+
+	if( m_niDevice.open( ANY_DEVICE ) != STATUS_OK )
+	{
+		ReportError( "Can't open OpenNI Device", OpenNI::getExtendedError() );
+		return false;
+	}
+
+	if( m_niDepthStream.create( m_niDevice, SENSOR_DEPTH ) != STATUS_OK )
+	{
+		ReportError( "Can't create depth stream", OpenNI::getExtendedError() );
+		return false;
+	}
+	else
+	{
+		openni::VideoMode mMode;
+		mMode.setFps( 30 );
+		mMode.setResolution( w, h );
+		mMode.setPixelFormat( openni::PIXEL_FORMAT_DEPTH_1_MM );
+		m_niDepthStream.setVideoMode( mMode );
+	}
+	#pragma endregion
+
+	#pragma region NiTE
+	using namespace nite;
+	if( NiTE::initialize() != nite::STATUS_OK )
+	{
+		ReportError( "NiTE", "NiTE initialize error" );
+		return false;
+	}
+
+	if( m_niUserTracker.create( &m_niDevice ) != nite::STATUS_OK )
+	{
+		ReportError( "User Tracker", "UserTracker created failed" );
+		return false;
+	}
+	SetSkeletonSmoothing( m_qSetting.value( "OpenNI/SkeletonSmooth", 0.75f ).toFloat() );
+	#pragma endregion
+
+	return true;
+}
+
+bool CNIFrontEnd::OpenSession( QString sFilename, float fSpeed )
+{
+	if( !m_Player.Open( sFilename.toLocal8Bit().constData() ) )
+	{
+		ReportError( "Session", std::string( "Can't open session file " ) + sFilename.toLocal8Bit().constData() );
+		return false;
+	}
+	m_Player.SetSpeed( fSpeed );
+	std::cout << "Replay " << m_Player.GetFrameCount() << " frames of " << m_Player.GetWidth() << "x" << m_Player.GetHeight() << std::endl;
+	return true;
+}
+
+void CNIFrontEnd::OpenSimulator()
+{
+	SSimulatorConfig mConfig;
+	GetResolution( mConfig.iWidth, mConfig.iHeight );
+	mConfig.iUsers			= m_qSetting.value( "Simulator/Users", 1 ).toInt();
+	mConfig.fJointNoise		= m_qSetting.value( "Simulator/JointNoise", 0 ).toFloat();
+	mConfig.fLowConfidence	= m_qSetting.value( "Simulator/LowConfidence", 0 ).toFloat();
+	mConfig.fButtonOffset	= m_qSetting.value( "Simulator/ButtonOffset", 200 ).toFloat();
+	m_Simulator.Open( mConfig );
+	m_Simulator.SetRate( m_qSetting.value( "Simulator/Rate", 30 ).toFloat() );
+	std::cout << "Simulate " << mConfig.iUsers << " users, " << mConfig.iWidth << "x" << mConfig.iHeight << std::endl;
+}
+
+bool CNIFrontEnd::RecordSession( QString sFilename, bool bCompressed )
+{
+	if( bCompressed )
+	{
+		CCompressedRecorder* pRecorder = new CCompressedRecorder( m_qSetting.value( "Record/QueueSize", 8 ).toUInt() );
+		pRecorder->SetKeyFrameInterval( m_qSetting.value( "Record/KeyFrameInterval", 300 ).toUInt() );
+		m_pRecorder.reset( pRecorder );
+	}
+	else
+		m_pRecorder.reset( new CSessionRecorder() );
+	return m_pRecorder->Open( sFilename.toLocal8Bit().constData() );
+}
+
+void CNIFrontEnd::ReportError( const char* szTitle, const std::string& sText )
+{
+	std::cerr << szTitle << ": " << sText << std::endl;
+}
+
+void CNIFrontEnd::SetupServices( CGestureEngine& rEngine )
+{
+	if( m_qSetting.value( "FlightRecorder/Enable", true ).toBool() )
+	{
+		m_pFlightRecorder.reset( new CFlightRecorder(	m_qSetting.value( "FlightRecorder/Seconds", 10 ).toFloat(), 30,
+														m_qSetting.value( "FlightRecorder/UserMapStep", 0 ).toInt() ) );
+		m_pFlightRecorder->SetPath( m_qSetting.value( "FlightRecorder/Path", "." ).toString().toLocal8Bit().constData() );
+		rEngine.m_pFlightRecorder = m_pFlightRecorder.get();
+	}
+
+	if( m_qSetting.value( "Shared/Enable", false ).toBool() )
+	{
+		if( m_SharedPublisher.Open(	m_qSetting.value( "Shared/Name", "NIController" ).toString().toLocal8Bit().constData(),
+									m_qSetting.value( "Shared/Slots", 4 ).toInt(), m_qSetting.value( "Shared/UserMapStep", 0 ).toInt() ) )
+			rEngine.m_pPublisher = &m_SharedPublisher;
+	}
+
+	rEngine.m_pMetrics = &m_Metrics;
+
+	// keys are queued and sent by the injector thread, so the frame thread never waits for the system
+	m_Injector.m_pMetrics = &m_Metrics;
+	if( m_Injector.Start( CInputInjector::ParseBackend( m_qSetting.value( "Input/Backend", "auto" ).toString().toLower().toLocal8Bit().constData() ) ) )
+		rEngine.m_funcSendKey = [this]( unsigned short uKey ){ m_Injector.PressKey( uKey ); };
+
+	if( m_qSetting.value( "Metrics/Port", 0 ).toUInt() > 0 )
+		m_MetricsServer.Start( (unsigned short)m_qSetting.value( "Metrics/Port", 0 ).toUInt() );
+}
+
+bool CNIFrontEnd::StartSource( bool bListener )
+{
+	if( m_bTraceOnStart )
+		Trace::Start( m_uTraceEvents );
+
+	// session player and simulator push frames like NiTE
+	if( m_Player.IsOpen() )
+		m_Player.Start( [this]( const CUserFrame& rFrame ){ OnFrame( rFrame ); } );
+	else if( m_Simulator.IsOpen() && m_Simulator.GetRate() > 0 )
+		m_Simulator.Start( [this]( const CUserFrame& rFrame ){ OnFrame( rFrame ); } );
+	else if( !m_Simulator.IsOpen() && bListener && m_niUserTracker.isValid() )
+		m_niUserTracker.addNewFrameListener( &m_LiveSource );
+	else
+		return false;
+	return true;
+}
+
+bool CNIFrontEnd::StopSource( bool bListener )
+{
+	if( m_Player.IsOpen() )
+		m_Player.Stop();
+	else if( m_Simulator.IsOpen() )
+		m_Simulator.Stop();
+	else if( !m_niUserTracker.isValid() )
+		return false;
+	else if( bListener )
+		m_niUserTracker.removeNewFrameListener( &m_LiveSource );
+	return true;
+}
+
+void CNIFrontEnd::StopServices()
+{
+	if( m_pRecorder && m_pRecorder->IsOpen() )
+	{
+		m_pRecorder->Close();
+		m_pRecorder->PrintStatistics();
+	}
+
+	if( Trace::IsEnabled() )
+	{
+		Trace::Stop();
+		Trace::WriteJson( m_sTraceFile );
+	}
+}
+
+void CNIFrontEnd::ToggleTrace()
+{
+	if( Trace::IsEnabled() )
+	{
+		Trace::Stop();
+		Trace::WriteJson( m_sTraceFile );
+	}
+	else
+	{
+		std::cout << "Start tracing" << std::endl;
+		Trace::Start( m_uTraceEvents );
+	}
+}
+
+void CNIFrontEnd::GetResolution( int& w, int& h )
+{
+	w = 640;
+	h = 480;
+	QStringList aSize = m_qSetting.value( "OpenNI/Resolution", "640/480" ).toString().split('/');
+	if( aSize.length() == 2 )
+	{
+		w = aSize[0].toInt();
+		h = aSize[1].toInt();
+	}
+}
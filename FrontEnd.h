@@ -0,0 +1,143 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <memory>
+#include <string>
+
+// Qt Header
+#include <QtCore/QSettings>
+
+// OpenNI and NiTE Header
+#include <OpenNI.h>
+#include <NiTE.h>
+
+// Application header
+#include "CompressedSession.h"
+#include "FlightRecorder.h"
+#include "FrameGrabber.h"
+#include "Gesture.h"
+#include "InputInjector.h"
+#include "Metrics.h"
+#include "Session.h"
+#include "SharedPublisher.h"
+#include "Simulator.h"
+#include "Trace.h"
+#pragma endregion
+
+/**
+ * Frame source, recorders and services shared by QNIControl and CNIDaemon.
+ * The frames of device listener, session player and simulator thread are passed to OnFrame() on
+ * the source thread; what is done with them is left to the front-end.
+ */
+class CNIFrontEnd
+{
+public:
+	QSettings	m_qSetting;
+
+public:
+	CNIFrontEnd( QString sINIFile = "" );
+	virtual ~CNIFrontEnd();
+
+	/**
+	 * Initial OpenNI and NiTE in the resolution of INI
+	 */
+	bool InitialNIDevice();
+
+	bool InitialNIDevice( int w, int h );
+
+	/**
+	 * Replay a recorded session file instead of using device
+	 */
+	bool OpenSession( QString sFilename, float fSpeed = 1.0f );
+
+	/**
+	 * Use simulated sensor instead of device, configured by Simulator section of INI
+	 */
+	void OpenSimulator();
+
+	/**
+	 * Record the frames into a session file, should be called before the source starts.
+	 * Compressed session is written by a background thread, and should be unpacked to replay.
+	 */
+	bool RecordSession( QString sFilename, bool bCompressed = false );
+
+	void SetSkeletonSmoothing( float fValue )
+	{
+		m_niUserTracker.setSkeletonSmoothingFactor( fValue );
+	}
+
+protected:
+	/**
+	 * Receive a frame from device, session player or simulator, run on the source thread
+	 */
+	virtual void OnFrame( const CUserFrame& rFrame ) = 0;
+
+	/**
+	 * Show an error of device or session, printed to console by default
+	 */
+	virtual void ReportError( const char* szTitle, const std::string& sText );
+
+	/**
+	 * Create flight recorder, shared publisher and input injector by INI, connect them and the
+	 * metrics to rEngine, and start metrics server
+	 */
+	void SetupServices( CGestureEngine& rEngine );
+
+	/**
+	 * Start tracing if enabled, and the frames of session player, simulator thread or, if bListener,
+	 * device listener. Return false if the frames should be read by the caller.
+	 */
+	bool StartSource( bool bListener );
+
+	/**
+	 * Stop what StartSource() started, return false if there is no source
+	 */
+	bool StopSource( bool bListener );
+
+	/**
+	 * Close the session recorder, and stop tracing and write the trace file
+	 */
+	void StopServices();
+
+	/**
+	 * Start tracing, or stop and write the trace file
+	 */
+	void ToggleTrace();
+
+	/**
+	 * Count the frame of source and write it into the recorders
+	 */
+	void RecordFrame( const CUserFrame& rFrame )
+	{
+		m_Metrics.AddSensorFrame();
+		if( m_pRecorder )
+			m_pRecorder->Write( rFrame );
+		if( m_pFlightRecorder )
+			m_pFlightRecorder->AddUserMap( rFrame );
+	}
+
+private:
+	/**
+	 * Size of sensor in INI, 640x480 if not set
+	 */
+	void GetResolution( int& w, int& h );
+
+protected:
+	bool			m_bTraceOnStart;
+	unsigned int	m_uTraceEvents;
+	std::string		m_sTraceFile;
+
+	CMetrics		m_Metrics;
+	CMetricsServer	m_MetricsServer;
+	CInputInjector	m_Injector;			/**< Sends the keys of all hand controls */
+
+	openni::Device		m_niDevice;
+	openni::VideoStream	m_niDepthStream;
+	nite::UserTracker	m_niUserTracker;
+	CSessionPlayer		m_Player;
+	CSimulatedSource	m_Simulator;
+	std::unique_ptr<CSessionWriter>		m_pRecorder;
+	CLiveFrameSource	m_LiveSource;
+	std::unique_ptr<CFlightRecorder>	m_pFlightRecorder;
+	CSharedPublisher	m_SharedPublisher;
+};
@@ -0,0 +1,966 @@
+#include "Gesture.h"
+
+// STL Header
+#include <cmath>
+#include <iostream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define NIC_SSE2
+	#include <emmintrin.h>
+#endif
+
+void CGestureClock::OnFrame( uint64_t uTimestamp )
+{
+	MeasureDelay( uTimestamp );
+
+	duration tdTime;
+	switch( m_eSource )
+	{
+	case GC_SENSOR:
+		tdTime = duration( rep( uTimestamp ) );
+		break;
+
+	case GC_STEADY:
+		tdTime = boost::chrono::duration_cast<duration>( boost::chrono::steady_clock::now().time_since_epoch() );
+		break;
+
+	default:
+		return;
+	}
+
+	time_point tpTime( tdTime + m_tdOffset );
+	if( tpTime < m_tpNow )
+	{
+		m_tdOffset	+= m_tpNow - tpTime;
+		tpTime		= m_tpNow;
+	}
+	m_tpNow = tpTime;
+}
+
+void CGestureClock::MeasureDelay( uint64_t uTimestamp )
+{
+	int64_t iAge = boost::chrono::duration_cast<duration>( boost::chrono::steady_clock::now().time_since_epoch() ).count() - int64_t( uTimestamp );
+
+	// a session looped or seeked, else let the shortest one rise 1 ms per second for clock drift
+	if( uTimestamp < m_uLastTimestamp )
+		m_iMinAge = std::numeric_limits<int64_t>::max();
+	else if( m_iMinAge != std::numeric_limits<int64_t>::max() )
+		m_iMinAge += int64_t( uTimestamp - m_uLastTimestamp ) / 1000;
+	m_uLastTimestamp = uTimestamp;
+
+	m_iMinAge = std::min( m_iMinAge, iAge );
+	m_tdDelay += ( duration( iAge - m_iMinAge ) - m_tdDelay ) / 8;
+}
+
+#pragma region Skeleton
+void SSkeletonPose::LoadJoints( const nite::Skeleton& rSkeleton )
+{
+	// the first 15 joint types of NiTE are the joints used, in the same order
+	for( int i = 0; i < SJointArray::COUNT; ++ i )
+	{
+		const nite::SkeletonJoint& rJoint = rSkeleton.getJoint( nite::JointType( i ) );
+		const nite::Point3f& rPos = rJoint.getPosition();
+		mJoints.aX[i]	= rPos.x;
+		mJoints.aY[i]	= rPos.y;
+		mJoints.aZ[i]	= rPos.z;
+		aConfidence[i]	= rJoint.getPositionConfidence();
+	}
+	for( int i = SJointArray::COUNT; i < SJointArray::PADDED; ++ i )
+	{
+		mJoints.aX[i] = mJoints.aY[i] = mJoints.aZ[i] = 0.0f;
+		aConfidence[i] = 0.0f;
+	}
+	mTorsoOrientation = rSkeleton.getJoint( nite::JOINT_TORSO ).getOrientation();
+}
+
+void CSkeletonTransform::TransformPose( SSkeletonPose& rPose )
+{
+	NIC_TRACE_SCOPE( "TransformPose" );
+	#pragma region Compute transformation
+	// rotation matrix of torso from the normalized quaternion; identity if unknown
+	const NiteQuaternion& rQ = rPose.mTorsoOrientation;
+	float fNorm = rQ.w * rQ.w + rQ.x * rQ.x + rQ.y * rQ.y + rQ.z * rQ.z;
+	float w = 1, x = 0, y = 0, z = 0;
+	if( fNorm > 0 )
+	{
+		float fInv = 1.0f / std::sqrt( fNorm );
+		w = rQ.w * fInv;
+		x = rQ.x * fInv;
+		y = rQ.y * fInv;
+		z = rQ.z * fInv;
+	}
+
+	// face direction, the torso rotates (0,0,-1) to minus the third column
+	rPose.vDirection = QVector3D( -2 * ( x * z + w * y ), -2 * ( y * z - w * x ), -( 1 - 2 * ( x * x + y * y ) ) );
+
+	if( m_bUpdateTransform.load( boost::memory_order_relaxed ) )
+	{
+		// inverse of a rigid transform: transposed rotation after moving torso to origin
+		m_aRotation[0] = 1 - 2 * ( y * y + z * z );
+		m_aRotation[1] = 2 * ( x * y + w * z );
+		m_aRotation[2] = 2 * ( x * z - w * y );
+		m_aRotation[3] = 2 * ( x * y - w * z );
+		m_aRotation[4] = 1 - 2 * ( x * x + z * z );
+		m_aRotation[5] = 2 * ( y * z + w * x );
+		m_aRotation[6] = 2 * ( x * z + w * y );
+		m_aRotation[7] = 2 * ( y * z - w * x );
+		m_aRotation[8] = 1 - 2 * ( x * x + y * y );
+
+		m_aTranslation[0] = rPose.mJoints.aX[nite::JOINT_TORSO];
+		m_aTranslation[1] = rPose.mJoints.aY[nite::JOINT_TORSO];
+		m_aTranslation[2] = rPose.mJoints.aZ[nite::JOINT_TORSO];
+	}
+	#pragma endregion
+
+	#pragma region transform joints position
+	const std::array<float,9>& r = m_aRotation;
+	float fOriginX = m_vPositionShift.x();
+	if( m_bFollowTorso )
+		fOriginX += m_aTranslation[0] * m_fScale;
+	const SJointArray& rIn = rPose.mJoints;
+	SJointArray& rOut = rPose.mRotated;
+#ifdef NIC_SSE2
+	const __m128	fR0 = _mm_set1_ps( r[0] ), fR1 = _mm_set1_ps( r[1] ), fR2 = _mm_set1_ps( r[2] ),
+					fR3 = _mm_set1_ps( r[3] ), fR4 = _mm_set1_ps( r[4] ), fR5 = _mm_set1_ps( r[5] ),
+					fR6 = _mm_set1_ps( r[6] ), fR7 = _mm_set1_ps( r[7] ), fR8 = _mm_set1_ps( r[8] );
+	const __m128	fTX = _mm_set1_ps( m_aTranslation[0] ),
+					fTY = _mm_set1_ps( m_aTranslation[1] ),
+					fTZ = _mm_set1_ps( m_aTranslation[2] );
+	const __m128	fScale	= _mm_set1_ps( m_fScale ),
+					fShiftX	= _mm_set1_ps( fOriginX ),
+					fShiftY	= _mm_set1_ps( m_vPositionShift.y() );
+	for( int i = 0; i < SJointArray::PADDED; i += 4 )
+	{
+		__m128	dx = _mm_sub_ps( _mm_loadu_ps( rIn.aX + i ), fTX ),
+				dy = _mm_sub_ps( _mm_loadu_ps( rIn.aY + i ), fTY ),
+				dz = _mm_sub_ps( _mm_loadu_ps( rIn.aZ + i ), fTZ );
+		__m128	rx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( fR0, dx ), _mm_mul_ps( fR1, dy ) ), _mm_mul_ps( fR2, dz ) ),
+				ry = _mm_add_ps( _mm_add_ps( _mm_mul_ps( fR3, dx ), _mm_mul_ps( fR4, dy ) ), _mm_mul_ps( fR5, dz ) ),
+				rz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( fR6, dx ), _mm_mul_ps( fR7, dy ) ), _mm_mul_ps( fR8, dz ) );
+		_mm_storeu_ps( rOut.aX + i, rx );
+		_mm_storeu_ps( rOut.aY + i, ry );
+		_mm_storeu_ps( rOut.aZ + i, rz );
+		_mm_storeu_ps( rPose.aX2D + i, _mm_add_ps( fShiftX, _mm_mul_ps( rx, fScale ) ) );
+		_mm_storeu_ps( rPose.aY2D + i, _mm_sub_ps( fShiftY, _mm_mul_ps( ry, fScale ) ) );
+	}
+#else
+	for( int i = 0; i < SJointArray::PADDED; ++ i )
+	{
+		float	dx = rIn.aX[i] - m_aTranslation[0],
+				dy = rIn.aY[i] - m_aTranslation[1],
+				dz = rIn.aZ[i] - m_aTranslation[2];
+		rOut.aX[i] = r[0] * dx + r[1] * dy + r[2] * dz;
+		rOut.aY[i] = r[3] * dx + r[4] * dy + r[5] * dz;
+		rOut.aZ[i] = r[6] * dx + r[7] * dy + r[8] * dz;
+		rPose.aX2D[i] = fOriginX + rOut.aX[i] * m_fScale;
+		rPose.aY2D[i] = m_vPositionShift.y() - rOut.aY[i] * m_fScale;
+	}
+#endif
+	#pragma endregion
+}
+
+const CUserSelector::TUserList& CUserSelector::SelectAll( const CUserFrame& rUserFrame )
+{
+	// scan user for tracking skeleton, and sort tracked users by distance
+	m_aUsers.clear();
+	for( int i = 0; i < rUserFrame.getUserCount(); ++ i )
+	{
+		const nite::UserData& rUser = rUserFrame.getUser( i );
+		if( rUser.isNew() )
+		{
+			// replayed frames already have the recorded skeletons
+			if( rUserFrame.isLive() && m_pUserTracker != NULL )
+				m_pUserTracker->startSkeletonTracking( rUser.getId() );
+		}
+		else
+		{
+			const nite::Skeleton& rSkeleton = rUser.getSkeleton();
+			if( rSkeleton.getState() == nite::SKELETON_TRACKED )
+			{
+				// users of same distance keep the order of NiTE
+				float fDistance = rUser.getCenterOfMass().z;
+				TUserList::iterator itPos = m_aUsers.end();
+				while( itPos != m_aUsers.begin() && ( *( itPos - 1 ) )->getCenterOfMass().z > fDistance )
+					-- itPos;
+				m_aUsers.insert( itPos, &rUser );
+			}
+		}
+	}
+	return m_aUsers;
+}
+#pragma endregion
+
+#pragma region Buttons
+bool CTimerButton::CheckInSide( const QPointF& rPt, const float& fDepth, const CGestureClock::time_point& tpNow )
+{
+	if( Contains( rPt ) )
+	{
+		switch( m_eStatus )
+		{
+		case BS_OUTSIDE:
+			m_eStatus = BS_INSIDE;
+			m_tpFirstIn = tpNow;
+			break;
+
+		case BS_INSIDE:
+			m_fProgress = float( boost::chrono::duration_cast<TDurationType>( tpNow - m_tpFirstIn ).count() ) / m_duTimeToPress.count();
+			if( m_fProgress > 1 )
+			{
+				m_fProgress = 1;
+				m_eStatus = BS_PRESSED;
+				m_funcPress();
+			}
+			break;
+		}
+		return true;
+	}
+	else
+	{
+		switch( m_eStatus )
+		{
+		case BS_PRESSED:
+			m_funcRelease();
+			break;
+		}
+		m_eStatus	= BS_OUTSIDE;
+		m_fProgress	= 0;
+	}
+	return false;
+}
+
+bool CDepthButton::CheckInSide( const QPointF& rPt, const float& fDepth, const CGestureClock::time_point& tpNow )
+{
+	if( Contains( rPt ) )
+	{
+		switch( m_eStatus )
+		{
+		case BS_OUTSIDE:
+			m_eStatus = BS_INSIDE;
+			m_fFirstInDepth = fDepth;
+			break;
+
+		case BS_INSIDE:
+			m_fProgress = ComputeProgess( fDepth );
+			if( m_fProgress >= 1.0f )
+			{
+				m_fProgress = 1;
+				m_eStatus = BS_PRESSED;
+				m_funcPress();
+			}
+			break;
+
+		case BS_PRESSED:
+			m_fProgress = ComputeProgess( fDepth );
+			if( m_fProgress < 1 )
+			{
+				m_eStatus = BS_INSIDE;
+				m_funcRelease();
+			}
+			break;
+		}
+		return true;
+	}
+	else
+	{
+		m_eStatus	= BS_OUTSIDE;
+		m_fProgress	= 0;
+	}
+	return false;
+}
+#pragma endregion
+
+#pragma region CHandControl
+CHandControl::CHandControl()
+{
+	m_fHandMoveThreshold	= 25;
+	m_fHandForwardDistance	= 250;
+	m_tdPreFixTime			= boost::chrono::milliseconds( 100 );
+	m_tdFixTime				= boost::chrono::milliseconds( 500 );
+	m_tdInvokeTime			= boost::chrono::milliseconds( 300 );
+	m_funcStartInput		= [](){};
+	m_funcEndInput			= [](){};
+	m_funcSendKey			= []( unsigned short ){};
+	m_pFlightRecorder		= NULL;
+	m_pMetrics				= NULL;
+	m_bMoving				= false;
+
+	m_bHandVisible			= false;
+	m_eHandState			= HS_GENERAL;
+	m_fFixProgress			= 0.0f;
+	m_bButtonsVisible		= true;
+	m_uLayoutVersion		= 0;
+	m_bPageHold				= false;
+
+	SetLayout( CButtonLayout::Default() );
+
+	m_eControlStatus	= NICS_INPUT;
+	UpdateStatus( NICS_NO_HAND );
+}
+
+bool CHandControl::UpdateStatus( const CHandControl::EControlStatus& eStatus )
+{
+	if( m_eControlStatus != eStatus )
+	{
+		if( m_pFlightRecorder )
+			m_pFlightRecorder->AddStatus( m_eControlStatus, eStatus );
+		if( m_pMetrics )
+			m_pMetrics->SetControlStatus( eStatus );
+		m_eControlStatus = eStatus;
+		m_bHandVisible = true;
+
+		switch( m_eControlStatus )
+		{
+		case NICS_NO_HAND:
+			UpdateStatus( NICS_STANDBY );
+			m_Trajectory.Clear();
+			m_bHandVisible = false;
+			m_bButtonsVisible = false;
+			m_funcEndInput();
+			break;
+
+		case NICS_STANDBY:
+			m_eHandState = HS_GENERAL;
+			m_bButtonsVisible = false;
+			m_funcEndInput();
+			break;
+
+		case NICS_FIXING:
+			m_eHandState = HS_FIXING;
+			m_FixPos = CurrentPos();
+			break;
+
+		case NICS_FIXED:
+			m_FixPos = CurrentPos();
+			m_aPageStack.clear();
+			ShowPage( 0 );
+			m_eHandState = HS_FIXED;
+			m_bButtonsVisible = true;
+			m_bMoving = false;
+			m_funcStartInput();
+			break;
+
+		case NICS_INPUT:
+			m_FixPos = CurrentPos();
+
+			break;
+		}
+		return true;
+	}
+	return false;
+}
+
+void CHandControl::UpdateHandPoint( const QPointF& rPt2D, const QVector3D& rPt3D, const CGestureClock::time_point& tpTime )
+{
+	NIC_TRACE_SCOPE( "HandControl" );
+	// add to trajectory, the window follows the pre-fix time
+	m_Trajectory.SetWindow( m_tdPreFixTime );
+	m_Trajectory.Push( float( rPt2D.x() ), float( rPt2D.y() ), tpTime.time_since_epoch() );
+	if( m_pFlightRecorder )
+		m_pFlightRecorder->AddHandPos( rPt2D, rPt3D );
+
+	// move hand icon
+	m_HandPos2D		= rPt2D;
+	m_tpHandTime	= tpTime;
+
+	// process
+	if( m_eControlStatus == NICS_NO_HAND )
+		UpdateStatus( NICS_STANDBY );
+
+	if( m_eControlStatus == NICS_STANDBY )
+	{
+		if( rPt3D.z() < -m_fHandForwardDistance )
+		{
+			// start float hand button if fix
+			if( m_Trajectory.IsStill( m_fHandMoveThreshold ) )
+			{
+				UpdateStatus( NICS_FIXING );
+			}
+		}
+	}
+
+	// check if hand move out from button
+	if( m_eControlStatus == NICS_FIXING )
+	{
+		if( QLineF( m_FixPos.mPos2D, rPt2D ).length() > m_fHandMoveThreshold )
+		{
+			UpdateStatus( NICS_STANDBY );
+		}
+		else
+		{
+			m_fFixProgress = ComputeProgress( tpTime - m_FixPos.tpTime, m_tdFixTime );
+			if( m_fFixProgress > 1 )
+			{
+				m_ButtonOrigin = rPt2D;
+				UpdateStatus( NICS_FIXED );
+			}
+		}
+	}
+
+	if( m_eControlStatus == NICS_FIXED )
+	{
+		if( rPt3D.z() > -m_fHandForwardDistance )
+			UpdateStatus( NICS_STANDBY );
+
+		if( !m_bMoving && QLineF( m_FixPos.mPos2D, rPt2D ).length() > m_fHandMoveThreshold )
+		{
+			m_bMoving		= true;
+			m_tpMoveStart	= tpTime;
+		}
+
+		CheckButtons( rPt2D - m_ButtonOrigin, rPt3D.z(), tpTime );
+	}
+}
+
+void CHandControl::SetLayout( const CButtonLayout& rLayout )
+{
+	for( auto itBut = m_aActiveButtons.begin(); itBut != m_aActiveButtons.end(); ++ itBut )
+		m_vButtons[*itBut]->Leave();
+	m_vButtons.clear();
+	m_aPageGrid.assign( rLayout.m_aPages.size(), CButtonGrid() );
+	for( size_t p = 0; p < rLayout.m_aPages.size(); ++ p )
+	{
+		const CButtonLayout::SPage& rPage = rLayout.m_aPages[p];
+		for( auto itDef = rPage.aButtons.begin(); itDef != rPage.aButtons.end(); ++ itDef )
+		{
+			CProgressButton* pButton = NULL;
+			if( itDef->bDepth )
+			{
+				pButton = new CDepthButton();
+			}
+			else
+			{
+				CTimerButton* pTimer = new CTimerButton();
+				pTimer->m_duTimeToPress = ( itDef->iTime > 0 ? boost::chrono::milliseconds( itDef->iTime ) : m_tdInvokeTime );
+				pButton = pTimer;
+			}
+			pButton->m_Pos		= itDef->mPos;
+			pButton->m_fSize	= itDef->fSize;
+			pButton->m_eShape	= itDef->eShape;
+			pButton->m_sLabel	= itDef->sLabel;
+			pButton->m_iPage	= int( p );
+
+			switch( itDef->eAction )
+			{
+			case CButtonLayout::BA_KEY:
+				{
+					std::string sName = itDef->sName.toLocal8Bit().constData();
+					unsigned short uKey = itDef->uKey;
+					pButton->m_funcPress = [this,sName,uKey](){
+						std::cout << sName << std::endl;
+						PressKey( uKey );
+						if( m_pFlightRecorder )
+							m_pFlightRecorder->Dump( sName.c_str() );
+					};
+				}
+				break;
+
+			case CButtonLayout::BA_PAGE:
+				{
+					int iPage = itDef->iPage;
+					pButton->m_funcPress = [this,iPage](){
+						// going to a page already in the stack goes back to it
+						auto itPage = std::find( m_aPageStack.begin(), m_aPageStack.end(), iPage );
+						if( itPage != m_aPageStack.end() )
+							m_aPageStack.erase( itPage, m_aPageStack.end() );
+						else
+							m_aPageStack.push_back( m_iPage );
+						m_iNextPage = iPage;
+					};
+				}
+				break;
+
+			case CButtonLayout::BA_BACK:
+				pButton->m_funcPress = [this](){
+					if( !m_aPageStack.empty() )
+					{
+						m_iNextPage = m_aPageStack.back();
+						m_aPageStack.pop_back();
+					}
+				};
+				break;
+			}
+
+			m_aPageGrid[p].Add( int( m_vButtons.size() ), pButton->GetBounds() );
+			m_vButtons.push_back( std::unique_ptr<CProgressButton>( pButton ) );
+		}
+		m_aPageGrid[p].Build();
+	}
+
+	// the checked buttons are at most all buttons, no allocation while checking
+	m_aActiveButtons.clear();
+	m_aActiveButtons.reserve( m_vButtons.size() );
+	m_aCheckButtons.reserve( m_vButtons.size() );
+	m_aPageStack.reserve( rLayout.m_aPages.size() );
+	m_iPage		= 0;
+	m_iNextPage	= -1;
+
+	// unique among hand controls, a view may be moved to another one
+	static boost::atomic<unsigned int> s_uLayoutVersion( 0 );
+	m_uLayoutVersion = ++ s_uLayoutVersion;
+}
+
+void CHandControl::CheckButtons( const QPointF& rPt, float fDepth, const TTimePoint& tpTime )
+{
+	// after the page is changed, the new buttons wait until the hand moves
+	if( m_bPageHold && QLineF( m_PageHoldPos, m_HandPos2D ).length() > m_fHandMoveThreshold )
+		m_bPageHold = false;
+
+	m_aCheckButtons.clear();
+	if( !m_bPageHold )
+	{
+		const int *pFirst, *pLast;
+		m_aPageGrid[m_iPage].Query( rPt, pFirst, pLast );
+		m_aCheckButtons.assign( pFirst, pLast );
+	}
+	for( auto itBut = m_aActiveButtons.begin(); itBut != m_aActiveButtons.end(); ++ itBut )
+	{
+		if( std::find( m_aCheckButtons.begin(), m_aCheckButtons.end(), *itBut ) == m_aCheckButtons.end() )
+			m_aCheckButtons.push_back( *itBut );
+	}
+
+	m_aActiveButtons.clear();
+	for( auto itBut = m_aCheckButtons.begin(); itBut != m_aCheckButtons.end(); ++ itBut )
+	{
+		CProgressButton& rButton = *m_vButtons[*itBut];
+		rButton.CheckInSide( rPt, fDepth, tpTime );
+		if( rButton.GetStatus() != CProgressButton::BS_OUTSIDE )
+			m_aActiveButtons.push_back( *itBut );
+	}
+
+	// a page button is pressed
+	if( m_iNextPage >= 0 )
+	{
+		ShowPage( m_iNextPage );
+		m_bPageHold		= true;
+		m_PageHoldPos	= m_HandPos2D;
+	}
+}
+
+void CHandControl::ShowPage( int iPage )
+{
+	for( auto itBut = m_aActiveButtons.begin(); itBut != m_aActiveButtons.end(); ++ itBut )
+		m_vButtons[*itBut]->Leave();
+	m_aActiveButtons.clear();
+	m_iPage		= iPage;
+	m_iNextPage	= -1;
+	m_bPageHold	= false;
+}
+
+void CHandControl::PressKey( unsigned short uKey )
+{
+	m_funcSendKey( uKey );
+
+	// a button is pressed without moving if it is under the fixed point; in time of the frame
+	if( m_pMetrics )
+	{
+		TTimePoint tpStart = m_bMoving ? m_tpMoveStart : m_FixPos.tpTime;
+		m_pMetrics->AddKeyLatency( boost::chrono::duration_cast<boost::chrono::microseconds>( m_tpHandTime - tpStart ) );
+	}
+}
+#pragma endregion
+
+#pragma region CGestureEngine
+CGestureEngine::CGestureEngine( nite::UserTracker* pTracker ) : m_UserSelector( pTracker ), m_WorkerPool( 1 )
+{
+	m_fJointConfidence	= 0.5f;
+	m_eInputPolicy		= IP_NEAREST;
+	m_bAutoLead			= true;
+	m_tdLead			= boost::chrono::milliseconds( 0 );
+	m_funcSendKey		= []( unsigned short ){};
+	m_pFlightRecorder	= NULL;
+	m_pMetrics			= NULL;
+	m_pPublisher		= NULL;
+	m_iViewWidth		= 0;
+	m_iViewHeight		= 0;
+
+	SetMaxUsers( 1 );
+}
+
+void CGestureEngine::LoadSettings( const QSettings& rSetting )
+{
+	m_fJointConfidence = rSetting.value( "OpenNI/JointConfidence", 0.5f ).toFloat();
+
+	QString sClock = rSetting.value( "Control/Clock", "sensor" ).toString().toLower();
+	m_Clock.m_eSource = ( sClock == "steady" ? CGestureClock::GC_STEADY : CGestureClock::GC_SENSOR );
+
+	QString sPolicy = rSetting.value( "Control/InputPolicy", "nearest" ).toString().toLower();
+	if( sPolicy == "first" )
+		m_eInputPolicy = IP_FIRST;
+	else if( sPolicy == "all" )
+		m_eInputPolicy = IP_ALL;
+	else
+		m_eInputPolicy = IP_NEAREST;
+
+	QString sLead = rSetting.value( "Control/FilterLead", "auto" ).toString().toLower();
+	m_bAutoLead	= ( sLead == "auto" );
+	m_tdLead	= boost::chrono::milliseconds( m_bAutoLead ? 0 : sLead.toInt() );
+
+	QString sFilter = rSetting.value( "Control/Filter", "none" ).toString().toLower();
+	CHandFilter::EType eFilter = CHandFilter::HF_NONE;
+	if( sFilter == "euro" )
+		eFilter = CHandFilter::HF_ONE_EURO;
+	else if( sFilter == "kalman" )
+		eFilter = CHandFilter::HF_KALMAN;
+
+	// the built-in buttons if the layout file can't be used
+	CButtonLayout mLayout = CButtonLayout::Default();
+	QString sLayout = rSetting.value( "Control/Layout", "" ).toString();
+	if( !sLayout.isEmpty() )
+		mLayout.Load( sLayout );
+
+	SetMaxUsers( rSetting.value( "Control/Users", 1 ).toUInt() );
+	SetUserThreads( rSetting.value( "Control/UserThreads", 1 ).toUInt() );
+
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+	{
+		CHandControl& rControl = ( *itSlot )->mHandControl;
+		rControl.m_fHandMoveThreshold	= rSetting.value( "Control/MoveThreshold", 25 ).toFloat();
+		rControl.m_fHandForwardDistance	= rSetting.value( "Control/ForwardDistance", 250 ).toFloat();
+		rControl.m_tdPreFixTime			= boost::chrono::milliseconds( rSetting.value( "Control/PreFixTime", 100 ).toInt() );
+		rControl.m_tdFixTime			= boost::chrono::milliseconds( rSetting.value( "Control/FixTime", 500 ).toInt() );
+		rControl.m_tdInvokeTime			= boost::chrono::milliseconds( rSetting.value( "Control/InvokeTime", 300 ).toInt() );
+		rControl.SetLayout( mLayout );
+
+		CHandFilter& rFilter = ( *itSlot )->mFilter;
+		rFilter.m_eType				= eFilter;
+		rFilter.m_fMinCutoff		= rSetting.value( "Control/FilterMinCutoff", 1.0f ).toFloat();
+		rFilter.m_fBeta				= rSetting.value( "Control/FilterBeta", 0.007f ).toFloat();
+		rFilter.m_fDerivateCutoff	= rSetting.value( "Control/FilterDerivateCutoff", 1.0f ).toFloat();
+		rFilter.m_fProcessNoise		= rSetting.value( "Control/FilterProcessNoise", 5000.0f ).toFloat();
+		rFilter.m_fMeasureNoise		= rSetting.value( "Control/FilterMeasureNoise", 4.0f ).toFloat();
+	}
+}
+
+void CGestureEngine::SetMaxUsers( unsigned int uUsers )
+{
+	uUsers = std::max( uUsers, 1u );
+	m_aSlots.clear();
+	m_aActiveSlots.clear();
+	m_aActiveSlots.reserve( uUsers );
+	m_iNearestSlot	= -1;
+	m_iInputSlot	= -1;
+
+	for( unsigned int i = 0; i < uUsers; ++ i )
+	{
+		SUserSlot* pSlot = new SUserSlot();
+		pSlot->bActive		= false;
+		pSlot->uID			= 0;
+		pSlot->pUser		= NULL;
+		pSlot->eControlHand	= NICH_NO_HAND;
+		pSlot->pView		= NULL;
+
+		// the menus of users are drawn over themselves, not at the center of view
+		CSkeletonTransform& rTransform = pSlot->mTransform;
+		rTransform.m_bFollowTorso = ( uUsers > 1 );
+		if( m_iViewWidth > 0 )
+			rTransform.SetViewSize( m_iViewWidth, m_iViewHeight );
+
+		CHandControl& rControl = pSlot->mHandControl;
+		rControl.m_funcStartInput	= [&rTransform](){ rTransform.KeepTransform( true ); };
+		rControl.m_funcEndInput		= [&rTransform](){ rTransform.KeepTransform( false ); };
+
+		// m_iInputSlot is only changed between the parallel processing of users
+		int iSlot = int( i );
+		rControl.m_funcSendKey = [this,iSlot]( unsigned short uKey ){
+			if( m_eInputPolicy == IP_ALL || m_iInputSlot == iSlot )
+				m_funcSendKey( uKey );
+		};
+
+		m_aSlots.push_back( std::unique_ptr<SUserSlot>( pSlot ) );
+	}
+}
+
+void CGestureEngine::SetViewSize( int w, int h )
+{
+	m_iViewWidth	= w;
+	m_iViewHeight	= h;
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+		( *itSlot )->mTransform.SetViewSize( w, h );
+}
+
+bool CGestureEngine::ProcessFrame( const CUserFrame& rUserFrame )
+{
+	if( !rUserFrame.isValid() )
+		return false;
+
+	const CUserSelector::TUserList* pUsers = NULL;
+	{
+		NIC_TRACE_SCOPE( "SelectUser" );
+		CMetrics::CStageTimer mTimer( m_pMetrics, CMetrics::MS_SELECT_USER );
+		pUsers = &( m_UserSelector.SelectAll( rUserFrame ) );
+		if( m_pMetrics != NULL )
+			m_pMetrics->SetTrackedUsers( int( pUsers->size() ) );
+	}
+	return ProcessUsers( rUserFrame, *pUsers );
+}
+
+bool CGestureEngine::ProcessUsers( const CUserFrame& rUserFrame, const CUserSelector::TUserList& rUsers )
+{
+	m_Clock.OnFrame( rUserFrame.getTimestamp() );
+	AssignSlots( rUsers );
+	SelectInputSlot();
+
+	// users are independent, only the slot with input has metrics and flight recorder
+	m_WorkerPool.ParallelFor( int( m_aActiveSlots.size() ), [this]( int i ){
+		SUserSlot& rSlot = *m_aSlots[m_aActiveSlots[i]];
+		rSlot.mPose.LoadJoints( rSlot.pUser->getSkeleton() );
+		{
+			CMetrics::CStageTimer mTimer( rSlot.mHandControl.m_pMetrics, CMetrics::MS_TRANSFORM );
+			rSlot.mTransform.TransformPose( rSlot.mPose );
+		}
+		ProcessSlot( rSlot, rSlot.mPose );
+	} );
+
+	NotifyViews();
+	Publish( &rUserFrame, rUserFrame.getTimestamp() );
+	return !m_aActiveSlots.empty();
+}
+
+void CGestureEngine::ProcessPose( const SSkeletonPose& rPose, uint64_t uTimestamp )
+{
+	m_Clock.OnFrame( uTimestamp );
+	SUserSlot& rSlot = *m_aSlots[0];
+	rSlot.bActive = true;
+	m_aActiveSlots.assign( 1, 0 );
+	m_iNearestSlot = 0;
+	SelectInputSlot();
+
+	// kept in the slot, so it is published and returned by GetNearestPose() like the selected users
+	rSlot.mPose = rPose;
+	ProcessSlot( rSlot, rSlot.mPose );
+	NotifyViews();
+	Publish( NULL, uTimestamp );
+}
+
+void CGestureEngine::UsersLost()
+{
+	AssignSlots( CUserSelector::TUserList() );
+	SelectInputSlot();
+	NotifyViews();
+	Publish( NULL, 0 );
+}
+
+void CGestureEngine::AssignSlots( const CUserSelector::TUserList& rUsers )
+{
+	// only the nearest users get slots
+	size_t uUsers = std::min( rUsers.size(), m_aSlots.size() );
+
+	// free the slots of lost users
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+	{
+		SUserSlot& rSlot = **itSlot;
+		if( !rSlot.bActive )
+			continue;
+
+		rSlot.pUser = NULL;
+		for( size_t i = 0; i < uUsers; ++ i )
+		{
+			if( rUsers[i]->getId() == rSlot.uID )
+				rSlot.pUser = rUsers[i];
+		}
+		if( rSlot.pUser == NULL )
+		{
+			rSlot.mHandControl.HandLost();
+			rSlot.mFilter.Reset();
+			rSlot.eControlHand	= NICH_NO_HAND;
+			rSlot.bActive		= false;
+		}
+	}
+
+	// keep the order of distance, new users get free slots
+	m_aActiveSlots.clear();
+	for( size_t i = 0; i < uUsers; ++ i )
+	{
+		int iFree = -1, iSlot = -1;
+		for( int j = 0; j < int( m_aSlots.size() ) && iSlot < 0; ++ j )
+		{
+			if( m_aSlots[j]->bActive )
+			{
+				if( m_aSlots[j]->pUser == rUsers[i] )
+					iSlot = j;
+			}
+			else if( iFree < 0 )
+			{
+				iFree = j;
+			}
+		}
+
+		if( iSlot < 0 )
+		{
+			// there is always a free slot, the number of users is limited
+			iSlot = iFree;
+			SUserSlot& rSlot = *m_aSlots[iSlot];
+			rSlot.bActive	= true;
+			rSlot.uID		= rUsers[i]->getId();
+			rSlot.pUser		= rUsers[i];
+		}
+		m_aActiveSlots.push_back( iSlot );
+	}
+	m_iNearestSlot = m_aActiveSlots.empty() ? -1 : m_aActiveSlots.front();
+}
+
+void CGestureEngine::SelectInputSlot()
+{
+	int iInput = m_iNearestSlot;
+	if( m_eInputPolicy == IP_FIRST )
+	{
+		// the owner keeps input while their buttons are shown, else the first one shows buttons
+		if( m_iInputSlot >= 0 && m_aSlots[m_iInputSlot]->bActive && m_aSlots[m_iInputSlot]->mHandControl.IsButtonsVisible() )
+		{
+			iInput = m_iInputSlot;
+		}
+		else
+		{
+			for( auto itSlot = m_aActiveSlots.begin(); itSlot != m_aActiveSlots.end(); ++ itSlot )
+			{
+				if( m_aSlots[*itSlot]->mHandControl.IsButtonsVisible() )
+				{
+					iInput = *itSlot;
+					break;
+				}
+			}
+		}
+	}
+
+	if( iInput != m_iInputSlot && m_iInputSlot >= 0 )
+	{
+		CHandControl& rControl = m_aSlots[m_iInputSlot]->mHandControl;
+		rControl.m_pFlightRecorder	= NULL;
+		rControl.m_pMetrics			= NULL;
+	}
+	if( iInput >= 0 )
+	{
+		CHandControl& rControl = m_aSlots[iInput]->mHandControl;
+		rControl.m_pFlightRecorder	= m_pFlightRecorder;
+		rControl.m_pMetrics			= m_pMetrics;
+		if( iInput != m_iInputSlot && m_pMetrics != NULL )
+			m_pMetrics->SetControlStatus( rControl.GetStatus() );
+	}
+	m_iInputSlot = iInput;
+}
+
+void CGestureEngine::ProcessSlot( SUserSlot& rSlot, const SSkeletonPose& rPose )
+{
+	CHandControl& rControl = rSlot.mHandControl;
+	CMetrics::CStageTimer mTimer( rControl.m_pMetrics, CMetrics::MS_HAND );
+	if( rControl.m_pFlightRecorder )
+		rControl.m_pFlightRecorder->AddSkeleton( rPose );
+
+	EControlHand	eHandStatus = NICH_NO_HAND;
+	#pragma region select nearest hand
+	{
+		NIC_TRACE_SCOPE( "SelectHand" );
+		float	fRC = rPose.aConfidence[nite::JOINT_RIGHT_HAND],
+				fLC = rPose.aConfidence[nite::JOINT_LEFT_HAND];
+
+		if( fRC > m_fJointConfidence )
+		{
+			if( fLC > m_fJointConfidence )
+			{
+				if( rPose.mRotated.aZ[nite::JOINT_RIGHT_HAND] > rPose.mRotated.aZ[nite::JOINT_LEFT_HAND] )
+					eHandStatus = NICH_LEFT_HAND;
+				else
+					eHandStatus = NICH_RIGHT_HAND;
+			}
+			else
+			{
+				eHandStatus = NICH_RIGHT_HAND;
+			}
+		}
+		else if( fLC > m_fJointConfidence )
+		{
+			eHandStatus = NICH_LEFT_HAND;
+		}
+	}
+	#pragma endregion
+
+	if( eHandStatus == NICH_NO_HAND || eHandStatus != rSlot.eControlHand )
+	{
+		rControl.HandLost();
+		rSlot.mFilter.Reset();
+		rSlot.eControlHand = eHandStatus;
+	}
+
+	if( rSlot.eControlHand != NICH_NO_HAND )
+	{
+		nite::JointType eJoint = ( eHandStatus == NICH_RIGHT_HAND ? nite::JOINT_RIGHT_HAND : nite::JOINT_LEFT_HAND );
+		QPointF		ptHand	= rPose.Joint2D( eJoint );
+		QVector3D	vHand	= rPose.JointRotated( eJoint );
+
+		// make up for the frame waiting and the lag of smoothing, at most 100 ms; raw position is not moved
+		boost::chrono::microseconds tdLead = m_tdLead;
+		if( rSlot.mFilter.m_eType == CHandFilter::HF_NONE )
+			tdLead = boost::chrono::microseconds::zero();
+		else if( m_bAutoLead )
+			tdLead = m_Clock.GetFrameDelay() + rSlot.mFilter.GetSmoothedLag();
+		tdLead = std::min( std::max( tdLead, boost::chrono::microseconds::zero() ), boost::chrono::microseconds( 100000 ) );
+		rSlot.mFilter.Filter( ptHand, vHand, m_Clock.Now().time_since_epoch(), tdLead );
+		if( rControl.m_pMetrics )
+			rControl.m_pMetrics->SetHandFilter( tdLead, rSlot.mFilter.GetSmoothedLag(), rSlot.mFilter.GetPredictedLag() );
+
+		rControl.UpdateHandPoint( ptHand, vHand, m_Clock.Now() );
+	}
+}
+
+void CGestureEngine::NotifyViews()
+{
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+	{
+		if( ( *itSlot )->pView != NULL )
+			( *itSlot )->pView->OnHandControlUpdate( ( *itSlot )->mHandControl );
+	}
+}
+
+void CGestureEngine::Publish( const CUserFrame* pUserFrame, uint64_t uTimestamp )
+{
+	SharedFrame::SSharedFrame* pFrame = ( m_pPublisher != NULL ? m_pPublisher->Begin() : NULL );
+	if( pFrame == NULL )
+		return;
+
+	NIC_TRACE_SCOPE( "Publish" );
+	pFrame->uTimestamp	= uTimestamp;
+	pFrame->iFrameIndex	= ( pUserFrame != NULL ? pUserFrame->getFrameIndex() : 0 );
+	for( auto itSlot = m_aActiveSlots.begin(); itSlot != m_aActiveSlots.end() && pFrame->uUserCount < SharedFrame::MAX_USERS; ++ itSlot )
+	{
+		const SUserSlot& rSlot = *m_aSlots[*itSlot];
+		const CHandControl& rControl = rSlot.mHandControl;
+		const SSkeletonPose& rPose = rSlot.mPose;
+		SharedFrame::SSharedUser& rUser = pFrame->aUsers[pFrame->uUserCount ++];
+
+		rUser.iUserID			= rSlot.uID;
+		rUser.iSlot				= *itSlot;
+		rUser.iControlStatus	= rControl.GetStatus();
+		rUser.iHandState		= rControl.GetHandState();
+		rUser.iControlHand		= rSlot.eControlHand;
+		rUser.bInput			= ( m_eInputPolicy == IP_ALL || m_iInputSlot == *itSlot );
+		rUser.bHandVisible		= rControl.IsHandVisible();
+		rUser.bButtonsVisible	= rControl.IsButtonsVisible();
+		rUser.iPage				= rControl.GetPage();
+		rUser.fFixProgress		= rControl.GetFixProgress();
+		rUser.aHand2D[0]		= float( rControl.GetHandPos().x() );
+		rUser.aHand2D[1]		= float( rControl.GetHandPos().y() );
+		rUser.aButtonOrigin[0]	= float( rControl.GetButtonOrigin().x() );
+		rUser.aButtonOrigin[1]	= float( rControl.GetButtonOrigin().y() );
+		rUser.aTorsoOrientation[0]	= rPose.mTorsoOrientation.x;
+		rUser.aTorsoOrientation[1]	= rPose.mTorsoOrientation.y;
+		rUser.aTorsoOrientation[2]	= rPose.mTorsoOrientation.z;
+		rUser.aTorsoOrientation[3]	= rPose.mTorsoOrientation.w;
+		for( int i = 0; i < SharedFrame::JOINTS; ++ i )
+		{
+			rUser.aJoint[i][0]		= rPose.mJoints.aX[i];
+			rUser.aJoint[i][1]		= rPose.mJoints.aY[i];
+			rUser.aJoint[i][2]		= rPose.mJoints.aZ[i];
+			rUser.aJoint[i][3]		= rPose.aConfidence[i];
+			rUser.aRotated[i][0]	= rPose.mRotated.aX[i];
+			rUser.aRotated[i][1]	= rPose.mRotated.aY[i];
+			rUser.aRotated[i][2]	= rPose.mRotated.aZ[i];
+			rUser.aJoint2D[i][0]	= rPose.aX2D[i];
+			rUser.aJoint2D[i][1]	= rPose.aY2D[i];
+		}
+	}
+	if( pUserFrame != NULL && pUserFrame->isValid() )
+		m_pPublisher->Commit( pUserFrame->getUserMap(), pUserFrame->getWidth(), pUserFrame->getHeight() );
+	else
+		m_pPublisher->Commit();
+}
+#pragma endregion
@@ -0,0 +1,788 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+
+// Qt Header
+#include <QtCore/QSettings>
+#include <QtGui/QtGui>
+
+// NiTE Header
+#include <NiTE.h>
+
+// Application header
+#include "ButtonLayout.h"
+#include "FlightRecorder.h"
+#include "HandFilter.h"
+#include "HandTrajectory.h"
+#include "Metrics.h"
+#include "SharedPublisher.h"
+#include "Trace.h"
+#include "UserFrame.h"
+#include "WorkerPool.h"
+#pragma endregion
+
+/**
+ * Gesture processing without graphics items, so it can run without QApplication and scene.
+ * Qt is only used for the vector types; the graphics items in UserMap.h and HandControl.h
+ * show the state of these objects.
+ */
+
+/**
+ * Time base of gestures, the hand control and buttons only use the time given by it.
+ * By default it follows the sensor timestamp of frames, so the gestures don't depend on when
+ * the frames are processed, and a replayed session gives the same gestures at any speed.
+ */
+class CGestureClock
+{
+public:
+	typedef boost::chrono::microseconds					duration;
+	typedef duration::rep								rep;
+	typedef duration::period							period;
+	typedef boost::chrono::time_point<CGestureClock>	time_point;
+
+	enum ESource
+	{
+		GC_SENSOR,		/**< Timestamp of frame */
+		GC_STEADY,		/**< Steady clock when the frame is processed */
+		GC_MANUAL,		/**< Only changed by Set() */
+	};
+
+public:
+	ESource		m_eSource;
+
+public:
+	CGestureClock() : m_tpNow( duration::zero() ), m_tdOffset( duration::zero() ), m_tdDelay( duration::zero() )
+	{
+		m_eSource			= GC_SENSOR;
+		m_uLastTimestamp	= 0;
+		m_iMinAge			= std::numeric_limits<int64_t>::max();
+	}
+
+	/**
+	 * Advance to the time of a frame, uTimestamp is sensor time in microseconds.
+	 * The time never goes backward, so a session which loops or seeks continues from the last time.
+	 */
+	void OnFrame( uint64_t uTimestamp );
+
+	void Set( const time_point& tpTime )
+	{
+		m_tpNow = tpTime;
+	}
+
+	const time_point& Now() const
+	{
+		return m_tpNow;
+	}
+
+	/**
+	 * Measured delay of frames from the sensor to OnFrame(), above the shortest one seen.
+	 * It contains the waiting for timer or queue, but not the constant delay of sensor and NiTE.
+	 */
+	duration GetFrameDelay() const
+	{
+		return m_tdDelay;
+	}
+
+private:
+	void MeasureDelay( uint64_t uTimestamp );
+
+private:
+	time_point	m_tpNow;
+	duration	m_tdOffset;			/**< Added to the time of source */
+	uint64_t	m_uLastTimestamp;
+	int64_t		m_iMinAge;			/**< The shortest steady time minus sensor time */
+	duration	m_tdDelay;			/**< Smoothed */
+};
+
+/**
+ * Position of joints as structure of arrays, so they can be transformed 4 at a time.
+ * The index is nite::JointType; the padding joint is kept 0.
+ */
+struct SJointArray
+{
+	enum
+	{
+		COUNT	= 15,
+		PADDED	= 16
+	};
+
+	float	aX[PADDED];
+	float	aY[PADDED];
+	float	aZ[PADDED];
+
+	QVector3D Position( int i ) const
+	{
+		return QVector3D( aX[i], aY[i], aZ[i] );
+	}
+};
+
+/**
+ * Joints of one skeleton, and the transformed result for control and drawing
+ */
+struct SSkeletonPose
+{
+	SJointArray		mJoints;							/**< Position from NiTE, in mm */
+	float			aConfidence[SJointArray::PADDED];	/**< Position confidence from NiTE */
+	NiteQuaternion	mTorsoOrientation;
+	SJointArray		mRotated;							/**< Position relative to torso */
+	float			aX2D[SJointArray::PADDED];			/**< Projected position in view */
+	float			aY2D[SJointArray::PADDED];
+	QVector3D		vDirection;
+
+	/**
+	 * Copy the joints used from NiTE skeleton
+	 */
+	void LoadJoints( const nite::Skeleton& rSkeleton );
+
+	QVector3D JointRotated( int i ) const
+	{
+		return mRotated.Position( i );
+	}
+
+	QPointF Joint2D( int i ) const
+	{
+		return QPointF( aX2D[i], aY2D[i] );
+	}
+};
+
+/**
+ * Transform joints into the coordinate of torso, and project them to 2D view position
+ */
+class CSkeletonTransform
+{
+public:
+	float		m_fScale;
+	QVector2D	m_vPositionShift;
+	bool		m_bFollowTorso;		/**< Shift the 2D x with torso, so the views of users don't overlap */
+
+public:
+	CSkeletonTransform()
+	{
+		m_fScale			= 1.0f / 2.5f;
+		m_vPositionShift	= QVector2D( 320, 320 );
+		m_bFollowTorso		= false;
+		m_bUpdateTransform	= true;
+
+		// identity
+		std::fill( m_aRotation.begin(), m_aRotation.end(), 0.0f );
+		m_aRotation[0] = m_aRotation[4] = m_aRotation[8] = 1.0f;
+		std::fill( m_aTranslation.begin(), m_aTranslation.end(), 0.0f );
+	}
+
+	/**
+	 * Fit the 2D position to a view of w x h
+	 */
+	void SetViewSize( int w, int h )
+	{
+		m_vPositionShift	= QVector2D( w / 2, h * 2.0f / 3 );
+		m_fScale			= 1.0f * w / 1600;
+	}
+
+	/**
+	 * Compute the transformed joints of pose, can be called from pipeline thread.
+	 * The inverse of torso pose is built from the quaternion directly, and all joints are
+	 * transformed and projected by SSE when available.
+	 */
+	void TransformPose( SSkeletonPose& rPose );
+
+	/**
+	 * Keep the torso transformation, so the hand moves relative to a fixed body while input
+	 */
+	void KeepTransform( bool bKeep = true )
+	{
+		m_bUpdateTransform.store( !bKeep, boost::memory_order_relaxed );
+	}
+
+private:
+	boost::atomic<bool>		m_bUpdateTransform;
+	std::array<float,9>		m_aRotation;		/**< Row-major, from sensor to torso coordinate */
+	std::array<float,3>		m_aTranslation;		/**< Torso position */
+};
+
+/**
+ * Find the nearest user with tracked skeleton, and start skeleton tracking of new users
+ */
+class CUserSelector
+{
+public:
+	typedef std::vector<const nite::UserData*>	TUserList;
+
+	/**
+	 * pTracker is used to start skeleton tracking of live frames, can be NULL
+	 */
+	CUserSelector( nite::UserTracker* pTracker = NULL ) : m_pUserTracker( pTracker )
+	{
+		m_aUsers.reserve( 16 );
+	}
+
+	/**
+	 * Return all users with tracked skeleton, the nearest first.
+	 * The list is valid until the next call, and the frame must be kept.
+	 */
+	const TUserList& SelectAll( const CUserFrame& rUserFrame );
+
+	/**
+	 * Return NULL if there is no tracked user; piTracked gets the number of tracked users
+	 */
+	const nite::UserData* Select( const CUserFrame& rUserFrame, int* piTracked = NULL )
+	{
+		const TUserList& rUsers = SelectAll( rUserFrame );
+		if( piTracked != NULL )
+			*piTracked = int( rUsers.size() );
+		return rUsers.empty() ? NULL : rUsers.front();
+	}
+
+	/**
+	 * Result of the last selection
+	 */
+	const TUserList& GetUsers() const
+	{
+		return m_aUsers;
+	}
+
+private:
+	nite::UserTracker*	m_pUserTracker;
+	TUserList			m_aUsers;
+};
+
+/**
+ * Logic of a button in hand control, m_Pos is relative to the origin of buttons.
+ * The hand is inside if it is in the circle or square of m_fSize.
+ */
+class CProgressButton
+{
+public:
+	enum EStatus
+	{
+		BS_OUTSIDE,
+		BS_INSIDE,
+		BS_PRESSED
+	};
+
+public:
+	std::function<void()>	m_funcPress;
+	std::function<void()>	m_funcRelease;
+	QPointF					m_Pos;
+	float					m_fSize;
+	EButtonShape			m_eShape;
+	QString					m_sLabel;		/**< Drawn on the button */
+	int						m_iPage;		/**< Page of the layout which shows it */
+
+public:
+	CProgressButton()
+	{
+		m_eStatus		= BS_OUTSIDE;
+		m_fProgress		= 0;
+		m_funcPress		= [](){};
+		m_funcRelease	= [](){};
+		m_fSize			= 70;
+		m_eShape		= BSH_RECT;
+		m_iPage			= 0;
+	}
+
+	virtual ~CProgressButton()
+	{
+	}
+
+	/**
+	 * Update with hand position at time tpNow of CGestureClock, return true if the hand is inside
+	 */
+	virtual bool CheckInSide( const QPointF& rPt, const float& fDepth, const CGestureClock::time_point& tpNow ) = 0;
+
+	EStatus GetStatus() const
+	{
+		return m_eStatus;
+	}
+
+	float GetProgress() const
+	{
+		return m_fProgress;
+	}
+
+	/**
+	 * The hand is gone without CheckInSide(), as the page is changed
+	 */
+	void Leave()
+	{
+		if( m_eStatus == BS_PRESSED )
+			m_funcRelease();
+		m_eStatus	= BS_OUTSIDE;
+		m_fProgress	= 0;
+	}
+
+	QRectF GetBounds() const
+	{
+		float fS = m_fSize / 2;
+		return QRectF( m_Pos.x() - fS, m_Pos.y() - fS, m_fSize, m_fSize );
+	}
+
+protected:
+	bool Contains( const QPointF& rPt ) const
+	{
+		if( m_eShape == BSH_CIRCLE )
+		{
+			QPointF ptDiff = rPt - m_Pos;
+			return ptDiff.x() * ptDiff.x() + ptDiff.y() * ptDiff.y() <= m_fSize * m_fSize / 4;
+		}
+		return GetBounds().contains( rPt );
+	}
+
+protected:
+	EStatus	m_eStatus;
+	float	m_fProgress;
+};
+
+/**
+ * A time-base button
+ */
+class CTimerButton : public CProgressButton
+{
+public:
+	typedef boost::chrono::milliseconds	TDurationType;
+
+	TDurationType	m_duTimeToPress;
+
+public:
+	CTimerButton()
+	{
+		m_duTimeToPress = boost::chrono::milliseconds( 500 );
+	}
+
+	bool CheckInSide( const QPointF& rPt, const float& fDepth, const CGestureClock::time_point& tpNow );
+
+protected:
+	CGestureClock::time_point	m_tpFirstIn;
+};
+
+/**
+ * A depth-base button
+ */
+class CDepthButton : public CProgressButton
+{
+public:
+	float	m_fPressDepth;
+
+public:
+	CDepthButton()
+	{
+		m_fPressDepth = 50;
+	}
+
+	bool CheckInSide( const QPointF& rPt, const float& fDepth, const CGestureClock::time_point& tpNow );
+
+protected:
+	float ComputeProgess( float fDepth )
+	{
+		return std::min( std::max( ( m_fFirstInDepth - fDepth ) / m_fPressDepth, 0.0f ), 1.0f );
+	}
+
+protected:
+	float	m_fFirstInDepth;
+};
+
+class CHandControl;
+
+/**
+ * Observer of hand control, to draw it
+ */
+class IHandControlView
+{
+public:
+	virtual ~IHandControlView()
+	{
+	}
+
+	/**
+	 * Called after the hand control is updated
+	 */
+	virtual void OnHandControlUpdate( const CHandControl& rControl ) = 0;
+};
+
+/**
+ * Hand control state machine: fix the hand to show buttons, then move to a button to send key
+ */
+class CHandControl
+{
+public:
+	enum EControlStatus
+	{
+		NICS_NO_HAND,
+		NICS_STANDBY,
+		NICS_FIXING,
+		NICS_FIXED,
+		NICS_INPUT,
+	};
+
+	/**
+	 * How the hand should be shown
+	 */
+	enum EHandState
+	{
+		HS_GENERAL,
+		HS_FIXING,
+		HS_FIXED
+	};
+
+	typedef std::vector<std::unique_ptr<CProgressButton>>	TButtonList;
+
+public:
+	float							m_fHandMoveThreshold;	/**< The movement threshold for fixing hand (2D) */
+	float							m_fHandForwardDistance;	/**< The forward distance threshold for initial fix hand */
+	boost::chrono::milliseconds		m_tdPreFixTime;			/**< The time start to fix */
+	boost::chrono::milliseconds		m_tdFixTime;			/**< The time to fix */
+	boost::chrono::milliseconds		m_tdInvokeTime;			/**< The time to invoke button, used by SetLayout() */
+	std::function<void()>			m_funcStartInput;
+	std::function<void()>			m_funcEndInput;
+	std::function<void(unsigned short)>	m_funcSendKey;		/**< Send key when button pressed, does nothing by default */
+	CFlightRecorder*				m_pFlightRecorder;		/**< Record hand and status, dump when button pressed; can be NULL */
+	CMetrics*						m_pMetrics;				/**< Time in each status and key latency; can be NULL */
+
+public:
+	CHandControl();
+
+	/**
+	 * Reset hand status, clear history
+	 */
+	void HandReset()
+	{
+		UpdateStatus( NICS_STANDBY );
+		m_Trajectory.Clear();
+	}
+
+	/**
+	 * Replace the buttons by the pages of a layout
+	 */
+	void SetLayout( const CButtonLayout& rLayout );
+
+	/**
+	 * Update current hand point information, tpTime is the time of frame from CGestureClock
+	 */
+	void UpdateHandPoint( const QPointF& rPt2D, const QVector3D& rPt3D, const CGestureClock::time_point& tpTime );
+
+	/**
+	 * Set the hand as lost
+	 */
+	void HandLost()
+	{
+		UpdateStatus( NICS_NO_HAND );
+	}
+
+	EControlStatus GetStatus() const
+	{
+		return m_eControlStatus;
+	}
+
+	#pragma region State to show
+	bool IsHandVisible() const
+	{
+		return m_bHandVisible;
+	}
+
+	EHandState GetHandState() const
+	{
+		return m_eHandState;
+	}
+
+	const QPointF& GetHandPos() const
+	{
+		return m_HandPos2D;
+	}
+
+	float GetFixProgress() const
+	{
+		return m_fFixProgress;
+	}
+
+	bool IsButtonsVisible() const
+	{
+		return m_bButtonsVisible;
+	}
+
+	/**
+	 * The position of buttons are relative to this point
+	 */
+	const QPointF& GetButtonOrigin() const
+	{
+		return m_ButtonOrigin;
+	}
+
+	/**
+	 * Buttons of all pages
+	 */
+	const TButtonList& GetButtons() const
+	{
+		return m_vButtons;
+	}
+
+	/**
+	 * Changed by each SetLayout() of any hand control, so views know to create the buttons again
+	 */
+	unsigned int GetLayoutVersion() const
+	{
+		return m_uLayoutVersion;
+	}
+
+	int GetPage() const
+	{
+		return m_iPage;
+	}
+	#pragma endregion
+
+private:
+	typedef	CGestureClock::time_point TTimePoint;
+
+	/**
+	 * Position of hand at a time point
+	 */
+	struct SHandPos
+	{
+		TTimePoint	tpTime;
+		QPointF		mPos2D;
+	};
+
+private:
+	bool UpdateStatus( const EControlStatus& eStatus );
+
+	SHandPos CurrentPos() const
+	{
+		SHandPos mPos;
+		mPos.tpTime = m_tpHandTime;
+		mPos.mPos2D = m_HandPos2D;
+		return mPos;
+	}
+
+	/**
+	 * Only the buttons around the hand and the buttons the hand was in are checked
+	 */
+	void CheckButtons( const QPointF& rPt, float fDepth, const TTimePoint& tpTime );
+
+	/**
+	 * Leave the buttons of current page and show another one
+	 */
+	void ShowPage( int iPage );
+
+	/**
+	 * Send key of button, and record the time since the hand started to move to it
+	 */
+	void PressKey( unsigned short uKey );
+
+	template<typename _TD1, typename _TD2>
+	float ComputeProgress( const _TD1& time1, const _TD2& time2 )
+	{
+		return float(boost::chrono::duration_cast<_TD2>( time1 ).count()) / time2.count();
+	}
+
+private:
+	EControlStatus		m_eControlStatus;
+
+	SHandPos	m_FixPos;
+	CHandTrajectory	m_Trajectory;		/**< Positions of the pre-fix time, to check if the hand is still */
+	TTimePoint		m_tpHandTime;		/**< Time of m_HandPos2D */
+	TButtonList		m_vButtons;
+	std::vector<CButtonGrid>	m_aPageGrid;		/**< Hit test index of each page */
+	unsigned int	m_uLayoutVersion;
+	int				m_iPage;
+	int				m_iNextPage;		/**< Page to show after the buttons are checked, -1 if none */
+	std::vector<int>	m_aPageStack;		/**< Pages before, for the back action */
+	std::vector<int>	m_aActiveButtons;	/**< Buttons not BS_OUTSIDE */
+	std::vector<int>	m_aCheckButtons;
+	bool			m_bPageHold;		/**< The page is changed, buttons wait the hand to move */
+	QPointF			m_PageHoldPos;
+	TTimePoint		m_tpMoveStart;		/**< Time the fixed hand started to move, for key latency */
+	bool			m_bMoving;
+
+	bool			m_bHandVisible;
+	EHandState		m_eHandState;
+	QPointF			m_HandPos2D;
+	float			m_fFixProgress;
+	bool			m_bButtonsVisible;
+	QPointF			m_ButtonOrigin;
+};
+
+/**
+ * Gesture processing of one frame: select the tracked users, transform their skeletons, select
+ * the nearest hand of each user and update their hand controls. Frames should be processed by
+ * one thread at a time.
+ *
+ * Each user gets a slot with their own transform and hand control, so several users can use the
+ * menu at the same time; the slots are processed in parallel by a worker pool. Which users may
+ * send keys is decided by EInputPolicy. With one slot it works like a single-user controller.
+ */
+class CGestureEngine
+{
+public:
+	/**
+	 * Which users may send keys
+	 */
+	enum EInputPolicy
+	{
+		IP_NEAREST,		/**< Only the nearest user */
+		IP_FIRST,		/**< The first user with fixed hand, until their buttons are hidden */
+		IP_ALL,			/**< Every user */
+	};
+
+public:
+	float				m_fJointConfidence;		/**< The confidence value of joint position to use */
+	EInputPolicy		m_eInputPolicy;
+	CGestureClock		m_Clock;				/**< Advanced by each frame processed */
+	bool				m_bAutoLead;			/**< Extrapolate the hand by measured delay and filter lag */
+	boost::chrono::milliseconds	m_tdLead;		/**< Extrapolation of the hand if not m_bAutoLead */
+
+	/**
+	 * Send the keys allowed by policy, does nothing by default; CInputInjector::PressKey() in the application.
+	 * With IP_ALL and more than one thread, it may be called by worker threads at the same time.
+	 */
+	std::function<void(unsigned short)>	m_funcSendKey;
+
+	CFlightRecorder*	m_pFlightRecorder;		/**< Records the user who has input, can be NULL */
+	CMetrics*			m_pMetrics;				/**< Can be NULL */
+	CSharedPublisher*	m_pPublisher;			/**< Gets the users of each frame processed, can be NULL */
+
+public:
+	/**
+	 * pTracker is used to start skeleton tracking of live frames, can be NULL
+	 */
+	CGestureEngine( nite::UserTracker* pTracker = NULL );
+
+	/**
+	 * Read the settings of Control and OpenNI/JointConfidence from INI
+	 */
+	void LoadSettings( const QSettings& rSetting );
+
+	/**
+	 * Rebuild uUsers slots of the default settings; views and hooks of hand control are removed
+	 */
+	void SetMaxUsers( unsigned int uUsers );
+
+	int GetMaxUsers() const
+	{
+		return int( m_aSlots.size() );
+	}
+
+	/**
+	 * Number of threads to process users, 0 to use all cores
+	 */
+	void SetUserThreads( unsigned int uThreads )
+	{
+		m_WorkerPool.SetThreadCount( uThreads );
+	}
+
+	/**
+	 * Fit the 2D position of all users to a view of w x h
+	 */
+	void SetViewSize( int w, int h );
+
+	/**
+	 * The view is updated on the processing thread after all users are processed
+	 */
+	void SetView( int iSlot, IHandControlView* pView )
+	{
+		m_aSlots[iSlot]->pView = pView;
+	}
+
+	CHandControl& GetHandControl( int iSlot = 0 )
+	{
+		return m_aSlots[iSlot]->mHandControl;
+	}
+
+	CSkeletonTransform& GetSkeletonTransform( int iSlot = 0 )
+	{
+		return m_aSlots[iSlot]->mTransform;
+	}
+
+	/**
+	 * Select users and process them, return true if there is any tracked user
+	 */
+	bool ProcessFrame( const CUserFrame& rUserFrame );
+
+	/**
+	 * Process users of the frame already selected by a CUserSelector
+	 */
+	bool ProcessUsers( const CUserFrame& rUserFrame, const CUserSelector::TUserList& rUsers );
+
+	/**
+	 * Select the control hand of a transformed pose and update the hand control of slot 0,
+	 * for the callers which select and transform the skeleton themselves.
+	 * uTimestamp is the sensor time of the frame, in microseconds.
+	 */
+	void ProcessPose( const SSkeletonPose& rPose, uint64_t uTimestamp );
+
+	/**
+	 * All users are lost, hide the hand controls
+	 */
+	void UsersLost();
+
+	/**
+	 * Pose of the nearest user of last ProcessFrame(), NULL if there is no user
+	 */
+	const SSkeletonPose* GetNearestPose() const
+	{
+		return m_iNearestSlot < 0 ? NULL : &( m_aSlots[m_iNearestSlot]->mPose );
+	}
+
+private:
+	enum EControlHand
+	{
+		NICH_NO_HAND,
+		NICH_RIGHT_HAND,
+		NICH_LEFT_HAND,
+	};
+
+	/**
+	 * State of one user, uID and pUser are only used if bActive
+	 */
+	struct SUserSlot
+	{
+		bool					bActive;
+		nite::UserId			uID;
+		const nite::UserData*	pUser;			/**< User of current frame */
+		CSkeletonTransform		mTransform;
+		CHandControl			mHandControl;
+		SSkeletonPose			mPose;
+		EControlHand			eControlHand;
+		CHandFilter				mFilter;
+		IHandControlView*		pView;
+	};
+
+	/**
+	 * Keep the slots of known users, free the slots of lost users and give new users free slots
+	 */
+	void AssignSlots( const CUserSelector::TUserList& rUsers );
+
+	/**
+	 * Choose the user who has input by policy, and move flight recorder and metrics to them
+	 */
+	void SelectInputSlot();
+
+	/**
+	 * Select hand and update hand control, may run on worker thread
+	 */
+	void ProcessSlot( SUserSlot& rSlot, const SSkeletonPose& rPose );
+
+	void NotifyViews();
+
+	/**
+	 * Write the active users to m_pPublisher; pUserFrame gives the user map and can be NULL
+	 */
+	void Publish( const CUserFrame* pUserFrame, uint64_t uTimestamp );
+
+private:
+	CUserSelector					m_UserSelector;
+	CWorkerPool						m_WorkerPool;
+	std::vector<std::unique_ptr<SUserSlot>>	m_aSlots;
+	std::vector<int>				m_aActiveSlots;		/**< Slots with user, the nearest first */
+	int								m_iNearestSlot;
+	int								m_iInputSlot;
+	int								m_iViewWidth;		/**< For the slots created later, 0 if not set */
+	int								m_iViewHeight;
+};
@@ -1,24 +1,8 @@
 #include "HandControl.h"
 
-// windows header
-#include <Windows.h>
-
-/**
- * Keyboard simulator
- */
-void SendKey( WORD key )
-{
-	INPUT mWinEvent;
-	mWinEvent.type = INPUT_KEYBOARD;
-	mWinEvent.ki.time = 0;
-	mWinEvent.ki.dwFlags = 0;
-	mWinEvent.ki.wScan = 0;
-	mWinEvent.ki.wVk = key;
-	SendInput( 1, &mWinEvent, sizeof(mWinEvent) );
-}
-
 void QHandIcon::paint( QPainter *pPainter, const QStyleOptionGraphicsItem *option, QWidget *widget )
 {
+	NIC_TRACE_SCOPE( "PaintHandIcon" );
 	switch( m_eStatus )
 	{
 	case HS_GENERAL:
@@ -48,134 +32,36 @@ void QHandIcon::paint( QPainter *pPainter, const QStyleOptionGraphicsItem *optio
 	}
 }
 
-bool QHandControl::UpdateStatus( const QHandControl::EControlStatus& eStatus )
+void QHandControl::OnHandControlUpdate( const CHandControl& rControl )
 {
-	if( m_eControlStatus != eStatus )
-	{
-		m_eControlStatus = eStatus;
-		m_HandIcon.show();
-
-		switch( m_eControlStatus )
-		{
-		case NICS_NO_HAND:
-			HandReset();
-			m_HandIcon.hide();
-			m_qButtons.hide();
-			m_funcEndInput();
-			break;
-
-		case NICS_STANDBY:
-			m_HandIcon.SetStatus( QHandIcon::HS_GENERAL );
-			m_qButtons.hide();
-			m_funcEndInput();
-			break;
-
-		case NICS_FIXING:
-			m_HandIcon.SetStatus( QHandIcon::HS_FIXING );
-			m_FixPos = CurrentPos();
-			break;
-
-		case NICS_FIXED:
-			m_FixPos = CurrentPos();
-			m_HandIcon.SetStatus( QHandIcon::HS_FIXED );
-			m_qButtons.show();
-			m_itCurrentButton = m_vButtons.end();
-			m_funcStartInput();
-			break;
-
-		case NICS_INPUT:
-			m_FixPos = CurrentPos();
-			
-			break;
-		}
-		return true;
-	}
-	return false;
-}
-
-void QHandControl::UpdateHandPoint( const QPointF& rPt2D, const QVector3D& rPt3D )
-{
-	// add to points list
-	SHandPos mPos( rPt2D, rPt3D );
-	m_aTrackList.push_back( mPos );
-
-	// move hand icon
-	m_HandIcon.resetTransform();
-	m_HandIcon.translate( rPt2D.x(), rPt2D.y() );
-
-	// process
-	if( m_eControlStatus == NICS_NO_HAND )
-		UpdateStatus( NICS_STANDBY );
-	
-	if( m_eControlStatus == NICS_STANDBY )
-	{
-		if( rPt3D.z() < -m_fHandForwardDistance )
-		{
-			// start float hand button if fix
-			if( Is2DPosFixFor( m_tdPreFixTime, m_fHandMoveThreshold ) )
-			{
-				UpdateStatus( NICS_FIXING );
-			}
-		}
-	}
-
-	// check if hand move out from button
-	if( m_eControlStatus == NICS_FIXING )
+	// button items are created for the buttons of control at the first update, and when the layout is changed
+	const CHandControl::TButtonList& rButtons = rControl.GetButtons();
+	if( m_uLayoutVersion != rControl.GetLayoutVersion() )
 	{
-		if( QLineF( m_FixPos.mPos2D, rPt2D ).length() > m_fHandMoveThreshold )
-		{
-			UpdateStatus( NICS_STANDBY );
-		}
-		else
-		{
-			float fProgress = ComputeProgress( mPos.tpTime - m_FixPos.tpTime, m_tdFixTime );
-			m_HandIcon.SetProgress( fProgress );
-			if( fProgress > 1 )
-			{
-				m_qButtons.resetTransform();
-				m_qButtons.translate( rPt2D.x(), rPt2D.y() + 50 );
-				UpdateStatus( NICS_FIXED );
-			}
-		}
-	}
-
-	if( m_eControlStatus == NICS_FIXED )
-	{
-		if( rPt3D.z() > -m_fHandForwardDistance )
-			UpdateStatus( NICS_STANDBY );
-
+		m_uLayoutVersion = rControl.GetLayoutVersion();
 		for( auto itBut = m_vButtons.begin(); itBut != m_vButtons.end(); ++ itBut )
+			delete *itBut;
+		m_vButtons.clear();
+
+		for( auto itBut = rButtons.begin(); itBut != rButtons.end(); ++ itBut )
 		{
-			if( (*itBut)->CheckInSide( rPt2D, rPt3D.z() ) )
-			{
-			}
+			QProgressButton* pButton = new QProgressButton( **itBut );
+			m_qButtons.addToGroup( pButton );
+			m_vButtons.push_back( pButton );
 		}
 	}
 
-	if( m_eControlStatus == NICS_INPUT )
-	{
-	}
-}
-
-void QHandControl::BuildButtons()
-{
-	QTimerButton* pBut1 = new QTimerButton();
-	pBut1->translate( 80, -50 );
-	pBut1->m_duTimeToPress = m_tdInvokeTime;
-	pBut1->m_funcPress = [](){
-		std::cout << "NEXT" << std::endl;
-		SendKey( VK_NEXT );
-	};
-	m_qButtons.addToGroup( pBut1 );
-	m_vButtons.push_back( pBut1 );
-
-	QTimerButton* pBut2 = new QTimerButton();
-	pBut2->translate( -80, -50 );
-	pBut2->m_duTimeToPress = m_tdInvokeTime;
-	pBut2->m_funcPress = [](){
-		std::cout << "previous" << std::endl;
-		SendKey( VK_PRIOR );
-	};
-	m_qButtons.addToGroup( pBut2 );
-	m_vButtons.push_back( pBut2 );
+	// hand icon, HAND_STATE has the same order as CHandControl::EHandState
+	m_HandIcon.setVisible( rControl.IsHandVisible() );
+	m_HandIcon.SetStatus( QHandIcon::HAND_STATE( rControl.GetHandState() ) );
+	m_HandIcon.SetProgress( rControl.GetFixProgress() );
+	if( m_HandIcon.pos() != rControl.GetHandPos() )
+		m_HandIcon.setPos( rControl.GetHandPos() );
+
+	// buttons
+	m_qButtons.setVisible( rControl.IsButtonsVisible() );
+	if( m_qButtons.pos() != rControl.GetButtonOrigin() )
+		m_qButtons.setPos( rControl.GetButtonOrigin() );
+	for( size_t i = 0; i < m_vButtons.size() && i < rButtons.size(); ++ i )
+		m_vButtons[i]->Sync( rControl.GetPage(), rButtons[i]->GetStatus(), rButtons[i]->GetProgress() );
 }
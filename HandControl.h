@@ -2,17 +2,14 @@
 
 #pragma region Header Files
 // STL Header
-#include <functional>
 #include <vector>
 
-// Boost Header
-#include <boost/chrono.hpp>
-#include <boost/circular_buffer.hpp>
-
 // QT Header
 #include <QtGui/QtGui>
 
+#include "Gesture.h"
 #include "NIButton.h"
+#include "Trace.h"
 #pragma endregion
 
 /**
@@ -58,6 +55,9 @@ public:
 
 		SetSize( fSize );
 		hide();
+
+		// only repainted when status or progress changes, moving reuses the cache
+		setCacheMode( QGraphicsItem::DeviceCoordinateCache );
 	}
 
 	/**
@@ -66,6 +66,7 @@ public:
 	void SetSize( float fSize )
 	{
 		float fHS = fSize / 2;
+		prepareGeometryChange();
 		m_Rect.setRect( -fHS, -fHS, fSize, fSize );
 	}
 
@@ -74,7 +75,11 @@ public:
 	 */
 	void SetStatus( const HAND_STATE& eStatus )
 	{
-		m_eStatus = eStatus;
+		if( m_eStatus != eStatus )
+		{
+			m_eStatus = eStatus;
+			update();
+		}
 	}
 
 	/**
@@ -82,12 +87,20 @@ public:
 	 */
 	void SetProgress( const float& fVal )
 	{
-		m_fProgress = fVal;
+		if( m_fProgress != fVal )
+		{
+			m_fProgress = fVal;
+			if( m_eStatus == HS_FIXING )
+				update();
+		}
 	}
 
+	/**
+	 * Include the half width of the progress pen, the cache is clipped by it
+	 */
 	QRectF boundingRect() const
 	{
-		return m_Rect;
+		return m_Rect.adjusted( -8, -8, 8, 8 );
 	}
 
 	void paint( QPainter *pPainter, const QStyleOptionGraphicsItem *option, QWidget *widget );
@@ -99,62 +112,25 @@ private:
 };
 
 /**
- * Hand control system
+ * Hand control view, shows the hand and buttons of a CHandControl
  */
-class QHandControl : public QGraphicsItemGroup
+class QHandControl : public QGraphicsItemGroup, public IHandControlView
 {
-public:
-	float							m_fHandMoveThreshold;	/**< The movement threshold for fixing hand (2D) */
-	float							m_fHandForwardDistance;	/**< The forward distance threshold for initial fix hand */
-	boost::chrono::milliseconds		m_tdPreFixTime;			/**< The time start to fix */
-	boost::chrono::milliseconds		m_tdFixTime;			/**< The time to fix */
-	boost::chrono::milliseconds		m_tdInvokeTime;			/**< The time to invoke button */	//TODO: no work now
-	std::function<void()>			m_funcStartInput;
-	std::function<void()>			m_funcEndInput;
-
 public:
 	QHandControl()
 	{
-		m_fHandMoveThreshold	= 25;
-		m_fHandForwardDistance	= 250;
-		m_tdPreFixTime			= boost::chrono::milliseconds( 100 );
-		m_tdFixTime				= boost::chrono::milliseconds( 500 );
-		m_tdInvokeTime			= boost::chrono::milliseconds( 300 );
-		m_funcStartInput		= [](){};
-		m_funcEndInput			= [](){};
-
-		m_aTrackList.set_capacity( 150 );
+		m_uLayoutVersion = 0;
 		SetRect( QRectF( 0, 0, 640, 480 ) );
-		BuildButtons();
 
 		addToGroup( &m_HandIcon );
 		addToGroup( &m_qButtons );
-
-		m_eControlStatus	= NICS_INPUT;
-		UpdateStatus( NICS_NO_HAND );
-	}
-
-	/**
-	 * Reset hand status, clear history
-	 */
-	void HandReset()
-	{
-		UpdateStatus( NICS_STANDBY );
-		m_aTrackList.clear();
+		m_qButtons.hide();
 	}
 
 	/**
-	 * Update current hand point information
+	 * Copy the state of hand control to graphics items
 	 */
-	void UpdateHandPoint( const QPointF& rPt2D, const QVector3D& rPt3D );
-
-	/**
-	 * Set the hand as lost
-	 */
-	void HandLost()
-	{
-		UpdateStatus( NICS_NO_HAND );
-	}
+	void OnHandControlUpdate( const CHandControl& rControl );
 
 	/**
 	 * Set the region of this widget
@@ -171,83 +147,10 @@ public:
 		return m_qRect;
 	}
 
-private:
-	typedef	boost::chrono::system_clock::time_point TTimePoint;
-
-	enum EControlStatus
-	{
-		NICS_NO_HAND,
-		NICS_STANDBY,
-		NICS_FIXING,
-		NICS_FIXED,
-		NICS_INPUT,
-	};
-
-	/**
-	 * Structure to save required data at each yime point
-	 */
-	struct SHandPos
-	{
-		TTimePoint	tpTime;
-		QPointF		mPos2D;
-		QVector3D	mPos3D;
-
-		SHandPos(){}
-
-		SHandPos( const QPointF& pos2D, const QVector3D& pos3D )
-		{
-			tpTime = boost::chrono::system_clock::now();
-			mPos2D = pos2D;
-			mPos3D = pos3D;
-		}
-	};
-
-private:
-	template<typename _TDuration>
-	bool Is2DPosFixFor( const _TDuration& rDuration, float fMoveRange = 10 )
-	{
-		if( m_aTrackList.size() < 2 )
-			return false;
-
-		auto itStartPt = m_aTrackList.rbegin();
-		auto itPt = itStartPt + 1;
-		for( ; itPt != m_aTrackList.rend(); ++ itPt )
-		{
-			// check position
-			if( QLineF( itStartPt->mPos2D, itPt->mPos2D ).length() > fMoveRange )
-				return false;
-
-			// check time
-			if( itStartPt->tpTime - itPt->tpTime > rDuration )
-				return true;
-		}
-		return false;
-	}
-
-	bool UpdateStatus( const EControlStatus& eStatus );
-
-	const SHandPos& CurrentPos() const
-	{
-		return m_aTrackList.back();
-	}
-
-	void BuildButtons();
-
-	template<typename _TD1, typename _TD2>
-	float ComputeProgress( const _TD1& time1, const _TD2& time2 )
-	{
-		return float(boost::chrono::duration_cast<_TD2>( time1 ).count()) / time2.count();
-	}
-
 private:
 	QHandIcon			m_HandIcon;
 	QGraphicsItemGroup	m_qButtons;
 	QRectF				m_qRect;
-	EControlStatus		m_eControlStatus;
-
-	SHandPos	m_FixPos;
-	boost::circular_buffer<SHandPos>	m_aTrackList;
-	std::vector<QBaseProgressButton*>	m_vButtons;
-	std::vector<QBaseProgressButton*>::iterator	m_itCurrentButton;
-	TTimePoint		m_tpFirstIn;
+	std::vector<QProgressButton*>	m_vButtons;	/**< Owned by m_qButtons */
+	unsigned int		m_uLayoutVersion;		/**< Of the hand control m_vButtons are created for */
 };
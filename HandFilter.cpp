@@ -0,0 +1,136 @@
+#include "HandFilter.h"
+
+// STL Header
+#include <cmath>
+
+/**
+ * Smoothing factor of a first order low pass filter
+ */
+static float Alpha( float fCutoff, float fDelta )
+{
+	float fTau = 1.0f / ( 2 * 3.14159265f * fCutoff );
+	return 1.0f / ( 1.0f + fTau / fDelta );
+}
+
+#pragma region CLagMeter
+void CHandFilter::CLagMeter::Add( double dDiffX, double dDiffY, double dVelocityX, double dVelocityY )
+{
+	// only a moving hand tells the lag, about the last 2 seconds at 30 fps
+	double dSpeed = dVelocityX * dVelocityX + dVelocityY * dVelocityY;
+	if( dSpeed < 100 * 100 )
+		return;
+
+	m_dShift	= m_dShift * 0.98 + dDiffX * dVelocityX + dDiffY * dVelocityY;
+	m_dSpeed	= m_dSpeed * 0.98 + dSpeed;
+}
+
+boost::chrono::microseconds CHandFilter::CLagMeter::Get() const
+{
+	if( m_dSpeed <= 0 )
+		return boost::chrono::microseconds::zero();
+	return boost::chrono::microseconds( int64_t( m_dShift / m_dSpeed * 1e6 ) );
+}
+#pragma endregion
+
+#pragma region CHandFilter
+CHandFilter::CHandFilter()
+{
+	m_eType				= HF_NONE;
+	m_fMinCutoff		= 1.0f;
+	m_fBeta				= 0.007f;
+	m_fDerivateCutoff	= 1.0f;
+	m_fProcessNoise		= 5000.0f;
+	m_fMeasureNoise		= 4.0f;
+
+	Reset();
+}
+
+void CHandFilter::Reset()
+{
+	m_bValid	= false;
+	m_iTime		= 0;
+}
+
+void CHandFilter::Filter( QPointF& rPt2D, QVector3D& rPt3D, boost::chrono::microseconds tdTime, boost::chrono::microseconds tdLead )
+{
+	if( m_eType == HF_NONE )
+		return;
+
+	float aValue[AXIS_COUNT] = { float( rPt2D.x() ), float( rPt2D.y() ), rPt3D.x(), rPt3D.y(), rPt3D.z() };
+
+	// start again after the hand was missed for a while
+	float fDelta = ( tdTime.count() - m_iTime ) / 1e6f;
+	if( !m_bValid || fDelta > 0.5f || fDelta < 0 )
+	{
+		for( int i = 0; i < AXIS_COUNT; ++ i )
+		{
+			SAxis& rAxis = m_aAxis[i];
+			rAxis.fValue			= aValue[i];
+			rAxis.fVelocity			= 0;
+			rAxis.aCovariance[0]	= m_fMeasureNoise;
+			rAxis.aCovariance[1]	= 0;
+			rAxis.aCovariance[2]	= m_fProcessNoise;
+		}
+		m_bValid	= true;
+		m_iTime		= tdTime.count();
+		return;
+	}
+
+	// the same frame again only moves forward
+	if( fDelta > 0 )
+	{
+		for( int i = 0; i < AXIS_COUNT; ++ i )
+		{
+			if( m_eType == HF_KALMAN )
+				FilterKalman( m_aAxis[i], aValue[i], fDelta );
+			else
+				FilterOneEuro( m_aAxis[i], aValue[i], fDelta );
+		}
+		m_iTime = tdTime.count();
+	}
+
+	float fLead = tdLead.count() / 1e6f;
+	float aOutput[AXIS_COUNT];
+	for( int i = 0; i < AXIS_COUNT; ++ i )
+		aOutput[i] = m_aAxis[i].fValue + m_aAxis[i].fVelocity * fLead;
+
+	const SAxis &rX = m_aAxis[0], &rY = m_aAxis[1];
+	m_SmoothedLag.Add( aValue[0] - rX.fValue, aValue[1] - rY.fValue, rX.fVelocity, rY.fVelocity );
+	m_PredictedLag.Add( aValue[0] - aOutput[0], aValue[1] - aOutput[1], rX.fVelocity, rY.fVelocity );
+
+	rPt2D = QPointF( aOutput[0], aOutput[1] );
+	rPt3D = QVector3D( aOutput[2], aOutput[3], aOutput[4] );
+}
+
+void CHandFilter::FilterOneEuro( SAxis& rAxis, float fValue, float fDelta )
+{
+	float fVelocity = ( fValue - rAxis.fValue ) / fDelta;
+	rAxis.fVelocity += Alpha( m_fDerivateCutoff, fDelta ) * ( fVelocity - rAxis.fVelocity );
+
+	float fCutoff = m_fMinCutoff + m_fBeta * std::fabs( rAxis.fVelocity );
+	rAxis.fValue += Alpha( fCutoff, fDelta ) * ( fValue - rAxis.fValue );
+}
+
+void CHandFilter::FilterKalman( SAxis& rAxis, float fValue, float fDelta )
+{
+	float* P = rAxis.aCovariance;
+
+	// predict by constant velocity, with white noise acceleration
+	float fDelta2 = fDelta * fDelta;
+	rAxis.fValue += rAxis.fVelocity * fDelta;
+	P[0] += fDelta * ( 2 * P[1] + fDelta * P[2] ) + m_fProcessNoise * fDelta2 * fDelta / 3;
+	P[1] += fDelta * P[2] + m_fProcessNoise * fDelta2 / 2;
+	P[2] += m_fProcessNoise * fDelta;
+
+	// update by the measured position
+	float fInnovation	= fValue - rAxis.fValue;
+	float fS			= P[0] + m_fMeasureNoise;
+	float fGain0		= P[0] / fS,
+		  fGain1		= P[1] / fS;
+	rAxis.fValue	+= fGain0 * fInnovation;
+	rAxis.fVelocity	+= fGain1 * fInnovation;
+	P[2] -= fGain1 * P[1];
+	P[1] -= fGain1 * P[0];
+	P[0] -= fGain0 * P[0];
+}
+#pragma endregion
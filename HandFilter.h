@@ -0,0 +1,110 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <array>
+
+// Boost Header
+#include <boost/chrono.hpp>
+
+// Qt Header
+#include <QtGui/QtGui>
+#pragma endregion
+
+/**
+ * Smooth the hand position and extrapolate it forward, to make up for the latency of sensor,
+ * NiTE smoothing and processing. The 2D and 3D positions are filtered axis by axis.
+ *
+ * The lag of output behind the raw position is measured while the hand moves, by the least
+ * squares time shift along the velocity, for both the smoothed and the extrapolated output.
+ */
+class CHandFilter
+{
+public:
+	enum EType
+	{
+		HF_NONE,			/**< Raw position */
+		HF_ONE_EURO,		/**< One Euro filter, the cutoff frequency rises with speed */
+		HF_KALMAN,			/**< Kalman filter of constant velocity */
+	};
+
+public:
+	EType		m_eType;
+	float		m_fMinCutoff;		/**< One Euro: cutoff frequency at rest (Hz) */
+	float		m_fBeta;			/**< One Euro: increase of cutoff by speed */
+	float		m_fDerivateCutoff;	/**< One Euro: cutoff frequency of speed (Hz) */
+	float		m_fProcessNoise;	/**< Kalman: variance of acceleration per second */
+	float		m_fMeasureNoise;	/**< Kalman: variance of position */
+
+public:
+	CHandFilter();
+
+	/**
+	 * Forget the hand, the next position is used as is. The measured lag is kept.
+	 */
+	void Reset();
+
+	/**
+	 * Filter the position of time tdTime, and move it forward by tdLead along the velocity
+	 */
+	void Filter( QPointF& rPt2D, QVector3D& rPt3D, boost::chrono::microseconds tdTime, boost::chrono::microseconds tdLead );
+
+	/**
+	 * Measured lag of the smoothed output behind the raw position, negative if ahead
+	 */
+	boost::chrono::microseconds GetSmoothedLag() const
+	{
+		return m_SmoothedLag.Get();
+	}
+
+	/**
+	 * Measured lag of the extrapolated output behind the raw position, negative if ahead
+	 */
+	boost::chrono::microseconds GetPredictedLag() const
+	{
+		return m_PredictedLag.Get();
+	}
+
+private:
+	enum
+	{
+		AXIS_COUNT	= 5		/**< x and y of 2D, x, y and z of 3D */
+	};
+
+	/**
+	 * State of one axis
+	 */
+	struct SAxis
+	{
+		float	fValue;
+		float	fVelocity;		/**< Per second */
+		float	aCovariance[3];	/**< Kalman: variance of value, covariance, variance of velocity */
+	};
+
+	/**
+	 * Recent least squares time shift of output, weighted by speed
+	 */
+	class CLagMeter
+	{
+	public:
+		CLagMeter() : m_dShift( 0 ), m_dSpeed( 0 ) {}
+
+		void Add( double dDiffX, double dDiffY, double dVelocityX, double dVelocityY );
+
+		boost::chrono::microseconds Get() const;
+
+	private:
+		double	m_dShift;
+		double	m_dSpeed;
+	};
+
+	void FilterOneEuro( SAxis& rAxis, float fValue, float fDelta );
+	void FilterKalman( SAxis& rAxis, float fValue, float fDelta );
+
+private:
+	std::array<SAxis,AXIS_COUNT>	m_aAxis;
+	bool							m_bValid;		/**< m_aAxis has a position */
+	int64_t							m_iTime;		/**< Microseconds of the last position */
+	CLagMeter						m_SmoothedLag;
+	CLagMeter						m_PredictedLag;
+};
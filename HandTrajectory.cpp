@@ -0,0 +1,98 @@
+#include "HandTrajectory.h"
+
+// STL Header
+#include <algorithm>
+
+CHandTrajectory::CHandTrajectory( unsigned int uCapacity )
+{
+	uint32_t uSize = 2;
+	while( uSize < uCapacity )
+		uSize <<= 1;
+	m_uMask = uSize - 1;
+
+	m_aX.reset( new float[uSize] );
+	m_aY.reset( new float[uSize] );
+	m_aTicks.reset( new int64_t[uSize] );
+	m_qMinX.aIndex.reset( new uint32_t[uSize] );
+	m_qMaxX.aIndex.reset( new uint32_t[uSize] );
+	m_qMinY.aIndex.reset( new uint32_t[uSize] );
+	m_qMaxY.aIndex.reset( new uint32_t[uSize] );
+
+	m_tdWindow = boost::chrono::microseconds::zero();
+	Clear();
+}
+
+void CHandTrajectory::Clear()
+{
+	m_uCount = 0;
+	m_uBegin = 0;
+	m_qMinX.uFront = m_qMinX.uBack = 0;
+	m_qMaxX.uFront = m_qMaxX.uBack = 0;
+	m_qMinY.uFront = m_qMinY.uBack = 0;
+	m_qMaxY.uFront = m_qMaxY.uBack = 0;
+}
+
+void CHandTrajectory::Push( float x, float y, boost::chrono::microseconds tdTime )
+{
+	uint32_t i = m_uCount ++;
+	int64_t iTicks = tdTime.count();
+
+	// the ring keeps the window, the oldest position is overwritten
+	if( m_uCount - m_uBegin > m_uMask + 1 )
+		m_uBegin = m_uCount - ( m_uMask + 1 );
+	m_aX[i & m_uMask]		= x;
+	m_aY[i & m_uMask]		= y;
+	m_aTicks[i & m_uMask]	= iTicks;
+
+	// the window starts from the newest position older than the duration
+	int64_t iLimit = iTicks - m_tdWindow.count();
+	while( m_uBegin != i && m_aTicks[( m_uBegin + 1 ) & m_uMask] < iLimit )
+		++ m_uBegin;
+
+	TrimQueue( m_qMinX );
+	TrimQueue( m_qMaxX );
+	TrimQueue( m_qMinY );
+	TrimQueue( m_qMaxY );
+	PushQueue( m_qMinX, m_aX.get(), i, false );
+	PushQueue( m_qMaxX, m_aX.get(), i, true );
+	PushQueue( m_qMinY, m_aY.get(), i, false );
+	PushQueue( m_qMaxY, m_aY.get(), i, true );
+}
+
+bool CHandTrajectory::IsStill( float fRadius ) const
+{
+	if( m_uCount < 2 )
+		return false;
+
+	// not tracked long enough
+	uint32_t iLast = ( m_uCount - 1 ) & m_uMask;
+	if( m_aTicks[iLast] - m_aTicks[m_uBegin & m_uMask] <= m_tdWindow.count() )
+		return false;
+
+	float	x = m_aX[iLast],
+			y = m_aY[iLast];
+	float	dx = std::max( Front( m_qMaxX, m_aX.get() ) - x, x - Front( m_qMinX, m_aX.get() ) ),
+			dy = std::max( Front( m_qMaxY, m_aY.get() ) - y, y - Front( m_qMinY, m_aY.get() ) );
+	return dx * dx + dy * dy <= fRadius * fRadius;
+}
+
+void CHandTrajectory::PushQueue( SMonotonicQueue& rQueue, const float* aValue, uint32_t i, bool bMax )
+{
+	float fValue = aValue[i & m_uMask];
+	while( rQueue.uBack != rQueue.uFront )
+	{
+		float fBack = aValue[rQueue.aIndex[( rQueue.uBack - 1 ) & m_uMask] & m_uMask];
+		if( bMax ? fBack > fValue : fBack < fValue )
+			break;
+		-- rQueue.uBack;
+	}
+	rQueue.aIndex[rQueue.uBack & m_uMask] = i;
+	++ rQueue.uBack;
+}
+
+void CHandTrajectory::TrimQueue( SMonotonicQueue& rQueue )
+{
+	// indices wrap around, so compare the distance to the newest one
+	while( rQueue.uBack != rQueue.uFront && m_uCount - 1 - rQueue.aIndex[rQueue.uFront & m_uMask] > m_uCount - 1 - m_uBegin )
+		++ rQueue.uFront;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <memory>
+
+// Boost Header
+#include <boost/chrono.hpp>
+#pragma endregion
+
+/**
+ * Recent 2D positions of a hand with time, kept in a fixed ring as structure of arrays.
+ *
+ * The positions of a sliding time window are tracked by monotonic deques of the minimum and
+ * maximum of x and y, so whether the hand stayed still during the window is known in O(1)
+ * amortized time, without walking the history. Nothing is allocated after construction.
+ */
+class CHandTrajectory
+{
+public:
+	/**
+	 * uCapacity is rounded up to a power of 2
+	 */
+	CHandTrajectory( unsigned int uCapacity = 150 );
+
+	/**
+	 * The duration to stay still; the history is cleared if it changes
+	 */
+	template<typename _TDuration>
+	void SetWindow( const _TDuration& rDuration )
+	{
+		boost::chrono::microseconds tdWindow = boost::chrono::duration_cast<boost::chrono::microseconds>( rDuration );
+		if( tdWindow != m_tdWindow )
+		{
+			m_tdWindow = tdWindow;
+			Clear();
+		}
+	}
+
+	void Clear();
+
+	/**
+	 * tdTime is the time since any epoch, not decreasing
+	 */
+	void Push( float x, float y, boost::chrono::microseconds tdTime );
+
+	/**
+	 * True if there is a position older than the window, and all positions since then are
+	 * within fRadius of the latest one. The bounding box of the window is used, so a diagonal
+	 * move is treated as the farthest corner.
+	 */
+	bool IsStill( float fRadius ) const;
+
+	bool IsEmpty() const
+	{
+		return m_uCount == 0;
+	}
+
+private:
+	/**
+	 * Indices of positions in window, with values in monotonic order from front to back
+	 */
+	struct SMonotonicQueue
+	{
+		std::unique_ptr<uint32_t[]>	aIndex;
+		uint32_t					uFront;
+		uint32_t					uBack;
+	};
+
+	/**
+	 * Push index i of aValue, dropping the indices at back which can't be the extreme any more.
+	 * bMax for the maximum, or the minimum.
+	 */
+	void PushQueue( SMonotonicQueue& rQueue, const float* aValue, uint32_t i, bool bMax );
+
+	/**
+	 * Drop the indices at front which are out of window
+	 */
+	void TrimQueue( SMonotonicQueue& rQueue );
+
+	float Front( const SMonotonicQueue& rQueue, const float* aValue ) const
+	{
+		return aValue[rQueue.aIndex[rQueue.uFront & m_uMask] & m_uMask];
+	}
+
+private:
+	uint32_t					m_uMask;		/**< Capacity - 1 */
+	std::unique_ptr<float[]>	m_aX;
+	std::unique_ptr<float[]>	m_aY;
+	std::unique_ptr<int64_t[]>	m_aTicks;		/**< Time in microseconds */
+	uint32_t					m_uCount;		/**< Positions pushed since cleared, the index of next one */
+	uint32_t					m_uBegin;		/**< Index of the oldest position in window */
+	boost::chrono::microseconds	m_tdWindow;
+
+	SMonotonicQueue				m_qMinX;
+	SMonotonicQueue				m_qMaxX;
+	SMonotonicQueue				m_qMinY;
+	SMonotonicQueue				m_qMaxY;
+};
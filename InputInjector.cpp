@@ -0,0 +1,489 @@
+#include "InputInjector.h"
+
+// STL Header
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Boost Header
+#include <boost/chrono.hpp>
+
+// Application header
+#include "Metrics.h"
+#include "Trace.h"
+
+#ifdef _WIN32
+// windows header
+#include <Windows.h>
+#endif
+
+#ifdef __linux__
+// linux header
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#endif
+
+#ifdef NIC_XTEST
+// X11 header
+#include <X11/Xlib.h>
+#include <X11/XF86keysym.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#endif
+
+#pragma region Backends
+#ifdef _WIN32
+/**
+ * SendInput() of Windows, takes virtual-key codes as is
+ */
+class CWin32InputBackend : public IInputBackend
+{
+public:
+	const char* GetName() const
+	{
+		return "win32";
+	}
+
+	bool Open()
+	{
+		return true;
+	}
+
+	void Send( const SInputEvent& rEvent )
+	{
+		INPUT mWinEvent;
+		memset( &mWinEvent, 0, sizeof( mWinEvent ) );
+		if( rEvent.eType == SInputEvent::IE_MOUSE_MOVE )
+		{
+			mWinEvent.type			= INPUT_MOUSE;
+			mWinEvent.mi.dx			= rEvent.iX;
+			mWinEvent.mi.dy			= rEvent.iY;
+			mWinEvent.mi.dwFlags	= MOUSEEVENTF_MOVE;
+		}
+		else
+		{
+			mWinEvent.type			= INPUT_KEYBOARD;
+			mWinEvent.ki.wVk		= rEvent.uKey;
+			mWinEvent.ki.dwFlags	= ( rEvent.eType == SInputEvent::IE_KEY_UP ? KEYEVENTF_KEYUP : 0 );
+		}
+		SendInput( 1, &mWinEvent, sizeof( mWinEvent ) );
+	}
+};
+#endif
+
+#ifdef __linux__
+/**
+ * Virtual-key code of Windows to key code of Linux input
+ */
+static const struct
+{
+	unsigned short	uVK;
+	unsigned short	uCode;
+} s_aLinuxKey[] = {
+	{ 0x08, KEY_BACKSPACE },	{ 0x09, KEY_TAB },			{ 0x0D, KEY_ENTER },		{ 0x10, KEY_LEFTSHIFT },
+	{ 0x11, KEY_LEFTCTRL },		{ 0x12, KEY_LEFTALT },		{ 0x1B, KEY_ESC },			{ 0x20, KEY_SPACE },
+	{ 0x21, KEY_PAGEUP },		{ 0x22, KEY_PAGEDOWN },		{ 0x23, KEY_END },			{ 0x24, KEY_HOME },
+	{ 0x25, KEY_LEFT },			{ 0x26, KEY_UP },			{ 0x27, KEY_RIGHT },		{ 0x28, KEY_DOWN },
+	{ 0x30, KEY_0 },	{ 0x31, KEY_1 },	{ 0x32, KEY_2 },	{ 0x33, KEY_3 },	{ 0x34, KEY_4 },
+	{ 0x35, KEY_5 },	{ 0x36, KEY_6 },	{ 0x37, KEY_7 },	{ 0x38, KEY_8 },	{ 0x39, KEY_9 },
+	{ 'A', KEY_A },	{ 'B', KEY_B },	{ 'C', KEY_C },	{ 'D', KEY_D },	{ 'E', KEY_E },	{ 'F', KEY_F },	{ 'G', KEY_G },
+	{ 'H', KEY_H },	{ 'I', KEY_I },	{ 'J', KEY_J },	{ 'K', KEY_K },	{ 'L', KEY_L },	{ 'M', KEY_M },	{ 'N', KEY_N },
+	{ 'O', KEY_O },	{ 'P', KEY_P },	{ 'Q', KEY_Q },	{ 'R', KEY_R },	{ 'S', KEY_S },	{ 'T', KEY_T },	{ 'U', KEY_U },
+	{ 'V', KEY_V },	{ 'W', KEY_W },	{ 'X', KEY_X },	{ 'Y', KEY_Y },	{ 'Z', KEY_Z },
+	{ 0x70, KEY_F1 },	{ 0x71, KEY_F2 },	{ 0x72, KEY_F3 },	{ 0x73, KEY_F4 },	{ 0x74, KEY_F5 },	{ 0x75, KEY_F6 },
+	{ 0x76, KEY_F7 },	{ 0x77, KEY_F8 },	{ 0x78, KEY_F9 },	{ 0x79, KEY_F10 },	{ 0x7A, KEY_F11 },	{ 0x7B, KEY_F12 },
+	{ 0xAD, KEY_MUTE },			{ 0xAE, KEY_VOLUMEDOWN },	{ 0xAF, KEY_VOLUMEUP },
+	{ 0xB0, KEY_NEXTSONG },		{ 0xB1, KEY_PREVIOUSSONG },	{ 0xB3, KEY_PLAYPAUSE },
+};
+
+/**
+ * Virtual keyboard and mouse of /dev/uinput, seen by X, Wayland and console alike
+ */
+class CUInputBackend : public IInputBackend
+{
+public:
+	CUInputBackend() : m_iDevice( -1 )
+	{
+	}
+
+	~CUInputBackend()
+	{
+		if( m_iDevice >= 0 )
+		{
+			ioctl( m_iDevice, UI_DEV_DESTROY );
+			close( m_iDevice );
+		}
+	}
+
+	const char* GetName() const
+	{
+		return "uinput";
+	}
+
+	bool Open()
+	{
+		m_iDevice = open( "/dev/uinput", O_WRONLY | O_NONBLOCK );
+		if( m_iDevice < 0 )
+			return false;
+
+		ioctl( m_iDevice, UI_SET_EVBIT, EV_KEY );
+		ioctl( m_iDevice, UI_SET_EVBIT, EV_REL );
+		ioctl( m_iDevice, UI_SET_EVBIT, EV_SYN );
+		ioctl( m_iDevice, UI_SET_RELBIT, REL_X );
+		ioctl( m_iDevice, UI_SET_RELBIT, REL_Y );
+		ioctl( m_iDevice, UI_SET_KEYBIT, BTN_LEFT );
+		for( size_t i = 0; i < sizeof( s_aLinuxKey ) / sizeof( s_aLinuxKey[0] ); ++ i )
+			ioctl( m_iDevice, UI_SET_KEYBIT, s_aLinuxKey[i].uCode );
+
+		struct uinput_user_dev mDevice;
+		memset( &mDevice, 0, sizeof( mDevice ) );
+		strncpy( mDevice.name, "NIController", UINPUT_MAX_NAME_SIZE - 1 );
+		mDevice.id.bustype = BUS_VIRTUAL;
+		if( write( m_iDevice, &mDevice, sizeof( mDevice ) ) != sizeof( mDevice ) || ioctl( m_iDevice, UI_DEV_CREATE ) < 0 )
+		{
+			close( m_iDevice );
+			m_iDevice = -1;
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Each event is a report of its own, so a press and release sent together are not folded
+	 * into one state change by the reader
+	 */
+	void Send( const SInputEvent& rEvent )
+	{
+		if( rEvent.eType == SInputEvent::IE_MOUSE_MOVE )
+		{
+			Write( EV_REL, REL_X, rEvent.iX );
+			Write( EV_REL, REL_Y, rEvent.iY );
+			Write( EV_SYN, SYN_REPORT, 0 );
+			return;
+		}
+
+		for( size_t i = 0; i < sizeof( s_aLinuxKey ) / sizeof( s_aLinuxKey[0] ); ++ i )
+		{
+			if( s_aLinuxKey[i].uVK == rEvent.uKey )
+			{
+				Write( EV_KEY, s_aLinuxKey[i].uCode, rEvent.eType == SInputEvent::IE_KEY_DOWN ? 1 : 0 );
+				Write( EV_SYN, SYN_REPORT, 0 );
+				return;
+			}
+		}
+	}
+
+private:
+	void Write( unsigned short uType, unsigned short uCode, int iValue )
+	{
+		struct input_event mEvent;
+		memset( &mEvent, 0, sizeof( mEvent ) );
+		mEvent.type		= uType;
+		mEvent.code		= uCode;
+		mEvent.value	= iValue;
+		if( write( m_iDevice, &mEvent, sizeof( mEvent ) ) != sizeof( mEvent ) )
+			std::cerr << "Can't write uinput event" << std::endl;
+	}
+
+private:
+	int		m_iDevice;
+};
+#endif
+
+#ifdef NIC_XTEST
+/**
+ * XTest extension of the X server of $DISPLAY, works under Xvfb
+ */
+class CXTestBackend : public IInputBackend
+{
+public:
+	CXTestBackend() : m_pDisplay( NULL )
+	{
+	}
+
+	~CXTestBackend()
+	{
+		if( m_pDisplay != NULL )
+			XCloseDisplay( m_pDisplay );
+	}
+
+	const char* GetName() const
+	{
+		return "xtest";
+	}
+
+	bool Open()
+	{
+		int iEvent, iError, iMajor, iMinor;
+		m_pDisplay = XOpenDisplay( NULL );
+		return m_pDisplay != NULL && XTestQueryExtension( m_pDisplay, &iEvent, &iError, &iMajor, &iMinor );
+	}
+
+	void Send( const SInputEvent& rEvent )
+	{
+		if( rEvent.eType == SInputEvent::IE_MOUSE_MOVE )
+		{
+			XTestFakeRelativeMotionEvent( m_pDisplay, rEvent.iX, rEvent.iY, CurrentTime );
+			return;
+		}
+
+		KeySym uSym = ToKeySym( rEvent.uKey );
+		KeyCode uCode = ( uSym != NoSymbol ? XKeysymToKeycode( m_pDisplay, uSym ) : 0 );
+		if( uCode != 0 )
+			XTestFakeKeyEvent( m_pDisplay, uCode, rEvent.eType == SInputEvent::IE_KEY_DOWN, CurrentTime );
+	}
+
+	void Flush()
+	{
+		XFlush( m_pDisplay );
+	}
+
+private:
+	static KeySym ToKeySym( unsigned short uKey )
+	{
+		if( uKey >= 'A' && uKey <= 'Z' )
+			return XK_a + ( uKey - 'A' );
+		if( uKey >= '0' && uKey <= '9' )
+			return XK_0 + ( uKey - '0' );
+		if( uKey >= 0x70 && uKey <= 0x7B )
+			return XK_F1 + ( uKey - 0x70 );
+
+		switch( uKey )
+		{
+		case 0x08:	return XK_BackSpace;
+		case 0x09:	return XK_Tab;
+		case 0x0D:	return XK_Return;
+		case 0x10:	return XK_Shift_L;
+		case 0x11:	return XK_Control_L;
+		case 0x12:	return XK_Alt_L;
+		case 0x1B:	return XK_Escape;
+		case 0x20:	return XK_space;
+		case 0x21:	return XK_Prior;
+		case 0x22:	return XK_Next;
+		case 0x23:	return XK_End;
+		case 0x24:	return XK_Home;
+		case 0x25:	return XK_Left;
+		case 0x26:	return XK_Up;
+		case 0x27:	return XK_Right;
+		case 0x28:	return XK_Down;
+		case 0xAD:	return XF86XK_AudioMute;
+		case 0xAE:	return XF86XK_AudioLowerVolume;
+		case 0xAF:	return XF86XK_AudioRaiseVolume;
+		case 0xB0:	return XF86XK_AudioNext;
+		case 0xB1:	return XF86XK_AudioPrev;
+		case 0xB3:	return XF86XK_AudioPlay;
+		}
+		return NoSymbol;
+	}
+
+private:
+	Display*	m_pDisplay;
+};
+#endif
+#pragma endregion
+
+#pragma region CInputInjector
+CInputInjector::CInputInjector() : m_uDropped( 0 ), m_bRunning( false ), m_bWaiting( false )
+{
+	m_pMetrics	= NULL;
+	m_bStop		= false;
+}
+
+CInputInjector::~CInputInjector()
+{
+	Stop();
+}
+
+CInputInjector::EBackend CInputInjector::ParseBackend( const char* szName )
+{
+	std::string sName = szName;
+	if( sName == "win32" )
+		return IB_WIN32;
+	if( sName == "uinput" )
+		return IB_UINPUT;
+	if( sName == "xtest" )
+		return IB_XTEST;
+	if( sName == "null" )
+		return IB_NULL;
+	return IB_AUTO;
+}
+
+bool CInputInjector::Start( EBackend eBackend )
+{
+	Stop();
+	m_pBackend.reset();
+
+	// try the backends of this system in order
+	static const EBackend s_aAuto[] = { IB_WIN32, IB_UINPUT, IB_XTEST, IB_NULL };
+	const EBackend* pFirst = s_aAuto;
+	const EBackend* pLast = s_aAuto + sizeof( s_aAuto ) / sizeof( s_aAuto[0] );
+	if( eBackend != IB_AUTO )
+	{
+		pFirst	= std::find( pFirst, pLast, eBackend );
+		pLast	= pFirst + 1;
+	}
+
+	for( const EBackend* pType = pFirst; pType != pLast && !m_pBackend; ++ pType )
+	{
+		std::unique_ptr<IInputBackend> pBackend;
+		switch( *pType )
+		{
+#ifdef _WIN32
+		case IB_WIN32:
+			pBackend.reset( new CWin32InputBackend() );
+			break;
+#endif
+#ifdef __linux__
+		case IB_UINPUT:
+			pBackend.reset( new CUInputBackend() );
+			break;
+#endif
+#ifdef NIC_XTEST
+		case IB_XTEST:
+			pBackend.reset( new CXTestBackend() );
+			break;
+#endif
+		case IB_NULL:
+			pBackend.reset( new CRecordInputBackend() );
+			break;
+
+		default:
+			break;
+		}
+
+		if( pBackend && pBackend->Open() )
+			m_pBackend = std::move( pBackend );
+	}
+
+	if( !m_pBackend )
+	{
+		std::cerr << "Can't open input backend" << std::endl;
+		return false;
+	}
+	std::cout << "Input backend: " << m_pBackend->GetName() << std::endl;
+
+	m_bStop		= false;
+	m_tInject	= boost::thread( &CInputInjector::InjectLoop, this );
+	m_bRunning.store( true );
+	return true;
+}
+
+void CInputInjector::Stop()
+{
+	if( m_tInject.joinable() )
+	{
+		m_bRunning.store( false );
+		{
+			boost::lock_guard<boost::mutex> lock( m_mtxWait );
+			m_bStop = true;
+		}
+		m_cvWait.notify_one();
+		m_tInject.join();
+	}
+}
+
+bool CInputInjector::PressChord( const unsigned short* aKeys, int iCount )
+{
+	bool bOK = true;
+	for( int i = 0; i < iCount; ++ i )
+		bOK = KeyDown( aKeys[i] ) && bOK;
+	for( int i = iCount - 1; i >= 0; -- i )
+		bOK = KeyUp( aKeys[i] ) && bOK;
+	return bOK;
+}
+
+int64_t CInputInjector::Now()
+{
+	return boost::chrono::duration_cast<boost::chrono::microseconds>( boost::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+bool CInputInjector::Push( SInputEvent::EType eType, unsigned short uKey, int iX, int iY )
+{
+	SInputEvent mEvent;
+	mEvent.eType		= eType;
+	mEvent.uKey			= uKey;
+	mEvent.iX			= iX;
+	mEvent.iY			= iY;
+	mEvent.iQueueTime	= Now();
+	mEvent.iInjectTime	= 0;
+	bool bQueued = m_qEvents.bounded_push( mEvent );
+
+	// a dropped release would leave the key held, so wait for the injector to make room
+	while( !bQueued && eType == SInputEvent::IE_KEY_UP && m_bRunning.load() )
+	{
+		boost::this_thread::yield();
+		bQueued = m_qEvents.bounded_push( mEvent );
+	}
+	if( !bQueued )
+	{
+		m_uDropped.fetch_add( 1, boost::memory_order_relaxed );
+		if( m_pMetrics != NULL )
+			m_pMetrics->AddDroppedInput();
+		return false;
+	}
+
+	// only lock if the thread may be sleeping
+	if( m_bWaiting.exchange( false ) )
+	{
+		boost::lock_guard<boost::mutex> lock( m_mtxWait );
+		m_cvWait.notify_one();
+	}
+	return true;
+}
+
+void CInputInjector::Inject( SInputEvent& rEvent )
+{
+	NIC_TRACE_SCOPE( "InjectInput" );
+	rEvent.iInjectTime = Now();
+	m_pBackend->Send( rEvent );
+	if( m_pMetrics != NULL )
+		m_pMetrics->AddInjectLatency( boost::chrono::microseconds( rEvent.iInjectTime - rEvent.iQueueTime ) );
+}
+
+void CInputInjector::InjectLoop()
+{
+	Trace::SetThreadName( "Input injector" );
+	SInputEvent mEvent;
+	bool bHave = false;
+	while( true )
+	{
+		if( !bHave )
+			bHave = m_qEvents.pop( mEvent );
+		if( bHave )
+		{
+			do
+			{
+				Inject( mEvent );
+			}
+			while( m_qEvents.pop( mEvent ) );
+			m_pBackend->Flush();
+		}
+
+		// producers notify after they see m_bWaiting, so an event queued after the last pop wakes the thread
+		boost::unique_lock<boost::mutex> lock( m_mtxWait );
+		if( m_bStop )
+		{
+			// events queued after the last pop are still injected
+			lock.unlock();
+			if( m_qEvents.pop( mEvent ) )
+			{
+				do
+				{
+					Inject( mEvent );
+				}
+				while( m_qEvents.pop( mEvent ) );
+				m_pBackend->Flush();
+			}
+			break;
+		}
+		m_bWaiting.store( true );
+		bHave = m_qEvents.pop( mEvent );
+		if( !bHave )
+			m_cvWait.wait( lock );
+		m_bWaiting.store( false );
+	}
+}
+#pragma endregion
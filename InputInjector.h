@@ -0,0 +1,211 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread.hpp>
+#pragma endregion
+
+class CMetrics;
+
+/**
+ * A keyboard or mouse event to inject; keys are virtual-key codes of Windows on all systems
+ */
+struct SInputEvent
+{
+	enum EType
+	{
+		IE_KEY_DOWN,
+		IE_KEY_UP,
+		IE_MOUSE_MOVE,		/**< Relative motion by iX, iY */
+	};
+
+	EType			eType;
+	unsigned short	uKey;
+	int				iX;
+	int				iY;
+	int64_t			iQueueTime;		/**< Steady clock microseconds when queued */
+	int64_t			iInjectTime;	/**< Steady clock microseconds when given to the system */
+};
+
+/**
+ * System interface to inject events, only used by the injector thread
+ */
+class IInputBackend
+{
+public:
+	virtual ~IInputBackend()
+	{
+	}
+
+	virtual const char* GetName() const = 0;
+
+	/**
+	 * Open the device, return false if it can't be used on this system
+	 */
+	virtual bool Open() = 0;
+
+	virtual void Send( const SInputEvent& rEvent ) = 0;
+
+	/**
+	 * Called after a batch of events is sent
+	 */
+	virtual void Flush()
+	{
+	}
+};
+
+/**
+ * Keeps the injected events instead of sending them, for tests and benchmark
+ */
+class CRecordInputBackend : public IInputBackend
+{
+public:
+	const char* GetName() const
+	{
+		return "null";
+	}
+
+	bool Open()
+	{
+		return true;
+	}
+
+	void Send( const SInputEvent& rEvent )
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_aEvents.push_back( rEvent );
+	}
+
+	/**
+	 * Copy of the events sent so far
+	 */
+	std::vector<SInputEvent> GetEvents() const
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		return m_aEvents;
+	}
+
+private:
+	mutable boost::mutex		m_Mutex;
+	std::vector<SInputEvent>	m_aEvents;
+};
+
+/**
+ * Inject keyboard and mouse events from a dedicated thread.
+ *
+ * Events are put into a fixed lock-free queue by any thread and never wait for the system;
+ * the injector thread sleeps until an event is queued. If the queue is full the event is
+ * dropped, except a key release, which waits for room so no key is left held. Each event is
+ * time-stamped when queued and when injected, and the delay between them is added to
+ * metrics, so with the key latency of hand control it gives the time from the hand starting
+ * to move to the key reaching the system.
+ */
+class CInputInjector
+{
+public:
+	enum EBackend
+	{
+		IB_AUTO,		/**< Win32 on Windows, else uinput, else XTest, else null */
+		IB_WIN32,		/**< SendInput() */
+		IB_UINPUT,		/**< Linux /dev/uinput virtual device, needs write permission */
+		IB_XTEST,		/**< XTest extension of X server, if built with NIC_XTEST */
+		IB_NULL,		/**< CRecordInputBackend */
+	};
+
+public:
+	CMetrics*	m_pMetrics;		/**< Injection delay; can be NULL */
+
+public:
+	CInputInjector();
+	~CInputInjector();
+
+	/**
+	 * Open a backend and start the thread, return false if the backend can't be used
+	 */
+	bool Start( EBackend eBackend = IB_AUTO );
+
+	/**
+	 * Inject the queued events and stop the thread; the backend is kept until next Start()
+	 */
+	void Stop();
+
+	/**
+	 * Parse auto, win32, uinput, xtest or null
+	 */
+	static EBackend ParseBackend( const char* szName );
+
+	/**
+	 * The backend of last Start(), NULL if not started
+	 */
+	IInputBackend* GetBackend() const
+	{
+		return m_pBackend.get();
+	}
+
+	#pragma region Queue events, called by any thread
+	bool KeyDown( unsigned short uKey )
+	{
+		return Push( SInputEvent::IE_KEY_DOWN, uKey, 0, 0 );
+	}
+
+	bool KeyUp( unsigned short uKey )
+	{
+		return Push( SInputEvent::IE_KEY_UP, uKey, 0, 0 );
+	}
+
+	/**
+	 * Press and release a key
+	 */
+	bool PressKey( unsigned short uKey )
+	{
+		return KeyDown( uKey ) && KeyUp( uKey );
+	}
+
+	/**
+	 * Press the keys in order and release them in reverse order, as CONTROL + C
+	 */
+	bool PressChord( const unsigned short* aKeys, int iCount );
+
+	bool MoveMouse( int iX, int iY )
+	{
+		return Push( SInputEvent::IE_MOUSE_MOVE, 0, iX, iY );
+	}
+	#pragma endregion
+
+	uint64_t GetDropped() const
+	{
+		return m_uDropped.load( boost::memory_order_relaxed );
+	}
+
+private:
+	enum
+	{
+		QUEUE_SIZE	= 256
+	};
+
+	bool Push( SInputEvent::EType eType, unsigned short uKey, int iX, int iY );
+
+	void Inject( SInputEvent& rEvent );
+
+	void InjectLoop();
+
+	static int64_t Now();
+
+private:
+	std::unique_ptr<IInputBackend>	m_pBackend;
+	boost::lockfree::queue<SInputEvent, boost::lockfree::capacity<QUEUE_SIZE>>	m_qEvents;
+	boost::atomic<uint64_t>			m_uDropped;
+
+	boost::thread					m_tInject;
+	boost::atomic<bool>				m_bRunning;		/**< Key releases wait for room only while the thread runs */
+	boost::mutex					m_mtxWait;
+	boost::condition_variable		m_cvWait;
+	boost::atomic<bool>				m_bWaiting;		/**< The thread may sleep, producers must notify */
+	bool							m_bStop;		/**< Guarded by m_mtxWait */
+};
@@ -0,0 +1,408 @@
+// Asio should be included before Windows.h, which may come with other headers
+#include <boost/asio.hpp>
+
+#include "Metrics.h"
+
+// STL Header
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Boost Header
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+
+static const char* s_aStageName[CMetrics::MS_COUNT] = { "update", "select_user", "colorize", "transform", "hand" };
+
+// same order as QHandControl::EControlStatus
+static const char* s_aStatusName[CMetrics::STATUS_COUNT] = { "no_hand", "standby", "fixing", "fixed", "input" };
+
+#pragma region CLatencyHistogram
+CLatencyHistogram::CLatencyHistogram() : m_uCount( 0 ), m_uSum( 0 )
+{
+	for( auto itBucket = m_aBuckets.begin(); itBucket != m_aBuckets.end(); ++ itBucket )
+		itBucket->store( 0, boost::memory_order_relaxed );
+}
+
+int CLatencyHistogram::BucketIndex( uint64_t uValue )
+{
+	if( uValue < 4 )
+		return int( uValue );
+
+	int iOctave = 2;
+	while( uValue >> ( iOctave + 1 ) )
+		++ iOctave;
+
+	int iIndex = 4 * ( iOctave - 1 ) + int( ( uValue >> ( iOctave - 2 ) ) & 3 );
+	return std::min( iIndex, int( BUCKETS ) - 1 );
+}
+
+uint64_t CLatencyHistogram::BucketLower( int iIndex )
+{
+	if( iIndex < 4 )
+		return iIndex;
+	return uint64_t( 4 + iIndex % 4 ) << ( iIndex / 4 - 1 );
+}
+
+void CLatencyHistogram::Add( uint64_t uMicroseconds )
+{
+	m_aBuckets[BucketIndex( uMicroseconds )].fetch_add( 1, boost::memory_order_relaxed );
+	m_uSum.fetch_add( uMicroseconds, boost::memory_order_relaxed );
+	m_uCount.fetch_add( 1, boost::memory_order_relaxed );
+}
+
+double CLatencyHistogram::GetQuantile( double dQuantile ) const
+{
+	// take a copy, the buckets may change while reading
+	std::array<uint64_t,BUCKETS> aBuckets;
+	uint64_t uTotal = 0;
+	for( int i = 0; i < BUCKETS; ++ i )
+	{
+		aBuckets[i] = m_aBuckets[i].load( boost::memory_order_relaxed );
+		uTotal += aBuckets[i];
+	}
+	if( uTotal == 0 )
+		return 0;
+
+	// interpolate linearly inside the bucket
+	double dRank = std::min( std::max( dQuantile, 0.0 ), 1.0 ) * uTotal;
+	uint64_t uBelow = 0;
+	for( int i = 0; i < BUCKETS; ++ i )
+	{
+		if( aBuckets[i] > 0 && uBelow + aBuckets[i] >= dRank )
+		{
+			double dLower = double( BucketLower( i ) ), dUpper = double( BucketLower( i + 1 ) );
+			return dLower + ( dUpper - dLower ) * ( dRank - uBelow ) / aBuckets[i];
+		}
+		uBelow += aBuckets[i];
+	}
+	return double( BucketLower( BUCKETS ) );
+}
+#pragma endregion
+
+#pragma region CRateMeter
+static int64_t CurrentSecond()
+{
+	return boost::chrono::duration_cast<boost::chrono::seconds>( boost::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+CRateMeter::CRateMeter() : m_uTotal( 0 )
+{
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+	{
+		itSlot->iSecond.store( -1, boost::memory_order_relaxed );
+		itSlot->uCount.store( 0, boost::memory_order_relaxed );
+	}
+}
+
+void CRateMeter::Add()
+{
+	int64_t iSecond = CurrentSecond();
+	SSlot& rSlot = m_aSlots[iSecond % SLOTS];
+	if( rSlot.iSecond.load( boost::memory_order_relaxed ) != iSecond )
+	{
+		// reuse the slot of SLOTS seconds ago
+		rSlot.uCount.store( 0, boost::memory_order_relaxed );
+		rSlot.iSecond.store( iSecond, boost::memory_order_release );
+	}
+	rSlot.uCount.fetch_add( 1, boost::memory_order_relaxed );
+	m_uTotal.fetch_add( 1, boost::memory_order_relaxed );
+}
+
+double CRateMeter::GetRate() const
+{
+	int64_t iSecond = CurrentSecond();
+	uint64_t uCount = 0;
+	for( auto itSlot = m_aSlots.begin(); itSlot != m_aSlots.end(); ++ itSlot )
+	{
+		int64_t iSlotSecond = itSlot->iSecond.load( boost::memory_order_acquire );
+		if( iSlotSecond >= iSecond - WINDOW && iSlotSecond < iSecond )
+			uCount += itSlot->uCount.load( boost::memory_order_relaxed );
+	}
+	return double( uCount ) / WINDOW;
+}
+#pragma endregion
+
+#pragma region CMetrics
+CMetrics::CMetrics() : m_uDroppedFrames( 0 ), m_uDroppedImages( 0 ), m_uDroppedInputs( 0 ), m_iTrackedUsers( 0 ),
+	m_iHandLead( 0 ), m_iSmoothedLag( 0 ), m_iPredictedLag( 0 ), m_iStatus( 0 ), m_iStatusSince( 0 )
+{
+	for( auto itTime = m_aStatusTime.begin(); itTime != m_aStatusTime.end(); ++ itTime )
+		itTime->store( 0, boost::memory_order_relaxed );
+	m_tpStart = TClock::now();
+}
+
+void CMetrics::SetControlStatus( int iStatus )
+{
+	if( iStatus < 0 || iStatus >= STATUS_COUNT )
+		return;
+
+	int64_t iNow = boost::chrono::duration_cast<boost::chrono::microseconds>( TClock::now() - m_tpStart ).count();
+	int iOld = m_iStatus.load( boost::memory_order_relaxed );
+	m_aStatusTime[iOld].fetch_add( iNow - m_iStatusSince.load( boost::memory_order_relaxed ), boost::memory_order_relaxed );
+	m_iStatusSince.store( iNow, boost::memory_order_relaxed );
+	m_iStatus.store( iStatus, boost::memory_order_relaxed );
+}
+
+double CMetrics::GetStatusSeconds( int iStatus ) const
+{
+	uint64_t uTime = m_aStatusTime[iStatus].load( boost::memory_order_relaxed );
+	if( m_iStatus.load( boost::memory_order_relaxed ) == iStatus )
+	{
+		int64_t iNow = boost::chrono::duration_cast<boost::chrono::microseconds>( TClock::now() - m_tpStart ).count();
+		uTime += std::max<int64_t>( iNow - m_iStatusSince.load( boost::memory_order_relaxed ), 0 );
+	}
+	return uTime / 1e6;
+}
+
+/**
+ * Write a latency histogram as Prometheus summary
+ */
+static void WriteSummary( std::ostream& rOut, const char* szName, const char* szLabels, const CLatencyHistogram& rHistogram )
+{
+	static const double s_aQuantile[] = { 0.5, 0.9, 0.99 };
+	std::string sLabels = szLabels;
+	for( int i = 0; i < 3; ++ i )
+	{
+		rOut << szName << "{" << sLabels << ( sLabels.empty() ? "" : "," ) << "quantile=\"" << s_aQuantile[i] << "\"} "
+			 << rHistogram.GetQuantile( s_aQuantile[i] ) / 1e6 << "\n";
+	}
+	std::string sSuffix = sLabels.empty() ? std::string( " " ) : "{" + sLabels + "} ";
+	rOut << szName << "_sum" << sSuffix << rHistogram.GetSum() / 1e6 << "\n";
+	rOut << szName << "_count" << sSuffix << rHistogram.GetCount() << "\n";
+}
+
+std::string CMetrics::FormatPrometheus() const
+{
+	std::ostringstream ssOut;
+	ssOut << std::setprecision( 9 );
+
+	ssOut << "# HELP nic_sensor_frames_total Frames received from sensor, session or simulator.\n"
+		  << "# TYPE nic_sensor_frames_total counter\n"
+		  << "nic_sensor_frames_total " << m_SensorFrames.GetTotal() << "\n"
+		  << "# HELP nic_sensor_fps Sensor frames per second in the last seconds.\n"
+		  << "# TYPE nic_sensor_fps gauge\n"
+		  << "nic_sensor_fps " << m_SensorFrames.GetRate() << "\n";
+
+	ssOut << "# HELP nic_processed_frames_total Frames processed by hand control.\n"
+		  << "# TYPE nic_processed_frames_total counter\n"
+		  << "nic_processed_frames_total " << m_ProcessedFrames.GetTotal() << "\n"
+		  << "# HELP nic_processed_fps Processed frames per second in the last seconds.\n"
+		  << "# TYPE nic_processed_fps gauge\n"
+		  << "nic_processed_fps " << m_ProcessedFrames.GetRate() << "\n";
+
+	ssOut << "# HELP nic_dropped_frames_total Frames dropped before hand control.\n"
+		  << "# TYPE nic_dropped_frames_total counter\n"
+		  << "nic_dropped_frames_total " << m_uDroppedFrames.load( boost::memory_order_relaxed ) << "\n"
+		  << "# HELP nic_dropped_images_total User map images replaced before shown.\n"
+		  << "# TYPE nic_dropped_images_total counter\n"
+		  << "nic_dropped_images_total " << m_uDroppedImages.load( boost::memory_order_relaxed ) << "\n"
+		  << "# HELP nic_dropped_inputs_total Input events dropped because the injector queue is full.\n"
+		  << "# TYPE nic_dropped_inputs_total counter\n"
+		  << "nic_dropped_inputs_total " << m_uDroppedInputs.load( boost::memory_order_relaxed ) << "\n";
+
+	ssOut << "# HELP nic_tracked_users Users with tracked skeleton in the last frame.\n"
+		  << "# TYPE nic_tracked_users gauge\n"
+		  << "nic_tracked_users " << m_iTrackedUsers.load( boost::memory_order_relaxed ) << "\n";
+
+	ssOut << "# HELP nic_stage_latency_seconds Processing time of each stage.\n"
+		  << "# TYPE nic_stage_latency_seconds summary\n";
+	for( int s = 0; s < MS_COUNT; ++ s )
+		WriteSummary( ssOut, "nic_stage_latency_seconds", ( std::string( "stage=\"" ) + s_aStageName[s] + "\"" ).c_str(), m_aStages[s] );
+
+	ssOut << "# HELP nic_control_status_seconds_total Time spent in each status of hand control.\n"
+		  << "# TYPE nic_control_status_seconds_total counter\n";
+	for( int i = 0; i < STATUS_COUNT; ++ i )
+		ssOut << "nic_control_status_seconds_total{status=\"" << s_aStatusName[i] << "\"} " << GetStatusSeconds( i ) << "\n";
+
+	ssOut << "# HELP nic_key_latency_seconds Time from the hand starting to move to a button until the key is sent.\n"
+		  << "# TYPE nic_key_latency_seconds summary\n";
+	WriteSummary( ssOut, "nic_key_latency_seconds", "", m_KeyLatency );
+
+	ssOut << "# HELP nic_inject_latency_seconds Time from an input event being queued until it is given to the system.\n"
+		  << "# TYPE nic_inject_latency_seconds summary\n";
+	WriteSummary( ssOut, "nic_inject_latency_seconds", "", m_InjectLatency );
+
+	int64_t iSmoothedLag = m_iSmoothedLag.load( boost::memory_order_relaxed ),
+			iPredictedLag = m_iPredictedLag.load( boost::memory_order_relaxed );
+	ssOut << "# HELP nic_hand_lead_seconds Time the hand is extrapolated forward by the hand filter.\n"
+		  << "# TYPE nic_hand_lead_seconds gauge\n"
+		  << "nic_hand_lead_seconds " << m_iHandLead.load( boost::memory_order_relaxed ) / 1e6 << "\n"
+		  << "# HELP nic_hand_filter_lag_seconds Measured lag of filtered hand behind the joint, negative if ahead.\n"
+		  << "# TYPE nic_hand_filter_lag_seconds gauge\n"
+		  << "nic_hand_filter_lag_seconds{output=\"smoothed\"} " << iSmoothedLag / 1e6 << "\n"
+		  << "nic_hand_filter_lag_seconds{output=\"predicted\"} " << iPredictedLag / 1e6 << "\n"
+		  << "# HELP nic_hand_latency_reduction_seconds Measured lag removed by the extrapolation.\n"
+		  << "# TYPE nic_hand_latency_reduction_seconds gauge\n"
+		  << "nic_hand_latency_reduction_seconds " << ( iSmoothedLag - iPredictedLag ) / 1e6 << "\n";
+
+	return ssOut.str();
+}
+
+std::string CMetrics::FormatSummary() const
+{
+	std::ostringstream ssOut;
+	ssOut << std::fixed << std::setprecision( 1 );
+	ssOut << "sensor " << m_SensorFrames.GetRate() << " fps, processed " << m_ProcessedFrames.GetRate()
+		  << " fps, dropped " << m_uDroppedFrames.load( boost::memory_order_relaxed ) << "\n";
+	ssOut << "users " << m_iTrackedUsers.load( boost::memory_order_relaxed )
+		  << ", status " << s_aStatusName[m_iStatus.load( boost::memory_order_relaxed )] << "\n";
+
+	ssOut << std::setprecision( 2 );
+	for( int s = 0; s < MS_COUNT; ++ s )
+	{
+		ssOut << std::left << std::setw( 12 ) << s_aStageName[s] << std::right
+			  << "p50 " << std::setw( 6 ) << m_aStages[s].GetQuantile( 0.5 ) / 1000
+			  << " ms, p99 " << std::setw( 6 ) << m_aStages[s].GetQuantile( 0.99 ) / 1000 << " ms\n";
+	}
+	ssOut << std::left << std::setw( 12 ) << "key" << std::right
+		  << "p50 " << std::setw( 6 ) << m_KeyLatency.GetQuantile( 0.5 ) / 1000
+		  << " ms, " << m_KeyLatency.GetCount() << " pressed\n";
+	ssOut << std::left << std::setw( 12 ) << "inject" << std::right
+		  << "p50 " << std::setw( 6 ) << m_InjectLatency.GetQuantile( 0.5 ) / 1000
+		  << " ms, p99 " << std::setw( 6 ) << m_InjectLatency.GetQuantile( 0.99 ) / 1000 << " ms\n";
+	ssOut << std::left << std::setw( 12 ) << "hand lead" << std::right
+		  << std::setw( 6 ) << m_iHandLead.load( boost::memory_order_relaxed ) / 1000.0
+		  << " ms, lag " << std::setw( 6 ) << m_iPredictedLag.load( boost::memory_order_relaxed ) / 1000.0 << " ms";
+	return ssOut.str();
+}
+#pragma endregion
+
+#pragma region CMetricsServer
+namespace asio = boost::asio;
+
+/**
+ * One HTTP request: read the header, write the response and close
+ */
+class CMetricsConnection : public boost::enable_shared_from_this<CMetricsConnection>
+{
+public:
+	CMetricsConnection( asio::io_service& rService, const CMetrics& rMetrics ) : m_Socket( rService ), m_rMetrics( rMetrics )
+	{
+	}
+
+	asio::ip::tcp::socket& Socket()
+	{
+		return m_Socket;
+	}
+
+	void Start()
+	{
+		boost::shared_ptr<CMetricsConnection> pThis = shared_from_this();
+		asio::async_read_until( m_Socket, m_sbRequest, "\r\n\r\n", [pThis]( const boost::system::error_code& rError, size_t ){
+			pThis->OnRead( rError );
+		} );
+	}
+
+private:
+	void OnRead( const boost::system::error_code& rError )
+	{
+		if( rError )
+			return;
+
+		// request line: GET /metrics HTTP/1.1
+		std::istream isRequest( &m_sbRequest );
+		std::string sMethod, sPath;
+		isRequest >> sMethod >> sPath;
+
+		std::string sStatus = "200 OK", sBody;
+		if( sMethod != "GET" )
+			sStatus = "405 Method Not Allowed";
+		else if( sPath == "/metrics" || sPath == "/" )
+			sBody = m_rMetrics.FormatPrometheus();
+		else
+			sStatus = "404 Not Found";
+
+		std::ostringstream ssResponse;
+		ssResponse << "HTTP/1.1 " << sStatus << "\r\n"
+				   << "Content-Type: text/plain; version=0.0.4\r\n"
+				   << "Content-Length: " << sBody.size() << "\r\n"
+				   << "Connection: close\r\n\r\n" << sBody;
+		m_sResponse = ssResponse.str();
+		boost::shared_ptr<CMetricsConnection> pThis = shared_from_this();
+		asio::async_write( m_Socket, asio::buffer( m_sResponse ), [pThis]( const boost::system::error_code& rError, size_t ){
+			pThis->OnWrite( rError );
+		} );
+	}
+
+	void OnWrite( const boost::system::error_code& rError )
+	{
+		boost::system::error_code eIgnore;
+		m_Socket.shutdown( asio::ip::tcp::socket::shutdown_both, eIgnore );
+	}
+
+private:
+	asio::ip::tcp::socket	m_Socket;
+	asio::streambuf			m_sbRequest;
+	std::string				m_sResponse;
+	const CMetrics&			m_rMetrics;
+};
+
+struct CMetricsServer::SImpl
+{
+	asio::io_service		mService;
+	asio::ip::tcp::acceptor	mAcceptor;
+	const CMetrics&			rMetrics;
+
+	SImpl( const CMetrics& rMetrics ) : mAcceptor( mService ), rMetrics( rMetrics )
+	{
+	}
+
+	void Accept()
+	{
+		boost::shared_ptr<CMetricsConnection> pConnection = boost::make_shared<CMetricsConnection>( boost::ref( mService ), boost::cref( rMetrics ) );
+		mAcceptor.async_accept( pConnection->Socket(), [this, pConnection]( const boost::system::error_code& rError ){
+			if( !rError )
+				pConnection->Start();
+			if( rError != asio::error::operation_aborted )
+				Accept();
+		} );
+	}
+};
+
+CMetricsServer::CMetricsServer( const CMetrics& rMetrics ) : m_rMetrics( rMetrics )
+{
+}
+
+CMetricsServer::~CMetricsServer()
+{
+	Stop();
+}
+
+bool CMetricsServer::Start( unsigned short uPort )
+{
+	Stop();
+
+	m_pImpl.reset( new SImpl( m_rMetrics ) );
+	boost::system::error_code eError;
+	asio::ip::tcp::endpoint mEndpoint( asio::ip::address_v4::loopback(), uPort );
+	m_pImpl->mAcceptor.open( mEndpoint.protocol(), eError );
+	if( !eError )
+		m_pImpl->mAcceptor.set_option( asio::ip::tcp::acceptor::reuse_address( true ), eError );
+	if( !eError )
+		m_pImpl->mAcceptor.bind( mEndpoint, eError );
+	if( !eError )
+		m_pImpl->mAcceptor.listen( asio::socket_base::max_connections, eError );
+	if( eError )
+	{
+		std::cerr << "Can't serve metrics on port " << uPort << ": " << eError.message() << std::endl;
+		m_pImpl.reset();
+		return false;
+	}
+
+	m_pImpl->Accept();
+	m_tServe = boost::thread( [this](){ m_pImpl->mService.run(); } );
+	std::cout << "Metrics on http://127.0.0.1:" << uPort << "/metrics" << std::endl;
+	return true;
+}
+
+void CMetricsServer::Stop()
+{
+	if( !m_pImpl )
+		return;
+
+	m_pImpl->mService.stop();
+	m_tServe.join();
+	m_pImpl.reset();
+}
+#pragma endregion
@@ -0,0 +1,299 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <string>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+#pragma endregion
+
+/**
+ * Latency histogram which can be updated by one thread and read by others without lock.
+ *
+ * Buckets are log-linear: 4 buckets per power of 2 microseconds, so a quantile is estimated
+ * within 25%; values above about 30 seconds are put into the last bucket.
+ */
+class CLatencyHistogram
+{
+public:
+	enum
+	{
+		BUCKETS	= 100
+	};
+
+public:
+	CLatencyHistogram();
+
+	void Add( uint64_t uMicroseconds );
+
+	uint64_t GetCount() const
+	{
+		return m_uCount.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * Sum of all values, in microseconds
+	 */
+	uint64_t GetSum() const
+	{
+		return m_uSum.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * Estimated quantile (0-1) in microseconds, 0 if empty
+	 */
+	double GetQuantile( double dQuantile ) const;
+
+private:
+	static int BucketIndex( uint64_t uValue );
+
+	/**
+	 * Value range of bucket [lower, upper)
+	 */
+	static uint64_t BucketLower( int iIndex );
+
+private:
+	std::array<boost::atomic<uint64_t>,BUCKETS>	m_aBuckets;
+	boost::atomic<uint64_t>		m_uCount;
+	boost::atomic<uint64_t>		m_uSum;
+};
+
+/**
+ * Event counter with the rate of last seconds, for one producer thread and any readers
+ */
+class CRateMeter
+{
+public:
+	CRateMeter();
+
+	void Add();
+
+	uint64_t GetTotal() const
+	{
+		return m_uTotal.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * Events per second in the last WINDOW complete seconds
+	 */
+	double GetRate() const;
+
+private:
+	enum
+	{
+		SLOTS	= 8,
+		WINDOW	= 4
+	};
+
+	/**
+	 * Events in one second
+	 */
+	struct SSlot
+	{
+		boost::atomic<int64_t>	iSecond;
+		boost::atomic<uint32_t>	uCount;
+	};
+
+	std::array<SSlot,SLOTS>		m_aSlots;
+	boost::atomic<uint64_t>		m_uTotal;
+};
+
+/**
+ * Live counters of the controller, read by CMetricsServer and QMetricsHUD.
+ *
+ * Every update is a few relaxed atomic operations and never locks, so the counters can be
+ * updated in the frame path of any thread. Each counter has only one writer thread.
+ */
+class CMetrics
+{
+public:
+	typedef boost::chrono::steady_clock	TClock;
+
+	enum EStage
+	{
+		MS_UPDATE,			/**< User map update in GUI thread, contains select, colorize and transform */
+		MS_SELECT_USER,
+		MS_COLORIZE,
+		MS_TRANSFORM,
+		MS_HAND,			/**< Hand selection and hand control */
+		MS_COUNT
+	};
+
+	enum
+	{
+		STATUS_COUNT	= 5		/**< Number of QHandControl::EControlStatus */
+	};
+
+	/**
+	 * Add the time from construction to destruction to a stage, nothing if metrics is NULL
+	 */
+	class CStageTimer
+	{
+	public:
+		CStageTimer( CMetrics* pMetrics, EStage eStage ) : m_pMetrics( pMetrics ), m_eStage( eStage )
+		{
+			if( m_pMetrics != NULL )
+				m_tpBegin = TClock::now();
+		}
+
+		~CStageTimer()
+		{
+			if( m_pMetrics != NULL )
+				m_pMetrics->AddStageTime( m_eStage, TClock::now() - m_tpBegin );
+		}
+
+	private:
+		CMetrics*			m_pMetrics;
+		EStage				m_eStage;
+		TClock::time_point	m_tpBegin;
+	};
+
+public:
+	CMetrics();
+
+	/**
+	 * A frame is received from sensor, session or simulator
+	 */
+	void AddSensorFrame()
+	{
+		m_SensorFrames.Add();
+	}
+
+	/**
+	 * A frame reached hand control
+	 */
+	void AddProcessedFrame()
+	{
+		m_ProcessedFrames.Add();
+	}
+
+	/**
+	 * A frame is dropped before hand control
+	 */
+	void AddDroppedFrame()
+	{
+		m_uDroppedFrames.fetch_add( 1, boost::memory_order_relaxed );
+	}
+
+	/**
+	 * A user map image is replaced before shown
+	 */
+	void AddDroppedImage()
+	{
+		m_uDroppedImages.fetch_add( 1, boost::memory_order_relaxed );
+	}
+
+	/**
+	 * An input event is dropped because the queue of input injector is full
+	 */
+	void AddDroppedInput()
+	{
+		m_uDroppedInputs.fetch_add( 1, boost::memory_order_relaxed );
+	}
+
+	void SetTrackedUsers( int iUsers )
+	{
+		m_iTrackedUsers.store( iUsers, boost::memory_order_relaxed );
+	}
+
+	void AddStageTime( EStage eStage, TClock::duration tdTime )
+	{
+		m_aStages[eStage].Add( boost::chrono::duration_cast<boost::chrono::microseconds>( tdTime ).count() );
+	}
+
+	/**
+	 * Status of hand control changed, called by the thread of hand control only
+	 */
+	void SetControlStatus( int iStatus );
+
+	/**
+	 * Time from the hand starting to move to a button until the key is sent
+	 */
+	void AddKeyLatency( boost::chrono::microseconds tdTime )
+	{
+		m_KeyLatency.Add( tdTime.count() );
+	}
+
+	/**
+	 * Time from an input event being queued until it is given to the system, called by the injector thread
+	 */
+	void AddInjectLatency( boost::chrono::microseconds tdTime )
+	{
+		m_InjectLatency.Add( tdTime.count() );
+	}
+
+	/**
+	 * Extrapolation of the hand, and the measured lag of hand filter before and after it
+	 */
+	void SetHandFilter( boost::chrono::microseconds tdLead, boost::chrono::microseconds tdSmoothedLag, boost::chrono::microseconds tdPredictedLag )
+	{
+		m_iHandLead.store( tdLead.count(), boost::memory_order_relaxed );
+		m_iSmoothedLag.store( tdSmoothedLag.count(), boost::memory_order_relaxed );
+		m_iPredictedLag.store( tdPredictedLag.count(), boost::memory_order_relaxed );
+	}
+
+	/**
+	 * All metrics in Prometheus text format
+	 */
+	std::string FormatPrometheus() const;
+
+	/**
+	 * Short text for on-screen display
+	 */
+	std::string FormatSummary() const;
+
+private:
+	/**
+	 * Seconds spent in status, include the current one
+	 */
+	double GetStatusSeconds( int iStatus ) const;
+
+private:
+	CRateMeter					m_SensorFrames;
+	CRateMeter					m_ProcessedFrames;
+	boost::atomic<uint64_t>		m_uDroppedFrames;
+	boost::atomic<uint64_t>		m_uDroppedImages;
+	boost::atomic<uint64_t>		m_uDroppedInputs;
+	boost::atomic<int>			m_iTrackedUsers;
+	std::array<CLatencyHistogram,MS_COUNT>	m_aStages;
+	CLatencyHistogram			m_KeyLatency;
+	CLatencyHistogram			m_InjectLatency;
+	boost::atomic<int64_t>		m_iHandLead;							/**< Microseconds */
+	boost::atomic<int64_t>		m_iSmoothedLag;
+	boost::atomic<int64_t>		m_iPredictedLag;
+
+	std::array<boost::atomic<uint64_t>,STATUS_COUNT>	m_aStatusTime;	/**< Microseconds of finished periods */
+	boost::atomic<int>			m_iStatus;
+	boost::atomic<int64_t>		m_iStatusSince;							/**< Microseconds since m_tpStart */
+	TClock::time_point			m_tpStart;
+};
+
+/**
+ * Serve the metrics over loopback HTTP, for Prometheus or curl http://127.0.0.1:port/metrics.
+ * Requests are handled one by one on its own thread.
+ */
+class CMetricsServer
+{
+public:
+	CMetricsServer( const CMetrics& rMetrics );
+	~CMetricsServer();
+
+	/**
+	 * Listen on 127.0.0.1:uPort, return false if the port can't be used
+	 */
+	bool Start( unsigned short uPort );
+
+	void Stop();
+
+private:
+	struct SImpl;
+
+	const CMetrics&			m_rMetrics;
+	std::unique_ptr<SImpl>	m_pImpl;
+	boost::thread			m_tServe;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#pragma region Header Files
+// Qt Header
+#include <QtGui/QtGui>
+
+// Application header
+#include "Metrics.h"
+#pragma endregion
+
+/**
+ * On-screen display of metrics, call Refresh() to update text
+ */
+class QMetricsHUD : public QGraphicsSimpleTextItem
+{
+public:
+	QMetricsHUD( const CMetrics& rMetrics ) : m_rMetrics( rMetrics )
+	{
+		setBrush( QBrush( Qt::yellow ) );
+		setFont( QFont( "Courier", 8 ) );
+		setZValue( 10 );
+	}
+
+	void Refresh()
+	{
+		setText( QString::fromStdString( m_rMetrics.FormatSummary() ) );
+	}
+
+private:
+	const CMetrics&	m_rMetrics;
+};
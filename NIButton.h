@@ -1,203 +1,108 @@
 #pragma once
 #pragma region Header Files
 // STL Header
-#include <algorithm>
 #include <array>
-#include <functional>
-
-// Boost Header
-#include <boost/chrono.hpp>
 
 // QT Header
 #include <QtGui/QtGui>
+
+// Application header
+#include "Gesture.h"
 #pragma endregion
 
 /**
- * A baisc circle button with progress arc
+ * A baisc circle or square button with progress arc and label, shows the state of a CProgressButton.
+ * The button is only read at construction, as it is freed when the layout of its control changes.
  */
-class QBaseProgressButton : public QGraphicsItem
+class QProgressButton : public QGraphicsItem
 {
 public:
-	std::function<void()>	m_funcPress;
-	std::function<void()>	m_funcRelease;
-
-public:
-	QBaseProgressButton() : QGraphicsItem()
+	QProgressButton( const CProgressButton& rButton ) : QGraphicsItem()
 	{
-		m_eStatus		= BS_OUTSIDE;
+		m_eShape		= rButton.m_eShape;
+		m_sLabel		= rButton.m_sLabel;
+		m_iPage			= rButton.m_iPage;
+		m_eStatus		= CProgressButton::BS_OUTSIDE;
 		m_fProgress		= 0;
-		m_funcPress		= [](){};
-		m_funcRelease	= [](){};
 
-		SetSize( 70 );
+		SetSize( rButton.m_fSize );
+		setPos( rButton.m_Pos );
 
 		m_aColor[0] = QBrush( qRgba( 0, 128, 128, 128 ) );
 		m_aColor[1] = QBrush( qRgba( 128, 128, 255, 128 ) );
 		m_aColor[2] = QBrush( qRgba( 255, 0, 0, 128 ) );
+
+		m_qBorderPen	= QPen( qRgba( 0, 0, 0, 0 ) );
+		m_qProgressPen	= QPen( qRgba( 255, 0, 0, 128 ) );
+		m_qProgressPen.setWidth( 10 );
+		m_qLabelPen		= QPen( Qt::white );
+
+		// only repainted by Sync() when the state changes
+		setCacheMode( QGraphicsItem::DeviceCoordinateCache );
 	}
 
 	virtual QRectF boundingRect() const
 	{
-		return m_qRect;
+		// the progress arc is drawn on the border
+		return m_qRect.adjusted( -5, -5, 5, 5 );
 	}
 
 	virtual void paint( QPainter *pPainter, const QStyleOptionGraphicsItem *option, QWidget *widget )
 	{
-		pPainter->setPen( QPen( qRgba( 0, 0, 0, 0 ) ) );
+		pPainter->setPen( m_qBorderPen );
 		pPainter->setBrush( m_aColor[m_eStatus] );
-		pPainter->drawEllipse( m_qRect );
+		if( m_eShape == BSH_CIRCLE )
+			pPainter->drawEllipse( m_qRect );
+		else
+			pPainter->drawRect( m_qRect );
 
-		if( m_eStatus != BS_OUTSIDE )
+		if( !m_sLabel.isEmpty() )
 		{
-			QPen mPen = QPen( qRgba( 255, 0, 0, 128 ) );
-			mPen.setWidth(10);
-			pPainter->setPen( mPen );
+			pPainter->setPen( m_qLabelPen );
+			pPainter->drawText( m_qRect, Qt::AlignCenter | Qt::TextWordWrap, m_sLabel );
+		}
+
+		if( m_eStatus != CProgressButton::BS_OUTSIDE )
+		{
+			pPainter->setPen( m_qProgressPen );
 			pPainter->drawArc( m_qRect, 90*16, 360 * 16 * m_fProgress );
 		}
 	}
 
-	virtual bool CheckInSide( const QPointF& rPos, const float& fDepth ) = 0;
-
 	virtual void SetSize( float fSize )
 	{
 		float fS = fSize / 2;
+		prepareGeometryChange();
 		m_qRect = QRectF( -fS, -fS, fSize, fSize );
 	}
 
-protected:
-	enum ESTATUS
+	/**
+	 * Set the state of button, repaint if changed; only shown if it is in page iPage
+	 */
+	void Sync( int iPage, CProgressButton::EStatus eStatus, float fProgress )
 	{
-		BS_OUTSIDE,
-		BS_INSIDE,
-		BS_PRESSED
-	};
+		bool bVisible = ( m_iPage == iPage );
+		if( isVisible() != bVisible )
+			setVisible( bVisible );
 
-protected:
-	ESTATUS	m_eStatus;
-	float	m_fProgress;
-
-	QRectF					m_qRect;
-	std::array<QBrush, 3>	m_aColor;
-};
-
-/**
- * A time-base button.
- */
-class QTimerButton : public QBaseProgressButton
-{
-public:
-	typedef boost::chrono::system_clock	TTimeColock;
-	typedef boost::chrono::milliseconds	TDurationType;
-
-	TDurationType	m_duTimeToPress;
-
-public:
-	QTimerButton() : QBaseProgressButton()
-	{
-		m_duTimeToPress = boost::chrono::milliseconds( 500 );
-	}
-
-	virtual bool CheckInSide( const QPointF& rPt, const float& fDepth = 0 )
-	{
-		if( shape().contains( mapFromScene( rPt ) ) )
+		if( m_eStatus != eStatus || m_fProgress != fProgress )
 		{
-			switch( m_eStatus )
-			{
-			case BS_OUTSIDE:
-				m_eStatus = BS_INSIDE;
-				m_tpFirstIn = TTimeColock::now();
-				break;
-
-			case BS_INSIDE:
-				m_fProgress = float( boost::chrono::duration_cast<TDurationType>( TTimeColock::now() - m_tpFirstIn ).count() ) / m_duTimeToPress.count();
-				if( m_fProgress > 1 )
-				{
-					m_fProgress = 1;
-					m_eStatus = BS_PRESSED;
-					m_funcPress();
-				}
-				break;
-			}
-			return true;
+			m_eStatus	= eStatus;
+			m_fProgress	= fProgress;
+			update();
 		}
-		else
-		{
-			switch( m_eStatus )
-			{
-			case BS_PRESSED:
-				m_funcRelease();
-				break;
-			}
-			m_eStatus	= BS_OUTSIDE;
-			m_fProgress	= 0;
-		}
-		return false;
-	}
-
-protected:
-	TTimeColock::time_point	m_tpFirstIn;
-};
-
-/**
- * A depth-base button
- */
-class QDepthButton : public QBaseProgressButton
-{
-public:
-	float	m_fPressDepth;
-
-public:
-	QDepthButton() : QBaseProgressButton()
-	{
-		m_fPressDepth = 50;
-	}
-
-	bool CheckInSide( const QPointF& rPt, const float& fDepth )
-	{
-		if( shape().contains( mapFromScene( rPt ) ) )
-		{
-			switch( m_eStatus )
-			{
-			case BS_OUTSIDE:
-				m_eStatus = BS_INSIDE;
-				m_fFirstInDepth = fDepth;
-				break;
-
-			case BS_INSIDE:
-				m_fProgress = ComputeProgess( fDepth );
-				if( m_fProgress >= 1.0f )
-				{
-					m_fProgress = 1;
-					m_eStatus = BS_PRESSED;
-					m_funcPress();
-				}
-				break;
-
-			case BS_PRESSED:
-				m_fProgress = ComputeProgess( fDepth );
-				if( m_fProgress < 1 )
-				{
-					m_eStatus = BS_INSIDE;
-					m_funcRelease();
-				}
-				break;
-			}
-			return true;
-		}
-		else
-		{
-			m_eStatus	= BS_OUTSIDE;
-			m_fProgress	= 0;
-		}
-		return false;
 	}
 
 protected:
-	float	m_fFirstInDepth;
+	EButtonShape				m_eShape;
+	QString						m_sLabel;
+	int							m_iPage;
+	CProgressButton::EStatus	m_eStatus;
+	float						m_fProgress;
 
-protected:
-	float ComputeProgess( float fDepth )
-	{
-		return std::min( std::max( ( m_fFirstInDepth - fDepth ) / m_fPressDepth, 0.0f ), 1.0f );
-	}
+	QRectF					m_qRect;
+	std::array<QBrush, 3>	m_aColor;
+	QPen					m_qBorderPen;
+	QPen					m_qProgressPen;
+	QPen					m_qLabelPen;
 };
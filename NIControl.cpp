@@ -1,13 +1,15 @@
 #include "NIControl.h"
 
+// STL Header
+#include <iostream>
+
 QNIControl::QNIControl( QString sINIFile ) :
-	m_qSetting( sINIFile, QSettings::IniFormat ),
-	QWidget(), m_qScene(), m_qView( &m_qScene, this ), m_qLayout(this), m_mUserMap( m_niUserTracker )
+	QWidget(), CNIFrontEnd( sINIFile ), m_qScene(), m_qView( &m_qScene, this ), m_qLayout(this), m_qHUD( m_Metrics ), m_mUserMap( m_niUserTracker ), m_FrameListener( this ), m_Pipeline( m_mUserMap, this )
 {
 	m_qRect = QRectF( 0, 0, 640, 480 );
 
-	m_fJointConfidence	= m_qSetting.value( "OpenNI/JointConfidence", 0.5f ).toFloat();
-	m_eControlHand		= NICH_NO_HAND;
+	m_bFrameListener	= m_qSetting.value( "OpenNI/FrameListener", false ).toBool();
+	m_bPipeline			= m_qSetting.value( "OpenNI/Pipeline", false ).toBool();
 
 	// configurate window
 	setAttribute(Qt::WA_NoSystemBackground, true);
@@ -26,87 +28,92 @@ QNIControl::QNIControl( QString sINIFile ) :
 	m_qView.installEventFilter( this );
 
 	// Scene
+	m_mUserMap.SetColorizeKernel( m_qSetting.value( "OpenNI/ColorizeKernel", "auto" ).toString() );
+	std::cout << "Colorize kernel: " << CDepthColorizer::GetKernelName( m_mUserMap.GetColorizeKernel() ) << std::endl;
+	m_mUserMap.SetColorizeThreads( m_qSetting.value( "OpenNI/ColorizeThreads", 1 ).toUInt() );
+	m_mUserMap.SetColorMap( m_qSetting.value( "OpenNI/ColorMap", "direct" ).toString() );
+	QStringList aRange = m_qSetting.value( "OpenNI/DepthRange", "1000/6000" ).toString().split('/');
+	if( aRange.length() == 2 )
+		m_mUserMap.SetDepthRange( aRange[0].toInt(), aRange[1].toInt(), m_qSetting.value( "OpenNI/AutoDepthRange", false ).toBool() );
+	else
+		m_mUserMap.SetDepthRange( 1000, 6000, m_qSetting.value( "OpenNI/AutoDepthRange", false ).toBool() );
+	m_mUserMap.SetIncremental( m_qSetting.value( "OpenNI/IncrementalUserMap", true ).toBool() );
+
 	m_qScene.addItem( &m_mUserMap );
 	m_mUserMap.setZValue( 2 );
 	//m_pUserMap->setOpacity( 0.5 );
 
-	m_qScene.addItem( &m_mHandControl );
-	m_mHandControl.setZValue( 1 );
+	// a hand control view for each user
+	m_Engine.LoadSettings( m_qSetting );
+	for( int i = 0; i < m_Engine.GetMaxUsers(); ++ i )
+	{
+		QHandControl* pView = new QHandControl();
+		m_aHandControl.push_back( std::unique_ptr<QHandControl>( pView ) );
+		m_qScene.addItem( pView );
+		pView->setZValue( 1 );
+		m_Engine.SetView( i, pView );
+		pView->OnHandControlUpdate( m_Engine.GetHandControl( i ) );
+	}
 
-	QONI_UserMap& rUMap = m_mUserMap;
-	m_mHandControl.m_funcStartInput			= [&rUMap](){ rUMap.KeepSkeletonTransform( true ); };
-	m_mHandControl.m_funcEndInput			= [&rUMap](){ rUMap.KeepSkeletonTransform( false ); };
-	m_mHandControl.m_fHandMoveThreshold		= m_qSetting.value( "Control/MoveThreshold", 25 ).toFloat();
-	m_mHandControl.m_fHandForwardDistance	= m_qSetting.value( "Control/ForwardDistance", 250 ).toFloat();
-	m_mHandControl.m_tdPreFixTime			= boost::chrono::milliseconds( m_qSetting.value( "Control/PreFixTime", 100 ).toInt() );
-	m_mHandControl.m_tdFixTime				= boost::chrono::milliseconds( m_qSetting.value( "Control/FixTime", 500 ).toInt() );
-	m_mHandControl.m_tdInvokeTime			= boost::chrono::milliseconds( m_qSetting.value( "Control/InvokeTime", 200 ).toInt() );
+	// the engine loads and transforms the skeletons of users, the user map only draws the image;
+	// in pipeline mode, the skeleton of the first user is transformed by user map
+	m_mUserMap.SetProcessSkeleton( false );
+	if( m_bPipeline )
+	{
+		CHandControl& rControl = m_Engine.GetHandControl( 0 );
+		QONI_UserMap& rUMap = m_mUserMap;
+		std::function<void()> funcStartInput = rControl.m_funcStartInput, funcEndInput = rControl.m_funcEndInput;
+		rControl.m_funcStartInput	= [&rUMap,funcStartInput](){ funcStartInput(); rUMap.KeepSkeletonTransform( true ); };
+		rControl.m_funcEndInput		= [&rUMap,funcEndInput](){ funcEndInput(); rUMap.KeepSkeletonTransform( false ); };
+	}
+
+	SetupServices( m_Engine );
+	m_mUserMap.SetMetrics( &m_Metrics );
+	m_FrameListener.SetMetrics( &m_Metrics );
+	m_Pipeline.SetMetrics( &m_Metrics );
+
+	m_iHUDTimer = 0;
+	m_qHUD.setPos( 5, 5 );
+	m_qScene.addItem( &m_qHUD );
+	ShowHUD( m_qSetting.value( "Metrics/HUD", false ).toBool() );
+
+	Trace::SetThreadName( "GUI" );
 
 	SetFramless( false );
 }
 
 QNIControl::~QNIControl()
 {
-	m_niUserTracker.destroy();
-	nite::NiTE::shutdown();
-
-	m_niDepthStream.destroy();
-	m_niDevice.close();
-	openni::OpenNI::shutdown();
+	Stop();
 }
 
-bool QNIControl::InitialNIDevice( int w, int h )
+bool QNIControl::InitialNIDevice()
 {
-	#pragma region OpenNI
-	using namespace openni;
-	if( OpenNI::initialize() != STATUS_OK )
-	{
-		QMessageBox::critical( NULL, "OpenNI initialize error", OpenNI::getExtendedError() );
-		return false;
-	}
-
-	if( m_niDevice.open( ANY_DEVICE ) != STATUS_OK )
-	{
-		QMessageBox::critical( NULL, "Can't open OpenNI Device", OpenNI::getExtendedError() );
+	if( !CNIFrontEnd::InitialNIDevice() )
 		return false;
-	}
 
-	if( m_niDepthStream.create( m_niDevice, SENSOR_DEPTH ) != STATUS_OK )
-	{
-		QMessageBox::critical( NULL, "Can't create depth stream", OpenNI::getExtendedError() );
-		return false;
-	}
-	else
-	{
-		openni::VideoMode mMode;
-		mMode.setFps( 30 );
-		mMode.setResolution( w, h );
-		mMode.setPixelFormat( openni::PIXEL_FORMAT_DEPTH_1_MM );
-		m_niDepthStream.setVideoMode( mMode );
-	}
-	#pragma endregion
+	ResizeScene();
+	return true;
+}
 
-	#pragma region NiTE
-	using namespace nite;
-	if( NiTE::initialize() != nite::STATUS_OK )
-	{
-		QMessageBox::critical( NULL, "NiTE", "NiTE initialize error" );
+bool QNIControl::OpenSession( QString sFilename, float fSpeed )
+{
+	if( !CNIFrontEnd::OpenSession( sFilename, fSpeed ) )
 		return false;
-	}
 
-	if( m_niUserTracker.create( &m_niDevice ) != nite::STATUS_OK )
-	{
-		QMessageBox::critical( NULL, "User Tracker", "UserTracker created failed" );
-		return false;
-	}
-	SetSkeletonSmoothing( m_qSetting.value( "OpenNI/SkeletonSmooth", 0.75f ).toFloat() );
-	#pragma endregion
+	ResizeScene();
+	return true;
+}
 
-	resize( m_qRect.width(), m_qRect.height() );
-	m_mUserMap.SetSize( m_qRect.width(), m_qRect.height() );
-	m_mHandControl.SetRect( m_qRect );
+void QNIControl::OpenSimulator()
+{
+	CNIFrontEnd::OpenSimulator();
+	ResizeScene();
+}
 
-	return true;
+void QNIControl::ReportError( const char* szTitle, const std::string& sText )
+{
+	QMessageBox::critical( NULL, szTitle, QString::fromLocal8Bit( sText.c_str() ) );
 }
 
 void QNIControl::SetFramless( bool bTrue )
@@ -127,65 +134,155 @@ void QNIControl::SetFramless( bool bTrue )
 	this->move( mPos );
 }
 
+void QNIControl::Start()
+{
+	if( m_bPipeline )
+		m_Pipeline.Start();
+
+	// frames of device are read by timer unless a listener is used
+	if( !StartSource( m_bPipeline || m_bFrameListener ) )
+	{
+		if( m_Simulator.IsOpen() )
+			startTimer( 0 );	// generate in GUI thread whenever idle, as fast as frames are processed
+		else
+			startTimer( 25 );
+	}
+}
+
+void QNIControl::Stop()
+{
+	if( !StopSource( m_bPipeline || m_bFrameListener ) )
+		return;
+
+	if( m_bPipeline )
+	{
+		m_Pipeline.Stop();
+		m_Pipeline.PrintStatistics();
+	}
+	else if( m_bFrameListener || m_Player.IsOpen() || m_Simulator.GetRate() > 0 )
+	{
+		std::cout << "Frames received: " << m_FrameListener.GetReceivedFrames()
+				  << ", processed: " << m_FrameListener.GetProcessedFrames()
+				  << ", dropped: " << m_FrameListener.GetDroppedFrames() << std::endl;
+	}
+
+	StopServices();
+}
+
+void QNIControl::ShowHUD( bool bShow )
+{
+	m_qHUD.setVisible( bShow );
+	if( bShow && m_iHUDTimer == 0 )
+	{
+		m_qHUD.Refresh();
+		m_iHUDTimer = startTimer( 500 );
+	}
+	else if( !bShow && m_iHUDTimer != 0 )
+	{
+		killTimer( m_iHUDTimer );
+		m_iHUDTimer = 0;
+	}
+}
+
+void QNIControl::OnFrame( const CUserFrame& rFrame )
+{
+	RecordFrame( rFrame );
+
+	if( m_bPipeline )
+		m_Pipeline.PushFrame( rFrame );
+	else
+		m_FrameListener.PushFrame( rFrame );
+}
+
 void QNIControl::timerEvent( QTimerEvent* pEvent )
 {
-	if( m_mUserMap.Update() )
+	if( pEvent->timerId() == m_iHUDTimer )
 	{
-		EControlHand	eHandStatus = NICH_NO_HAND;
-		#pragma region select nearest hand
-		float	fRC = m_mUserMap.GetActiveUserJoint( nite::JOINT_RIGHT_HAND ).getPositionConfidence(),
-				fLC = m_mUserMap.GetActiveUserJoint( nite::JOINT_LEFT_HAND ).getPositionConfidence();
+		m_qHUD.Refresh();
+		return;
+	}
+
+	NIC_TRACE_SCOPE( "TimerEvent" );
+	CUserFrame mUserFrame;
+	if( m_Simulator.IsOpen() )
+		m_Simulator.GenerateFrame( mUserFrame );
+	else if( !mUserFrame.Read( m_niUserTracker ) )
+		return;
+	RecordFrame( mUserFrame );
 
-		if( fRC > m_fJointConfidence )
+	m_Metrics.AddProcessedFrame();
+	m_mUserMap.Update( mUserFrame );
+	ProcessUsers( mUserFrame );
+}
+
+void QNIControl::customEvent( QEvent* pEvent )
+{
+	NIC_TRACE_SCOPE( "CustomEvent" );
+	if( pEvent->type() == QONI_FrameListener::FrameEvent )
+	{
+		CUserFrame mUserFrame;
+		if( m_FrameListener.FetchFrame( mUserFrame ) )
 		{
-			if( fLC > m_fJointConfidence )
-			{
-				QVector3D	posR = m_mUserMap.GetActiveUserJointTR( nite::JOINT_RIGHT_HAND ),
-							posL = m_mUserMap.GetActiveUserJointTR( nite::JOINT_LEFT_HAND );
-				if( posR.z() > posL.z() )
-					eHandStatus = NICH_LEFT_HAND;
-				else
-					eHandStatus = NICH_RIGHT_HAND;
-			}
-			else
+			m_Metrics.AddProcessedFrame();
+			m_mUserMap.Update( mUserFrame );
+			ProcessUsers( mUserFrame );
+		}
+	}
+	else if( pEvent->type() == QONI_FramePipeline::GestureEvent )
+	{
+		QONI_FramePipeline::SGestureFrame mFrame;
+		while( m_Pipeline.FetchGesture( mFrame ) )
+		{
+			m_Metrics.AddProcessedFrame();
+			if( mFrame.bActiveUser )
 			{
-				eHandStatus = NICH_RIGHT_HAND;
+				m_mUserMap.SetActivePose( mFrame.mPose );
+				ProcessHand( mFrame.uTimestamp );
 			}
 		}
-		else if( fLC > m_fJointConfidence )
+	}
+	else if( pEvent->type() == QONI_FramePipeline::RenderEvent )
+	{
+		if( m_Pipeline.FetchImage( m_mUserMap.GetUserImageBuffer() ) )
 		{
-			eHandStatus = NICH_LEFT_HAND;
+			m_mUserMap.PresentUserImage();
 		}
-		#pragma endregion
+	}
+}
 
-		if( eHandStatus == NICH_NO_HAND || eHandStatus != m_eControlHand )
-		{
-			m_mHandControl.HandLost();
-			m_eControlHand = eHandStatus;
-		}
+void QNIControl::UpdateRenderTarget()
+{
+	// minimized, hidden or fully covered by its parent
+	bool bVisible = isVisible() && !isMinimized() && !m_qView.viewport()->visibleRegion().isEmpty();
+	int iWidth = m_qView.mapFromScene( m_qRect ).boundingRect().width();
+	m_mUserMap.SetRenderTarget( bVisible, iWidth );
+}
 
-		if( m_eControlHand != NICH_NO_HAND )
-		{
-			#pragma region General Hand position process
-			// get hand info
-			QVector3D	mHandPos3D;
-			QPointF		mHandPos2D;
-			if( eHandStatus == NICH_RIGHT_HAND )
-			{
-				mHandPos3D = m_mUserMap.GetActiveUserJointTR( nite::JOINT_RIGHT_HAND );
-				mHandPos2D = m_mUserMap.GetActiveUserJoint2D( nite::JOINT_RIGHT_HAND );
-			}
-			else
-			{
-				mHandPos3D = m_mUserMap.GetActiveUserJointTR( nite::JOINT_LEFT_HAND );
-				mHandPos2D = m_mUserMap.GetActiveUserJoint2D( nite::JOINT_LEFT_HAND );
-			}
+void QNIControl::ResizeScene()
+{
+	resize( m_qRect.width(), m_qRect.height() );
+	m_mUserMap.SetSize( m_qRect.width(), m_qRect.height() );
+	m_Engine.SetViewSize( m_qRect.width(), m_qRect.height() );
+	for( auto itView = m_aHandControl.begin(); itView != m_aHandControl.end(); ++ itView )
+		( *itView )->SetRect( m_qRect );
 
-			// add current position into track list
-			m_mHandControl.UpdateHandPoint( mHandPos2D, mHandPos3D );
-			#pragma endregion
-		}
-	}
+	// a fixed scene rect, so items moving out of view don't change the view transform
+	m_qScene.setSceneRect( m_qRect );
+	m_qView.fitInView( m_qRect, Qt::KeepAspectRatio );
+}
+
+void QNIControl::ProcessUsers( const CUserFrame& rUserFrame )
+{
+	// the users selected by user map point into this frame
+	if( !rUserFrame.isValid() )
+		return;
 
-	m_qView.fitInView( m_qRect, Qt::KeepAspectRatio  );
+	// the skeleton shown is the nearest user in engine, so it matches the hand control
+	if( m_Engine.ProcessUsers( rUserFrame, m_mUserMap.GetTrackedUsers() ) )
+		m_mUserMap.SetActivePose( *m_Engine.GetNearestPose() );
+}
+
+void QNIControl::ProcessHand( uint64_t uTimestamp )
+{
+	m_Engine.ProcessPose( m_mUserMap.GetActivePose(), uTimestamp );
 }
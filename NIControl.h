@@ -1,65 +1,50 @@
 #pragma once
 #pragma region Header Files
 // STL Header
-#include <array>
+#include <memory>
+#include <vector>
 
 // Qt Header
-#include <QtCore/QSettings>
 #include <QtGui/QtGui>
 
-// OpenNI and NiTE Header
-#include <OpenNI.h>
-#include <NiTE.h>
-
 // Application header
+#include "FrameGrabber.h"
+#include "FrontEnd.h"
+#include "Gesture.h"
+#include "Metrics.h"
+#include "MetricsHUD.h"
+#include "Pipeline.h"
 #include "UserMap.h"
 #include "HandControl.h"
 #pragma endregion
 
 // Main Window
-class QNIControl : public QWidget
+class QNIControl : public QWidget, public CNIFrontEnd
 {
-public:
-	float		m_fJointConfidence;
-	QSettings	m_qSetting;
-
 public:
 	QNIControl( QString sINIFile = "" );
 	~QNIControl();
 
 	/**
-	 * Initial OpenNI and NiTE
+	 * Initial OpenNI and NiTE, and resize to the sensor
 	 */
-	bool InitialNIDevice()
-	{
-		QString s = m_qSetting.value( "OpenNI/Resolution", "640/480" ).toString();
-		QStringList a = s.split('/');
-		if( a.length() == 2 )
-		{
-			m_aResoultion[0] = a[0].toInt();
-			m_aResoultion[1] = a[1].toInt();
-		}
-		else
-		{
-			m_aResoultion[0] = 640;
-			m_aResoultion[1] = 480;
-		}
-		return InitialNIDevice( m_aResoultion[0], m_aResoultion[1] );
-	}
+	bool InitialNIDevice();
 
-	bool InitialNIDevice( int w, int h );
+	/**
+	 * Replay a recorded session file instead of using device
+	 */
+	bool OpenSession( QString sFilename, float fSpeed = 1.0f );
 
-	void Start()
-	{
-		startTimer( 25 );
-	}
+	/**
+	 * Use simulated sensor instead of device, configured by Simulator section of INI
+	 */
+	void OpenSimulator();
 
-	void SetFramless( bool bTrue );
+	void Start();
 
-	void SetSkeletonSmoothing( float fValue )
-	{
-		m_niUserTracker.setSkeletonSmoothingFactor( fValue );
-	}
+	void Stop();
+
+	void SetFramless( bool bTrue );
 
 private:
 	bool eventFilter(QObject *object, QEvent *event)
@@ -91,38 +76,115 @@ private:
 		case Qt::Key_M:
 			SetFramless( !m_bFrameless );
 			break;
+
+		// replay control: seek 1 second, double or half speed
+		case Qt::Key_Left:
+		case Qt::Key_Right:
+			if( m_Player.IsOpen() )
+				m_Player.Seek( m_Player.GetPosition() + ( pEvent->key() == Qt::Key_Right ? 30 : -30 ) );
+			break;
+
+		case Qt::Key_Up:
+		case Qt::Key_Down:
+			if( m_Player.IsOpen() )
+				m_Player.SetSpeed( m_Player.GetSpeed() * ( pEvent->key() == Qt::Key_Up ? 2.0f : 0.5f ) );
+			break;
+
+		case Qt::Key_D:
+			if( m_pFlightRecorder )
+				m_pFlightRecorder->Dump( "hotkey" );
+			break;
+
+		case Qt::Key_T:
+			ToggleTrace();
+			break;
+
+		case Qt::Key_H:
+			ShowHUD( !m_qHUD.isVisible() );
+			break;
 		}
 	}
 
 	void resizeEvent( QResizeEvent* pEvent )
 	{
-		m_qView.fitInView( &m_mUserMap, Qt::KeepAspectRatio );
+		// the view transform only changes here and in ResizeScene()
+		m_qView.fitInView( m_qRect, Qt::KeepAspectRatio );
+		UpdateRenderTarget();
 	}
 
-	void timerEvent( QTimerEvent* pEvent );
+	void showEvent( QShowEvent* pEvent )
+	{
+		UpdateRenderTarget();
+	}
 
-private:
-	enum EControlHand
+	void hideEvent( QHideEvent* pEvent )
+	{
+		UpdateRenderTarget();
+	}
+
+	void changeEvent( QEvent* pEvent )
 	{
-		NICH_NO_HAND,
-		NICH_RIGHT_HAND,
-		NICH_LEFT_HAND,
-	};
+		if( pEvent->type() == QEvent::WindowStateChange )
+			UpdateRenderTarget();
+		QWidget::changeEvent( pEvent );
+	}
+
+	void timerEvent( QTimerEvent* pEvent );
+
+	void customEvent( QEvent* pEvent );
+
+	/**
+	 * Tell user map the size it is shown in view, or it is not visible
+	 */
+	void UpdateRenderTarget();
+
+	/**
+	 * Pass a frame from the source thread to pipeline or GUI thread
+	 */
+	void OnFrame( const CUserFrame& rFrame );
+
+	/**
+	 * Show the error in a message box
+	 */
+	void ReportError( const char* szTitle, const std::string& sText );
+
+	/**
+	 * Resize window, user map and hand controls to m_qRect
+	 */
+	void ResizeScene();
+
+	/**
+	 * Process all users selected by user map in the last update of this frame
+	 */
+	void ProcessUsers( const CUserFrame& rUserFrame );
+
+	/**
+	 * Select the control hand of active user from pipeline and update hand control of the first user,
+	 * uTimestamp is the sensor time of the frame
+	 */
+	void ProcessHand( uint64_t uTimestamp );
+
+	/**
+	 * Show or hide metrics on screen
+	 */
+	void ShowHUD( bool bShow );
 
 private:
-	std::array<unsigned int,2>	m_aResoultion;
 	QRectF			m_qRect;
 	bool			m_bFrameless;
-	EControlHand	m_eControlHand;
+	bool			m_bFrameListener;
+	bool			m_bPipeline;
+	int				m_iHUDTimer;
 
 	QGraphicsScene	m_qScene;
 	QGraphicsView	m_qView;
 	QGridLayout		m_qLayout;
+	QMetricsHUD		m_qHUD;
 
 	QONI_UserMap	m_mUserMap;
-	QHandControl	m_mHandControl;
+	std::vector<std::unique_ptr<QHandControl>>	m_aHandControl;		/**< View of each user slot of engine */
+	CGestureEngine	m_Engine;			/**< Users are selected by user map, or the pose comes from pipeline */
 
-	openni::Device		m_niDevice;
-	openni::VideoStream	m_niDepthStream;
-	nite::UserTracker	m_niUserTracker;
+	QONI_FrameListener	m_FrameListener;
+	QONI_FramePipeline	m_Pipeline;
 };
@@ -0,0 +1,74 @@
+#include "NIDaemon.h"
+
+// STL Header
+#include <iostream>
+
+// Boost Header
+#include <boost/thread.hpp>
+
+volatile std::sig_atomic_t CNIDaemon::s_bQuit = 0;
+
+CNIDaemon::CNIDaemon( QString sINIFile ) :
+	CNIFrontEnd( sINIFile ), m_Engine( &m_niUserTracker )
+{
+	// same 2D space as the window, so the thresholds in pixel work the same
+	m_Engine.SetViewSize( 640, 480 );
+	m_Engine.LoadSettings( m_qSetting );
+	SetupServices( m_Engine );
+	Trace::SetThreadName( "Main" );
+}
+
+int CNIDaemon::Run()
+{
+	s_bQuit = 0;
+	std::signal( SIGINT, OnSignal );
+	std::signal( SIGTERM, OnSignal );
+
+	Start();
+	std::cout << "Running without window, press Ctrl+C to quit" << std::endl;
+	if( m_Simulator.IsOpen() && m_Simulator.GetRate() <= 0 )
+	{
+		// generate in this thread as fast as frames are processed
+		CUserFrame mUserFrame;
+		while( !s_bQuit )
+		{
+			m_Simulator.GenerateFrame( mUserFrame );
+			OnFrame( mUserFrame );
+		}
+	}
+	else
+	{
+		while( !s_bQuit )
+			boost::this_thread::sleep_for( boost::chrono::milliseconds( 100 ) );
+	}
+	Stop();
+
+	std::cout << m_Metrics.FormatSummary() << std::endl;
+	return 0;
+}
+
+void CNIDaemon::Start()
+{
+	StartSource( true );
+}
+
+void CNIDaemon::Stop()
+{
+	StopSource( true );
+	StopServices();
+}
+
+void CNIDaemon::OnFrame( const CUserFrame& rFrame )
+{
+	NIC_TRACE_SCOPE( "DaemonFrame" );
+	RecordFrame( rFrame );
+
+	// processed on the source thread, so no frame is dropped
+	m_Metrics.AddProcessedFrame();
+	m_Engine.ProcessFrame( rFrame );
+}
+
+void CNIDaemon::OnSignal( int iSignal )
+{
+	s_bQuit = 1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <csignal>
+
+// Application header
+#include "FrontEnd.h"
+#include "Gesture.h"
+#pragma endregion
+
+/**
+ * Controller without window: frames are processed by CGestureEngine on the thread of source,
+ * and keys are sent like QNIControl. Nothing is drawn, so it doesn't need QApplication.
+ */
+class CNIDaemon : public CNIFrontEnd
+{
+public:
+	CNIDaemon( QString sINIFile = "" );
+
+	/**
+	 * Process frames until Ctrl+C, return the exit code
+	 */
+	int Run();
+
+private:
+	void Start();
+
+	void Stop();
+
+	void OnFrame( const CUserFrame& rFrame );
+
+	/**
+	 * Handler of SIGINT and SIGTERM
+	 */
+	static void OnSignal( int iSignal );
+
+private:
+	CGestureEngine		m_Engine;
+
+	static volatile std::sig_atomic_t	s_bQuit;
+};
@@ -0,0 +1,170 @@
+#include "Pipeline.h"
+
+// STL Header
+#include <iostream>
+
+const QEvent::Type QONI_FramePipeline::GestureEvent	= static_cast<QEvent::Type>( QEvent::registerEventType() );
+const QEvent::Type QONI_FramePipeline::RenderEvent	= static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+QONI_FramePipeline::QONI_FramePipeline( QONI_UserMap& rUserMap, QObject* pReceiver ) :
+	m_rUserMap( rUserMap ), m_pReceiver( pReceiver ), m_pMetrics( NULL ),
+	m_qAcquired( 2 ), m_qSkeleton( 2 ), m_qColorize( 1 ), m_qGesture( 8 ),
+	m_bGesturePending( false ), m_bRenderPending( false ), m_uRendered( 0 ), m_uImageDropped( 0 )
+{
+	m_bRunning = false;
+}
+
+QONI_FramePipeline::~QONI_FramePipeline()
+{
+	Stop();
+}
+
+void QONI_FramePipeline::Start()
+{
+	if( m_bRunning )
+		return;
+
+	m_qAcquired.Reset();
+	m_qSkeleton.Reset();
+	m_qColorize.Reset();
+	m_qGesture.Reset();
+
+	m_bRunning	= true;
+	m_tSelect	= boost::thread( [this](){ SelectStage(); } );
+	m_tSkeleton	= boost::thread( [this](){ SkeletonStage(); } );
+	m_tColorize	= boost::thread( [this](){ ColorizeStage(); } );
+}
+
+void QONI_FramePipeline::Stop()
+{
+	if( !m_bRunning )
+		return;
+
+	m_qAcquired.Stop();
+	m_qSkeleton.Stop();
+	m_qColorize.Stop();
+	m_qGesture.Stop();
+
+	m_tSelect.join();
+	m_tSkeleton.join();
+	m_tColorize.join();
+	m_bRunning = false;
+}
+
+void QONI_FramePipeline::PushFrame( const CUserFrame& rFrame )
+{
+	CountPush( m_qAcquired.Push( rFrame ), false );
+}
+
+bool QONI_FramePipeline::FetchGesture( SGestureFrame& rFrame )
+{
+	m_bGesturePending.store( false, boost::memory_order_release );
+	return m_qGesture.TryPop( rFrame );
+}
+
+bool QONI_FramePipeline::FetchImage( SUserImageBuffer& rBuffer )
+{
+	m_bRenderPending.store( false, boost::memory_order_release );
+	if( m_mbImage.Fetch() )
+	{
+		// exchange buffers, so the images are reused without copy
+		rBuffer.Swap( m_mbImage.Front() );
+		m_uRendered.fetch_add( 1, boost::memory_order_relaxed );
+		return true;
+	}
+	return false;
+}
+
+void QONI_FramePipeline::PrintStatistics()
+{
+	std::cout << "Pipeline dropped frames: acquire " << m_qAcquired.GetDropped()
+			  << ", skeleton " << m_qSkeleton.GetDropped()
+			  << ", colorize " << m_qColorize.GetDropped()
+			  << ", gesture " << m_qGesture.GetDropped()
+			  << ", render " << m_uImageDropped.load( boost::memory_order_relaxed )
+			  << "; rendered " << m_uRendered.load( boost::memory_order_relaxed ) << std::endl;
+}
+
+void QONI_FramePipeline::SelectStage()
+{
+	Trace::SetThreadName( "Select stage" );
+	CUserFrame mUserFrame;
+	while( m_qAcquired.Pop( mUserFrame ) )
+	{
+		NIC_TRACE_SCOPE( "SelectStage" );
+		const nite::UserData* pActiveUser = m_rUserMap.SelectActiveUser( mUserFrame );
+
+		SSkeletonJob mSkeleton;
+		mSkeleton.bActiveUser	= ( pActiveUser != NULL );
+		mSkeleton.uTimestamp	= mUserFrame.getTimestamp();
+		if( mSkeleton.bActiveUser )
+			mSkeleton.mPose.LoadJoints( pActiveUser->getSkeleton() );
+		CountPush( m_qSkeleton.Push( mSkeleton ), false );
+
+		// no need to colorize if the user map can't be seen
+		if( !m_rUserMap.IsRenderVisible() )
+			continue;
+
+		SColorizeJob mColorize;
+		mColorize.mFrame	= mUserFrame;
+		mColorize.uActiveID	= ( pActiveUser != NULL ? pActiveUser->getId() : 0 );
+		CountPush( m_qColorize.Push( mColorize ), true );
+	}
+}
+
+void QONI_FramePipeline::SkeletonStage()
+{
+	Trace::SetThreadName( "Skeleton stage" );
+	SSkeletonJob mJob;
+	while( m_qSkeleton.Pop( mJob ) )
+	{
+		NIC_TRACE_SCOPE( "SkeletonStage" );
+		SGestureFrame mFrame;
+		mFrame.bActiveUser	= mJob.bActiveUser;
+		mFrame.uTimestamp	= mJob.uTimestamp;
+		if( mJob.bActiveUser )
+		{
+			mFrame.mPose = mJob.mPose;
+			m_rUserMap.TransformPose( mFrame.mPose );
+		}
+		CountPush( m_qGesture.Push( mFrame ), false );
+		Notify( m_bGesturePending, GestureEvent );
+	}
+}
+
+void QONI_FramePipeline::ColorizeStage()
+{
+	Trace::SetThreadName( "Colorize stage" );
+	SColorizeJob mJob;
+	while( m_qColorize.Pop( mJob ) )
+	{
+		NIC_TRACE_SCOPE( "ColorizeStage" );
+		int iStep = m_rUserMap.GetRenderStep( mJob.mFrame.getWidth() );
+		if( iStep == 0 )
+		{
+			mJob.mFrame.release();
+			continue;
+		}
+
+		SUserImageBuffer& rImage = m_mbImage.Back();
+		m_rUserMap.PrepareUserImage( rImage, mJob.mFrame.getWidth(), mJob.mFrame.getHeight(), iStep );
+		m_rUserMap.DrawUserMap( mJob.mFrame, mJob.uActiveID, rImage );
+
+		// release the frame before waiting next job
+		mJob.mFrame.release();
+
+		if( m_mbImage.Publish() )
+		{
+			m_uImageDropped.fetch_add( 1, boost::memory_order_relaxed );
+			CountPush( false, true );
+		}
+		Notify( m_bRenderPending, RenderEvent );
+	}
+}
+
+void QONI_FramePipeline::Notify( boost::atomic<bool>& bPending, QEvent::Type eType )
+{
+	// only one event of each type in Qt queue
+	if( !bPending.exchange( true, boost::memory_order_acq_rel ) )
+		QCoreApplication::postEvent( m_pReceiver, new QEvent( eType ) );
+}
@@ -0,0 +1,143 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <array>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+// Qt Header
+#include <QtGui/QtGui>
+
+// NiTE Header
+#include <NiTE.h>
+
+// Application header
+#include "BoundedQueue.h"
+#include "FrameGrabber.h"
+#include "Metrics.h"
+#include "UserFrame.h"
+#include "UserMap.h"
+#pragma endregion
+
+/**
+ * Multi-thread frame processing pipeline.
+ *
+ * acquire (NiTE thread) -> select user -> skeleton transform -> gesture (GUI thread)
+ *                                      -> colorize           -> render (GUI thread)
+ *
+ * The graphics items can only be touched by GUI thread, so the gesture state machine and
+ * rendering are done when receiver get GestureEvent and RenderEvent. These two events are
+ * independent, so the gesture path never waits for the user map image.
+ */
+class QONI_FramePipeline
+{
+public:
+	static const QEvent::Type GestureEvent;
+	static const QEvent::Type RenderEvent;
+
+	/**
+	 * Output of skeleton stage
+	 */
+	struct SGestureFrame
+	{
+		bool			bActiveUser;
+		SSkeletonPose	mPose;
+		uint64_t		uTimestamp;		/**< Sensor time of the frame, for CGestureClock */
+	};
+
+public:
+	QONI_FramePipeline( QONI_UserMap& rUserMap, QObject* pReceiver );
+	~QONI_FramePipeline();
+
+	void Start();
+	void Stop();
+
+	/**
+	 * The acquire stage, called on the source thread (NiTE or session player)
+	 */
+	void PushFrame( const CUserFrame& rFrame );
+
+	/**
+	 * Get the next result of skeleton stage, should be called on GestureEvent
+	 */
+	bool FetchGesture( SGestureFrame& rFrame );
+
+	/**
+	 * Get the latest user map image, should be called on RenderEvent.
+	 * The image is swapped with rBuffer, which should be a buffer not used any more.
+	 */
+	bool FetchImage( SUserImageBuffer& rBuffer );
+
+	/**
+	 * Print the frame counters of each stage
+	 */
+	void PrintStatistics();
+
+	/**
+	 * Count dropped frames and images, NULL to disable; set before Start()
+	 */
+	void SetMetrics( CMetrics* pMetrics )
+	{
+		m_pMetrics = pMetrics;
+	}
+
+private:
+	/**
+	 * Output of select stage
+	 */
+	struct SSkeletonJob
+	{
+		bool			bActiveUser;
+		SSkeletonPose	mPose;			/**< Joints loaded, not transformed */
+		uint64_t		uTimestamp;
+	};
+
+	struct SColorizeJob
+	{
+		CUserFrame					mFrame;
+		nite::UserId				uActiveID;
+	};
+
+	void SelectStage();
+	void SkeletonStage();
+	void ColorizeStage();
+
+	void Notify( boost::atomic<bool>& bPending, QEvent::Type eType );
+
+	/**
+	 * Count the result of TBoundedQueue::Push()
+	 */
+	void CountPush( bool bPushed, bool bImage )
+	{
+		if( !bPushed && m_pMetrics != NULL )
+		{
+			if( bImage )
+				m_pMetrics->AddDroppedImage();
+			else
+				m_pMetrics->AddDroppedFrame();
+		}
+	}
+
+private:
+	QONI_UserMap&	m_rUserMap;
+	QObject*		m_pReceiver;
+	CMetrics*		m_pMetrics;
+
+	TBoundedQueue<CUserFrame>					m_qAcquired;
+	TBoundedQueue<SSkeletonJob>					m_qSkeleton;
+	TBoundedQueue<SColorizeJob>					m_qColorize;
+	TBoundedQueue<SGestureFrame>				m_qGesture;
+	TLatestMailbox<SUserImageBuffer>			m_mbImage;
+
+	boost::atomic<bool>			m_bGesturePending;
+	boost::atomic<bool>			m_bRenderPending;
+	boost::atomic<unsigned int>	m_uRendered;
+	boost::atomic<unsigned int>	m_uImageDropped;
+
+	bool			m_bRunning;
+	boost::thread	m_tSelect;
+	boost::thread	m_tSkeleton;
+	boost::thread	m_tColorize;
+};
@@ -0,0 +1,357 @@
+#include "Session.h"
+
+// STL Header
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace Session;
+
+static const char s_aMagic[8] = { 'Q', 'O', 'N', 'I', 'S', 'E', 'S', '1' };
+
+#pragma region CSessionRecorder
+CSessionRecorder::CSessionRecorder()
+{
+	m_uOffset = 0;
+}
+
+CSessionRecorder::~CSessionRecorder()
+{
+	Close();
+}
+
+bool CSessionRecorder::Open( const std::string& sFilename )
+{
+	Close();
+
+	boost::lock_guard<boost::mutex> lock( m_Mutex );
+	m_fsFile.open( sFilename.c_str(), std::ios::binary | std::ios::trunc );
+	if( !m_fsFile.is_open() )
+	{
+		std::cerr << "Can't create session file " << sFilename << std::endl;
+		return false;
+	}
+
+	// header is written again when closed
+	SSessionHeader mHeader = {};
+	m_fsFile.write( reinterpret_cast<const char*>( &mHeader ), sizeof( mHeader ) );
+	m_uOffset = sizeof( mHeader );
+	m_aIndex.clear();
+	return true;
+}
+
+void CSessionRecorder::Close()
+{
+	boost::lock_guard<boost::mutex> lock( m_Mutex );
+	if( !m_fsFile.is_open() )
+		return;
+
+	SSessionHeader mHeader = {};
+	std::memcpy( mHeader.aMagic, s_aMagic, sizeof( s_aMagic ) );
+	mHeader.uVersion		= FILE_VERSION;
+	mHeader.uFrameCount		= uint32_t( m_aIndex.size() );
+	mHeader.uIndexOffset	= m_uOffset;
+	mHeader.uUserDataSize	= sizeof( NiteUserData );
+
+	if( !m_aIndex.empty() )
+		m_fsFile.write( reinterpret_cast<const char*>( &m_aIndex[0] ), m_aIndex.size() * sizeof( uint64_t ) );
+	m_fsFile.seekp( 0 );
+	m_fsFile.write( reinterpret_cast<const char*>( &mHeader ), sizeof( mHeader ) );
+	m_fsFile.close();
+}
+
+bool CSessionRecorder::Write( const CUserFrame& rFrame )
+{
+	boost::lock_guard<boost::mutex> lock( m_Mutex );
+	if( !m_fsFile.is_open() || !rFrame.isValid() )
+		return false;
+
+	SFrameRecord mRecord = {};
+	mRecord.uTimestamp	= rFrame.getTimestamp();
+	mRecord.iFrameIndex	= rFrame.getFrameIndex();
+	mRecord.uWidth		= uint16_t( rFrame.getWidth() );
+	mRecord.uHeight		= uint16_t( rFrame.getHeight() );
+	mRecord.uUserCount	= uint32_t( rFrame.getUserCount() );
+
+	size_t uPixels = size_t( rFrame.getWidth() ) * rFrame.getHeight();
+	m_aIndex.push_back( m_uOffset );
+	m_fsFile.write( reinterpret_cast<const char*>( &mRecord ), sizeof( mRecord ) );
+	m_fsFile.write( reinterpret_cast<const char*>( rFrame.getDepth() ), uPixels * sizeof( openni::DepthPixel ) );
+	m_fsFile.write( reinterpret_cast<const char*>( rFrame.getUserMap() ), uPixels * sizeof( nite::UserId ) );
+	m_uOffset += sizeof( mRecord ) + uPixels * ( sizeof( openni::DepthPixel ) + sizeof( nite::UserId ) );
+	Pad();
+
+	// nite::UserData is a wrapper of NiteUserData without other members
+	if( mRecord.uUserCount > 0 )
+	{
+		size_t uBytes = mRecord.uUserCount * sizeof( NiteUserData );
+		m_fsFile.write( reinterpret_cast<const char*>( &rFrame.getUser( 0 ) ), uBytes );
+		m_uOffset += uBytes;
+		Pad();
+	}
+	return m_fsFile.good();
+}
+
+void CSessionRecorder::PrintStatistics() const
+{
+	std::cout << "Recorded frames: " << m_aIndex.size() << ", " << ( m_uOffset >> 20 ) << " MB" << std::endl;
+}
+
+void CSessionRecorder::Pad()
+{
+	static const char aZero[BLOCK_ALIGN] = {};
+	uint64_t uAligned = AlignBlock( m_uOffset );
+	m_fsFile.write( aZero, std::streamsize( uAligned - m_uOffset ) );
+	m_uOffset = uAligned;
+}
+#pragma endregion
+
+#pragma region CSessionPlayer
+CSessionPlayer::CSessionPlayer()
+{
+	m_pData			= NULL;
+	m_uSize			= 0;
+	m_pIndex		= NULL;
+	m_uFrameCount	= 0;
+	m_iNextFrame	= 0;
+	m_fSpeed		= 1.0f;
+	m_bLoop			= true;
+	m_bResync		= true;
+	m_bRunning		= false;
+	m_bStop			= false;
+}
+
+CSessionPlayer::~CSessionPlayer()
+{
+	Close();
+}
+
+bool CSessionPlayer::Open( const std::string& sFilename )
+{
+	Close();
+
+	using namespace boost::interprocess;
+	try
+	{
+		file_mapping mFile( sFilename.c_str(), read_only );
+		mapped_region mRegion( mFile, read_only );
+		m_mFile.swap( mFile );
+		m_mRegion.swap( mRegion );
+	}
+	catch( interprocess_exception& e )
+	{
+		std::cerr << "Can't open session file " << sFilename << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	const char* pData = static_cast<const char*>( m_mRegion.get_address() );
+	size_t uSize = m_mRegion.get_size();
+
+	// validate header and index
+	const SSessionHeader* pHeader = reinterpret_cast<const SSessionHeader*>( pData );
+	if( uSize < sizeof( SSessionHeader ) || std::memcmp( pHeader->aMagic, s_aMagic, sizeof( s_aMagic ) ) != 0 )
+	{
+		std::cerr << "Not a session file, or it is not closed: " << sFilename << std::endl;
+		Close();
+		return false;
+	}
+	if( pHeader->uVersion != FILE_VERSION || pHeader->uUserDataSize != sizeof( NiteUserData ) )
+	{
+		std::cerr << "Session file " << sFilename << " is recorded by an incompatible version" << std::endl;
+		Close();
+		return false;
+	}
+	if( pHeader->uIndexOffset + uint64_t( pHeader->uFrameCount ) * sizeof( uint64_t ) > uSize )
+	{
+		std::cerr << "Session file " << sFilename << " is truncated" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_pData			= pData;
+	m_uSize			= uSize;
+	m_pIndex		= reinterpret_cast<const uint64_t*>( pData + pHeader->uIndexOffset );
+	m_uFrameCount	= pHeader->uFrameCount;
+	m_iNextFrame	= 0;
+	m_bResync		= true;
+	return true;
+}
+
+void CSessionPlayer::Close()
+{
+	Stop();
+
+	boost::interprocess::mapped_region().swap( m_mRegion );
+	boost::interprocess::file_mapping().swap( m_mFile );
+	m_pData			= NULL;
+	m_uSize			= 0;
+	m_pIndex		= NULL;
+	m_uFrameCount	= 0;
+}
+
+int CSessionPlayer::GetWidth() const
+{
+	if( m_uFrameCount == 0 )
+		return 0;
+	return reinterpret_cast<const SFrameRecord*>( m_pData + m_pIndex[0] )->uWidth;
+}
+
+int CSessionPlayer::GetHeight() const
+{
+	if( m_uFrameCount == 0 )
+		return 0;
+	return reinterpret_cast<const SFrameRecord*>( m_pData + m_pIndex[0] )->uHeight;
+}
+
+bool CSessionPlayer::GetFrame( int iFrame, CUserFrame& rFrame ) const
+{
+	if( iFrame < 0 || uint32_t( iFrame ) >= m_uFrameCount )
+		return false;
+
+	uint64_t uOffset = m_pIndex[iFrame];
+	if( uOffset + sizeof( SFrameRecord ) > m_uSize )
+		return false;
+
+	const SFrameRecord* pRecord = reinterpret_cast<const SFrameRecord*>( m_pData + uOffset );
+	uint64_t uPixels = uint64_t( pRecord->uWidth ) * pRecord->uHeight,
+			 uDepth = uOffset + sizeof( SFrameRecord ),
+			 uUserMap = uDepth + uPixels * sizeof( openni::DepthPixel ),
+			 uUsers = AlignBlock( uUserMap + uPixels * sizeof( nite::UserId ) );
+	if( uUsers + uint64_t( pRecord->uUserCount ) * sizeof( NiteUserData ) > m_uSize )
+		return false;
+
+	rFrame.SetData( reinterpret_cast<const openni::DepthPixel*>( m_pData + uDepth ),
+					reinterpret_cast<const nite::UserId*>( m_pData + uUserMap ),
+					pRecord->uWidth, pRecord->uHeight,
+					reinterpret_cast<const NiteUserData*>( m_pData + uUsers ), pRecord->uUserCount,
+					pRecord->uTimestamp, pRecord->iFrameIndex );
+	return true;
+}
+
+void CSessionPlayer::Start( const TFrameSink& funcSink )
+{
+	if( m_bRunning || !IsOpen() )
+		return;
+
+	m_funcSink	= funcSink;
+	m_bStop		= false;
+	m_bResync	= true;
+	m_bRunning	= true;
+	m_tPlay		= boost::thread( [this](){ PlayLoop(); } );
+}
+
+void CSessionPlayer::Stop()
+{
+	if( !m_bRunning )
+		return;
+
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_cvControl.notify_all();
+	m_tPlay.join();
+	m_bRunning = false;
+}
+
+void CSessionPlayer::Seek( int iFrame )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_iNextFrame	= std::min( std::max( iFrame, 0 ), int( m_uFrameCount ) );
+		m_bResync		= true;
+	}
+	m_cvControl.notify_all();
+}
+
+int CSessionPlayer::GetPosition()
+{
+	boost::lock_guard<boost::mutex> lock( m_Mutex );
+	return m_iNextFrame;
+}
+
+void CSessionPlayer::SetSpeed( float fSpeed )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_fSpeed	= std::max( fSpeed, 0.0f );
+		m_bResync	= true;
+	}
+	m_cvControl.notify_all();
+}
+
+float CSessionPlayer::GetSpeed()
+{
+	boost::lock_guard<boost::mutex> lock( m_Mutex );
+	return m_fSpeed;
+}
+
+void CSessionPlayer::SetLoop( bool bLoop )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_bLoop = bLoop;
+	}
+	m_cvControl.notify_all();
+}
+
+void CSessionPlayer::PlayLoop()
+{
+	typedef boost::chrono::steady_clock	TClock;
+	TClock::time_point	tpBase;
+	uint64_t			uBaseTimestamp = 0;
+	CUserFrame			mFrame;
+	Trace::SetThreadName( "Session player" );
+
+	boost::unique_lock<boost::mutex> lock( m_Mutex );
+	while( !m_bStop )
+	{
+		if( m_iNextFrame >= int( m_uFrameCount ) )
+		{
+			if( m_bLoop && m_uFrameCount > 0 )
+			{
+				m_iNextFrame	= 0;
+				m_bResync		= true;
+			}
+			else
+			{
+				// wait for seek or stop
+				m_cvControl.wait( lock );
+			}
+			continue;
+		}
+
+		if( !GetFrame( m_iNextFrame, mFrame ) )
+		{
+			std::cerr << "Session frame " << m_iNextFrame << " is broken" << std::endl;
+			++ m_iNextFrame;
+			continue;
+		}
+
+		// timing is relative to the first frame after seek or speed change
+		if( m_bResync )
+		{
+			tpBase			= TClock::now();
+			uBaseTimestamp	= mFrame.getTimestamp();
+			m_bResync		= false;
+		}
+
+		if( m_fSpeed > 0 && mFrame.getTimestamp() > uBaseTimestamp )
+		{
+			double dDelay = ( mFrame.getTimestamp() - uBaseTimestamp ) / m_fSpeed;
+			TClock::time_point tpDue = tpBase + boost::chrono::microseconds( int64_t( dDelay ) );
+			if( TClock::now() < tpDue )
+			{
+				// woken up early by seek, speed change or stop
+				m_cvControl.wait_until( lock, tpDue );
+				continue;
+			}
+		}
+
+		++ m_iNextFrame;
+		lock.unlock();
+		m_funcSink( mFrame );
+		lock.lock();
+	}
+}
+#pragma endregion
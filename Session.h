@@ -0,0 +1,222 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Boost Header
+#include <boost/chrono.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/thread.hpp>
+
+// Application header
+#include "UserFrame.h"
+#pragma endregion
+
+/**
+ * Session file format, all values are little-endian and every block is 8-byte aligned.
+ *
+ *   SSessionHeader
+ *   frame 0: SFrameRecord, depth (w*h uint16), user map (w*h int16), NiteUserData[uUserCount]
+ *   frame 1: ...
+ *   index:   uint64 file offset of each frame
+ *
+ * The users are stored as raw NiteUserData, so a file can only be replayed by the build of
+ * the same NiTE version; uUserDataSize is checked when open.
+ */
+namespace Session
+{
+	struct SSessionHeader
+	{
+		char		aMagic[8];		/**< "QONISES1" */
+		uint32_t	uVersion;
+		uint32_t	uFrameCount;
+		uint64_t	uIndexOffset;
+		uint32_t	uUserDataSize;	/**< sizeof(NiteUserData) when recording */
+		uint32_t	uReserved;
+	};
+
+	struct SFrameRecord
+	{
+		uint64_t	uTimestamp;		/**< sensor timestamp in microseconds */
+		int32_t		iFrameIndex;
+		uint16_t	uWidth;
+		uint16_t	uHeight;
+		uint32_t	uUserCount;
+		uint32_t	uReserved;
+	};
+
+	enum
+	{
+		FILE_VERSION	= 1,
+		BLOCK_ALIGN		= 8,
+	};
+
+	inline uint64_t AlignBlock( uint64_t uSize )
+	{
+		return ( uSize + BLOCK_ALIGN - 1 ) & ~uint64_t( BLOCK_ALIGN - 1 );
+	}
+}
+
+/**
+ * Interface of session recorders.
+ * Write() may be called by the frame thread, Close() after no more frames come.
+ */
+class CSessionWriter
+{
+public:
+	virtual ~CSessionWriter()
+	{
+	}
+
+	virtual bool Open( const std::string& sFilename ) = 0;
+
+	virtual void Close() = 0;
+
+	virtual bool IsOpen() const = 0;
+
+	virtual bool Write( const CUserFrame& rFrame ) = 0;
+
+	virtual unsigned int GetFrameCount() const = 0;
+
+	/**
+	 * Print the recording result
+	 */
+	virtual void PrintStatistics() const = 0;
+};
+
+/**
+ * Write user frames into a session file, without compression.
+ */
+class CSessionRecorder : public CSessionWriter
+{
+public:
+	CSessionRecorder();
+	~CSessionRecorder();
+
+	bool Open( const std::string& sFilename );
+
+	/**
+	 * Write the index and header, the file is not playable before closed
+	 */
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_fsFile.is_open();
+	}
+
+	bool Write( const CUserFrame& rFrame );
+
+	unsigned int GetFrameCount() const
+	{
+		return (unsigned int)m_aIndex.size();
+	}
+
+	void PrintStatistics() const;
+
+private:
+	void Pad();
+
+private:
+	std::ofstream			m_fsFile;
+	std::vector<uint64_t>	m_aIndex;
+	uint64_t				m_uOffset;
+	boost::mutex			m_Mutex;
+};
+
+/**
+ * Replay a session file by memory mapping.
+ *
+ * The frames point into the mapped file without copy, so they are valid until Close().
+ * A thread send the frames to sink with the recorded timing, scaled by playback speed.
+ */
+class CSessionPlayer
+{
+public:
+	typedef std::function<void(const CUserFrame&)>	TFrameSink;
+
+public:
+	CSessionPlayer();
+	~CSessionPlayer();
+
+	bool Open( const std::string& sFilename );
+
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_pData != NULL;
+	}
+
+	int GetFrameCount() const
+	{
+		return int( m_uFrameCount );
+	}
+
+	/**
+	 * Size of the first frame
+	 */
+	int GetWidth() const;
+	int GetHeight() const;
+
+	/**
+	 * Get the frame at position iFrame of file
+	 */
+	bool GetFrame( int iFrame, CUserFrame& rFrame ) const;
+
+	/**
+	 * Start playback from current position
+	 */
+	void Start( const TFrameSink& funcSink );
+
+	void Stop();
+
+	/**
+	 * Move to position iFrame of file, can be called while playing
+	 */
+	void Seek( int iFrame );
+
+	/**
+	 * The position of next frame to play
+	 */
+	int GetPosition();
+
+	/**
+	 * Playback speed relative to recording, 0 to play as fast as possible
+	 */
+	void SetSpeed( float fSpeed );
+
+	float GetSpeed();
+
+	/**
+	 * Restart from the first frame at end of file
+	 */
+	void SetLoop( bool bLoop );
+
+private:
+	void PlayLoop();
+
+private:
+	boost::interprocess::file_mapping	m_mFile;
+	boost::interprocess::mapped_region	m_mRegion;
+	const char*							m_pData;
+	size_t								m_uSize;
+	const uint64_t*						m_pIndex;
+	uint32_t							m_uFrameCount;
+
+	TFrameSink					m_funcSink;
+	boost::thread				m_tPlay;
+	boost::mutex				m_Mutex;
+	boost::condition_variable	m_cvControl;
+	int							m_iNextFrame;
+	float						m_fSpeed;
+	bool						m_bLoop;
+	bool						m_bResync;
+	bool						m_bRunning;
+	bool						m_bStop;
+};
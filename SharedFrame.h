@@ -0,0 +1,119 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#pragma endregion
+
+// the atomics are shared by processes, so they can't be emulated by a lock
+#if BOOST_ATOMIC_INT32_LOCK_FREE != 2 || BOOST_ATOMIC_INT64_LOCK_FREE != 2
+	#error Shared frames need lock-free 32 and 64 bit atomics
+#endif
+
+/**
+ * Layout of the shared memory written by CSharedPublisher and read by CSharedFrameReader.
+ * Only this header, SharedReader.h and SharedReader.cpp are needed by other applications.
+ *
+ *   SSharedHeader
+ *   slot 0: SSharedSlot, user map (uMapBytes)
+ *   slot 1: ...
+ *
+ * Frame n is written into slot n % uSlotCount, so a reader of the latest frame only meets the
+ * writer if it is uSlotCount - 1 frames late. Each slot is a seqlock: uSequence is odd while the
+ * slot is written, and a copy is valid if uSequence is the same even value before and after it.
+ * Readers never block the publisher.
+ */
+namespace SharedFrame
+{
+	enum
+	{
+		LAYOUT_VERSION	= 1,
+		MAX_USERS		= 8,
+		JOINTS			= 15,		/**< nite::JointType */
+		SLOT_ALIGN		= 64,
+	};
+
+	/**
+	 * One user of a frame; status values are CHandControl::EControlStatus and EHandState
+	 */
+	struct SSharedUser
+	{
+		int32_t		iUserID;
+		int32_t		iSlot;				/**< Slot of gesture engine, kept while the user is tracked */
+		int32_t		iControlStatus;		/**< NO_HAND, STANDBY, FIXING, FIXED, INPUT */
+		int32_t		iHandState;			/**< GENERAL, FIXING, FIXED */
+		int32_t		iControlHand;		/**< 0 none, 1 right, 2 left */
+		int32_t		bInput;				/**< The buttons of this user send keys */
+		int32_t		bHandVisible;
+		int32_t		bButtonsVisible;
+		int32_t		iPage;				/**< Page of button layout */
+		float		fFixProgress;		/**< 0 - 1 */
+		float		aHand2D[2];			/**< Control hand in view */
+		float		aButtonOrigin[2];	/**< Buttons are relative to it, in view */
+		float		aTorsoOrientation[4];	/**< x, y, z, w */
+		float		aJoint[JOINTS][4];	/**< x, y, z (mm) and confidence from NiTE */
+		float		aRotated[JOINTS][3];	/**< Relative to torso */
+		float		aJoint2D[JOINTS][2];	/**< Projected in view */
+	};
+
+	struct SSharedFrame
+	{
+		uint64_t	uFrameNumber;		/**< 1 for the first frame published */
+		uint64_t	uTimestamp;			/**< Sensor timestamp in microseconds, 0 when all users are lost without frame */
+		int64_t		iPublishTime;		/**< Steady clock microseconds when published, to measure delay */
+		int32_t		iFrameIndex;
+		uint32_t	uUserCount;			/**< Users with skeleton, the nearest first */
+		uint16_t	uMapWidth;			/**< 0 if there is no user map */
+		uint16_t	uMapHeight;
+		uint32_t	uReserved;
+		SSharedUser	aUsers[MAX_USERS];
+	};
+
+	/**
+	 * Frame in ring, followed by the user map of uMapWidth x uMapHeight bytes (user ID)
+	 */
+	struct SSharedSlot
+	{
+		boost::atomic<uint32_t>	uSequence;
+		uint32_t				uReserved;
+		SSharedFrame			mFrame;
+	};
+
+	struct SSharedHeader
+	{
+		char		aMagic[8];			/**< "NICSHM01" */
+		uint32_t	uVersion;			/**< LAYOUT_VERSION */
+		uint32_t	uSlotCount;
+		uint32_t	uSlotSize;			/**< Bytes of a slot with user map, aligned to SLOT_ALIGN */
+		uint32_t	uMapBytes;			/**< Largest user map of a slot, 0 if not published */
+		boost::atomic<uint64_t>	uLatest;	/**< Frame number of the last committed frame, 0 if none */
+	};
+
+	static const char s_aMagic[8] = { 'N', 'I', 'C', 'S', 'H', 'M', '0', '1' };
+
+	inline uint32_t AlignSlot( uint64_t uSize )
+	{
+		return uint32_t( ( uSize + SLOT_ALIGN - 1 ) & ~uint64_t( SLOT_ALIGN - 1 ) );
+	}
+
+	inline uint32_t HeaderSize()
+	{
+		return AlignSlot( sizeof( SSharedHeader ) );
+	}
+
+	/**
+	 * Slot of frame uFrameNumber in the mapped memory
+	 */
+	inline SSharedSlot* GetSlot( void* pBase, uint64_t uFrameNumber )
+	{
+		const SSharedHeader* pHeader = static_cast<const SSharedHeader*>( pBase );
+		return reinterpret_cast<SSharedSlot*>( static_cast<char*>( pBase ) + HeaderSize() + ( uFrameNumber % pHeader->uSlotCount ) * pHeader->uSlotSize );
+	}
+
+	inline uint8_t* GetUserMap( SSharedSlot* pSlot )
+	{
+		return reinterpret_cast<uint8_t*>( pSlot ) + AlignSlot( sizeof( SSharedSlot ) );
+	}
+}
@@ -0,0 +1,136 @@
+#include "SharedPublisher.h"
+
+// STL Header
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+// Boost Header
+#include <boost/chrono.hpp>
+
+using namespace SharedFrame;
+
+CSharedPublisher::CSharedPublisher()
+{
+	m_pBase			= NULL;
+	m_pSlot			= NULL;
+	m_uFrameNumber	= 0;
+	m_iUserMapStep	= 0;
+	m_uMapBytes		= 0;
+}
+
+CSharedPublisher::~CSharedPublisher()
+{
+	Close();
+}
+
+bool CSharedPublisher::Open( const std::string& sName, int iSlots, int iUserMapStep, int iWidth, int iHeight )
+{
+	Close();
+
+	m_iUserMapStep	= std::max( iUserMapStep, 0 );
+	m_uMapBytes		= m_iUserMapStep > 0 ? uint32_t( iWidth / m_iUserMapStep ) * ( iHeight / m_iUserMapStep ) : 0;
+	uint32_t uSlots		= uint32_t( std::max( iSlots, 2 ) ),
+			 uSlotSize	= AlignSlot( AlignSlot( sizeof( SSharedSlot ) ) + m_uMapBytes );
+
+	// a publisher which didn't close leaves the memory, readers of it see no new frame
+	using namespace boost::interprocess;
+	shared_memory_object::remove( sName.c_str() );
+	try
+	{
+		shared_memory_object mShm( create_only, sName.c_str(), read_write );
+		mShm.truncate( offset_t( HeaderSize() ) + offset_t( uSlots ) * uSlotSize );
+		mapped_region mRegion( mShm, read_write );
+		m_mShm.swap( mShm );
+		m_mRegion.swap( mRegion );
+	}
+	catch( interprocess_exception& e )
+	{
+		std::cerr << "Can't create shared memory " << sName << ": " << e.what() << std::endl;
+		shared_memory_object::remove( sName.c_str() );
+		return false;
+	}
+	m_sName = sName;
+	m_pBase = m_mRegion.get_address();
+
+	// the magic is written last, so readers don't use a header being built
+	SSharedHeader* pHeader = new( m_pBase ) SSharedHeader();
+	pHeader->uVersion	= LAYOUT_VERSION;
+	pHeader->uSlotCount	= uSlots;
+	pHeader->uSlotSize	= uSlotSize;
+	pHeader->uMapBytes	= m_uMapBytes;
+	pHeader->uLatest.store( 0 );
+	for( uint32_t i = 0; i < uSlots; ++ i )
+		new( GetSlot( m_pBase, i ) ) SSharedSlot();
+	boost::atomic_thread_fence( boost::memory_order_release );
+	std::memcpy( pHeader->aMagic, s_aMagic, sizeof( s_aMagic ) );
+
+	m_uFrameNumber = 0;
+	std::cout << "Publish frames to shared memory " << sName << std::endl;
+	return true;
+}
+
+void CSharedPublisher::Close()
+{
+	if( m_pBase == NULL )
+		return;
+
+	boost::interprocess::mapped_region().swap( m_mRegion );
+	boost::interprocess::shared_memory_object().swap( m_mShm );
+	boost::interprocess::shared_memory_object::remove( m_sName.c_str() );
+	m_pBase = NULL;
+	m_pSlot = NULL;
+}
+
+SSharedFrame* CSharedPublisher::Begin()
+{
+	if( m_pBase == NULL )
+		return NULL;
+
+	// odd sequence: readers of this slot retry or give up
+	m_pSlot = GetSlot( m_pBase, ++ m_uFrameNumber );
+	m_pSlot->uSequence.store( m_pSlot->uSequence.load( boost::memory_order_relaxed ) + 1, boost::memory_order_relaxed );
+	boost::atomic_thread_fence( boost::memory_order_release );
+
+	SSharedFrame& rFrame = m_pSlot->mFrame;
+	rFrame.uFrameNumber	= m_uFrameNumber;
+	rFrame.uTimestamp	= 0;
+	rFrame.iFrameIndex	= 0;
+	rFrame.uUserCount	= 0;
+	rFrame.uMapWidth	= 0;
+	rFrame.uMapHeight	= 0;
+	return &rFrame;
+}
+
+void CSharedPublisher::Commit( const int16_t* pUserMap, int iWidth, int iHeight )
+{
+	if( m_pSlot == NULL )
+		return;
+
+	SSharedFrame& rFrame = m_pSlot->mFrame;
+	if( m_iUserMapStep > 0 && pUserMap != NULL )
+	{
+		int iStep = m_iUserMapStep,
+			iMapWidth = iWidth / iStep,
+			iMapHeight = iHeight / iStep;
+		if( uint32_t( iMapWidth ) * iMapHeight <= m_uMapBytes )
+		{
+			uint8_t* pPixels = GetUserMap( m_pSlot );
+			for( int y = 0; y < iMapHeight; ++ y )
+			{
+				const int16_t* pRow = pUserMap + size_t( y * iStep ) * iWidth;
+				for( int x = 0; x < iMapWidth; ++ x )
+					*pPixels++ = uint8_t( pRow[x * iStep] );
+			}
+			rFrame.uMapWidth	= uint16_t( iMapWidth );
+			rFrame.uMapHeight	= uint16_t( iMapHeight );
+		}
+	}
+	rFrame.iPublishTime = boost::chrono::duration_cast<boost::chrono::microseconds>( boost::chrono::steady_clock::now().time_since_epoch() ).count();
+
+	// even sequence: the slot is complete, then it becomes the latest
+	m_pSlot->uSequence.store( m_pSlot->uSequence.load( boost::memory_order_relaxed ) + 1, boost::memory_order_release );
+	static_cast<SSharedHeader*>( m_pBase )->uLatest.store( m_uFrameNumber, boost::memory_order_release );
+	m_pSlot = NULL;
+}
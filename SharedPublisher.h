@@ -0,0 +1,68 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <string>
+
+// Boost Header
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+// Application header
+#include "SharedFrame.h"
+#pragma endregion
+
+/**
+ * Publish the users and hand control of each frame into a ring in shared memory, for other
+ * processes on the same computer to read by CSharedFrameReader.
+ *
+ * The frame is written in place, and readers copy it without any lock, so the publisher never
+ * waits for them. There must be only one publisher of a name; the shared memory is removed
+ * when closed.
+ */
+class CSharedPublisher
+{
+public:
+	CSharedPublisher();
+	~CSharedPublisher();
+
+	/**
+	 * Create shared memory sName of iSlots frames; user maps are published only if
+	 * iUserMapStep > 0, sampled every iUserMapStep pixels of a iWidth x iHeight frame.
+	 */
+	bool Open( const std::string& sName, int iSlots = 4, int iUserMapStep = 0, int iWidth = 640, int iHeight = 480 );
+
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_pBase != NULL;
+	}
+
+	/**
+	 * Start writing the next frame, NULL if not open. The frame is cleared but its users are
+	 * not; it is not seen by readers until Commit().
+	 */
+	SharedFrame::SSharedFrame* Begin();
+
+	/**
+	 * Copy the user map (nite::UserId of each pixel) if wanted, and publish the frame begun;
+	 * pUserMap can be NULL
+	 */
+	void Commit( const int16_t* pUserMap = NULL, int iWidth = 0, int iHeight = 0 );
+
+	uint64_t GetPublished() const
+	{
+		return m_uFrameNumber;
+	}
+
+private:
+	std::string								m_sName;
+	boost::interprocess::shared_memory_object	m_mShm;
+	boost::interprocess::mapped_region		m_mRegion;
+	void*									m_pBase;
+	SharedFrame::SSharedSlot*				m_pSlot;		/**< Slot being written */
+	uint64_t								m_uFrameNumber;	/**< Number of the last frame begun */
+	int										m_iUserMapStep;
+	uint32_t								m_uMapBytes;
+};
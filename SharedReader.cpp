@@ -0,0 +1,112 @@
+#include "SharedReader.h"
+
+// STL Header
+#include <cstring>
+#include <iostream>
+
+using namespace SharedFrame;
+
+enum
+{
+	READ_RETRIES	= 4,
+};
+
+CSharedFrameReader::CSharedFrameReader()
+{
+	m_pBase			= NULL;
+	m_uLastFrame	= 0;
+	m_uSkipped		= 0;
+	m_uRetries		= 0;
+}
+
+bool CSharedFrameReader::Open( const std::string& sName )
+{
+	Close();
+
+	// read-write, as a 64 bit atomic load may be a compare-exchange on 32 bit systems
+	using namespace boost::interprocess;
+	try
+	{
+		shared_memory_object mShm( open_only, sName.c_str(), read_write );
+		mapped_region mRegion( mShm, read_write );
+		m_mShm.swap( mShm );
+		m_mRegion.swap( mRegion );
+	}
+	catch( interprocess_exception& e )
+	{
+		std::cerr << "Can't open shared memory " << sName << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	// the magic is written after the rest of header
+	const SSharedHeader* pHeader = static_cast<const SSharedHeader*>( m_mRegion.get_address() );
+	size_t uSize = m_mRegion.get_size();
+	if( uSize < HeaderSize() || std::memcmp( pHeader->aMagic, s_aMagic, sizeof( s_aMagic ) ) != 0 )
+	{
+		std::cerr << "Shared memory " << sName << " is not ready" << std::endl;
+		Close();
+		return false;
+	}
+	boost::atomic_thread_fence( boost::memory_order_acquire );
+	if( pHeader->uVersion != LAYOUT_VERSION || pHeader->uSlotCount == 0 ||
+		uint64_t( HeaderSize() ) + uint64_t( pHeader->uSlotCount ) * pHeader->uSlotSize > uSize )
+	{
+		std::cerr << "Shared memory " << sName << " is published by an incompatible version" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_pBase			= m_mRegion.get_address();
+	m_uLastFrame	= 0;
+	m_uSkipped		= 0;
+	m_uRetries		= 0;
+	return true;
+}
+
+void CSharedFrameReader::Close()
+{
+	boost::interprocess::mapped_region().swap( m_mRegion );
+	boost::interprocess::shared_memory_object().swap( m_mShm );
+	m_pBase = NULL;
+}
+
+bool CSharedFrameReader::ReadLatest( SSharedFrame& rFrame, std::vector<uint8_t>* pUserMap )
+{
+	if( m_pBase == NULL )
+		return false;
+
+	const SSharedHeader* pHeader = static_cast<const SSharedHeader*>( m_pBase );
+	for( int iTry = 0; iTry < READ_RETRIES; ++ iTry )
+	{
+		uint64_t uLatest = pHeader->uLatest.load( boost::memory_order_acquire );
+		if( uLatest == 0 || uLatest == m_uLastFrame )
+			return false;
+
+		SSharedSlot* pSlot = GetSlot( m_pBase, uLatest );
+		uint32_t uSequence = pSlot->uSequence.load( boost::memory_order_acquire );
+		if( uSequence % 2 == 0 )
+		{
+			std::memcpy( &rFrame, &( pSlot->mFrame ), sizeof( rFrame ) );
+			size_t uMapBytes = size_t( rFrame.uMapWidth ) * rFrame.uMapHeight;
+			if( pUserMap != NULL && uMapBytes <= pHeader->uMapBytes )
+			{
+				pUserMap->resize( uMapBytes );
+				if( uMapBytes > 0 )
+					std::memcpy( pUserMap->data(), GetUserMap( pSlot ), uMapBytes );
+			}
+
+			// the copy is valid if the slot is not written meanwhile, and is still the same frame
+			boost::atomic_thread_fence( boost::memory_order_acquire );
+			if( pSlot->uSequence.load( boost::memory_order_relaxed ) == uSequence && rFrame.uFrameNumber == uLatest &&
+				rFrame.uUserCount <= MAX_USERS )
+			{
+				if( m_uLastFrame > 0 && uLatest > m_uLastFrame + 1 )
+					m_uSkipped += uLatest - m_uLastFrame - 1;
+				m_uLastFrame = uLatest;
+				return true;
+			}
+		}
+		++ m_uRetries;
+	}
+	return false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Boost Header
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+// Application header
+#include "SharedFrame.h"
+#pragma endregion
+
+/**
+ * Read the frames of CSharedPublisher from another process; it doesn't need OpenNI, NiTE or Qt.
+ * Any number of readers can read the same memory, and they are never waited by the publisher.
+ *
+ *	CSharedFrameReader mReader;
+ *	SharedFrame::SSharedFrame mFrame;
+ *	if( mReader.Open( "NIController" ) )
+ *		while( ... )
+ *			if( mReader.ReadLatest( mFrame ) )
+ *				use mFrame.aUsers[0 .. mFrame.uUserCount - 1]
+ */
+class CSharedFrameReader
+{
+public:
+	CSharedFrameReader();
+
+	/**
+	 * Map the shared memory sName, return false if it is not published or of another version
+	 */
+	bool Open( const std::string& sName );
+
+	void Close();
+
+	bool IsOpen() const
+	{
+		return m_pBase != NULL;
+	}
+
+	/**
+	 * Copy the latest frame into rFrame, and its user map into pUserMap if not NULL.
+	 * Return false if there is no frame newer than the last one read.
+	 */
+	bool ReadLatest( SharedFrame::SSharedFrame& rFrame, std::vector<uint8_t>* pUserMap = NULL );
+
+	/**
+	 * Frames published but not read, because a newer one was read
+	 */
+	uint64_t GetSkipped() const
+	{
+		return m_uSkipped;
+	}
+
+	/**
+	 * Copies thrown away because the publisher was writing the slot
+	 */
+	uint64_t GetRetries() const
+	{
+		return m_uRetries;
+	}
+
+private:
+	boost::interprocess::shared_memory_object	m_mShm;
+	boost::interprocess::mapped_region		m_mRegion;
+	void*									m_pBase;
+	uint64_t								m_uLastFrame;
+	uint64_t								m_uSkipped;
+	uint64_t								m_uRetries;
+};
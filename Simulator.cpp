@@ -0,0 +1,456 @@
+#include "Simulator.h"
+
+// STL Header
+#include <algorithm>
+#include <cmath>
+
+// Boost Header
+#include <boost/chrono.hpp>
+
+enum
+{
+	SCRIPT_FPS			= 30,
+	CALIBRATION_FRAMES	= 15,
+	BACKGROUND_DEPTH	= 4500,	/**< Depth of back wall (mm) */
+	SENSOR_HEIGHT		= 1000,	/**< Height of sensor above floor (mm) */
+};
+
+/**
+ * Duration of script phases in seconds
+ */
+enum EScriptPhase
+{
+	SP_WALK_IN,
+	SP_RAISE,
+	SP_HOLD,
+	SP_MOVE,
+	SP_PRESS,
+	SP_LOWER,
+	SP_LEAVE,
+	SP_ABSENT,
+	SP_COUNT,
+};
+static const float s_aPhaseTime[SP_COUNT] = { 2.0f, 0.5f, 1.0f, 0.3f, 1.0f, 0.5f, 2.0f, 1.0f };
+
+/**
+ * Joint positions relative to torso when standing with hands down (mm)
+ */
+static const float s_aRestPose[NITE_JOINT_COUNT][3] = {
+	{    0,   450, 0 },		// head
+	{    0,   300, 0 },		// neck
+	{ -180,   280, 0 },		// left shoulder
+	{  180,   280, 0 },		// right shoulder
+	{ -200,    30, 0 },		// left elbow
+	{  200,    30, 0 },		// right elbow
+	{ -220,  -200, 0 },		// left hand
+	{  220,  -200, 0 },		// right hand
+	{    0,     0, 0 },		// torso
+	{ -100,  -200, 0 },		// left hip
+	{  100,  -200, 0 },		// right hip
+	{ -100,  -600, 0 },		// left knee
+	{  100,  -600, 0 },		// right knee
+	{ -100, -1000, 0 },		// left foot
+	{  100, -1000, 0 },		// right foot
+};
+
+/**
+ * Right hand and elbow when raised forward
+ */
+static const float s_aRaisedHand[3]		= { 150, 150, -450 };
+static const float s_aRaisedElbow[3]	= { 190, 120, -220 };
+
+/**
+ * Bones to draw into depth map, with radius (mm)
+ */
+static const struct SBone
+{
+	int		iFrom;
+	int		iTo;
+	float	fRadius;
+} s_aBones[] = {
+	{ NITE_JOINT_HEAD,				NITE_JOINT_NECK,			100 },
+	{ NITE_JOINT_NECK,				NITE_JOINT_TORSO,			170 },
+	{ NITE_JOINT_TORSO,				NITE_JOINT_LEFT_HIP,		140 },
+	{ NITE_JOINT_TORSO,				NITE_JOINT_RIGHT_HIP,		140 },
+	{ NITE_JOINT_LEFT_SHOULDER,		NITE_JOINT_RIGHT_SHOULDER,	60 },
+	{ NITE_JOINT_LEFT_SHOULDER,		NITE_JOINT_LEFT_ELBOW,		50 },
+	{ NITE_JOINT_LEFT_ELBOW,		NITE_JOINT_LEFT_HAND,		45 },
+	{ NITE_JOINT_RIGHT_SHOULDER,	NITE_JOINT_RIGHT_ELBOW,		50 },
+	{ NITE_JOINT_RIGHT_ELBOW,		NITE_JOINT_RIGHT_HAND,		45 },
+	{ NITE_JOINT_LEFT_HIP,			NITE_JOINT_LEFT_KNEE,		70 },
+	{ NITE_JOINT_LEFT_KNEE,			NITE_JOINT_LEFT_FOOT,		55 },
+	{ NITE_JOINT_RIGHT_HIP,			NITE_JOINT_RIGHT_KNEE,		70 },
+	{ NITE_JOINT_RIGHT_KNEE,		NITE_JOINT_RIGHT_FOOT,		55 },
+};
+
+static float SmoothStep( float t )
+{
+	t = std::min( std::max( t, 0.0f ), 1.0f );
+	return t * t * ( 3 - 2 * t );
+}
+
+CSimulatedSource::CSimulatedSource()
+{
+	m_fFocal		= 0;
+	m_uNextBuffer	= 0;
+	m_iFrameIndex	= 0;
+	m_bRunning		= false;
+	m_bStop			= false;
+	m_fRate			= 0;
+	m_uFrames		= 0;
+}
+
+CSimulatedSource::~CSimulatedSource()
+{
+	Close();
+}
+
+void CSimulatedSource::Open( const SSimulatorConfig& rConfig )
+{
+	Close();
+
+	m_Config		= rConfig;
+	m_Config.iUsers	= std::max( m_Config.iUsers, 0 );
+	m_uNextBuffer	= 0;
+	m_iFrameIndex	= 0;
+	m_uFrames		= 0;
+	m_Random.seed( m_Config.uSeed );
+
+	// 58 degree horizontal field of view, like PrimeSense sensors
+	int w = m_Config.iWidth, h = m_Config.iHeight;
+	m_fFocal = w * 0.5f / std::tan( 29.0f * 3.14159265f / 180 );
+
+	// back wall and floor
+	m_aBackground.resize( size_t( w ) * h );
+	for( int y = 0; y < h; ++ y )
+	{
+		float fBelow = y - h * 0.5f;
+		openni::DepthPixel uDepth = BACKGROUND_DEPTH;
+		if( fBelow > 0 )
+			uDepth = openni::DepthPixel( std::min( m_fFocal * SENSOR_HEIGHT / fBelow, float( BACKGROUND_DEPTH ) ) );
+		std::fill_n( m_aBackground.begin() + size_t( y ) * w, w, uDepth );
+	}
+
+	m_aBuffers.resize( std::max( m_Config.uBuffers, 2u ) );
+	for( auto itBuf = m_aBuffers.begin(); itBuf != m_aBuffers.end(); ++ itBuf )
+	{
+		itBuf->aDepth.resize( size_t( w ) * h );
+		itBuf->aUserMap.resize( size_t( w ) * h );
+		itBuf->aUsers.reserve( m_Config.iUsers );
+	}
+
+	SUserState mState = { 0 };
+	m_aUserState.assign( m_Config.iUsers, mState );
+}
+
+void CSimulatedSource::Close()
+{
+	Stop();
+	m_aBuffers.clear();
+	m_aUserState.clear();
+}
+
+void CSimulatedSource::GenerateFrame( CUserFrame& rFrame )
+{
+	SFrameBuffer& rBuffer = m_aBuffers[m_uNextBuffer];
+	m_uNextBuffer = ( m_uNextBuffer + 1 ) % m_aBuffers.size();
+
+	std::copy( m_aBackground.begin(), m_aBackground.end(), rBuffer.aDepth.begin() );
+	std::fill( rBuffer.aUserMap.begin(), rBuffer.aUserMap.end(), nite::UserId( 0 ) );
+	rBuffer.aUsers.clear();
+
+	double dTime = double( m_iFrameIndex ) / SCRIPT_FPS;
+	for( int i = 0; i < m_Config.iUsers; ++ i )
+	{
+		SUserState& rState = m_aUserState[i];
+		SScriptState mScript = EvaluateScript( i, dTime );
+
+		// user is detected when the body enters the field of view
+		float fHalfView = mScript.fZ * m_Config.iWidth * 0.5f / m_fFocal;
+		bool bVisible = mScript.bPresent && std::fabs( mScript.fX ) < fHalfView + 200;
+		if( !bVisible && rState.iVisibleFrames == 0 )
+			continue;
+
+		rBuffer.aUsers.push_back( NiteUserData() );
+		NiteUserData& rUser = rBuffer.aUsers.back();
+		rUser.id = nite::UserId( i + 1 );
+
+		if( !bVisible )
+		{
+			// report lost once, then remove
+			rUser.state				= NITE_USER_STATE_LOST;
+			rState.iVisibleFrames	= 0;
+			continue;
+		}
+
+		rUser.state = NITE_USER_STATE_VISIBLE | ( rState.iVisibleFrames == 0 ? NITE_USER_STATE_NEW : 0 );
+		++ rState.iVisibleFrames;
+
+		BuildSkeleton( mScript, rUser.skeleton );
+		rUser.skeleton.state = ( rState.iVisibleFrames > CALIBRATION_FRAMES ? NITE_SKELETON_TRACKED : NITE_SKELETON_CALIBRATING );
+		rUser.centerOfMass = rUser.skeleton.joints[NITE_JOINT_TORSO].position;
+		rUser.boundingBox.min = rUser.boundingBox.max = rUser.centerOfMass;
+		for( int j = 0; j < NITE_JOINT_COUNT; ++ j )
+		{
+			const NitePoint3f& rPos = rUser.skeleton.joints[j].position;
+			rUser.boundingBox.min.x = std::min( rUser.boundingBox.min.x, rPos.x );
+			rUser.boundingBox.min.y = std::min( rUser.boundingBox.min.y, rPos.y );
+			rUser.boundingBox.min.z = std::min( rUser.boundingBox.min.z, rPos.z );
+			rUser.boundingBox.max.x = std::max( rUser.boundingBox.max.x, rPos.x );
+			rUser.boundingBox.max.y = std::max( rUser.boundingBox.max.y, rPos.y );
+			rUser.boundingBox.max.z = std::max( rUser.boundingBox.max.z, rPos.z );
+		}
+
+		DrawUser( rUser.skeleton, rUser.id, rBuffer );
+	}
+
+	rFrame.SetData( &rBuffer.aDepth[0], &rBuffer.aUserMap[0], m_Config.iWidth, m_Config.iHeight,
+					rBuffer.aUsers.empty() ? NULL : &rBuffer.aUsers[0], int( rBuffer.aUsers.size() ),
+					uint64_t( m_iFrameIndex ) * 1000000 / SCRIPT_FPS, m_iFrameIndex );
+	++ m_iFrameIndex;
+	m_uFrames.fetch_add( 1, boost::memory_order_relaxed );
+}
+
+CSimulatedSource::SScriptState CSimulatedSource::EvaluateScript( int iUser, double dTime ) const
+{
+	float fCycle = 0;
+	for( int i = 0; i < SP_COUNT; ++ i )
+		fCycle += s_aPhaseTime[i];
+
+	// users stand side by side, the first is nearest
+	float fLane = ( iUser - ( m_Config.iUsers - 1 ) * 0.5f ) * 700;
+	float t = float( std::fmod( dTime + iUser * 1.3, double( fCycle ) ) );
+
+	SScriptState mState;
+	mState.bPresent	= true;
+	mState.fX		= fLane;
+	mState.fZ		= 2000.0f + iUser * 400;
+	mState.fWalk	= 0;
+	mState.fRaise	= 0;
+	mState.fShift	= 0;
+
+	int iPhase = 0;
+	while( iPhase < SP_COUNT - 1 && t >= s_aPhaseTime[iPhase] )
+		t -= s_aPhaseTime[iPhase++];
+	float fProgress = t / s_aPhaseTime[iPhase];
+
+	switch( iPhase )
+	{
+	case SP_WALK_IN:
+		mState.fX		= fLane - 3000 * ( 1 - fProgress );
+		mState.fWalk	= t * 6.0f;
+		break;
+
+	case SP_RAISE:
+		mState.fRaise	= SmoothStep( fProgress );
+		break;
+
+	case SP_HOLD:
+		mState.fRaise	= 1;
+		break;
+
+	case SP_MOVE:
+		mState.fRaise	= 1;
+		mState.fShift	= SmoothStep( fProgress );
+		break;
+
+	case SP_PRESS:
+		mState.fRaise	= 1;
+		mState.fShift	= 1;
+		break;
+
+	case SP_LOWER:
+		mState.fRaise	= 1 - SmoothStep( fProgress );
+		mState.fShift	= 1 - SmoothStep( fProgress );
+		break;
+
+	case SP_LEAVE:
+		mState.fX		= fLane + 3000 * fProgress;
+		mState.fWalk	= t * 6.0f;
+		break;
+
+	case SP_ABSENT:
+		mState.bPresent	= false;
+		break;
+	}
+	return mState;
+}
+
+void CSimulatedSource::BuildSkeleton( const SScriptState& rState, NiteSkeleton& rSkeleton )
+{
+	std::normal_distribution<float> mNoise( 0.0f, std::max( m_Config.fJointNoise, 0.001f ) );
+	std::uniform_real_distribution<float> mUniform( 0.0f, 1.0f );
+
+	float fSwing = std::sin( rState.fWalk );
+	for( int j = 0; j < NITE_JOINT_COUNT; ++ j )
+	{
+		float aPos[3] = { s_aRestPose[j][0], s_aRestPose[j][1], s_aRestPose[j][2] };
+
+		// legs and left arm swing when walking
+		switch( j )
+		{
+		case NITE_JOINT_LEFT_KNEE:		aPos[2] += fSwing * 80;		break;
+		case NITE_JOINT_LEFT_FOOT:		aPos[2] += fSwing * 200;	break;
+		case NITE_JOINT_RIGHT_KNEE:		aPos[2] -= fSwing * 80;		break;
+		case NITE_JOINT_RIGHT_FOOT:		aPos[2] -= fSwing * 200;	break;
+		case NITE_JOINT_LEFT_HAND:		aPos[2] -= fSwing * 100;	break;
+		case NITE_JOINT_RIGHT_HAND:
+		case NITE_JOINT_RIGHT_ELBOW:
+			{
+				const float* pRaised = ( j == NITE_JOINT_RIGHT_HAND ? s_aRaisedHand : s_aRaisedElbow );
+				for( int k = 0; k < 3; ++ k )
+					aPos[k] += ( pRaised[k] - aPos[k] ) * rState.fRaise;
+				if( j == NITE_JOINT_RIGHT_HAND )
+					aPos[0] += m_Config.fButtonOffset * rState.fShift;
+				else
+					aPos[2] += fSwing * 50 * ( 1 - rState.fRaise );
+			}
+			break;
+		}
+
+		NiteSkeletonJoint& rJoint = rSkeleton.joints[j];
+		rJoint.jointType				= NiteJointType( j );
+		rJoint.position.x				= rState.fX + aPos[0];
+		rJoint.position.y				= aPos[1];
+		rJoint.position.z				= rState.fZ + aPos[2];
+		rJoint.positionConfidence		= 1;
+		rJoint.orientation.x			= 0;
+		rJoint.orientation.y			= 0;
+		rJoint.orientation.z			= 0;
+		rJoint.orientation.w			= 1;
+		rJoint.orientationConfidence	= 1;
+
+		if( m_Config.fJointNoise > 0 )
+		{
+			rJoint.position.x += mNoise( m_Random );
+			rJoint.position.y += mNoise( m_Random );
+			rJoint.position.z += mNoise( m_Random );
+		}
+
+		// lost joint jumps away with no confidence, the torso is never lost
+		if( j != NITE_JOINT_TORSO && m_Config.fLowConfidence > 0 && mUniform( m_Random ) < m_Config.fLowConfidence )
+		{
+			rJoint.position.x			+= ( mUniform( m_Random ) - 0.5f ) * 600;
+			rJoint.position.y			+= ( mUniform( m_Random ) - 0.5f ) * 600;
+			rJoint.positionConfidence	= 0;
+		}
+	}
+}
+
+void CSimulatedSource::DrawUser( const NiteSkeleton& rSkeleton, nite::UserId uID, SFrameBuffer& rBuffer ) const
+{
+	for( size_t i = 0; i < sizeof( s_aBones ) / sizeof( s_aBones[0] ); ++ i )
+	{
+		const SBone& rBone = s_aBones[i];
+		DrawBone( rSkeleton.joints[rBone.iFrom].position, rSkeleton.joints[rBone.iTo].position, rBone.fRadius, uID, rBuffer );
+	}
+}
+
+void CSimulatedSource::DrawBone( const NitePoint3f& rFrom, const NitePoint3f& rTo, float fRadius, nite::UserId uID, SFrameBuffer& rBuffer ) const
+{
+	if( rFrom.z <= fRadius || rTo.z <= fRadius )
+		return;
+
+	// project to image, as a capsule of constant radius
+	int w = m_Config.iWidth, h = m_Config.iHeight;
+	float	fX0 = w * 0.5f + m_fFocal * rFrom.x / rFrom.z,
+			fY0 = h * 0.5f - m_fFocal * rFrom.y / rFrom.z,
+			fX1 = w * 0.5f + m_fFocal * rTo.x / rTo.z,
+			fY1 = h * 0.5f - m_fFocal * rTo.y / rTo.z,
+			fR = m_fFocal * fRadius * 2 / ( rFrom.z + rTo.z );
+
+	int iLeft	= std::max( int( std::min( fX0, fX1 ) - fR ), 0 ),
+		iRight	= std::min( int( std::max( fX0, fX1 ) + fR ) + 1, w ),
+		iTop	= std::max( int( std::min( fY0, fY1 ) - fR ), 0 ),
+		iBottom	= std::min( int( std::max( fY0, fY1 ) + fR ) + 1, h );
+	if( iLeft >= iRight || iTop >= iBottom )
+		return;
+
+	float fDX = fX1 - fX0, fDY = fY1 - fY0, fLength2 = std::max( fDX * fDX + fDY * fDY, 1e-6f ), fR2 = fR * fR;
+	for( int y = iTop; y < iBottom; ++ y )
+	{
+		openni::DepthPixel* pDepth = &rBuffer.aDepth[size_t( y ) * w];
+		nite::UserId* pUserMap = &rBuffer.aUserMap[size_t( y ) * w];
+		for( int x = iLeft; x < iRight; ++ x )
+		{
+			float fPX = x - fX0, fPY = y - fY0;
+			float t = std::min( std::max( ( fPX * fDX + fPY * fDY ) / fLength2, 0.0f ), 1.0f );
+			float fEX = fPX - t * fDX, fEY = fPY - t * fDY, fDist2 = fEX * fEX + fEY * fEY;
+			if( fDist2 >= fR2 )
+				continue;
+
+			// surface bulges toward sensor at the center of bone
+			float fDepth = rFrom.z + t * ( rTo.z - rFrom.z ) - fRadius * std::sqrt( 1 - fDist2 / fR2 );
+			if( fDepth < pDepth[x] )
+			{
+				pDepth[x]		= openni::DepthPixel( fDepth );
+				pUserMap[x]		= uID;
+			}
+		}
+	}
+}
+
+void CSimulatedSource::Start( const TFrameSink& funcSink )
+{
+	if( m_bRunning || !IsOpen() )
+		return;
+
+	m_funcSink	= funcSink;
+	m_bStop		= false;
+	m_bRunning	= true;
+	m_tPlay		= boost::thread( [this](){ PlayLoop(); } );
+}
+
+void CSimulatedSource::Stop()
+{
+	if( !m_bRunning )
+		return;
+
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_cvStop.notify_all();
+	m_tPlay.join();
+	m_bRunning = false;
+}
+
+void CSimulatedSource::PlayLoop()
+{
+	typedef boost::chrono::steady_clock	TClock;
+	TClock::time_point	tpNext = TClock::now();
+	CUserFrame			mFrame;
+	Trace::SetThreadName( "Simulator" );
+
+	while( true )
+	{
+		{
+			boost::unique_lock<boost::mutex> lock( m_Mutex );
+			if( m_bStop )
+				break;
+
+			float fRate = m_fRate.load( boost::memory_order_relaxed );
+			TClock::time_point tpNow = TClock::now();
+			if( fRate > 0 )
+			{
+				if( tpNow < tpNext )
+				{
+					m_cvStop.wait_until( lock, tpNext );
+					continue;
+				}
+
+				// don't catch up after falling behind
+				tpNext += boost::chrono::microseconds( int64_t( 1000000 / fRate ) );
+				if( tpNext < tpNow )
+					tpNext = tpNow;
+			}
+			else
+			{
+				tpNext = tpNow;
+			}
+		}
+
+		GenerateFrame( mFrame );
+		m_funcSink( mFrame );
+	}
+}
@@ -0,0 +1,176 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+// Application header
+#include "UserFrame.h"
+#pragma endregion
+
+/**
+ * Settings of simulated sensor
+ */
+struct SSimulatorConfig
+{
+	int				iWidth;
+	int				iHeight;
+	int				iUsers;			/**< Number of users, each plays the script with a time offset */
+	float			fJointNoise;	/**< Standard deviation of joint position noise (mm) */
+	float			fLowConfidence;	/**< Probability of a joint to be lost in a frame (0-1) */
+	float			fButtonOffset;	/**< Distance the hand moves right from the fixed point to the NEXT button (mm) */
+	unsigned int	uBuffers;		/**< Number of frame buffers, a frame is valid until uBuffers - 1 more frames are generated */
+	unsigned int	uSeed;
+
+	SSimulatorConfig()
+	{
+		iWidth			= 320;
+		iHeight			= 240;
+		iUsers			= 1;
+		fJointNoise		= 0;
+		fLowConfidence	= 0;
+		fButtonOffset	= 200;
+		uBuffers		= 16;
+		uSeed			= 1;
+	}
+};
+
+/**
+ * Sensor simulator, generate depth map, user map and NiTE user data by script.
+ *
+ * Each user walks in, raises the right hand forward, holds still until the buttons are shown,
+ * moves to the NEXT button and holds again, lowers the hand and leaves. The script runs on
+ * frame time of 30 fps, so generating frames faster than real time plays the script faster.
+ *
+ * Frames are sent to the sink like CSessionPlayer, by a thread which runs at the given rate
+ * or as fast as possible, or generated one by one by GenerateFrame(). The frames are not
+ * copied, so a consumer which keeps frames should keep up with the rate.
+ */
+class CSimulatedSource
+{
+public:
+	typedef std::function<void(const CUserFrame&)>	TFrameSink;
+
+public:
+	CSimulatedSource();
+	~CSimulatedSource();
+
+	/**
+	 * Allocate the frame buffers and reset script
+	 */
+	void Open( const SSimulatorConfig& rConfig );
+
+	void Close();
+
+	bool IsOpen() const
+	{
+		return !m_aBuffers.empty();
+	}
+
+	int GetWidth() const
+	{
+		return m_Config.iWidth;
+	}
+
+	int GetHeight() const
+	{
+		return m_Config.iHeight;
+	}
+
+	/**
+	 * Generate next frame into next buffer
+	 */
+	void GenerateFrame( CUserFrame& rFrame );
+
+	/**
+	 * Send frames to sink by a thread
+	 */
+	void Start( const TFrameSink& funcSink );
+
+	void Stop();
+
+	/**
+	 * Frames per second of the thread, 0 to generate as fast as possible
+	 */
+	void SetRate( float fFps )
+	{
+		m_fRate.store( std::max( fFps, 0.0f ), boost::memory_order_relaxed );
+	}
+
+	float GetRate() const
+	{
+		return m_fRate.load( boost::memory_order_relaxed );
+	}
+
+	uint64_t GetGeneratedFrames() const
+	{
+		return m_uFrames.load( boost::memory_order_relaxed );
+	}
+
+private:
+	/**
+	 * Storage of one frame
+	 */
+	struct SFrameBuffer
+	{
+		std::vector<openni::DepthPixel>	aDepth;
+		std::vector<nite::UserId>		aUserMap;
+		std::vector<NiteUserData>		aUsers;
+	};
+
+	/**
+	 * Position of a user in script
+	 */
+	struct SScriptState
+	{
+		bool	bPresent;
+		float	fX;				/**< Torso position */
+		float	fZ;
+		float	fWalk;			/**< Walking cycle, radian */
+		float	fRaise;			/**< 0: hand down, 1: hand forward */
+		float	fShift;			/**< 0: fixed point, 1: on NEXT button */
+	};
+
+	/**
+	 * Tracking state of a user between frames
+	 */
+	struct SUserState
+	{
+		int		iVisibleFrames;		/**< 0 if not detected */
+	};
+
+	SScriptState EvaluateScript( int iUser, double dTime ) const;
+
+	void BuildSkeleton( const SScriptState& rState, NiteSkeleton& rSkeleton );
+
+	void DrawUser( const NiteSkeleton& rSkeleton, nite::UserId uID, SFrameBuffer& rBuffer ) const;
+
+	void DrawBone( const NitePoint3f& rFrom, const NitePoint3f& rTo, float fRadius, nite::UserId uID, SFrameBuffer& rBuffer ) const;
+
+	void PlayLoop();
+
+private:
+	SSimulatorConfig			m_Config;
+	float						m_fFocal;			/**< Focal length in pixels */
+	std::vector<openni::DepthPixel>	m_aBackground;
+	std::vector<SFrameBuffer>	m_aBuffers;
+	std::vector<SUserState>		m_aUserState;
+	unsigned int				m_uNextBuffer;
+	int							m_iFrameIndex;
+	std::mt19937				m_Random;
+
+	TFrameSink					m_funcSink;
+	boost::thread				m_tPlay;
+	boost::mutex				m_Mutex;
+	boost::condition_variable	m_cvStop;
+	bool						m_bRunning;
+	bool						m_bStop;
+	boost::atomic<float>		m_fRate;
+	boost::atomic<uint64_t>		m_uFrames;
+};
@@ -0,0 +1,208 @@
+#include "Trace.h"
+
+// STL Header
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Boost Header
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+
+#if defined( _MSC_VER )
+	#define NIC_THREAD_LOCAL	__declspec( thread )
+#else
+	#define NIC_THREAD_LOCAL	__thread
+#endif
+
+namespace Trace
+{
+	boost::atomic<bool>	g_bEnabled( false );
+
+	struct SEvent
+	{
+		const char*	szName;
+		uint64_t	uBegin;
+		uint64_t	uEnd;
+	};
+
+	/**
+	 * Events of one thread. Only the owner thread writes; uCount is published after the
+	 * event is written, so the events below it can be read by other threads.
+	 */
+	struct SThreadBuffer
+	{
+		std::vector<SEvent>			aEvents;
+		boost::atomic<uint32_t>		uCount;
+		boost::atomic<uint32_t>		uDropped;
+		boost::atomic<unsigned int>	uGeneration;
+		unsigned int				uThreadID;
+		bool						bExited;		/**< Only the events are kept, removed at next Start() */
+		std::string					sName;
+	};
+
+	static const boost::chrono::steady_clock::time_point	s_tpEpoch = boost::chrono::steady_clock::now();
+
+	static boost::mutex									s_mtxBuffers;
+	static std::vector<std::unique_ptr<SThreadBuffer>>	s_aBuffers;
+	static boost::atomic<unsigned int>					s_uGeneration( 0 );
+	static boost::atomic<unsigned int>					s_uCapacity( 100000 );
+	static unsigned int									s_uThreadCount = 0;
+
+	static NIC_THREAD_LOCAL SThreadBuffer*				t_pBuffer = NULL;
+
+	/**
+	 * Called when the thread exits: the events recorded since last start are kept for WriteJson(),
+	 * and the rest of buffer is freed
+	 */
+	static void ReleaseThreadBuffer( SThreadBuffer* pBuffer )
+	{
+		boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+		uint32_t uCount = 0;
+		if( pBuffer->uGeneration.load( boost::memory_order_relaxed ) == s_uGeneration.load( boost::memory_order_acquire ) )
+			uCount = pBuffer->uCount.load( boost::memory_order_relaxed );
+		std::vector<SEvent>( pBuffer->aEvents.begin(), pBuffer->aEvents.begin() + uCount ).swap( pBuffer->aEvents );
+		pBuffer->uCount.store( uCount, boost::memory_order_relaxed );
+		pBuffer->bExited = true;
+		t_pBuffer = NULL;
+	}
+
+	static boost::thread_specific_ptr<SThreadBuffer>		s_tssBuffer( ReleaseThreadBuffer );
+
+	/**
+	 * Buffer of current thread, registered at the first use and kept until exit.
+	 * The events are allocated by AddEvent(), so a thread which is only named costs a few bytes.
+	 */
+	static SThreadBuffer* GetThreadBuffer()
+	{
+		if( t_pBuffer == NULL )
+		{
+			std::unique_ptr<SThreadBuffer> pBuffer( new SThreadBuffer() );
+			pBuffer->uCount			= 0;
+			pBuffer->uDropped		= 0;
+			pBuffer->uGeneration	= s_uGeneration.load();
+			pBuffer->bExited		= false;
+
+			boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+			pBuffer->uThreadID = ++ s_uThreadCount;
+			t_pBuffer = pBuffer.get();
+			s_tssBuffer.reset( t_pBuffer );
+			s_aBuffers.push_back( std::move( pBuffer ) );
+		}
+
+		// restarted, the old events are dropped by owner thread
+		SThreadBuffer* pBuffer = t_pBuffer;
+		unsigned int uGeneration = s_uGeneration.load( boost::memory_order_acquire );
+		if( pBuffer->uGeneration.load( boost::memory_order_relaxed ) != uGeneration )
+		{
+			pBuffer->uGeneration.store( uGeneration, boost::memory_order_relaxed );
+			pBuffer->uCount.store( 0, boost::memory_order_relaxed );
+			pBuffer->uDropped.store( 0, boost::memory_order_relaxed );
+		}
+		return pBuffer;
+	}
+
+	void Start( unsigned int uEventsPerThread )
+	{
+		// the events of exited threads are dropped like the others
+		{
+			boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+			s_aBuffers.erase( std::remove_if( s_aBuffers.begin(), s_aBuffers.end(), []( const std::unique_ptr<SThreadBuffer>& pBuffer ){ return pBuffer->bExited; } ), s_aBuffers.end() );
+		}
+
+		s_uCapacity.store( std::max( uEventsPerThread, 1u ) );
+		s_uGeneration.fetch_add( 1, boost::memory_order_release );
+		g_bEnabled.store( true );
+	}
+
+	void Stop()
+	{
+		g_bEnabled.store( false );
+	}
+
+	void SetThreadName( const char* szName )
+	{
+		SThreadBuffer* pBuffer = GetThreadBuffer();
+		boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+		pBuffer->sName = szName;
+	}
+
+	uint64_t Now()
+	{
+		return boost::chrono::duration_cast<boost::chrono::nanoseconds>( boost::chrono::steady_clock::now() - s_tpEpoch ).count();
+	}
+
+	void AddEvent( const char* szName, uint64_t uBegin, uint64_t uEnd )
+	{
+		SThreadBuffer* pBuffer = GetThreadBuffer();
+		uint32_t uIndex = pBuffer->uCount.load( boost::memory_order_relaxed );
+
+		// first event since Start(), allocate or resize the events
+		if( uIndex == 0 && pBuffer->aEvents.size() != s_uCapacity.load( boost::memory_order_relaxed ) )
+		{
+			boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+			pBuffer->aEvents.resize( s_uCapacity.load() );
+		}
+
+		if( uIndex >= pBuffer->aEvents.size() )
+		{
+			pBuffer->uDropped.fetch_add( 1, boost::memory_order_relaxed );
+			return;
+		}
+
+		SEvent& rEvent = pBuffer->aEvents[uIndex];
+		rEvent.szName	= szName;
+		rEvent.uBegin	= uBegin;
+		rEvent.uEnd		= uEnd;
+		pBuffer->uCount.store( uIndex + 1, boost::memory_order_release );
+	}
+
+	bool WriteJson( const std::string& sFilename )
+	{
+		std::ofstream fsJson( sFilename.c_str() );
+		if( !fsJson.is_open() )
+		{
+			std::cerr << "Can't write trace file " << sFilename << std::endl;
+			return false;
+		}
+
+		// timestamps are in microseconds
+		fsJson << std::fixed << std::setprecision( 3 );
+		fsJson << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		fsJson << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"NIController\"}}";
+
+		uint64_t uEvents = 0, uDropped = 0;
+		unsigned int uGeneration = s_uGeneration.load( boost::memory_order_acquire );
+		boost::lock_guard<boost::mutex> lock( s_mtxBuffers );
+		for( auto itBuf = s_aBuffers.begin(); itBuf != s_aBuffers.end(); ++ itBuf )
+		{
+			const SThreadBuffer& rBuffer = **itBuf;
+			if( !rBuffer.sName.empty() )
+			{
+				fsJson << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << rBuffer.uThreadID
+					   << ",\"args\":{\"name\":\"" << rBuffer.sName << "\"}}";
+			}
+
+			// buffer not used since last start
+			if( rBuffer.uGeneration != uGeneration )
+				continue;
+
+			uint32_t uCount = rBuffer.uCount.load( boost::memory_order_acquire );
+			for( uint32_t i = 0; i < uCount; ++ i )
+			{
+				const SEvent& rEvent = rBuffer.aEvents[i];
+				fsJson << ",\n{\"name\":\"" << rEvent.szName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << rBuffer.uThreadID
+					   << ",\"ts\":" << rEvent.uBegin / 1000.0 << ",\"dur\":" << ( rEvent.uEnd - rEvent.uBegin ) / 1000.0 << "}";
+			}
+			uEvents		+= uCount;
+			uDropped	+= rBuffer.uDropped.load( boost::memory_order_relaxed );
+		}
+		fsJson << "\n]}\n";
+
+		std::cout << "Trace written: " << sFilename << ", " << uEvents << " events, " << uDropped << " dropped" << std::endl;
+		return fsJson.good();
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <string>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#pragma endregion
+
+/**
+ * Scoped trace markers of the frame loop, written as Chrome trace JSON
+ * (chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Each thread appends events to its own buffer without lock; the events are allocated at the
+ * first event of the thread after Start(), and events after it is full are dropped. When the
+ * thread exits, only its events are kept until next Start(). When tracing is not started, a
+ * marker only loads one atomic flag and SetThreadName() keeps only the name. Define
+ * NIC_NO_TRACE to compile markers out.
+ *
+ * Marker names should be string literals, only the pointer is kept.
+ */
+namespace Trace
+{
+	extern boost::atomic<bool>	g_bEnabled;
+
+	/**
+	 * Clear the events and start recording, each thread keeps up to uEventsPerThread events
+	 */
+	void Start( unsigned int uEventsPerThread = 100000 );
+
+	/**
+	 * Stop recording, the events are kept until next Start()
+	 */
+	void Stop();
+
+	inline bool IsEnabled()
+	{
+		return g_bEnabled.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * Write the events recorded, should not be called with Start() at the same time
+	 */
+	bool WriteJson( const std::string& sFilename );
+
+	/**
+	 * Name the current thread in trace
+	 */
+	void SetThreadName( const char* szName );
+
+	/**
+	 * Nanoseconds since program start
+	 */
+	uint64_t Now();
+
+	void AddEvent( const char* szName, uint64_t uBegin, uint64_t uEnd );
+
+	/**
+	 * Record the time from construction to destruction
+	 */
+	class CScope
+	{
+	public:
+		explicit CScope( const char* szName )
+		{
+			m_szName = IsEnabled() ? szName : NULL;
+			if( m_szName != NULL )
+				m_uBegin = Now();
+		}
+
+		~CScope()
+		{
+			if( m_szName != NULL )
+				AddEvent( m_szName, m_uBegin, Now() );
+		}
+
+	private:
+		const char*	m_szName;
+		uint64_t	m_uBegin;
+	};
+}
+
+#ifdef NIC_NO_TRACE
+	#define NIC_TRACE_SCOPE( name )
+#else
+	#define NIC_TRACE_JOIN2( a, b )	a##b
+	#define NIC_TRACE_JOIN( a, b )	NIC_TRACE_JOIN2( a, b )
+	#define NIC_TRACE_SCOPE( name )	Trace::CScope NIC_TRACE_JOIN( mTraceScope, __LINE__ )( name )
+#endif
@@ -0,0 +1,60 @@
+#include "UserFrame.h"
+
+CUserFrame::CUserFrame()
+{
+	release();
+}
+
+bool CUserFrame::Read( nite::UserTracker& rTracker )
+{
+	NIC_TRACE_SCOPE( "ReadFrame" );
+	if( rTracker.readFrame( &m_vfUserFrame ) != nite::STATUS_OK || !m_vfUserFrame.isValid() )
+	{
+		release();
+		return false;
+	}
+
+	m_vfDepth = m_vfUserFrame.getDepthFrame();
+	const nite::Array<nite::UserData>& aUsers = m_vfUserFrame.getUsers();
+
+	m_pDepth		= static_cast<const openni::DepthPixel*>( m_vfDepth.getData() );
+	m_pUserMap		= m_vfUserFrame.getUserMap().getPixels();
+	m_iWidth		= m_vfDepth.getWidth();
+	m_iHeight		= m_vfDepth.getHeight();
+	m_iUserCount	= aUsers.getSize();
+	m_pUsers		= ( m_iUserCount > 0 ? &aUsers[0] : NULL );
+	m_uTimestamp	= m_vfUserFrame.getTimestamp();
+	m_iFrameIndex	= m_vfUserFrame.getFrameIndex();
+	return true;
+}
+
+void CUserFrame::SetData( const openni::DepthPixel* pDepth, const nite::UserId* pUserMap, int w, int h,
+						  const NiteUserData* pUsers, int iUserCount, uint64_t uTimestamp, int iFrameIndex )
+{
+	m_vfUserFrame.release();
+	m_vfDepth.release();
+
+	m_pDepth		= pDepth;
+	m_pUserMap		= pUserMap;
+	m_iWidth		= w;
+	m_iHeight		= h;
+	m_pUsers		= reinterpret_cast<const nite::UserData*>( pUsers );
+	m_iUserCount	= iUserCount;
+	m_uTimestamp	= uTimestamp;
+	m_iFrameIndex	= iFrameIndex;
+}
+
+void CUserFrame::release()
+{
+	m_vfUserFrame.release();
+	m_vfDepth.release();
+
+	m_pDepth		= NULL;
+	m_pUserMap		= NULL;
+	m_iWidth		= 0;
+	m_iHeight		= 0;
+	m_pUsers		= NULL;
+	m_iUserCount	= 0;
+	m_uTimestamp	= 0;
+	m_iFrameIndex	= -1;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+
+// OpenNI and NiTE Header
+#include <OpenNI.h>
+#include <NiTE.h>
+
+// Application header
+#include "Trace.h"
+#pragma endregion
+
+/**
+ * One frame of user tracker: depth map, user map, users with skeletons and timestamp.
+ *
+ * The data is not copied. A live frame keeps the NiTE frame references, and a replayed
+ * frame points into the memory-mapped session file, so the same code path can process both.
+ * Depth and user map rows are continuous, width pixels per row.
+ */
+class CUserFrame
+{
+public:
+	CUserFrame();
+
+	/**
+	 * Read the latest frame from user tracker
+	 */
+	bool Read( nite::UserTracker& rTracker );
+
+	/**
+	 * Use data from other storage, which should be valid while this frame is used.
+	 * pUsers is an array of NiteUserData, which has the same layout as nite::UserData.
+	 */
+	void SetData( const openni::DepthPixel* pDepth, const nite::UserId* pUserMap, int w, int h,
+				  const NiteUserData* pUsers, int iUserCount, uint64_t uTimestamp, int iFrameIndex );
+
+	/**
+	 * Release the NiTE frame or the pointers
+	 */
+	void release();
+
+	bool isValid() const
+	{
+		return m_pDepth != NULL;
+	}
+
+	/**
+	 * True if the frame is read from user tracker, false if replayed
+	 */
+	bool isLive() const
+	{
+		return m_vfUserFrame.isValid();
+	}
+
+	const openni::DepthPixel* getDepth() const
+	{
+		return m_pDepth;
+	}
+
+	const nite::UserId* getUserMap() const
+	{
+		return m_pUserMap;
+	}
+
+	int getWidth() const
+	{
+		return m_iWidth;
+	}
+
+	int getHeight() const
+	{
+		return m_iHeight;
+	}
+
+	int getUserCount() const
+	{
+		return m_iUserCount;
+	}
+
+	const nite::UserData& getUser( int i ) const
+	{
+		return m_pUsers[i];
+	}
+
+	/**
+	 * Timestamp of sensor, in microseconds
+	 */
+	uint64_t getTimestamp() const
+	{
+		return m_uTimestamp;
+	}
+
+	int getFrameIndex() const
+	{
+		return m_iFrameIndex;
+	}
+
+private:
+	nite::UserTrackerFrameRef	m_vfUserFrame;
+	openni::VideoFrameRef		m_vfDepth;
+
+	const openni::DepthPixel*	m_pDepth;
+	const nite::UserId*			m_pUserMap;
+	int							m_iWidth;
+	int							m_iHeight;
+	const nite::UserData*		m_pUsers;
+	int							m_iUserCount;
+	uint64_t					m_uTimestamp;
+	int							m_iFrameIndex;
+};
@@ -2,200 +2,384 @@
 
 void QONI_Skeleton::paint( QPainter *painter,  const QStyleOptionGraphicsItem *option, QWidget *widget )
 {
-	// set pen for drawing
+	NIC_TRACE_SCOPE( "PaintSkeleton" );
+	// head, body, hands and legs
+	static const int s_aBones[BONE_COUNT][2] = {
+		{ 0, 1 },
+		{ 1, 2 }, { 1, 3 }, { 1, 8 }, { 8, 9 }, { 8, 10 },
+		{ 2, 4 }, { 4, 6 }, { 3, 5 }, { 5, 7 },
+		{ 9, 11 }, { 11, 13 }, { 10, 12 }, { 12, 14 }
+	};
+
+	// draw all bones at once
+	std::array<QLineF,BONE_COUNT> aLines;
+	for( int i = 0; i < BONE_COUNT; ++ i )
+		aLines[i] = QLineF( m_Pose.Joint2D( s_aBones[i][0] ), m_Pose.Joint2D( s_aBones[i][1] ) );
 	painter->setPen( m_qSkeletonPen );
+	painter->drawLines( aLines.data(), BONE_COUNT );
 
-	// draw head
-	painter->drawLine( m_aJoint2D[0], m_aJoint2D[1] );
-
-	// draw body
-	painter->drawLine( m_aJoint2D[1], m_aJoint2D[2] );
-	painter->drawLine( m_aJoint2D[1], m_aJoint2D[3] );
-	painter->drawLine( m_aJoint2D[1], m_aJoint2D[8] );
-	painter->drawLine( m_aJoint2D[8], m_aJoint2D[9] );
-	painter->drawLine( m_aJoint2D[8], m_aJoint2D[10] );
-
-	// hands
-	painter->drawLine( m_aJoint2D[2], m_aJoint2D[4] );
-	painter->drawLine( m_aJoint2D[4], m_aJoint2D[6] );
-	painter->drawLine( m_aJoint2D[3], m_aJoint2D[5] );
-	painter->drawLine( m_aJoint2D[5], m_aJoint2D[7] );
-
-	// legs
-	painter->drawLine( m_aJoint2D[9], m_aJoint2D[11] );
-	painter->drawLine( m_aJoint2D[11], m_aJoint2D[13] );
-	painter->drawLine( m_aJoint2D[10], m_aJoint2D[12] );
-	painter->drawLine( m_aJoint2D[12], m_aJoint2D[14] );
-
-	// draw joints
-	for( int i = 0; i < m_aJoint2D.size(); ++ i )
+	// draw joints, the pen is only changed between different colors
+	const QPen* pLastPen = &m_qSkeletonPen;
+	for( int i = 0; i < SJointArray::COUNT; ++ i )
 	{
-		float fD = m_aJointRotated[i].z();
-		if( fD > 0 )
-		{
-			painter->setPen( m_qSkeletonPen );
-		}
-		else
+		const QPen* pPen = &m_qSkeletonPen;
+		float fD = m_Pose.mRotated.aZ[i];
+		if( fD <= 0 )
 		{
 			//TODO: should controlled by parameter
 			fD = std::min( 1.0f, -fD / 500 );
-			QPen pen1( qRgba( fD * 255, fD * 255, 64, 255 ) );
-			pen1.setWidth( 3 );
-			painter->setPen( pen1 );
+			pPen = &m_aJointPen[int( fD * ( JOINT_PENS - 1 ) + 0.5f )];
 		}
-		painter->drawEllipse( m_aJoint2D[i], 5, 5 );
+		if( pPen != pLastPen )
+		{
+			painter->setPen( *pPen );
+			pLastPen = pPen;
+		}
+		painter->drawEllipse( m_Pose.Joint2D( i ), 5, 5 );
 	}
 }
 
-void QONI_Skeleton::SetSkeleton( const nite::Skeleton& rSkeleton )
+void QONI_Skeleton::UpdateBounds()
 {
-	#pragma region Load all joints
-	m_aJointOri[ 0] = rSkeleton.getJoint(nite::JOINT_HEAD			);
-	m_aJointOri[ 1] = rSkeleton.getJoint(nite::JOINT_NECK			);
-	m_aJointOri[ 2] = rSkeleton.getJoint(nite::JOINT_LEFT_SHOULDER	);
-	m_aJointOri[ 3] = rSkeleton.getJoint(nite::JOINT_RIGHT_SHOULDER	);
-	m_aJointOri[ 4] = rSkeleton.getJoint(nite::JOINT_LEFT_ELBOW		);
-	m_aJointOri[ 5] = rSkeleton.getJoint(nite::JOINT_RIGHT_ELBOW	);
-	m_aJointOri[ 6] = rSkeleton.getJoint(nite::JOINT_LEFT_HAND		);
-	m_aJointOri[ 7] = rSkeleton.getJoint(nite::JOINT_RIGHT_HAND		);
-	m_aJointOri[ 8] = rSkeleton.getJoint(nite::JOINT_TORSO			);
-	m_aJointOri[ 9] = rSkeleton.getJoint(nite::JOINT_LEFT_HIP		);
-	m_aJointOri[10] = rSkeleton.getJoint(nite::JOINT_RIGHT_HIP		);
-	m_aJointOri[11] = rSkeleton.getJoint(nite::JOINT_LEFT_KNEE		);
-	m_aJointOri[12] = rSkeleton.getJoint(nite::JOINT_RIGHT_KNEE		);
-	m_aJointOri[13] = rSkeleton.getJoint(nite::JOINT_LEFT_FOOT		);
-	m_aJointOri[14] = rSkeleton.getJoint(nite::JOINT_RIGHT_FOOT		);
-	#pragma endregion
-
-	#pragma region Compute transformation
-	// compute face direction
-	auto tr = m_aJointOri[8].getOrientation();
-	QQuaternion qTRotation( tr.w, tr.x, tr.y, tr.z );
-	m_vDirection = qTRotation.rotatedVector( QVector3D( 0, 0, -1 ) );
-
-	if( m_bUpdateransform )
+	float	fMinX = m_Pose.aX2D[0], fMaxX = fMinX,
+			fMinY = m_Pose.aY2D[0], fMaxY = fMinY;
+	for( int i = 1; i < SJointArray::COUNT; ++ i )
 	{
-		// compute transformation matrix
-		m_qTransform.setToIdentity();
-		auto tt = m_aJointOri[8].getPosition();
-		m_qTransform.translate( tt.x, tt.y, tt.z );
-		m_qTransform.rotate( qTRotation );
-		m_qTransform = m_qTransform.inverted();
+		fMinX = std::min( fMinX, m_Pose.aX2D[i] );
+		fMaxX = std::max( fMaxX, m_Pose.aX2D[i] );
+		fMinY = std::min( fMinY, m_Pose.aY2D[i] );
+		fMaxY = std::max( fMaxY, m_Pose.aY2D[i] );
 	}
-	#pragma endregion
-	
-	#pragma region transform joints position
-	for( int i = 0; i < m_aJointRotated.size(); ++ i )
+
+	// joint circles and the width of pens
+	const float fMargin = 5 + 2;
+	QRectF qBounds( fMinX - fMargin, fMinY - fMargin, fMaxX - fMinX + 2 * fMargin, fMaxY - fMinY + 2 * fMargin );
+	if( qBounds != m_qBounds )
 	{
-		const auto& rPos = m_aJointOri[i].getPosition();
-		QVector4D qPos( rPos.x, rPos.y, rPos.z, 1 );
-		m_aJointRotated[i] = ( m_qTransform * qPos ).toVector3D();
-		m_aJoint2D[i] = QPointF(	m_vPositionShift.x() + m_aJointRotated[i].x() * m_fScale, 
-									m_vPositionShift.y() - m_aJointRotated[i].y() * m_fScale );
+		prepareGeometryChange();
+		m_qBounds = qBounds;
 	}
-	#pragma endregion
+	update();
 }
 
 bool QONI_UserMap::Update()
 {
-	nite::UserTrackerFrameRef	vfUserFrame;
-	if( m_rUserTracker.readFrame( &vfUserFrame ) == nite::STATUS_OK )
+	CUserFrame mUserFrame;
+	if( mUserFrame.Read( m_rUserTracker ) )
+		return Update( mUserFrame );
+	return false;
+}
+
+bool QONI_UserMap::Update( const CUserFrame& rUserFrame )
+{
+	NIC_TRACE_SCOPE( "UpdateUserMap" );
+	CMetrics::CStageTimer mTimer( m_pMetrics, CMetrics::MS_UPDATE );
+	if( rUserFrame.isValid() )
 	{
-		// get user data
-		const nite::Array<nite::UserData>& aUsers = vfUserFrame.getUsers();
-
-		// get depth map
-		openni::VideoFrameRef vfDepth = vfUserFrame.getDepthFrame();
-		int w = vfDepth.getWidth(),
-			h = vfDepth.getHeight();
-		const openni::DepthPixel* pDepth = static_cast<const openni::DepthPixel*>( vfDepth.getData() );
-
-		QImage mImage( w, h, QImage::Format_ARGB32 );
-		bool	bUseUserMap	= false;
-		if( aUsers.getSize() > 0 )
+		int iStep = GetRenderStep( rUserFrame.getWidth() );
+		SUserImageBuffer& rImage = GetUserImageBuffer();
+		if( iStep > 0 )
+			PrepareUserImage( rImage, rUserFrame.getWidth(), rUserFrame.getHeight(), iStep );
+
+		const nite::UserData* pActiveUser = SelectActiveUser( rUserFrame );
+		if( pActiveUser != NULL )
 		{
-			// scan user for tracking skeleton and find active user
-			const nite::UserData*	pActiveUser = NULL;
-			float fDistance = 100000;
-			for( int i = 0; i < aUsers.getSize(); ++ i )
+			if( iStep > 0 )
+				DrawUserMap( rUserFrame, pActiveUser->getId(), rImage );
+
+			// Analyze user skeleton
+			if( m_bProcessSkeleton )
 			{
-				const nite::UserData& rUser = aUsers[i];
-				if( rUser.isNew() )
-				{
-					m_rUserTracker.startSkeletonTracking( rUser.getId() );
-				}
-				else
-				{
-					const nite::Skeleton& rSkeleton = rUser.getSkeleton();
-					if( rSkeleton.getState() == nite::SKELETON_TRACKED )
-					{
-						if( rUser.getCenterOfMass().z < fDistance )
-						{
-							fDistance = rUser.getCenterOfMass().z;
-							pActiveUser = &rUser;
-						}
-					}
-				}
+				SSkeletonPose mPose;
+				mPose.LoadJoints( pActiveUser->getSkeleton() );
+				TransformPose( mPose );
+				SetActivePose( mPose );
 			}
+		}
+		else if( iStep > 0 )
+		{
+			DrawUserMap( rUserFrame, 0, rImage );
+		}
 
-			if( pActiveUser != NULL )
-			{
-				bUseUserMap = true;
+		// skeleton is always updated if processed here, image only when it can be seen
+		if( iStep > 0 )
+			PresentUserImage();
+		return pActiveUser != NULL;
+	}
+	return false;
+}
+
+const nite::UserData* QONI_UserMap::SelectActiveUser( const CUserFrame& rUserFrame )
+{
+	NIC_TRACE_SCOPE( "SelectUser" );
+	CMetrics::CStageTimer mTimer( m_pMetrics, CMetrics::MS_SELECT_USER );
+	int iTracked = 0;
+	const nite::UserData* pActiveUser = m_UserSelector.Select( rUserFrame, &iTracked );
+	if( m_pMetrics != NULL )
+		m_pMetrics->SetTrackedUsers( iTracked );
+	return pActiveUser;
+}
+
+int QONI_UserMap::GetRenderStep( int w ) const
+{
+	if( !IsRenderVisible() )
+		return 0;
 
-				// get user map
-				const nite::UserMap& rUserMap = vfUserFrame.getUserMap();
-				const nite::UserId* pUserMap = rUserMap.getPixels();
-				nite::UserId uID = pActiveUser->getId();
+	// coarser sampling while the image is still at least as wide as the view
+	int iViewWidth = m_iViewWidth.load( boost::memory_order_relaxed ), iStep = 1;
+	if( iViewWidth > 0 )
+	{
+		while( iStep < MAX_RENDER_STEP && w / ( iStep * 2 ) >= iViewWidth )
+			iStep *= 2;
+	}
+	return iStep;
+}
+
+void QONI_UserMap::DrawUserMap( const CUserFrame& rUserFrame, nite::UserId uID, SUserImageBuffer& rBuffer )
+{
+	NIC_TRACE_SCOPE( "Colorize" );
+	CMetrics::CStageTimer mTimer( m_pMetrics, CMetrics::MS_COLORIZE );
+	// get depth map
+	SDepthSource mSource;
+	mSource.pDepth		= rUserFrame.getDepth();
+	mSource.pUserMap	= ( uID != 0 ? rUserFrame.getUserMap() : NULL );
+	mSource.iWidth		= rUserFrame.getWidth();
+	mSource.iStep		= rBuffer.iStep;
+
+	if( m_bUseColorLUT )
+		m_ColorLUT.UpdateHistogram( mSource.pDepth, mSource.pUserMap, uID, rUserFrame.getWidth(), rUserFrame.getHeight() );
+
+	// depth map changes everywhere, only user map is drawn incrementally
+	if( m_bIncremental && uID != 0 )
+		DrawChangedTiles( mSource, uID, rBuffer );
+	else
+		DrawFullImage( mSource, uID, rBuffer );
 
-				// draw user map
-				//#pragma omp parallel for num_threads(4)
-				for( int y = 0; y < h; ++ y )
+	if( m_bUseColorLUT )
+		rBuffer.mImage.setColorTable( uID != 0 ? m_aUserColorTable : m_aDepthColorTable );
+}
+
+void QONI_UserMap::DrawFullImage( const SDepthSource& rSource, nite::UserId uID, SUserImageBuffer& rBuffer )
+{
+	// colorize in bands of rows by worker pool
+	int w = rBuffer.mImage.width(),
+		h = rBuffer.mImage.height();
+	m_WorkerPool.ParallelFor( ( h + COLORIZE_BAND - 1 ) / COLORIZE_BAND, [&]( int iBand ){
+		int y = iBand * COLORIZE_BAND;
+		DrawRect( rSource, uID, QRect( 0, y, w, std::min<int>( COLORIZE_BAND, h - y ) ), rBuffer );
+	} );
+
+	// content is not tracked
+	std::fill( rBuffer.aTileSignature.begin(), rBuffer.aTileSignature.end(), uint32_t( SUserImageBuffer::SIG_UNKNOWN ) );
+}
+
+void QONI_UserMap::DrawChangedTiles( const SDepthSource& rSource, nite::UserId uID, SUserImageBuffer& rBuffer )
+{
+	const int iTile = SUserImageBuffer::TILE_SIZE;
+	int w = rBuffer.mImage.width(),
+		h = rBuffer.mImage.height();
+
+	// bounding box of user in image, in tiles
+	int iMinX = w, iMaxX = -1, iMinY = h, iMaxY = -1;
+	for( int y = 0; y < h; ++ y )
+	{
+		const nite::UserId* pU = rSource.pUserMap + rSource.Offset( 0, y );
+		int x0 = 0, x1 = w - 1;
+		while( x0 < w && pU[x0 * rSource.iStep] != uID )
+			++ x0;
+		if( x0 == w )
+			continue;
+		while( pU[x1 * rSource.iStep] != uID )
+			-- x1;
+
+		iMinX = std::min( iMinX, x0 );
+		iMaxX = std::max( iMaxX, x1 );
+		iMinY = std::min( iMinY, y );
+		iMaxY = y;
+	}
+
+	int iCol0 = iMinX / iTile, iCol1 = ( iMaxX < 0 ? -1 : iMaxX / iTile ),
+		iRow0 = iMinY / iTile, iRow1 = ( iMaxY < 0 ? -1 : iMaxY / iTile );
+
+	// the output of a pixel only depends on user mask and its 8-bit value (palette index if colormap is used),
+	// so depth noise which doesn't change the color doesn't redraw the tile
+	uint32_t uSeed = 2166136261u ^ ( m_bUseColorLUT ? m_ColorLUT.GetVersion() * 16777619u : 0 );
+
+	m_WorkerPool.ParallelFor( rBuffer.iTileCols * rBuffer.iTileRows, [&]( int iIdx ){
+		int iCol = iIdx % rBuffer.iTileCols,
+			iRow = iIdx / rBuffer.iTileCols;
+		QRect qTile = rBuffer.TileRect( iCol, iRow );
+
+		uint32_t uSignature = SUserImageBuffer::SIG_EMPTY;
+		if( iCol >= iCol0 && iCol <= iCol1 && iRow >= iRow0 && iRow <= iRow1 )
+		{
+			// FNV-1a of user pixels and their position in tile
+			uint32_t uHash = uSeed;
+			bool bUser = false;
+			for( int y = qTile.top(); y <= qTile.bottom(); ++ y )
+			{
+				int iOffset = rSource.Offset( 0, y );
+				const openni::DepthPixel*	pD = rSource.pDepth + iOffset;
+				const nite::UserId*			pU = rSource.pUserMap + iOffset;
+				for( int x = qTile.left(); x <= qTile.right(); ++ x )
 				{
-					for( unsigned int x = 0; x < w; ++ x )
-					{
-						unsigned int uIdx = x+w*y;
-						if( pUserMap[uIdx] == uID )
-						{
-							const openni::DepthPixel& rValue = pDepth[x+w*y];
-							int iColor = 128 * ( 1.0f - 1.0f * rValue / 3000 ) + 127;
-							mImage.setPixel( x, y, qRgba( iColor, 0, 0, 128 ) );
-						}
-						else
-						{
-							mImage.setPixel( x, y, qRgba( 0, 0, 0, 0 ) );
-						}
-					}
+					int sx = x * rSource.iStep;
+					if( pU[sx] != uID )
+						continue;
+
+					uint32_t uValue = ( m_bUseColorLUT ? m_ColorLUT.GetIndex( pD[sx] ) : CDepthColorizer::GetUserValue( pD[sx] ) );
+					uHash = ( uHash ^ ( ( uint32_t( ( y - qTile.top() ) * iTile + x - qTile.left() ) << 16 ) | uValue ) ) * 16777619u;
+					bUser = true;
 				}
+			}
 
-				// Analyze user skeleton
-				const auto& rSkeleton = pActiveUser->getSkeleton();
-				m_UserSkeleton.SetSkeleton( rSkeleton );
-				m_UserDirection.SetDirection( QVector2D( m_UserSkeleton.m_vDirection.x(), m_UserSkeleton.m_vDirection.z() ).normalized() );
-				m_UserSkeleton.show();
+			if( bUser )
+			{
+				uSignature = uHash;
+				if( uSignature == SUserImageBuffer::SIG_EMPTY || uSignature == SUserImageBuffer::SIG_UNKNOWN )
+					uSignature = 1;
 			}
 		}
 
-		if( !bUseUserMap )
+		uint32_t& rSignature = rBuffer.aTileSignature[iIdx];
+		if( rSignature == uSignature && uSignature != SUserImageBuffer::SIG_UNKNOWN )
+			return;
+		rSignature = uSignature;
+
+		if( uSignature == SUserImageBuffer::SIG_EMPTY )
+		{
+			// clear to transparent, which is 0 in both formats
+			int iBytes = qTile.width() * rBuffer.mImage.depth() / 8;
+			for( int y = qTile.top(); y <= qTile.bottom(); ++ y )
+				std::fill_n( rBuffer.mImage.scanLine( y ) + qTile.left() * rBuffer.mImage.depth() / 8, iBytes, 0 );
+		}
+		else
+		{
+			DrawRect( rSource, uID, qTile, rBuffer );
+		}
+	} );
+}
+
+void QONI_UserMap::DrawRect( const SDepthSource& rSource, nite::UserId uID, const QRect& rRect, SUserImageBuffer& rBuffer )
+{
+	int iBytesPerPixel = rBuffer.mImage.depth() / 8,
+		iStride = rBuffer.mImage.bytesPerLine();
+
+	// the source rows are continuous only if the rectangle covers whole rows without sampling
+	if( rSource.iStep == 1 )
+	{
+		bool bFullRow = ( rRect.width() == rSource.iWidth );
+		int iRows = ( bFullRow ? rRect.height() : 1 );
+		for( int y = rRect.top(); y <= rRect.bottom(); y += iRows )
 		{
-			//#pragma omp parallel for num_threads(4)
-			for( int y = 0; y < h; ++ y )
+			int iOffset = rSource.Offset( rRect.left(), y );
+			const openni::DepthPixel* pD = rSource.pDepth + iOffset;
+			const nite::UserId* pU = ( uID != 0 ? rSource.pUserMap + iOffset : NULL );
+			DrawPixels( pD, pU, uID, rRect.width(), iRows, rBuffer.mImage.scanLine( y ) + rRect.left() * iBytesPerPixel, iStride );
+		}
+		return;
+	}
+
+	// gather sampled pixels into a small buffer, then colorize
+	std::array<openni::DepthPixel,GATHER_SIZE>	aDepth;
+	std::array<nite::UserId,GATHER_SIZE>		aUser;
+	for( int y = rRect.top(); y <= rRect.bottom(); ++ y )
+	{
+		for( int x0 = rRect.left(); x0 <= rRect.right(); x0 += GATHER_SIZE )
+		{
+			int iCount = std::min<int>( GATHER_SIZE, rRect.right() + 1 - x0 ),
+				iOffset = rSource.Offset( x0, y );
+			for( int i = 0; i < iCount; ++ i )
+				aDepth[i] = rSource.pDepth[iOffset + i * rSource.iStep];
+			if( uID != 0 )
 			{
-				for( unsigned int x = 0; x < w; ++ x )
-				{
-					const openni::DepthPixel& rValue = pDepth[x+w*y];
-					int iColor = 255 * ( 1.0f - 1.0f * ( rValue - 1000 ) / 5000 );
-					mImage.setPixel( x, y, qRgba( iColor, iColor, iColor, iColor ) );
-				}
+				for( int i = 0; i < iCount; ++ i )
+					aUser[i] = rSource.pUserMap[iOffset + i * rSource.iStep];
 			}
+
+			DrawPixels( aDepth.data(), ( uID != 0 ? aUser.data() : NULL ), uID, iCount, 1, rBuffer.mImage.scanLine( y ) + x0 * iBytesPerPixel, iStride );
 		}
+	}
+}
+
+void QONI_UserMap::DrawPixels( const openni::DepthPixel* pDepth, const nite::UserId* pUserMap, nite::UserId uID, int w, int h, unsigned char* pDst, int iStride ) const
+{
+	if( m_bUseColorLUT )
+	{
+		if( uID != 0 )
+			m_ColorLUT.DrawUserMap( pDepth, pUserMap, uID, w, h, pDst, iStride );
+		else
+			m_ColorLUT.DrawDepthMap( pDepth, w, h, pDst, iStride );
+	}
+	else
+	{
+		if( uID != 0 )
+			m_Colorizer.DrawUserMap( pDepth, pUserMap, uID, w, h, pDst, iStride );
+		else
+			m_Colorizer.DrawDepthMap( pDepth, w, h, pDst, iStride );
+	}
+}
+
+void QONI_UserMap::SetActivePose( const SSkeletonPose& rPose )
+{
+	m_UserSkeleton.SetPose( rPose );
+	m_UserDirection.SetDirection( QVector2D( rPose.vDirection.x(), rPose.vDirection.z() ).normalized() );
+	m_UserSkeleton.show();
+}
+
+void QUserImage::SwapBuffers()
+{
+	const SUserImageBuffer& rOld = FrontBuffer();
+	m_iFront = 1 - m_iFront;
+	const SUserImageBuffer& rNew = FrontBuffer();
+
+	QSizeF qSize = rNew.mImage.size();
+	if( m_qRect.size() != qSize )
+	{
+		prepareGeometryChange();
+		m_qRect = QRectF( QPointF( 0, 0 ), qSize );
+		update();
+		return;
+	}
+
+	if( rOld.aTileSignature.size() != rNew.aTileSignature.size() )
+	{
+		update();
+		return;
+	}
 
-		m_UserImage.setPixmap( QPixmap::fromImage( mImage ) );
-		if( w != m_qRect.width() )
+	// repaint changed tiles, merged into horizontal runs
+	for( int iRow = 0; iRow < rNew.iTileRows; ++ iRow )
+	{
+		int iRunStart = -1;
+		for( int iCol = 0; iCol <= rNew.iTileCols; ++ iCol )
 		{
-			m_UserImage.resetTransform();
-			m_UserImage.setScale( m_qRect.width() / w );
-		}
+			bool bDirty = false;
+			if( iCol < rNew.iTileCols )
+			{
+				int iIdx = iCol + iRow * rNew.iTileCols;
+				bDirty = ( rNew.aTileSignature[iIdx] != rOld.aTileSignature[iIdx] || rNew.aTileSignature[iIdx] == SUserImageBuffer::SIG_UNKNOWN );
+			}
 
-		return bUseUserMap;
+			if( bDirty && iRunStart < 0 )
+			{
+				iRunStart = iCol;
+			}
+			else if( !bDirty && iRunStart >= 0 )
+			{
+				update( QRectF( rNew.TileRect( iRunStart, iRow ) | rNew.TileRect( iCol - 1, iRow ) ) );
+				iRunStart = -1;
+			}
+		}
 	}
 }
+
+void QONI_UserMap::PresentUserImage()
+{
+	NIC_TRACE_SCOPE( "PresentImage" );
+	m_UserImage.SwapBuffers();
+
+	qreal fScale = m_qRect.width() / m_UserImage.FrontBuffer().mImage.width();
+	if( m_UserImage.scale() != fScale )
+		m_UserImage.setScale( fScale );
+}
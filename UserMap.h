@@ -1,7 +1,12 @@
 #pragma once
 #pragma region Header Files
 // STL Header
+#include <algorithm>
 #include <array>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
 
 // Qt Header
 #include <QtGui/QtGui>
@@ -10,6 +15,13 @@
 #include <OpenNI.h>
 #include <NiTE.h>
 
+// Application header
+#include "DepthColorizer.h"
+#include "Gesture.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "UserFrame.h"
+#include "WorkerPool.h"
 #pragma endregion
 
 /**
@@ -32,17 +44,20 @@ public:
 
 		m_vDir = QVector2D( 0, -1 );
 		SetSize( fSize );
+		setCacheMode( QGraphicsItem::DeviceCoordinateCache );
 	}
 
 	void SetSize( float fSize )
 	{
 		float fS = fSize / 2;
+		prepareGeometryChange();
 		m_qRect = QRectF( -fS, -fS, fSize, fSize );
 	}
 
 	QRectF boundingRect() const
 	{
-		return m_qRect;
+		// the circle is drawn on the border
+		return m_qRect.adjusted( -2, -2, 2, 2 );
 	}
 
 	void paint( QPainter *painter,  const QStyleOptionGraphicsItem *option, QWidget *widget )
@@ -59,7 +74,11 @@ public:
 
 	void SetDirection( const QVector2D& rVec )
 	{
-		m_vDir = rVec;
+		if( m_vDir != rVec )
+		{
+			m_vDir = rVec;
+			update();
+		}
 	}
 
 private:
@@ -67,54 +86,168 @@ private:
 	QVector2D	m_vDir;
 };
 
+/**
+ * Image buffer of user map, with the signature of the content of each tile.
+ * The tiles with the same signature needn't to be drawn again.
+ */
+struct SUserImageBuffer
+{
+	enum
+	{
+		TILE_SIZE		= 32,
+		SIG_EMPTY		= 0,			/**< transparent tile */
+		SIG_UNKNOWN		= 0xffffffff,	/**< always redraw */
+	};
+
+	QImage					mImage;
+	int						iStep;			/**< sensor pixels per image pixel */
+	int						iTileCols;
+	int						iTileRows;
+	std::vector<uint32_t>	aTileSignature;
+
+	SUserImageBuffer()
+	{
+		iStep = 1;
+		iTileCols = iTileRows = 0;
+	}
+
+	/**
+	 * Exchange content without copy
+	 */
+	void Swap( SUserImageBuffer& rBuffer )
+	{
+		qSwap( mImage, rBuffer.mImage );
+		std::swap( iStep, rBuffer.iStep );
+		std::swap( iTileCols, rBuffer.iTileCols );
+		std::swap( iTileRows, rBuffer.iTileRows );
+		aTileSignature.swap( rBuffer.aTileSignature );
+	}
+
+	QRect TileRect( int iCol, int iRow ) const
+	{
+		return QRect( iCol * TILE_SIZE, iRow * TILE_SIZE, TILE_SIZE, TILE_SIZE ) & mImage.rect();
+	}
+};
+
+/**
+ * The QGraphicsItem to draw user map image, double buffered.
+ * The next frame is drawn into back buffer while front buffer is painting. The buffers are
+ * reused if the size and format are not changed, so there is no image allocation per frame.
+ */
+class QUserImage : public QGraphicsItem
+{
+public:
+	QUserImage() : QGraphicsItem()
+	{
+		m_iFront = 0;
+	}
+
+	/**
+	 * The buffer to draw next frame
+	 */
+	SUserImageBuffer& BackBuffer()
+	{
+		return m_aBuffer[1 - m_iFront];
+	}
+
+	const SUserImageBuffer& FrontBuffer() const
+	{
+		return m_aBuffer[m_iFront];
+	}
+
+	/**
+	 * Show the back buffer, only repaint the tiles changed
+	 */
+	void SwapBuffers();
+
+	QRectF boundingRect() const
+	{
+		return m_qRect;
+	}
+
+	void paint( QPainter *painter,  const QStyleOptionGraphicsItem *option, QWidget *widget )
+	{
+		NIC_TRACE_SCOPE( "PaintUserMap" );
+		painter->drawImage( QPointF( 0, 0 ), FrontBuffer().mImage );
+	}
+
+private:
+	std::array<SUserImageBuffer,2>	m_aBuffer;
+	int								m_iFront;
+	QRectF							m_qRect;
+};
+
 /**
  * The user skeleton
  */
-class QONI_Skeleton : public QGraphicsItem
+class QONI_Skeleton : public QGraphicsItem, public CSkeletonTransform
 {
 public:
-	float		m_fScale;
-	QVector2D	m_vPositionShift;
 	QPen		m_qSkeletonPen;
 
 public:
 	QONI_Skeleton()
 	{
-		m_fScale			= 1.0f / 2.5f;
-		m_vPositionShift	= QVector2D( 320, 320 );
-
 		m_qSkeletonPen.setWidth( 3 );
 		m_qSkeletonPen.setColor( qRgba( 64, 64, 255, 192 ) );
 
-		m_bUpdateransform	= true;
+		// pens of joints in front of torso, from near to far
+		for( int i = 0; i < JOINT_PENS; ++ i )
+		{
+			float fD = float( i ) / ( JOINT_PENS - 1 );
+			m_aJointPen[i] = QPen( qRgba( fD * 255, fD * 255, 64, 255 ) );
+			m_aJointPen[i].setWidth( 3 );
+		}
 	}
 
+	/**
+	 * Updated with the pose, not computed for each query
+	 */
 	QRectF boundingRect() const
 	{
-		QRectF qRect( m_aJoint2D[0], QSizeF( 1, 1 ) );
-		for( auto itP = m_aJoint2D.begin(); itP != m_aJoint2D.end(); ++ itP )
-			qRect |= QRectF( *itP, QSizeF( 1, 1 ) );
-		return qRect;
+		return m_qBounds;
 	}
 
 	void paint( QPainter *painter,  const QStyleOptionGraphicsItem *option, QWidget *widget );
 
-	void SetSkeleton( const nite::Skeleton& rSkeleton );
+	void SetSkeleton( const nite::Skeleton& rSkeleton )
+	{
+		SSkeletonPose mPose;
+		mPose.LoadJoints( rSkeleton );
+		TransformPose( mPose );
+		SetPose( mPose );
+	}
 
-	void KeepTransform( bool bKeep = true )
+	/**
+	 * Use a transformed pose to draw
+	 */
+	void SetPose( const SSkeletonPose& rPose )
 	{
-		m_bUpdateransform = !bKeep;
+		m_Pose = rPose;
+		UpdateBounds();
 	}
 
-public:
-	std::array<QPointF,15>				m_aJoint2D;
-	std::array<QVector3D,15>			m_aJointRotated;
-	std::array<nite::SkeletonJoint,15>	m_aJointOri;
-	QVector3D	m_vDirection;
+	const SSkeletonPose& GetPose() const
+	{
+		return m_Pose;
+	}
+
+private:
+	enum
+	{
+		BONE_COUNT	= 14,
+		JOINT_PENS	= 32,	/**< Colors of joint depth, quantized */
+	};
+
+	/**
+	 * Fit the bounds to the joints and repaint
+	 */
+	void UpdateBounds();
 
 private:
-	bool		m_bUpdateransform;
-	QMatrix4x4	m_qTransform;
+	SSkeletonPose					m_Pose;
+	QRectF							m_qBounds;
+	std::array<QPen,JOINT_PENS>		m_aJointPen;
 };
 
 /**
@@ -123,8 +256,16 @@ private:
 class QONI_UserMap : public QGraphicsItemGroup
 {
 public:
-	QONI_UserMap( nite::UserTracker& rUserTracker ) : m_rUserTracker(rUserTracker)
+	QONI_UserMap( nite::UserTracker& rUserTracker ) : m_rUserTracker(rUserTracker), m_UserSelector(&rUserTracker), m_WorkerPool(1)
 	{
+		m_bUseColorLUT = false;
+		m_bIncremental = false;
+		m_bProcessSkeleton = true;
+		m_pMetrics = NULL;
+		m_bRenderVisible.store( true );
+		m_iViewWidth.store( 0 );
+		m_Colorizer.SetPremultiplied( true );
+
 		addToGroup(&m_UserImage);
 		addToGroup(&m_UserSkeleton);
 		addToGroup(&m_UserDirection);
@@ -134,8 +275,210 @@ public:
 		m_UserSkeleton.hide();
 	}
 
+	/**
+	 * Read a frame from user tracker and update
+	 */
 	bool Update();
 
+	/**
+	 * Update with a frame which is already read, return true if there is an active user
+	 */
+	bool Update( const CUserFrame& rUserFrame );
+
+	/**
+	 * Find the nearest tracked user, and start skeleton tracking for new users.
+	 * Return NULL if there is no tracked user.
+	 */
+	const nite::UserData* SelectActiveUser( const CUserFrame& rUserFrame );
+
+	/**
+	 * Draw the user map of given user into image; draw depth map if uID is 0.
+	 * The buffer should be prepared by PrepareUserImage().
+	 * This update the depth histogram of colormap, so should be called only by one thread.
+	 */
+	void DrawUserMap( const CUserFrame& rUserFrame, nite::UserId uID, SUserImageBuffer& rBuffer );
+
+	/**
+	 * Make sure the buffer can be used to draw user map of a w x h depth frame, sampled every
+	 * iStep pixels; only allocate if size or format changed.
+	 * The format is premultiplied ARGB32, or 8-bit indexed if colormap is used.
+	 */
+	void PrepareUserImage( SUserImageBuffer& rBuffer, int w, int h, int iStep = 1 ) const
+	{
+		QImage::Format eFormat = m_bUseColorLUT ? QImage::Format_Indexed8 : QImage::Format_ARGB32_Premultiplied;
+		w /= iStep;
+		h /= iStep;
+		rBuffer.iStep = iStep;
+		if( rBuffer.mImage.width() != w || rBuffer.mImage.height() != h || rBuffer.mImage.format() != eFormat )
+		{
+			rBuffer.mImage		= QImage( w, h, eFormat );
+			rBuffer.iTileCols	= ( w + SUserImageBuffer::TILE_SIZE - 1 ) / SUserImageBuffer::TILE_SIZE;
+			rBuffer.iTileRows	= ( h + SUserImageBuffer::TILE_SIZE - 1 ) / SUserImageBuffer::TILE_SIZE;
+			rBuffer.aTileSignature.assign( rBuffer.iTileCols * rBuffer.iTileRows, SUserImageBuffer::SIG_UNKNOWN );
+		}
+	}
+
+	/**
+	 * Set how the user map is shown: iViewWidth is the width in device pixels, 0 if unknown.
+	 * Nothing is colorized if not visible. Can be called when other threads are drawing.
+	 */
+	void SetRenderTarget( bool bVisible, int iViewWidth )
+	{
+		m_bRenderVisible.store( bVisible, boost::memory_order_relaxed );
+		m_iViewWidth.store( iViewWidth, boost::memory_order_relaxed );
+	}
+
+	bool IsRenderVisible() const
+	{
+		return m_bRenderVisible.load( boost::memory_order_relaxed );
+	}
+
+	/**
+	 * The sampling step to colorize a depth frame of width w, so the image is not much larger
+	 * than the view; 0 if the user map is not visible.
+	 */
+	int GetRenderStep( int w ) const;
+
+	/**
+	 * Only redraw the tiles changed in the bounding box of user
+	 */
+	void SetIncremental( bool bIncremental )
+	{
+		m_bIncremental = bIncremental;
+	}
+
+	/**
+	 * Load and transform the skeleton of the active user in Update(); turn off when a
+	 * CGestureEngine processes the users and sets the pose shown by SetActivePose()
+	 */
+	void SetProcessSkeleton( bool bProcess )
+	{
+		m_bProcessSkeleton = bProcess;
+	}
+
+	/**
+	 * Select colormap: "direct" to draw ARGB32 image directly, or the colormap of CDepthColorLUT
+	 */
+	void SetColorMap( const QString& sName )
+	{
+		CDepthColorLUT::EColorMap eColorMap;
+		m_bUseColorLUT = CDepthColorLUT::ParseColorMap( sName.toLower().toStdString(), eColorMap );
+		if( m_bUseColorLUT )
+		{
+			m_ColorLUT.SetColorMap( eColorMap );
+
+			// keep color tables, so images share them without copy
+			const CDepthColorLUT::TPalette& rUser = m_ColorLUT.GetUserPalette();
+			m_aUserColorTable = QVector<QRgb>::fromStdVector( std::vector<QRgb>( rUser.begin(), rUser.end() ) );
+			const CDepthColorLUT::TPalette& rDepth = m_ColorLUT.GetDepthPalette();
+			m_aDepthColorTable = QVector<QRgb>::fromStdVector( std::vector<QRgb>( rDepth.begin(), rDepth.end() ) );
+		}
+	}
+
+	/**
+	 * Set the number of threads to colorize, 0 to use all cores
+	 */
+	void SetColorizeThreads( unsigned int uThreads )
+	{
+		m_WorkerPool.SetThreadCount( uThreads );
+	}
+
+	/**
+	 * Set depth range of colormap, in mm
+	 */
+	void SetDepthRange( int iNear, int iFar, bool bAuto )
+	{
+		m_ColorLUT.SetRange( uint16_t( iNear ), uint16_t( iFar ) );
+		m_ColorLUT.SetAutoRange( bAuto );
+	}
+
+	/**
+	 * Select colorization kernel: "auto", "scalar", "sse2" or "avx2"
+	 */
+	void SetColorizeKernel( const QString& sName )
+	{
+		m_Colorizer.SetKernel( sName.toLower().toStdString() );
+	}
+
+	CDepthColorizer::EKernel GetColorizeKernel() const
+	{
+		return m_Colorizer.GetKernel();
+	}
+
+	/**
+	 * Record stage time and tracked users, NULL to disable
+	 */
+	void SetMetrics( CMetrics* pMetrics )
+	{
+		m_pMetrics = pMetrics;
+	}
+
+	/**
+	 * Compute active user pose, can be called from pipeline thread
+	 */
+	void TransformPose( SSkeletonPose& rPose )
+	{
+		CMetrics::CStageTimer mTimer( m_pMetrics, CMetrics::MS_TRANSFORM );
+		m_UserSkeleton.TransformPose( rPose );
+	}
+
+	/**
+	 * Set the transformed pose of active user
+	 */
+	void SetActivePose( const SSkeletonPose& rPose );
+
+	/**
+	 * The back buffer of user map image, draw next frame here and call PresentUserImage()
+	 */
+	SUserImageBuffer& GetUserImageBuffer()
+	{
+		return m_UserImage.BackBuffer();
+	}
+
+	/**
+	 * Show the image in back buffer
+	 */
+	void PresentUserImage();
+
+private:
+	/**
+	 * Depth frame to draw, pUserMap is NULL for depth map
+	 */
+	struct SDepthSource
+	{
+		const openni::DepthPixel*	pDepth;
+		const nite::UserId*			pUserMap;
+		int							iWidth;
+		int							iStep;
+
+		int Offset( int x, int y ) const
+		{
+			return x * iStep + y * iStep * iWidth;
+		}
+	};
+
+	/**
+	 * Draw all pixels by bands of rows
+	 */
+	void DrawFullImage( const SDepthSource& rSource, nite::UserId uID, SUserImageBuffer& rBuffer );
+
+	/**
+	 * Only redraw the tiles which signature changed
+	 */
+	void DrawChangedTiles( const SDepthSource& rSource, nite::UserId uID, SUserImageBuffer& rBuffer );
+
+	/**
+	 * Draw pixels in rectangle of image
+	 */
+	void DrawRect( const SDepthSource& rSource, nite::UserId uID, const QRect& rRect, SUserImageBuffer& rBuffer );
+
+	/**
+	 * Colorize continuous pixels by colormap or colorizer
+	 */
+	void DrawPixels( const openni::DepthPixel* pDepth, const nite::UserId* pUserMap, nite::UserId uID, int w, int h, unsigned char* pDst, int iStride ) const;
+
+public:
+
 	void SetSize( int w, int h )
 	{
 		float fDirSize = w / 16;
@@ -143,25 +486,26 @@ public:
 		m_UserDirection.resetTransform();
 		m_UserDirection.translate( w - fDirSize, h - fDirSize );
 
-		m_UserSkeleton.m_vPositionShift = QVector2D( w / 2, h * 2.0f / 3 );
-		m_UserSkeleton.m_fScale = 1.0f * w / 1600;
+		m_UserSkeleton.SetViewSize( w, h );
 
 		m_qRect = QRectF( 0, 0, w, h );
 	}
 
-	const nite::SkeletonJoint& GetActiveUserJoint( const nite::JointType& eJoint ) const 
-	{
-		return m_UserSkeleton.m_aJointOri[eJoint];
-	}
-
-	const QVector3D& GetActiveUserJointTR( const nite::JointType& eJoint ) const 
+	/**
+	 * The transformed pose of active user, for CGestureEngine::ProcessPose()
+	 */
+	const SSkeletonPose& GetActivePose() const
 	{
-		return m_UserSkeleton.m_aJointRotated[eJoint];
+		return m_UserSkeleton.GetPose();
 	}
 
-	const QPointF& GetActiveUserJoint2D( const nite::JointType& eJoint ) const 
+	/**
+	 * Users with tracked skeleton of the last update, the nearest first, for CGestureEngine::ProcessUsers().
+	 * They point into the frame of that update.
+	 */
+	const CUserSelector::TUserList& GetTrackedUsers() const
 	{
-		return m_UserSkeleton.m_aJoint2D[eJoint];
+		return m_UserSelector.GetUsers();
 	}
 
 	void KeepSkeletonTransform( bool bKeep )
@@ -176,8 +520,27 @@ public:
 
 private:
 	nite::UserTracker&		m_rUserTracker;
-	QGraphicsPixmapItem		m_UserImage;
+	CUserSelector			m_UserSelector;
+	QUserImage				m_UserImage;
 	QONI_Skeleton			m_UserSkeleton;
 	QUserDirection			m_UserDirection;
 	QRectF					m_qRect;
+	CDepthColorizer			m_Colorizer;
+	bool					m_bUseColorLUT;
+	CDepthColorLUT			m_ColorLUT;
+	QVector<QRgb>			m_aUserColorTable;
+	QVector<QRgb>			m_aDepthColorTable;
+	CWorkerPool				m_WorkerPool;
+	bool					m_bIncremental;
+	bool					m_bProcessSkeleton;
+	CMetrics*				m_pMetrics;
+	boost::atomic<bool>		m_bRenderVisible;
+	boost::atomic<int>		m_iViewWidth;
+
+	enum
+	{
+		COLORIZE_BAND	= 16,	/**< rows of each colorize task */
+		MAX_RENDER_STEP	= 8,	/**< coarsest sampling of depth frame */
+		GATHER_SIZE		= 256,	/**< pixels sampled per kernel call when downsampling */
+	};
 };
@@ -0,0 +1,174 @@
+#include "WorkerPool.h"
+
+// STL Header
+#include <algorithm>
+
+CWorkerPool::CWorkerPool( unsigned int uThreads )
+{
+	m_uThreads		= 1;
+	m_pTask			= NULL;
+	m_uGeneration	= 0;
+	m_uBusy			= 0;
+	m_bStop			= false;
+	SetThreadCount( uThreads );
+}
+
+CWorkerPool::~CWorkerPool()
+{
+	StopThreads();
+}
+
+void CWorkerPool::SetThreadCount( unsigned int uThreads )
+{
+	if( uThreads == 0 )
+		uThreads = std::max( boost::thread::hardware_concurrency(), 1u );
+
+	StopThreads();
+	m_uThreads = uThreads;
+	m_aRanges.reset( new SRange[m_uThreads] );
+	for( unsigned int i = 0; i < m_uThreads; ++ i )
+		m_aRanges[i].uRange.store( 0 );
+	StartThreads();
+}
+
+void CWorkerPool::ParallelFor( int iCount, const std::function<void(int)>& funcTask )
+{
+	if( m_uThreads == 1 || iCount <= 1 )
+	{
+		for( int i = 0; i < iCount; ++ i )
+			funcTask( i );
+		return;
+	}
+
+	// split tasks into ranges
+	for( unsigned int i = 0; i < m_uThreads; ++ i )
+	{
+		uint64_t uBegin	= uint64_t( iCount ) * i / m_uThreads,
+				 uEnd	= uint64_t( iCount ) * ( i + 1 ) / m_uThreads;
+		m_aRanges[i].uRange.store( ( uBegin << 32 ) | uEnd, boost::memory_order_relaxed );
+	}
+
+	// wake up workers
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_pTask	= &funcTask;
+		m_uBusy	= m_uThreads - 1;
+		++ m_uGeneration;
+	}
+	m_cvStart.notify_all();
+
+	// caller is worker 0
+	RunTasks( 0 );
+
+	boost::unique_lock<boost::mutex> lock( m_Mutex );
+	while( m_uBusy > 0 )
+		m_cvDone.wait( lock );
+	m_pTask = NULL;
+}
+
+void CWorkerPool::StartThreads()
+{
+	// new workers wait for the next job, not the last one run
+	unsigned int uGeneration;
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_bStop		= false;
+		uGeneration	= m_uGeneration;
+	}
+	for( unsigned int i = 1; i < m_uThreads; ++ i )
+		m_vThreads.push_back( new boost::thread( [this,i,uGeneration](){ WorkerLoop( i, uGeneration ); } ) );
+}
+
+void CWorkerPool::StopThreads()
+{
+	{
+		boost::lock_guard<boost::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_cvStart.notify_all();
+
+	for( auto itThread = m_vThreads.begin(); itThread != m_vThreads.end(); ++ itThread )
+	{
+		(*itThread)->join();
+		delete *itThread;
+	}
+	m_vThreads.clear();
+}
+
+void CWorkerPool::WorkerLoop( unsigned int uIndex, unsigned int uGeneration )
+{
+	while( true )
+	{
+		{
+			boost::unique_lock<boost::mutex> lock( m_Mutex );
+			while( !m_bStop && m_uGeneration == uGeneration )
+				m_cvStart.wait( lock );
+
+			if( m_bStop )
+				return;
+			uGeneration = m_uGeneration;
+		}
+
+		RunTasks( uIndex );
+
+		bool bLast;
+		{
+			boost::lock_guard<boost::mutex> lock( m_Mutex );
+			bLast = ( -- m_uBusy == 0 );
+		}
+		if( bLast )
+			m_cvDone.notify_one();
+	}
+}
+
+void CWorkerPool::RunTasks( unsigned int uIndex )
+{
+	const std::function<void(int)>& funcTask = *m_pTask;
+	int iTask;
+
+	// own tasks
+	while( PopFront( m_aRanges[uIndex], iTask ) )
+		funcTask( iTask );
+
+	// steal from others, start from the next worker
+	for( unsigned int i = 1; i < m_uThreads; ++ i )
+	{
+		SRange& rVictim = m_aRanges[( uIndex + i ) % m_uThreads];
+		while( PopBack( rVictim, iTask ) )
+			funcTask( iTask );
+	}
+}
+
+bool CWorkerPool::PopFront( SRange& rRange, int& iTask )
+{
+	uint64_t uRange = rRange.uRange.load( boost::memory_order_acquire );
+	while( true )
+	{
+		uint64_t uBegin = uRange >> 32, uEnd = uRange & 0xffffffff;
+		if( uBegin >= uEnd )
+			return false;
+
+		if( rRange.uRange.compare_exchange_weak( uRange, ( ( uBegin + 1 ) << 32 ) | uEnd, boost::memory_order_acq_rel ) )
+		{
+			iTask = int( uBegin );
+			return true;
+		}
+	}
+}
+
+bool CWorkerPool::PopBack( SRange& rRange, int& iTask )
+{
+	uint64_t uRange = rRange.uRange.load( boost::memory_order_acquire );
+	while( true )
+	{
+		uint64_t uBegin = uRange >> 32, uEnd = uRange & 0xffffffff;
+		if( uBegin >= uEnd )
+			return false;
+
+		if( rRange.uRange.compare_exchange_weak( uRange, ( uBegin << 32 ) | ( uEnd - 1 ), boost::memory_order_acq_rel ) )
+		{
+			iTask = int( uEnd - 1 );
+			return true;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#pragma region Header Files
+// STL Header
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Boost Header
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#pragma endregion
+
+/**
+ * Persistent worker threads for data-parallel loops.
+ *
+ * ParallelFor() splits the tasks into one contiguous range per worker. Each worker takes
+ * tasks from the front of its own range, and when it is empty, steals tasks from the back
+ * of the other ranges, so uneven tasks still balance. The calling thread works too.
+ */
+class CWorkerPool
+{
+public:
+	/**
+	 * uThreads is the total number of threads including the caller, 0 to use all cores
+	 */
+	CWorkerPool( unsigned int uThreads = 0 );
+	~CWorkerPool();
+
+	/**
+	 * Change the number of threads, 0 to use all cores
+	 */
+	void SetThreadCount( unsigned int uThreads );
+
+	/**
+	 * The number of threads including the caller
+	 */
+	unsigned int GetThreadCount() const
+	{
+		return m_uThreads;
+	}
+
+	/**
+	 * Run funcTask( i ) for i in [0, iCount), and wait for all tasks done.
+	 * Should not be called by different threads at the same time.
+	 */
+	void ParallelFor( int iCount, const std::function<void(int)>& funcTask );
+
+private:
+	/**
+	 * Task range of a worker, begin in high 32 bits and end in low 32 bits.
+	 * Padded to avoid false sharing between workers.
+	 */
+	struct SRange
+	{
+		boost::atomic<uint64_t>	uRange;
+		char					aPadding[64 - sizeof(boost::atomic<uint64_t>)];
+	};
+
+	void StartThreads();
+	void StopThreads();
+	/**
+	 * uGeneration is the job generation when the thread is started
+	 */
+	void WorkerLoop( unsigned int uIndex, unsigned int uGeneration );
+	void RunTasks( unsigned int uIndex );
+	bool PopFront( SRange& rRange, int& iTask );
+	bool PopBack( SRange& rRange, int& iTask );
+
+private:
+	unsigned int						m_uThreads;
+	std::vector<boost::thread*>			m_vThreads;
+	std::unique_ptr<SRange[]>			m_aRanges;
+	const std::function<void(int)>*		m_pTask;
+
+	boost::mutex				m_Mutex;
+	boost::condition_variable	m_cvStart;
+	boost::condition_variable	m_cvDone;
+	unsigned int				m_uGeneration;
+	unsigned int				m_uBusy;
+	bool						m_bStop;
+};
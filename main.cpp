@@ -2,29 +2,92 @@
 
 // Application header
 #include "NIControl.h"
+#include "NIDaemon.h"
 
 #pragma endregion
 
 int main( int argc, char** argv )
 {
+	#pragma region Options
+	// NIController [INI file] [--record file [--compress]] [--replay file] [--speed x] [--simulate] [--headless]
+	// NIController --unpack compressed_file session_file
+	// parsed before QApplication, which is not created in headless mode
+	QString sINIFile = "NIController.ini", sRecordFile, sReplayFile;
+	float fReplaySpeed = 1.0f;
+	bool bCompress = false, bSimulate = false, bHeadless = false;
+	QStringList aArgs;
+	for( int i = 0; i < argc; ++ i )
+		aArgs.append( QString::fromLocal8Bit( argv[i] ) );
+	for( int i = 1; i < aArgs.size(); ++ i )
+	{
+		if( aArgs[i] == "--unpack" && i + 2 < aArgs.size() )
+			return UnpackSession( aArgs[i + 1].toLocal8Bit().constData(), aArgs[i + 2].toLocal8Bit().constData() ) ? 0 : -1;
+		else if( aArgs[i] == "--record" && i + 1 < aArgs.size() )
+			sRecordFile = aArgs[++i];
+		else if( aArgs[i] == "--compress" )
+			bCompress = true;
+		else if( aArgs[i] == "--replay" && i + 1 < aArgs.size() )
+			sReplayFile = aArgs[++i];
+		else if( aArgs[i] == "--speed" && i + 1 < aArgs.size() )
+			fReplaySpeed = aArgs[++i].toFloat();
+		else if( aArgs[i] == "--simulate" )
+			bSimulate = true;
+		else if( aArgs[i] == "--headless" )
+			bHeadless = true;
+		else
+			sINIFile = aArgs[i];
+	}
+	if( !bHeadless )
+		bHeadless = QSettings( sINIFile, QSettings::IniFormat ).value( "Control/Headless", false ).toBool();
+	#pragma endregion
+
+	#pragma region Headless
+	if( bHeadless )
+	{
+		CNIDaemon mDaemon( sINIFile );
+		if( !sReplayFile.isEmpty() )
+		{
+			if( !mDaemon.OpenSession( sReplayFile, fReplaySpeed ) )
+				return -1;
+		}
+		else if( bSimulate )
+		{
+			mDaemon.OpenSimulator();
+		}
+		else if( !mDaemon.InitialNIDevice() )
+		{
+			return -1;
+		}
+		if( !sRecordFile.isEmpty() )
+			mDaemon.RecordSession( sRecordFile, bCompress );
+		return mDaemon.Run();
+	}
+	#pragma endregion
+
 	#pragma region Qt Core
 	// Qt Application
 	QApplication qOpenNIApp( argc, argv );
 	#pragma endregion
 
 	#pragma region Qt Widget
-	QString sINIFile = "";
-	if( argc > 1 )
-		sINIFile = argv[1];
-	else
-		sINIFile = "NIController.ini";
-
 	// Qt Window
 	QNIControl qWin( sINIFile );
-	qWin.InitialNIDevice();
+	if( !sReplayFile.isEmpty() )
+	{
+		if( !qWin.OpenSession( sReplayFile, fReplaySpeed ) )
+			return -1;
+	}
+	else if( bSimulate )
+	{
+		qWin.OpenSimulator();
+	}
+	else
+	{
+		qWin.InitialNIDevice();
+	}
+	if( !sRecordFile.isEmpty() )
+		qWin.RecordSession( sRecordFile, bCompress );
 	qWin.show();
-
-	qWin.m_fJointConfidence;	//TODO: should assign from option
 	#pragma endregion
 
 	// main loop
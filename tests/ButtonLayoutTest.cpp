@@ -0,0 +1,65 @@
+#include "ButtonLayout.h"
+
+// STL Header
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// POSIX Header
+#include <unistd.h>
+
+static int s_iFailed = 0;
+
+static void Check( bool bOK, const char* szWhat )
+{
+	if( !bOK )
+	{
+		std::cerr << "FAILED: " << szWhat << std::endl;
+		++ s_iFailed;
+	}
+}
+
+/**
+ * Load a layout of one page with the button actions in aAction
+ */
+static bool LoadActions( CButtonLayout& rLayout, const char* const* aAction, int iCount )
+{
+	std::ostringstream ssName;
+	ssName << "ButtonLayoutTest" << getpid() << ".ini";
+	std::string sName = ssName.str();
+	{
+		std::ofstream fsFile( sName.c_str() );
+		fsFile << "[Layout]\nPages = main\n\n[main]\nArrange = radial\nButtons\\size = " << iCount << "\n";
+		for( int i = 0; i < iCount; ++ i )
+			fsFile << "Buttons\\" << i + 1 << "\\Action = " << aAction[i] << "\n";
+	}
+	bool bOK = rLayout.Load( QString( sName.c_str() ) );
+	unlink( sName.c_str() );
+	return bOK;
+}
+
+int main()
+{
+	// a single letter or digit is the key itself, numbers are codes only with 0x
+	const char* aKeys[] = { "key 5", "key A", "key 0x22", "key 0", "key a", "key NEXT" };
+	const unsigned short aCodes[] = { '5', 'A', 0x22, '0', 'A', 0x22 };
+	CButtonLayout mLayout;
+	bool bOK = LoadActions( mLayout, aKeys, 6 ) && mLayout.m_aPages.size() == 1 && mLayout.m_aPages[0].aButtons.size() == 6;
+	for( int i = 0; bOK && i < 6; ++ i )
+	{
+		const CButtonLayout::SButton& rButton = mLayout.m_aPages[0].aButtons[i];
+		bOK = ( rButton.eAction == CButtonLayout::BA_KEY && rButton.uKey == aCodes[i] );
+		if( !bOK )
+			std::cerr << aKeys[i] << " is " << rButton.uKey << std::endl;
+	}
+	Check( bOK, "key actions" );
+
+	// decimal codes and words which are not key names are errors
+	const char* aWrong[] = { "key 34", "key 0x", "key 0x0", "key PAGE_DOWN" };
+	for( int i = 0; i < 4; ++ i )
+		Check( !LoadActions( mLayout, aWrong + i, 1 ), aWrong[i] );
+
+	if( s_iFailed == 0 )
+		std::cout << "ButtonLayout: all passed" << std::endl;
+	return s_iFailed == 0 ? 0 : 1;
+}
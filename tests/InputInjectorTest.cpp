@@ -0,0 +1,123 @@
+#include "InputInjector.h"
+#include "Metrics.h"
+
+// STL Header
+#include <iostream>
+#include <map>
+#include <vector>
+
+static int s_iFailed = 0;
+
+static void Check( bool bOK, const char* szWhat )
+{
+	if( !bOK )
+	{
+		std::cerr << "FAILED: " << szWhat << std::endl;
+		++ s_iFailed;
+	}
+}
+
+/**
+ * Wait until the backend has sent uCount events, or a second passed
+ */
+static std::vector<SInputEvent> WaitForEvents( const CRecordInputBackend& rBackend, size_t uCount )
+{
+	std::vector<SInputEvent> aEvents = rBackend.GetEvents();
+	for( int i = 0; i < 1000 && aEvents.size() < uCount; ++ i )
+	{
+		boost::this_thread::sleep_for( boost::chrono::milliseconds( 1 ) );
+		aEvents = rBackend.GetEvents();
+	}
+	return aEvents;
+}
+
+static bool IsKey( const SInputEvent& rEvent, SInputEvent::EType eType, unsigned short uKey )
+{
+	return rEvent.eType == eType && rEvent.uKey == uKey;
+}
+
+int main()
+{
+	CMetrics mMetrics;
+	CInputInjector mInjector;
+	mInjector.m_pMetrics = &mMetrics;
+	if( !mInjector.Start( CInputInjector::IB_NULL ) )
+	{
+		std::cerr << "FAILED: start null backend" << std::endl;
+		return 1;
+	}
+	CRecordInputBackend& rBackend = dynamic_cast<CRecordInputBackend&>( *mInjector.GetBackend() );
+
+	// keys are sent in the order queued, each released right after it is pressed
+	bool bOK = true;
+	for( unsigned short uKey = 'A'; uKey <= 'Z'; ++ uKey )
+		bOK = mInjector.PressKey( uKey ) && bOK;
+	Check( bOK, "keys queued" );
+	std::vector<SInputEvent> aEvents = WaitForEvents( rBackend, 52 );
+	bOK = ( aEvents.size() == 52 );
+	for( size_t i = 0; bOK && i < 26; ++ i )
+	{
+		bOK =	IsKey( aEvents[i * 2], SInputEvent::IE_KEY_DOWN, 'A' + i ) &&
+				IsKey( aEvents[i * 2 + 1], SInputEvent::IE_KEY_UP, 'A' + i ) &&
+				aEvents[i * 2].iInjectTime >= aEvents[i * 2].iQueueTime;
+	}
+	Check( bOK, "event order" );
+
+	// chord keys are pressed in order and released in reverse order
+	const unsigned short aChord[] = { 0x11, 0x10, 'C' };
+	Check( mInjector.PressChord( aChord, 3 ), "chord queued" );
+	Check( mInjector.MoveMouse( 5, -3 ), "mouse queued" );
+	aEvents = WaitForEvents( rBackend, 59 );
+	bOK = ( aEvents.size() == 59 );
+	for( int i = 0; bOK && i < 3; ++ i )
+	{
+		bOK =	IsKey( aEvents[52 + i], SInputEvent::IE_KEY_DOWN, aChord[i] ) &&
+				IsKey( aEvents[55 + i], SInputEvent::IE_KEY_UP, aChord[2 - i] );
+	}
+	Check( bOK, "chord release order" );
+	Check( bOK && aEvents[58].eType == SInputEvent::IE_MOUSE_MOVE && aEvents[58].iX == 5 && aEvents[58].iY == -3, "mouse move" );
+
+	// a burst larger than the queue: presses may be dropped, but each press sent is released
+	size_t uQueued = aEvents.size();
+	for( int i = 0; i < 5000; ++ i )
+	{
+		unsigned short uKey = 'A' + i % 26;
+		if( mInjector.KeyDown( uKey ) )
+		{
+			mInjector.KeyUp( uKey );
+			uQueued += 2;
+		}
+	}
+
+	// and the events queued before Stop() are all injected
+	mInjector.Stop();
+	aEvents = rBackend.GetEvents();
+	Check( aEvents.size() == uQueued, "queued events injected before stop" );
+
+	std::map<unsigned short,int> mHeld;
+	bOK = true;
+	for( size_t i = 59; i < aEvents.size(); ++ i )
+	{
+		int& rHeld = mHeld[aEvents[i].uKey];
+		rHeld += ( aEvents[i].eType == SInputEvent::IE_KEY_DOWN ? 1 : -1 );
+		bOK = bOK && ( rHeld == 0 || rHeld == 1 );
+	}
+	for( auto itKey = mHeld.begin(); itKey != mHeld.end(); ++ itKey )
+		bOK = bOK && itKey->second == 0;
+	Check( bOK, "every key released" );
+	Check( uQueued == 59 + 2 * ( 5000 - mInjector.GetDropped() ), "only dropped presses missing" );
+
+	// each start has a new backend, which gets all the keys pressed before stop
+	bOK = true;
+	for( int i = 0; i < 100 && bOK; ++ i )
+	{
+		bOK = mInjector.Start( CInputInjector::IB_NULL ) && mInjector.PressKey( 'A' ) && mInjector.PressKey( 'B' );
+		mInjector.Stop();
+		bOK = bOK && dynamic_cast<CRecordInputBackend&>( *mInjector.GetBackend() ).GetEvents().size() == 4;
+	}
+	Check( bOK, "restart" );
+
+	if( s_iFailed == 0 )
+		std::cout << "InputInjector: all passed" << std::endl;
+	return s_iFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+#include "SharedPublisher.h"
+#include "SharedReader.h"
+
+// STL Header
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Boost Header
+#include <boost/thread.hpp>
+
+// POSIX Header
+#include <unistd.h>
+
+using namespace SharedFrame;
+
+enum
+{
+	MAP_WIDTH	= 64,
+	MAP_HEIGHT	= 48,
+	MAP_STEP	= 4,
+	FRAMES		= 200000,
+};
+
+static int s_iFailed = 0;
+
+static void Check( bool bOK, const char* szWhat )
+{
+	if( !bOK )
+	{
+		std::cerr << "FAILED: " << szWhat << std::endl;
+		++ s_iFailed;
+	}
+}
+
+/**
+ * Write frame uNumber with every value derived from it, so a frame mixed from two is detected
+ */
+static void PublishFrame( CSharedPublisher& rPublisher, std::vector<int16_t>& rUserMap )
+{
+	SSharedFrame* pFrame = rPublisher.Begin();
+	uint64_t uNumber = pFrame->uFrameNumber;
+	pFrame->uTimestamp	= uNumber * 33333;
+	pFrame->iFrameIndex	= int32_t( uNumber );
+	pFrame->uUserCount	= uint32_t( uNumber % MAX_USERS ) + 1;
+	for( uint32_t u = 0; u < pFrame->uUserCount; ++ u )
+	{
+		SSharedUser& rUser = pFrame->aUsers[u];
+		rUser.iUserID	= int32_t( uNumber + u );
+		rUser.iSlot		= int32_t( u );
+		for( int j = 0; j < JOINTS; ++ j )
+		{
+			for( int k = 0; k < 4; ++ k )
+				rUser.aJoint[j][k] = float( uNumber % 100000 );
+		}
+	}
+
+	int16_t iValue = int16_t( uNumber % 200 );
+	for( auto itPixel = rUserMap.begin(); itPixel != rUserMap.end(); ++ itPixel )
+		*itPixel = iValue;
+	rPublisher.Commit( rUserMap.data(), MAP_WIDTH, MAP_HEIGHT );
+}
+
+static bool IsConsistent( const SSharedFrame& rFrame, const std::vector<uint8_t>& rUserMap )
+{
+	uint64_t uNumber = rFrame.uFrameNumber;
+	if( rFrame.uTimestamp != uNumber * 33333 || rFrame.iFrameIndex != int32_t( uNumber ) ||
+		rFrame.uUserCount != uint32_t( uNumber % MAX_USERS ) + 1 )
+		return false;
+
+	for( uint32_t u = 0; u < rFrame.uUserCount; ++ u )
+	{
+		const SSharedUser& rUser = rFrame.aUsers[u];
+		if( rUser.iUserID != int32_t( uNumber + u ) || rUser.iSlot != int32_t( u ) )
+			return false;
+		for( int j = 0; j < JOINTS; ++ j )
+		{
+			for( int k = 0; k < 4; ++ k )
+			{
+				if( rUser.aJoint[j][k] != float( uNumber % 100000 ) )
+					return false;
+			}
+		}
+	}
+
+	if( rFrame.uMapWidth != MAP_WIDTH / MAP_STEP || rFrame.uMapHeight != MAP_HEIGHT / MAP_STEP ||
+		rUserMap.size() != size_t( rFrame.uMapWidth ) * rFrame.uMapHeight )
+		return false;
+	for( auto itPixel = rUserMap.begin(); itPixel != rUserMap.end(); ++ itPixel )
+	{
+		if( *itPixel != uint8_t( uNumber % 200 ) )
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	std::ostringstream ssName;
+	ssName << "NIControllerTest" << getpid();
+	std::string sName = ssName.str();
+
+	CSharedFrameReader mReader;
+	Check( !mReader.Open( sName ), "no memory before publisher" );
+
+	CSharedPublisher mPublisher;
+	if( !mPublisher.Open( sName, 4, MAP_STEP, MAP_WIDTH, MAP_HEIGHT ) )
+	{
+		std::cerr << "FAILED: open publisher" << std::endl;
+		return 1;
+	}
+	Check( mReader.Open( sName ), "reader open" );
+
+	SSharedFrame mFrame;
+	std::vector<uint8_t> aUserMap;
+	Check( !mReader.ReadLatest( mFrame, &aUserMap ), "nothing before first frame" );
+
+	// one frame round trip, and it is only read once
+	std::vector<int16_t> aSource( MAP_WIDTH * MAP_HEIGHT );
+	PublishFrame( mPublisher, aSource );
+	Check( mReader.ReadLatest( mFrame, &aUserMap ) && mFrame.uFrameNumber == 1 && IsConsistent( mFrame, aUserMap ), "first frame" );
+	Check( !mReader.ReadLatest( mFrame, &aUserMap ), "same frame not read again" );
+
+	// the user map is sampled every MAP_STEP pixels
+	for( int y = 0; y < MAP_HEIGHT; ++ y )
+	{
+		for( int x = 0; x < MAP_WIDTH; ++ x )
+			aSource[y * MAP_WIDTH + x] = int16_t( ( x / MAP_STEP + y / MAP_STEP ) % 3 );
+	}
+	mPublisher.Begin();
+	mPublisher.Commit( aSource.data(), MAP_WIDTH, MAP_HEIGHT );
+	bool bOK = mReader.ReadLatest( mFrame, &aUserMap ) && aUserMap.size() == ( MAP_WIDTH / MAP_STEP ) * ( MAP_HEIGHT / MAP_STEP );
+	for( int i = 0; bOK && i < int( aUserMap.size() ); ++ i )
+		bOK = ( aUserMap[i] == ( i % ( MAP_WIDTH / MAP_STEP ) + i / ( MAP_WIDTH / MAP_STEP ) ) % 3 );
+	Check( bOK, "user map sampled" );
+
+	// a reader running with the publisher never gets a frame mixed from two
+	boost::atomic<bool> bDone( false );
+	uint64_t uRead = 0, uTorn = 0, uBackward = 0;
+	boost::thread tReader( [&](){
+		CSharedFrameReader mOther;
+		SSharedFrame mRead;
+		std::vector<uint8_t> aRead;
+		uint64_t uLast = 0;
+		if( !mOther.Open( sName ) )
+			return;
+		while( !bDone.load() )
+		{
+			if( !mOther.ReadLatest( mRead, &aRead ) )
+				continue;
+			++ uRead;
+			if( !IsConsistent( mRead, aRead ) )
+				++ uTorn;
+			if( mRead.uFrameNumber <= uLast )
+				++ uBackward;
+			uLast = mRead.uFrameNumber;
+		}
+	} );
+	for( int i = 0; i < FRAMES; ++ i )
+	{
+		PublishFrame( mPublisher, aSource );
+
+		// let the reader run on a single core too
+		if( i % 64 == 0 )
+			boost::this_thread::yield();
+	}
+	bDone.store( true );
+	tReader.join();
+	Check( uRead > 0, "frames read while publishing" );
+	Check( uTorn == 0, "no torn frame" );
+	Check( uBackward == 0, "frames read in order" );
+	Check( mPublisher.GetPublished() == FRAMES + 2, "frames published" );
+
+	// the memory is removed with the publisher
+	mReader.Close();
+	mPublisher.Close();
+	Check( !mReader.Open( sName ), "memory removed on close" );
+
+	if( s_iFailed == 0 )
+		std::cout << "SharedFrame: all passed, " << uRead << " of " << FRAMES << " frames read" << std::endl;
+	return s_iFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include "WorkerPool.h"
+
+// STL Header
+#include <iostream>
+#include <vector>
+
+static int s_iFailed = 0;
+
+static void Check( bool bOK, const char* szWhat )
+{
+	if( !bOK )
+	{
+		std::cerr << "FAILED: " << szWhat << std::endl;
+		++ s_iFailed;
+	}
+}
+
+/**
+ * Run iCount tasks and check each one runs once
+ */
+static bool RunOnce( CWorkerPool& rPool, int iCount )
+{
+	std::vector<boost::atomic<int>> aRuns( iCount );
+	for( auto itRun = aRuns.begin(); itRun != aRuns.end(); ++ itRun )
+		itRun->store( 0 );
+
+	rPool.ParallelFor( iCount, [&aRuns]( int i ){ aRuns[i].fetch_add( 1 ); } );
+	for( int i = 0; i < iCount; ++ i )
+	{
+		if( aRuns[i].load() != 1 )
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	CWorkerPool mPool( 4 );
+	Check( RunOnce( mPool, 1000 ), "tasks run once" );
+
+	// uneven tasks are stolen by the other workers
+	boost::atomic<int> iSum( 0 );
+	mPool.ParallelFor( 64, [&iSum]( int i ){
+		if( i == 0 )
+			boost::this_thread::sleep_for( boost::chrono::milliseconds( 20 ) );
+		iSum.fetch_add( i );
+	} );
+	Check( iSum.load() == 64 * 63 / 2, "uneven tasks" );
+
+	// threads started after jobs have run must wait for the next job, or they finish it early
+	bool bOK = true;
+	for( int i = 0; i < 50 && bOK; ++ i )
+	{
+		unsigned int uThreads = 2 + i % 5;
+		mPool.SetThreadCount( uThreads );
+		bOK = ( mPool.GetThreadCount() == uThreads );
+
+		// let the new threads start before the job, then again right after the reconfigure
+		if( i % 2 == 0 )
+			boost::this_thread::sleep_for( boost::chrono::milliseconds( 2 ) );
+		boost::atomic<int> iDone( 0 );
+		mPool.ParallelFor( 64, [&iDone]( int ){ iDone.fetch_add( 1 ); } );
+		bOK = bOK && ( iDone.load() == 64 );
+	}
+	Check( bOK, "all tasks done after reconfigure" );
+	Check( RunOnce( mPool, 500 ), "tasks run once after reconfigure" );
+
+	if( s_iFailed == 0 )
+		std::cout << "WorkerPool: all passed" << std::endl;
+	return s_iFailed == 0 ? 0 : 1;
+}